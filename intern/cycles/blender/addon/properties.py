@@ -349,6 +349,13 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         min=0.0, max=1.0,
         default=0.01,
     )
+    use_light_tree: BoolProperty(
+        name="Light Tree",
+        description="Pick lights based on their estimated contribution to the shading point, "
+        "using a hierarchy of bounding boxes and cones (faster convergence in scenes with many lights, "
+        "not compatible with sampling all lights, CPU only)",
+        default=False,
+    )
 
     use_adaptive_sampling: BoolProperty(
         name="Use Adaptive Sampling",
@@ -644,6 +651,11 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         description="Use special type BVH optimized for hair (uses more ram but renders faster)",
         default=True,
     )
+    debug_use_compressed_bvh: BoolProperty(
+        name="Use Compressed BVH",
+        description="Store BVH node bounds with 8 bit precision (uses less ram but renders slower, CPU only)",
+        default=False,
+    )
     debug_bvh_time_steps: IntProperty(
         name="BVH Time Steps",
         description="Split BVH primitives by this number of time steps to speed up render time in cost of memory",
@@ -757,6 +769,20 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         items=enum_texture_limit
     )
 
+    use_texture_cache: BoolProperty(
+        name="Texture Cache",
+        description="Read image tiles from files on demand when rendering on the CPU, "
+        "instead of loading all images into memory up front",
+        default=False,
+    )
+    texture_cache_size: IntProperty(
+        name="Cache Size",
+        description="Memory limit of the texture cache in megabytes, "
+        "least recently used tiles are freed first",
+        min=64, max=1048576,
+        default=4096,
+    )
+
     ao_bounces: IntProperty(
         name="AO Bounces",
         default=0,
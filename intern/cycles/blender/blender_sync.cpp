@@ -301,6 +301,7 @@ void BlenderSync::sync_integrator()
   integrator->sample_all_lights_direct = get_boolean(cscene, "sample_all_lights_direct");
   integrator->sample_all_lights_indirect = get_boolean(cscene, "sample_all_lights_indirect");
   integrator->light_sampling_threshold = get_float(cscene, "light_sampling_threshold");
+  integrator->use_light_tree = get_boolean(cscene, "use_light_tree");
 
   if (RNA_boolean_get(&cscene, "use_adaptive_sampling")) {
     integrator->sampling_pattern = SAMPLING_PATTERN_PMJ;
@@ -353,6 +354,9 @@ void BlenderSync::sync_integrator()
     integrator->ao_bounces = 0;
   }
 
+  if (integrator->use_light_tree != previntegrator.use_light_tree)
+    scene->light_manager->tag_update(scene);
+
   if (integrator->modified(previntegrator))
     integrator->tag_update(scene);
 }
@@ -734,6 +738,7 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
 
   params.use_bvh_spatial_split = RNA_boolean_get(&cscene, "debug_use_spatial_splits");
   params.use_bvh_unaligned_nodes = RNA_boolean_get(&cscene, "debug_use_hair_bvh");
+  params.use_bvh_compressed_nodes = RNA_boolean_get(&cscene, "debug_use_compressed_bvh");
   params.num_bvh_time_steps = RNA_int_get(&cscene, "debug_bvh_time_steps");
 
   if (background && params.shadingsystem != SHADINGSYSTEM_OSL)
@@ -755,6 +760,9 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
     params.texture_limit = 0;
   }
 
+  params.use_texture_cache = RNA_boolean_get(&cscene, "use_texture_cache");
+  params.texture_cache_size = RNA_int_get(&cscene, "texture_cache_size");
+
   /* TODO(sergey): Once OSL supports per-microarchitecture optimization get
    * rid of this.
    */
@@ -103,7 +103,12 @@ int BVHStackEntry::encodeIdx() const
 BVH::BVH(const BVHParams &params_,
          const vector<Geometry *> &geometry_,
          const vector<Object *> &objects_)
-    : params(params_), geometry(geometry_), objects(objects_)
+    : params(params_),
+      geometry(geometry_),
+      objects(objects_),
+      top_level_prims_size(0),
+      top_level_nodes_size(0),
+      top_level_leaf_nodes_size(0)
 {
 }
 
@@ -196,12 +201,20 @@ void BVH::build(Progress &progress, Stats *)
 
 void BVH::refit(Progress &progress)
 {
+  if (params.top_level) {
+    unpack_instances();
+  }
+
   progress.set_substatus("Packing BVH primitives");
   pack_primitives();
 
   if (progress.get_cancel())
     return;
 
+  if (params.top_level) {
+    pack_instances(top_level_nodes_size, top_level_leaf_nodes_size);
+  }
+
   progress.set_substatus("Refitting BVH nodes");
   refit_nodes();
 }
@@ -338,6 +351,74 @@ void BVH::pack_primitives()
   }
 }
 
+/* Compressed Nodes */
+
+uint BVH::quantize_child_bounds(const BoundBox *bounds,
+                                const int num,
+                                float3 &origin,
+                                float3 &scale,
+                                uchar lower[3][8],
+                                uchar upper[3][8])
+{
+  assert(num <= 8);
+
+  BoundBox node_bounds = BoundBox::empty;
+  uint child_mask = 0;
+  for (int i = 0; i < num; i++) {
+    if (bounds[i].valid()) {
+      node_bounds.grow(bounds[i]);
+      child_mask |= (1 << i);
+    }
+  }
+
+  memset(lower, 0, sizeof(uchar) * 3 * 8);
+  memset(upper, 0, sizeof(uchar) * 3 * 8);
+
+  if (child_mask == 0) {
+    origin = make_float3(0.0f, 0.0f, 0.0f);
+    scale = make_float3(0.0f, 0.0f, 0.0f);
+    return 0;
+  }
+
+  /* Margin for the precision lost when the kernel reconstructs the bounds, so planes
+   * are always outside of the original bounds. */
+  const float3 margin = (fabs(node_bounds.min) + fabs(node_bounds.max)) * (4.0f * FLT_EPSILON);
+  origin = node_bounds.min - margin;
+  scale = (node_bounds.size() + 2.0f * margin) * (1.0f / 255.0f);
+
+  for (int axis = 0; axis < 3; axis++) {
+    const float o = origin[axis];
+    const float s = scale[axis];
+    const float m = margin[axis];
+    if (s == 0.0f) {
+      continue;
+    }
+
+    for (int i = 0; i < num; i++) {
+      if (!(child_mask & (1 << i))) {
+        continue;
+      }
+
+      const float bmin = bounds[i].min[axis];
+      const float bmax = bounds[i].max[axis];
+
+      int q_lower = (int)clamp(floorf((bmin - o) / s), 0.0f, 255.0f);
+      while (q_lower > 0 && o + q_lower * s > bmin - m) {
+        q_lower--;
+      }
+      int q_upper = (int)clamp(ceilf((bmax - o) / s), 0.0f, 255.0f);
+      while (q_upper < 255 && o + q_upper * s < bmax + m) {
+        q_upper++;
+      }
+
+      lower[axis][i] = (uchar)q_lower;
+      upper[axis][i] = (uchar)q_upper;
+    }
+  }
+
+  return child_mask;
+}
+
 /* Pack Instances */
 
 void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
@@ -349,6 +430,10 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
   const bool use_qbvh = (params.bvh_layout == BVH_LAYOUT_BVH4);
   const bool use_obvh = (params.bvh_layout == BVH_LAYOUT_BVH8);
 
+  top_level_prims_size = pack.prim_index.size();
+  top_level_nodes_size = nodes_size;
+  top_level_leaf_nodes_size = leaf_nodes_size;
+
   /* Adjust primitive index to point to the triangle in the global array, for
    * geometry with transform applied and already in the top level BVH.
    */
@@ -510,7 +595,11 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
       for (size_t i = 0, j = 0; i < bvh_nodes_size; j++) {
         size_t nsize, nsize_bbox;
-        if (bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
+        if ((use_qbvh || use_obvh) && (bvh_nodes[i].x & PATH_RAY_NODE_COMPRESSED)) {
+          nsize = (use_obvh) ? BVH_ONODE_COMPRESSED_SIZE : BVH_QNODE_COMPRESSED_SIZE;
+          nsize_bbox = nsize - 1;
+        }
+        else if (bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
           if (use_obvh) {
             nsize = BVH_UNALIGNED_ONODE_SIZE;
             nsize_bbox = BVH_UNALIGNED_ONODE_SIZE - 1;
@@ -577,4 +666,24 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
   }
 }
 
+/* Remove the instances merged by pack_instances(), restoring the top level arrays as they
+ * were after packing the top level primitives. */
+void BVH::unpack_instances()
+{
+  pack.prim_index.resize(top_level_prims_size);
+  pack.prim_type.resize(top_level_prims_size);
+  pack.prim_object.resize(top_level_prims_size);
+  if (pack.prim_time.size()) {
+    pack.prim_time.resize(top_level_prims_size);
+  }
+  pack.nodes.resize(top_level_nodes_size);
+  pack.leaf_nodes.resize(top_level_leaf_nodes_size);
+
+  for (size_t i = 0; i < pack.prim_index.size(); i++) {
+    if (pack.prim_index[i] != -1) {
+      pack.prim_index[i] -= objects[pack.prim_object[i]]->geometry->prim_offset;
+    }
+  }
+}
+
 CCL_NAMESPACE_END
@@ -99,6 +99,8 @@ class BVH {
   {
   }
 
+  /* Update bounds for deformed geometry, keeping the tree structure. For the top level,
+   * the BVHs of instanced geometry must have been refit first. */
   void refit(Progress &progress);
 
  protected:
@@ -106,6 +108,11 @@ class BVH {
       const vector<Geometry *> &geometry,
       const vector<Object *> &objects);
 
+  /* Sizes of the top level arrays without the merged instances, to merge again on refit. */
+  size_t top_level_prims_size;
+  size_t top_level_nodes_size;
+  size_t top_level_leaf_nodes_size;
+
   /* Refit range of primitives. */
   void refit_primitives(int start, int end, BoundBox &bbox, uint &visibility);
 
@@ -113,8 +120,19 @@ class BVH {
   void pack_primitives();
   void pack_triangle(int idx, float4 storage[3]);
 
+  /* Quantize child bounds of a compressed node to 8 bits per axis, relative to their
+   * union. Bounds are rounded outwards so the quantized boxes contain the original ones.
+   * Returns the mask of children with valid bounds. */
+  static uint quantize_child_bounds(const BoundBox *bounds,
+                                    const int num,
+                                    float3 &origin,
+                                    float3 &scale,
+                                    uchar lower[3][8],
+                                    uchar upper[3][8]);
+
   /* merge instance BVH's */
   void pack_instances(size_t nodes_size, size_t leaf_nodes_size);
+  void unpack_instances();
 
   /* for subclasses to implement */
   virtual void pack_nodes(const BVHNode *root) = 0;
@@ -23,6 +23,10 @@
 #include "bvh/bvh_node.h"
 #include "bvh/bvh_unaligned.h"
 
+#include "util/util_logging.h"
+#include "util/util_string.h"
+#include "util/util_time.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* Can we avoid this somehow or make more generic?
@@ -156,8 +160,14 @@ void BVH4::pack_aligned_inner(const BVHStackEntry &e, const BVHStackEntry *en, i
     bounds[i] = en[i].node->bounds;
     child[i] = en[i].encodeIdx();
   }
-  pack_aligned_node(
-      e.idx, bounds, child, e.node->visibility, e.node->time_from, e.node->time_to, num);
+  if (params.use_compressed_nodes) {
+    pack_compressed_node(
+        e.idx, bounds, child, e.node->visibility, e.node->time_from, e.node->time_to, num);
+  }
+  else {
+    pack_aligned_node(
+        e.idx, bounds, child, e.node->visibility, e.node->time_from, e.node->time_to, num);
+  }
 }
 
 void BVH4::pack_aligned_node(int idx,
@@ -171,7 +181,8 @@ void BVH4::pack_aligned_node(int idx,
   float4 data[BVH_QNODE_SIZE];
   memset(data, 0, sizeof(data));
 
-  data[0].x = __uint_as_float(visibility & ~PATH_RAY_NODE_UNALIGNED);
+  data[0].x = __uint_as_float(visibility &
+                              ~(PATH_RAY_NODE_UNALIGNED | PATH_RAY_NODE_COMPRESSED));
   data[0].y = time_from;
   data[0].z = time_to;
 
@@ -208,6 +219,47 @@ void BVH4::pack_aligned_node(int idx,
   memcpy(&pack.nodes[idx], data, sizeof(float4) * BVH_QNODE_SIZE);
 }
 
+void BVH4::pack_compressed_node(int idx,
+                                const BoundBox *bounds,
+                                const int *child,
+                                const uint visibility,
+                                const float time_from,
+                                const float time_to,
+                                const int num)
+{
+  float3 origin, scale;
+  uchar lower[3][8], upper[3][8];
+  const uint child_mask = quantize_child_bounds(bounds, num, origin, scale, lower, upper);
+
+  float4 data[BVH_QNODE_COMPRESSED_SIZE];
+  memset(data, 0, sizeof(data));
+
+  data[0].x = __uint_as_float((visibility & ~PATH_RAY_NODE_UNALIGNED) |
+                              PATH_RAY_NODE_COMPRESSED);
+  data[0].y = time_from;
+  data[0].z = time_to;
+  /* Empty child slots are masked out by the kernel. */
+  data[0].w = __uint_as_float(child_mask);
+
+  data[1] = make_float4(origin.x, origin.y, origin.z, 0.0f);
+  data[2] = make_float4(scale.x, scale.y, scale.z, 0.0f);
+
+  /* One byte per child: lower and upper bounds of X and Y, Z is stored next to the
+   * origin and scale to fit the node into five float4. */
+  memcpy(&data[3].x, lower[0], 4);
+  memcpy(&data[3].y, upper[0], 4);
+  memcpy(&data[3].z, lower[1], 4);
+  memcpy(&data[3].w, upper[1], 4);
+  memcpy(&data[1].w, lower[2], 4);
+  memcpy(&data[2].w, upper[2], 4);
+
+  for (int i = 0; i < num; i++) {
+    data[4][i] = __int_as_float(child[i]);
+  }
+
+  memcpy(&pack.nodes[idx], data, sizeof(float4) * BVH_QNODE_COMPRESSED_SIZE);
+}
+
 void BVH4::pack_unaligned_inner(const BVHStackEntry &e, const BVHStackEntry *en, int num)
 {
   Transform aligned_space[4];
@@ -240,7 +292,8 @@ void BVH4::pack_unaligned_node(int idx,
   float4 data[BVH_UNALIGNED_QNODE_SIZE];
   memset(data, 0, sizeof(data));
 
-  data[0].x = __uint_as_float(visibility | PATH_RAY_NODE_UNALIGNED);
+  data[0].x = __uint_as_float((visibility & ~PATH_RAY_NODE_COMPRESSED) |
+                              PATH_RAY_NODE_UNALIGNED);
   data[0].y = time_from;
   data[0].z = time_to;
 
@@ -297,20 +350,20 @@ void BVH4::pack_unaligned_node(int idx,
 
 void BVH4::pack_nodes(const BVHNode *root)
 {
+  const double pack_start_time = time_dt();
+
   /* Calculate size of the arrays required. */
   const size_t num_nodes = root->getSubtreeSize(BVH_STAT_NODE_COUNT);
   const size_t num_leaf_nodes = root->getSubtreeSize(BVH_STAT_LEAF_COUNT);
   assert(num_leaf_nodes <= num_nodes);
   const size_t num_inner_nodes = num_nodes - num_leaf_nodes;
-  size_t node_size;
-  if (params.use_unaligned_nodes) {
-    const size_t num_unaligned_nodes = root->getSubtreeSize(BVH_STAT_UNALIGNED_INNER_COUNT);
-    node_size = (num_unaligned_nodes * BVH_UNALIGNED_QNODE_SIZE) +
-                (num_inner_nodes - num_unaligned_nodes) * BVH_QNODE_SIZE;
-  }
-  else {
-    node_size = num_inner_nodes * BVH_QNODE_SIZE;
-  }
+  const size_t num_unaligned_nodes = (params.use_unaligned_nodes) ?
+                                         root->getSubtreeSize(BVH_STAT_UNALIGNED_INNER_COUNT) :
+                                         0;
+  const int aligned_node_size = (params.use_compressed_nodes) ? BVH_QNODE_COMPRESSED_SIZE :
+                                                                BVH_QNODE_SIZE;
+  const size_t node_size = (num_unaligned_nodes * BVH_UNALIGNED_QNODE_SIZE) +
+                           (num_inner_nodes - num_unaligned_nodes) * aligned_node_size;
   /* Resize arrays. */
   pack.nodes.clear();
   pack.leaf_nodes.clear();
@@ -332,7 +385,7 @@ void BVH4::pack_nodes(const BVHNode *root)
   }
   else {
     stack.push_back(BVHStackEntry(root, nextNodeIdx));
-    nextNodeIdx += root->has_unaligned() ? BVH_UNALIGNED_QNODE_SIZE : BVH_QNODE_SIZE;
+    nextNodeIdx += root->has_unaligned() ? BVH_UNALIGNED_QNODE_SIZE : aligned_node_size;
   }
 
   while (stack.size()) {
@@ -359,7 +412,8 @@ void BVH4::pack_nodes(const BVHNode *root)
         }
         else {
           idx = nextNodeIdx;
-          nextNodeIdx += children[i]->has_unaligned() ? BVH_UNALIGNED_QNODE_SIZE : BVH_QNODE_SIZE;
+          nextNodeIdx += children[i]->has_unaligned() ? BVH_UNALIGNED_QNODE_SIZE :
+                                                        aligned_node_size;
         }
         stack.push_back(BVHStackEntry(children[i], idx));
       }
@@ -371,12 +425,23 @@ void BVH4::pack_nodes(const BVHNode *root)
   assert(node_size == nextNodeIdx);
   /* Root index to start traversal at, to handle case of single leaf node. */
   pack.root_index = (root->is_leaf()) ? -1 : 0;
+
+  if (params.use_compressed_nodes) {
+    const size_t uncompressed_node_size = (num_unaligned_nodes * BVH_UNALIGNED_QNODE_SIZE) +
+                                          (num_inner_nodes - num_unaligned_nodes) *
+                                              BVH_QNODE_SIZE;
+    VLOG(1) << "BVH4 compressed nodes statistics:\n"
+            << "  Pack time: " << time_dt() - pack_start_time << "\n"
+            << "  Number of inner nodes: " << string_human_readable_number(num_inner_nodes)
+            << "\n"
+            << "  Inner nodes memory: "
+            << string_human_readable_size(node_size * sizeof(int4)) << " (uncompressed "
+            << string_human_readable_size(uncompressed_node_size * sizeof(int4)) << ")\n";
+  }
 }
 
 void BVH4::refit_nodes()
 {
-  assert(!params.top_level);
-
   BoundBox bbox = BoundBox::empty;
   uint visibility = 0;
   refit_node(0, (pack.root_index == -1) ? true : false, bbox, visibility);
@@ -411,10 +476,14 @@ void BVH4::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
   else {
     int4 *data = &pack.nodes[idx];
     bool is_unaligned = (data[0].x & PATH_RAY_NODE_UNALIGNED) != 0;
+    bool is_compressed = (data[0].x & PATH_RAY_NODE_COMPRESSED) != 0;
     int4 c;
     if (is_unaligned) {
       c = data[13];
     }
+    else if (is_compressed) {
+      c = data[4];
+    }
     else {
       c = data[7];
     }
@@ -438,6 +507,9 @@ void BVH4::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
       pack_unaligned_node(
           idx, aligned_space, child_bbox, &c[0], visibility, 0.0f, 1.0f, num_nodes);
     }
+    else if (is_compressed) {
+      pack_compressed_node(idx, child_bbox, &c[0], visibility, 0.0f, 1.0f, num_nodes);
+    }
     else {
       pack_aligned_node(idx, child_bbox, &c[0], visibility, 0.0f, 1.0f, num_nodes);
     }
@@ -36,6 +36,7 @@ class Progress;
 
 #define BVH_QNODE_SIZE 8
 #define BVH_QNODE_LEAF_SIZE 1
+#define BVH_QNODE_COMPRESSED_SIZE 5
 #define BVH_UNALIGNED_QNODE_SIZE 14
 
 /* BVH4
@@ -68,6 +69,14 @@ class BVH4 : public BVH {
                          const float time_to,
                          const int num);
 
+  void pack_compressed_node(int idx,
+                            const BoundBox *bounds,
+                            const int *child,
+                            const uint visibility,
+                            const float time_from,
+                            const float time_to,
+                            const int num);
+
   void pack_unaligned_inner(const BVHStackEntry &e, const BVHStackEntry *en, int num);
   void pack_unaligned_node(int idx,
                            const Transform *aligned_space,
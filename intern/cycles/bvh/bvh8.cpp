@@ -35,6 +35,10 @@
 #include "bvh/bvh_node.h"
 #include "bvh/bvh_unaligned.h"
 
+#include "util/util_logging.h"
+#include "util/util_string.h"
+#include "util/util_time.h"
+
 CCL_NAMESPACE_BEGIN
 
 BVH8::BVH8(const BVHParams &params_,
@@ -188,8 +192,14 @@ void BVH8::pack_aligned_inner(const BVHStackEntry &e, const BVHStackEntry *en, i
     bounds[i] = en[i].node->bounds;
     child[i] = en[i].encodeIdx();
   }
-  pack_aligned_node(
-      e.idx, bounds, child, e.node->visibility, e.node->time_from, e.node->time_to, num);
+  if (params.use_compressed_nodes) {
+    pack_compressed_node(
+        e.idx, bounds, child, e.node->visibility, e.node->time_from, e.node->time_to, num);
+  }
+  else {
+    pack_aligned_node(
+        e.idx, bounds, child, e.node->visibility, e.node->time_from, e.node->time_to, num);
+  }
 }
 
 void BVH8::pack_aligned_node(int idx,
@@ -203,7 +213,8 @@ void BVH8::pack_aligned_node(int idx,
   float8 data[8];
   memset(data, 0, sizeof(data));
 
-  data[0].a = __uint_as_float(visibility & ~PATH_RAY_NODE_UNALIGNED);
+  data[0].a = __uint_as_float(visibility &
+                              ~(PATH_RAY_NODE_UNALIGNED | PATH_RAY_NODE_COMPRESSED));
   data[0].b = time_from;
   data[0].c = time_to;
 
@@ -240,6 +251,47 @@ void BVH8::pack_aligned_node(int idx,
   memcpy(&pack.nodes[idx], data, sizeof(float4) * BVH_ONODE_SIZE);
 }
 
+void BVH8::pack_compressed_node(int idx,
+                                const BoundBox *bounds,
+                                const int *child,
+                                const uint visibility,
+                                const float time_from,
+                                const float time_to,
+                                const int num)
+{
+  float3 origin, scale;
+  uchar lower[3][8], upper[3][8];
+  const uint child_mask = quantize_child_bounds(bounds, num, origin, scale, lower, upper);
+
+  float4 data[BVH_ONODE_COMPRESSED_SIZE];
+  memset(data, 0, sizeof(data));
+
+  data[0].x = __uint_as_float((visibility & ~PATH_RAY_NODE_UNALIGNED) |
+                              PATH_RAY_NODE_COMPRESSED);
+  data[0].y = time_from;
+  data[0].z = time_to;
+  /* Empty child slots are masked out by the kernel. */
+  data[0].w = __uint_as_float(child_mask);
+
+  data[1] = make_float4(origin.x, origin.y, origin.z, 0.0f);
+  data[2] = make_float4(scale.x, scale.y, scale.z, 0.0f);
+
+  /* One byte per child, lower bounds followed by upper bounds for each axis. */
+  for (int axis = 0; axis < 3; axis++) {
+    uchar *bytes = (uchar *)&data[3 + axis];
+    memcpy(bytes, lower[axis], 8);
+    memcpy(bytes + 8, upper[axis], 8);
+  }
+
+  /* Children are last, like in the other node types. */
+  int *children = (int *)&data[6];
+  for (int i = 0; i < num; i++) {
+    children[i] = child[i];
+  }
+
+  memcpy(&pack.nodes[idx], data, sizeof(float4) * BVH_ONODE_COMPRESSED_SIZE);
+}
+
 void BVH8::pack_unaligned_inner(const BVHStackEntry &e, const BVHStackEntry *en, int num)
 {
   Transform aligned_space[8];
@@ -272,7 +324,8 @@ void BVH8::pack_unaligned_node(int idx,
   float8 data[BVH_UNALIGNED_ONODE_SIZE];
   memset(data, 0, sizeof(data));
 
-  data[0].a = __uint_as_float(visibility | PATH_RAY_NODE_UNALIGNED);
+  data[0].a = __uint_as_float((visibility & ~PATH_RAY_NODE_COMPRESSED) |
+                              PATH_RAY_NODE_UNALIGNED);
   data[0].b = time_from;
   data[0].c = time_to;
 
@@ -329,20 +382,20 @@ void BVH8::pack_unaligned_node(int idx,
 
 void BVH8::pack_nodes(const BVHNode *root)
 {
+  const double pack_start_time = time_dt();
+
   /* Calculate size of the arrays required. */
   const size_t num_nodes = root->getSubtreeSize(BVH_STAT_NODE_COUNT);
   const size_t num_leaf_nodes = root->getSubtreeSize(BVH_STAT_LEAF_COUNT);
   assert(num_leaf_nodes <= num_nodes);
   const size_t num_inner_nodes = num_nodes - num_leaf_nodes;
-  size_t node_size;
-  if (params.use_unaligned_nodes) {
-    const size_t num_unaligned_nodes = root->getSubtreeSize(BVH_STAT_UNALIGNED_INNER_COUNT);
-    node_size = (num_unaligned_nodes * BVH_UNALIGNED_ONODE_SIZE) +
-                (num_inner_nodes - num_unaligned_nodes) * BVH_ONODE_SIZE;
-  }
-  else {
-    node_size = num_inner_nodes * BVH_ONODE_SIZE;
-  }
+  const size_t num_unaligned_nodes = (params.use_unaligned_nodes) ?
+                                         root->getSubtreeSize(BVH_STAT_UNALIGNED_INNER_COUNT) :
+                                         0;
+  const int aligned_node_size = (params.use_compressed_nodes) ? BVH_ONODE_COMPRESSED_SIZE :
+                                                                BVH_ONODE_SIZE;
+  const size_t node_size = (num_unaligned_nodes * BVH_UNALIGNED_ONODE_SIZE) +
+                           (num_inner_nodes - num_unaligned_nodes) * aligned_node_size;
   /* Resize arrays. */
   pack.nodes.clear();
   pack.leaf_nodes.clear();
@@ -364,7 +417,7 @@ void BVH8::pack_nodes(const BVHNode *root)
   }
   else {
     stack.push_back(BVHStackEntry(root, nextNodeIdx));
-    nextNodeIdx += root->has_unaligned() ? BVH_UNALIGNED_ONODE_SIZE : BVH_ONODE_SIZE;
+    nextNodeIdx += root->has_unaligned() ? BVH_UNALIGNED_ONODE_SIZE : aligned_node_size;
   }
 
   while (stack.size()) {
@@ -390,7 +443,8 @@ void BVH8::pack_nodes(const BVHNode *root)
         }
         else {
           idx = nextNodeIdx;
-          nextNodeIdx += children[i]->has_unaligned() ? BVH_UNALIGNED_ONODE_SIZE : BVH_ONODE_SIZE;
+          nextNodeIdx += children[i]->has_unaligned() ? BVH_UNALIGNED_ONODE_SIZE :
+                                                        aligned_node_size;
         }
         stack.push_back(BVHStackEntry(children[i], idx));
       }
@@ -402,12 +456,23 @@ void BVH8::pack_nodes(const BVHNode *root)
   assert(node_size == nextNodeIdx);
   /* Root index to start traversal at, to handle case of single leaf node. */
   pack.root_index = (root->is_leaf()) ? -1 : 0;
+
+  if (params.use_compressed_nodes) {
+    const size_t uncompressed_node_size = (num_unaligned_nodes * BVH_UNALIGNED_ONODE_SIZE) +
+                                          (num_inner_nodes - num_unaligned_nodes) *
+                                              BVH_ONODE_SIZE;
+    VLOG(1) << "BVH8 compressed nodes statistics:\n"
+            << "  Pack time: " << time_dt() - pack_start_time << "\n"
+            << "  Number of inner nodes: " << string_human_readable_number(num_inner_nodes)
+            << "\n"
+            << "  Inner nodes memory: "
+            << string_human_readable_size(node_size * sizeof(int4)) << " (uncompressed "
+            << string_human_readable_size(uncompressed_node_size * sizeof(int4)) << ")\n";
+  }
 }
 
 void BVH8::refit_nodes()
 {
-  assert(!params.top_level);
-
   BoundBox bbox = BoundBox::empty;
   uint visibility = 0;
   refit_node(0, (pack.root_index == -1) ? true : false, bbox, visibility);
@@ -495,6 +560,9 @@ void BVH8::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
   else {
     float8 *data = (float8 *)&pack.nodes[idx];
     bool is_unaligned = (__float_as_uint(data[0].a) & PATH_RAY_NODE_UNALIGNED) != 0;
+    bool is_compressed = (__float_as_uint(data[0].a) & PATH_RAY_NODE_COMPRESSED) != 0;
+    /* Children are stored in the last float8 of the node. */
+    const int child_offset = (is_unaligned) ? 13 : (is_compressed) ? 3 : 7;
     /* Refit inner node, set bbox from children. */
     BoundBox child_bbox[8] = {BoundBox::empty,
                               BoundBox::empty,
@@ -509,7 +577,7 @@ void BVH8::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
     int num_nodes = 0;
 
     for (int i = 0; i < 8; ++i) {
-      child[i] = __float_as_int(data[(is_unaligned) ? 13 : 7][i]);
+      child[i] = __float_as_int(data[child_offset][i]);
 
       if (child[i] != 0) {
         refit_node((child[i] < 0) ? -child[i] - 1 : child[i],
@@ -534,6 +602,9 @@ void BVH8::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
       pack_unaligned_node(
           idx, aligned_space, child_bbox, child, visibility, 0.0f, 1.0f, num_nodes);
     }
+    else if (is_compressed) {
+      pack_compressed_node(idx, child_bbox, child, visibility, 0.0f, 1.0f, num_nodes);
+    }
     else {
       pack_aligned_node(idx, child_bbox, child, visibility, 0.0f, 1.0f, num_nodes);
     }
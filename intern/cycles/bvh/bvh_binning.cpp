@@ -23,7 +23,10 @@
 
 #include "util/util_algorithm.h"
 #include "util/util_boundbox.h"
+#include "util/util_foreach.h"
+#include "util/util_task.h"
 #include "util/util_types.h"
+#include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -96,74 +99,12 @@ BVHObjectBinning::BVHObjectBinning(const BVHRange &job,
   num_bins = min(size_t(MAX_BINS), size_t(4.0f + 0.05f * size()));
   scale = rcp(cent_bounds_.size()) * make_float3((float)num_bins);
 
-  /* initialize binning counter and bounds */
-  BoundBox bin_bounds[MAX_BINS][4]; /* bounds for every bin in every dimension */
-  int4 bin_count[MAX_BINS];         /* number of primitives mapped to bin */
+  /* map geometry to bins */
+  Bins bins;
+  bin_prims(prims, &bins);
 
-  for (size_t i = 0; i < num_bins; i++) {
-    bin_count[i] = make_int4(0);
-    bin_bounds[i][0] = bin_bounds[i][1] = bin_bounds[i][2] = BoundBox::empty;
-  }
-
-  /* map geometry to bins, unrolled once */
-  {
-    ssize_t i;
-
-    for (i = 0; i < ssize_t(size()) - 1; i += 2) {
-      prefetch_L2(&prims[start() + i + 8]);
-
-      /* map even and odd primitive to bin */
-      const BVHReference &prim0 = prims[start() + i + 0];
-      const BVHReference &prim1 = prims[start() + i + 1];
-
-      BoundBox bounds0 = get_prim_bounds(prim0);
-      BoundBox bounds1 = get_prim_bounds(prim1);
-
-      int4 bin0 = get_bin(bounds0);
-      int4 bin1 = get_bin(bounds1);
-
-      /* increase bounds for bins for even primitive */
-      int b00 = (int)extract<0>(bin0);
-      bin_count[b00][0]++;
-      bin_bounds[b00][0].grow(bounds0);
-      int b01 = (int)extract<1>(bin0);
-      bin_count[b01][1]++;
-      bin_bounds[b01][1].grow(bounds0);
-      int b02 = (int)extract<2>(bin0);
-      bin_count[b02][2]++;
-      bin_bounds[b02][2].grow(bounds0);
-
-      /* increase bounds of bins for odd primitive */
-      int b10 = (int)extract<0>(bin1);
-      bin_count[b10][0]++;
-      bin_bounds[b10][0].grow(bounds1);
-      int b11 = (int)extract<1>(bin1);
-      bin_count[b11][1]++;
-      bin_bounds[b11][1].grow(bounds1);
-      int b12 = (int)extract<2>(bin1);
-      bin_count[b12][2]++;
-      bin_bounds[b12][2].grow(bounds1);
-    }
-
-    /* for uneven number of primitives */
-    if (i < ssize_t(size())) {
-      /* map primitive to bin */
-      const BVHReference &prim0 = prims[start() + i];
-      BoundBox bounds0 = get_prim_bounds(prim0);
-      int4 bin0 = get_bin(bounds0);
-
-      /* increase bounds of bins */
-      int b00 = (int)extract<0>(bin0);
-      bin_count[b00][0]++;
-      bin_bounds[b00][0].grow(bounds0);
-      int b01 = (int)extract<1>(bin0);
-      bin_count[b01][1]++;
-      bin_bounds[b01][1].grow(bounds0);
-      int b02 = (int)extract<2>(bin0);
-      bin_count[b02][2]++;
-      bin_bounds[b02][2].grow(bounds0);
-    }
-  }
+  const int4 *bin_count = bins.count;
+  const BoundBox(*bin_bounds)[4] = bins.bounds;
 
   /* sweep from right to left and compute parallel prefix of merged bounds */
   float4 r_area[MAX_BINS];  /* area of bounds of primitives on the right */
@@ -226,24 +167,137 @@ BVHObjectBinning::BVHObjectBinning(const BVHRange &job,
   leafSAH = bounds_.half_area() * blocks(size());
 }
 
-void BVHObjectBinning::split(BVHReference *prims,
-                             BVHObjectBinning &left_o,
-                             BVHObjectBinning &right_o) const
+size_t BVHObjectBinning::parallel_block_size() const
 {
-  size_t N = size();
+  return max(size_t(PARALLEL_BLOCK_SIZE), divide_up(size(), PARALLEL_MAX_BLOCKS));
+}
+
+void BVHObjectBinning::init_bins(Bins *bins) const
+{
+  for (size_t i = 0; i < num_bins; i++) {
+    bins->count[i] = make_int4(0);
+    bins->bounds[i][0] = bins->bounds[i][1] = bins->bounds[i][2] = BoundBox::empty;
+  }
+}
+
+void BVHObjectBinning::bin_prims(const BVHReference *prims, Bins *bins) const
+{
+  init_bins(bins);
+
+  if (size() < PARALLEL_MIN_SIZE) {
+    bin_block(prims, start(), end(), bins);
+    return;
+  }
+
+  const size_t block_size = parallel_block_size();
+  const size_t num_blocks = divide_up(size(), block_size);
+  vector<Bins> block_bins(num_blocks);
+
+  TaskPool pool;
+  for (size_t i = 0; i < num_blocks; i++) {
+    const size_t block_start = start() + i * block_size;
+    const size_t block_end = min(block_start + block_size, (size_t)end());
+    init_bins(&block_bins[i]);
+    pool.push(function_bind(
+        &BVHObjectBinning::bin_block, this, prims, block_start, block_end, &block_bins[i]));
+  }
+  pool.wait_work();
+
+  /* merge bins of blocks, the result is the same in any order. Bins and sides
+   * of blocks can be empty, so bounds are merged rather than grown. */
+  for (size_t i = 0; i < num_blocks; i++) {
+    for (size_t j = 0; j < num_bins; j++) {
+      bins->count[j] = bins->count[j] + block_bins[i].count[j];
+      for (int k = 0; k < 3; k++) {
+        bins->bounds[j][k] = merge(bins->bounds[j][k], block_bins[i].bounds[j][k]);
+      }
+    }
+  }
+}
+
+void BVHObjectBinning::bin_block(const BVHReference *prims,
+                                 size_t block_start,
+                                 size_t block_end,
+                                 Bins *bins) const
+{
+  int4 *bin_count = bins->count;
+  BoundBox(*bin_bounds)[4] = bins->bounds;
+
+  /* map geometry to bins, unrolled once */
+  {
+    ssize_t i;
+
+    for (i = block_start; i < ssize_t(block_end) - 1; i += 2) {
+      prefetch_L2(&prims[i + 8]);
+
+      /* map even and odd primitive to bin */
+      const BVHReference &prim0 = prims[i + 0];
+      const BVHReference &prim1 = prims[i + 1];
+
+      BoundBox bounds0 = get_prim_bounds(prim0);
+      BoundBox bounds1 = get_prim_bounds(prim1);
+
+      int4 bin0 = get_bin(bounds0);
+      int4 bin1 = get_bin(bounds1);
+
+      /* increase bounds for bins for even primitive */
+      int b00 = (int)extract<0>(bin0);
+      bin_count[b00][0]++;
+      bin_bounds[b00][0].grow(bounds0);
+      int b01 = (int)extract<1>(bin0);
+      bin_count[b01][1]++;
+      bin_bounds[b01][1].grow(bounds0);
+      int b02 = (int)extract<2>(bin0);
+      bin_count[b02][2]++;
+      bin_bounds[b02][2].grow(bounds0);
+
+      /* increase bounds of bins for odd primitive */
+      int b10 = (int)extract<0>(bin1);
+      bin_count[b10][0]++;
+      bin_bounds[b10][0].grow(bounds1);
+      int b11 = (int)extract<1>(bin1);
+      bin_count[b11][1]++;
+      bin_bounds[b11][1].grow(bounds1);
+      int b12 = (int)extract<2>(bin1);
+      bin_count[b12][2]++;
+      bin_bounds[b12][2].grow(bounds1);
+    }
+
+    /* for uneven number of primitives */
+    if (i < ssize_t(block_end)) {
+      /* map primitive to bin */
+      const BVHReference &prim0 = prims[i];
+      BoundBox bounds0 = get_prim_bounds(prim0);
+      int4 bin0 = get_bin(bounds0);
 
+      /* increase bounds of bins */
+      int b00 = (int)extract<0>(bin0);
+      bin_count[b00][0]++;
+      bin_bounds[b00][0].grow(bounds0);
+      int b01 = (int)extract<1>(bin0);
+      bin_count[b01][1]++;
+      bin_bounds[b01][1].grow(bounds0);
+      int b02 = (int)extract<2>(bin0);
+      bin_count[b02][2]++;
+      bin_bounds[b02][2].grow(bounds0);
+    }
+  }
+}
+
+void BVHObjectBinning::split_block(BVHReference *prims, SplitBlock *block) const
+{
   BoundBox lgeom_bounds = BoundBox::empty;
   BoundBox rgeom_bounds = BoundBox::empty;
   BoundBox lcent_bounds = BoundBox::empty;
   BoundBox rcent_bounds = BoundBox::empty;
 
-  ssize_t l = 0, r = N - 1;
+  ssize_t l = block->start, r = ssize_t(block->end) - 1;
 
   while (l <= r) {
-    prefetch_L2(&prims[start() + l + 8]);
-    prefetch_L2(&prims[start() + r - 8]);
+    prefetch_L2(&prims[l + 8]);
+    prefetch_L2(&prims[r - 8]);
 
-    BVHReference prim = prims[start() + l];
+    BVHReference prim = prims[l];
     BoundBox unaligned_bounds = get_prim_bounds(prim);
     float3 unaligned_center = unaligned_bounds.center2();
     float3 center = prim.bounds().center2();
@@ -256,14 +310,92 @@ void BVHObjectBinning::split(BVHReference *prims,
     else {
       rgeom_bounds.grow(prim.bounds());
       rcent_bounds.grow(center);
-      swap(prims[start() + l], prims[start() + r]);
+      swap(prims[l], prims[r]);
       r--;
     }
   }
+
+  block->num_left = l - block->start;
+  block->lgeom_bounds = lgeom_bounds;
+  block->rgeom_bounds = rgeom_bounds;
+  block->lcent_bounds = lcent_bounds;
+  block->rcent_bounds = rcent_bounds;
+}
+
+void BVHObjectBinning::split(BVHReference *prims,
+                             BVHObjectBinning &left_o,
+                             BVHObjectBinning &right_o) const
+{
+  size_t N = size();
+
+  BoundBox lgeom_bounds = BoundBox::empty;
+  BoundBox rgeom_bounds = BoundBox::empty;
+  BoundBox lcent_bounds = BoundBox::empty;
+  BoundBox rcent_bounds = BoundBox::empty;
+
+  size_t l = 0;
+
+  if (N < PARALLEL_MIN_SIZE) {
+    SplitBlock block;
+    block.start = start();
+    block.end = end();
+    split_block(prims, &block);
+
+    l = block.num_left;
+    lgeom_bounds = block.lgeom_bounds;
+    rgeom_bounds = block.rgeom_bounds;
+    lcent_bounds = block.lcent_bounds;
+    rcent_bounds = block.rcent_bounds;
+  }
+  else {
+    /* partition blocks in parallel */
+    const size_t block_size = parallel_block_size();
+    const size_t num_blocks = divide_up(N, block_size);
+    vector<SplitBlock> blocks(num_blocks);
+
+    TaskPool pool;
+    for (size_t i = 0; i < num_blocks; i++) {
+      blocks[i].start = start() + i * block_size;
+      blocks[i].end = min(blocks[i].start + block_size, (size_t)end());
+      pool.push(function_bind(&BVHObjectBinning::split_block, this, prims, &blocks[i]));
+    }
+    pool.wait_work();
+
+    foreach (const SplitBlock &block, blocks) {
+      l += block.num_left;
+      lgeom_bounds = merge(lgeom_bounds, block.lgeom_bounds);
+      rgeom_bounds = merge(rgeom_bounds, block.rgeom_bounds);
+      lcent_bounds = merge(lcent_bounds, block.lcent_bounds);
+      rcent_bounds = merge(rcent_bounds, block.rcent_bounds);
+    }
+
+    /* swap primitives on the right of blocks before the split position with
+     * primitives on the left of blocks after it, there are as many of both */
+    const size_t mid = start() + l;
+    size_t i = 0, i_end = 0, i_block = 0;
+    size_t j = 0, j_end = 0, j_block = 0;
+
+    for (;;) {
+      while (i >= i_end && i_block < num_blocks) {
+        const SplitBlock &block = blocks[i_block++];
+        i = block.start + block.num_left;
+        i_end = min(block.end, mid);
+      }
+      while (j >= j_end && j_block < num_blocks) {
+        const SplitBlock &block = blocks[j_block++];
+        j = max(block.start, mid);
+        j_end = block.start + block.num_left;
+      }
+      if (i >= i_end || j >= j_end) {
+        break;
+      }
+      swap(prims[i++], prims[j++]);
+    }
+  }
+
   /* finish */
-  if (l != 0 && N - 1 - r != 0) {
-    right_o = BVHObjectBinning(BVHRange(rgeom_bounds, rcent_bounds, start() + l, N - 1 - r),
-                               prims);
+  if (l != 0 && l != N) {
+    right_o = BVHObjectBinning(BVHRange(rgeom_bounds, rcent_bounds, start() + l, N - l), prims);
     left_o = BVHObjectBinning(BVHRange(lgeom_bounds, lcent_bounds, start(), l), prims);
     return;
   }
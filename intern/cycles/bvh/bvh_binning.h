@@ -27,12 +27,15 @@ CCL_NAMESPACE_BEGIN
 
 class BVHBuild;
 
-/* Single threaded object binner. Finds the split with the best SAH heuristic
+/* Object binner. Finds the split with the best SAH heuristic
  * by testing for each dimension multiple partitionings for regular spaced
  * partition locations. A partitioning for a partition location is computed,
  * by putting primitives whose centroid is on the left and right of the split
  * location to different sets. The SAH is evaluated by computing the number of
- * blocks occupied by the primitives in the partitions. */
+ * blocks occupied by the primitives in the partitions.
+ *
+ * Large ranges, near the root of the tree where there is not enough tasks to
+ * keep all threads busy yet, are binned and partitioned by multiple threads. */
 
 class BVHObjectBinning : public BVHRange {
  public:
@@ -71,6 +74,40 @@ class BVHObjectBinning : public BVHRange {
   enum { MAX_BINS = 32 };
   enum { LOG_BLOCK_SIZE = 2 };
 
+  /* Ranges of at least this size are binned and split in parallel. The number of
+   * primitives per thread only depends on the range size, so the result of the
+   * split does not depend on the number of threads. */
+  enum { PARALLEL_MIN_SIZE = 1 << 16 };
+  enum { PARALLEL_BLOCK_SIZE = 1 << 14 };
+  enum { PARALLEL_MAX_BLOCKS = 1024 };
+
+  /* Bin counts and bounds for every dimension. */
+  struct Bins {
+    int4 count[MAX_BINS];
+    BoundBox bounds[MAX_BINS][4];
+  };
+
+  /* Primitives of a partitioned block, left of the split followed by right. */
+  struct SplitBlock {
+    size_t start;
+    size_t end;
+    size_t num_left;
+    BoundBox lgeom_bounds;
+    BoundBox rgeom_bounds;
+    BoundBox lcent_bounds;
+    BoundBox rcent_bounds;
+  };
+
+  size_t parallel_block_size() const;
+  void init_bins(Bins *bins) const;
+  /* Bins the whole range, in parallel blocks for large ranges. */
+  void bin_prims(const BVHReference *prims, Bins *bins) const;
+  void bin_block(const BVHReference *prims,
+                 size_t block_start,
+                 size_t block_end,
+                 Bins *bins) const;
+  void split_block(BVHReference *prims, SplitBlock *block) const;
+
   /* computes the bin numbers for each dimension for a box. */
   __forceinline int4 get_bin(const BoundBox &box) const
   {
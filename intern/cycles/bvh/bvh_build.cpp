@@ -109,23 +109,24 @@ BVHBuild::~BVHBuild()
 
 /* Adding References */
 
-void BVHBuild::add_reference_triangles(BoundBox &root, BoundBox &center, Mesh *mesh, int i)
+void BVHBuild::add_reference_triangles(BVHReferenceBlock &block, Mesh *mesh)
 {
+  BVHReference *refs = &references[block.offset];
+  const int i = block.object_index;
   const Attribute *attr_mP = NULL;
   if (mesh->has_motion_blur()) {
     attr_mP = mesh->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
   }
-  const size_t num_triangles = mesh->num_triangles();
-  for (uint j = 0; j < num_triangles; j++) {
+  for (uint j = block.prim_start; j < block.prim_end; j++) {
     Mesh::Triangle t = mesh->get_triangle(j);
     const float3 *verts = &mesh->verts[0];
     if (attr_mP == NULL) {
       BoundBox bounds = BoundBox::empty;
       t.bounds_grow(verts, bounds);
       if (bounds.valid() && t.valid(verts)) {
-        references.push_back(BVHReference(bounds, j, i, PRIMITIVE_TRIANGLE));
-        root.grow(bounds);
-        center.grow(bounds.center2());
+        refs[block.num_references++] = BVHReference(bounds, j, i, PRIMITIVE_TRIANGLE);
+        block.bounds.grow(bounds);
+        block.center.grow(bounds.center2());
       }
     }
     else if (params.num_motion_triangle_steps == 0 || params.use_spatial_split) {
@@ -143,9 +144,9 @@ void BVHBuild::add_reference_triangles(BoundBox &root, BoundBox &center, Mesh *m
         t.bounds_grow(vert_steps + step * num_verts, bounds);
       }
       if (bounds.valid()) {
-        references.push_back(BVHReference(bounds, j, i, PRIMITIVE_MOTION_TRIANGLE));
-        root.grow(bounds);
-        center.grow(bounds.center2());
+        refs[block.num_references++] = BVHReference(bounds, j, i, PRIMITIVE_MOTION_TRIANGLE);
+        block.bounds.grow(bounds);
+        block.center.grow(bounds.center2());
       }
     }
     else {
@@ -153,7 +154,7 @@ void BVHBuild::add_reference_triangles(BoundBox &root, BoundBox &center, Mesh *m
        * primitives into separate nodes for each of the time steps.
        * This way we minimize overlap of neighbor curve primitives.
        */
-      const int num_bvh_steps = params.num_motion_curve_steps * 2 + 1;
+      const int num_bvh_steps = params.num_motion_triangle_steps * 2 + 1;
       const float num_bvh_steps_inv_1 = 1.0f / (num_bvh_steps - 1);
       const size_t num_verts = mesh->verts.size();
       const size_t num_steps = mesh->motion_steps;
@@ -181,10 +182,10 @@ void BVHBuild::add_reference_triangles(BoundBox &root, BoundBox &center, Mesh *m
         bounds.grow(curr_bounds);
         if (bounds.valid()) {
           const float prev_time = (float)(bvh_step - 1) * num_bvh_steps_inv_1;
-          references.push_back(
-              BVHReference(bounds, j, i, PRIMITIVE_MOTION_TRIANGLE, prev_time, curr_time));
-          root.grow(bounds);
-          center.grow(bounds.center2());
+          refs[block.num_references++] = BVHReference(
+              bounds, j, i, PRIMITIVE_MOTION_TRIANGLE, prev_time, curr_time);
+          block.bounds.grow(bounds);
+          block.center.grow(bounds.center2());
         }
         /* Current time boundbox becomes previous one for the
          * next time step.
@@ -195,14 +196,15 @@ void BVHBuild::add_reference_triangles(BoundBox &root, BoundBox &center, Mesh *m
   }
 }
 
-void BVHBuild::add_reference_curves(BoundBox &root, BoundBox &center, Hair *hair, int i)
+void BVHBuild::add_reference_curves(BVHReferenceBlock &block, Hair *hair)
 {
+  BVHReference *refs = &references[block.offset];
+  const int i = block.object_index;
   const Attribute *curve_attr_mP = NULL;
   if (hair->has_motion_blur()) {
     curve_attr_mP = hair->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
   }
-  const size_t num_curves = hair->num_curves();
-  for (uint j = 0; j < num_curves; j++) {
+  for (uint j = block.prim_start; j < block.prim_end; j++) {
     const Hair::Curve curve = hair->get_curve(j);
     const float *curve_radius = &hair->curve_radius[0];
     for (int k = 0; k < curve.num_keys - 1; k++) {
@@ -212,9 +214,9 @@ void BVHBuild::add_reference_curves(BoundBox &root, BoundBox &center, Hair *hair
         curve.bounds_grow(k, &hair->curve_keys[0], curve_radius, bounds);
         if (bounds.valid()) {
           int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_CURVE, k);
-          references.push_back(BVHReference(bounds, j, i, packed_type));
-          root.grow(bounds);
-          center.grow(bounds.center2());
+          refs[block.num_references++] = BVHReference(bounds, j, i, packed_type);
+          block.bounds.grow(bounds);
+          block.center.grow(bounds.center2());
         }
       }
       else if (params.num_motion_curve_steps == 0 || params.use_spatial_split) {
@@ -233,9 +235,9 @@ void BVHBuild::add_reference_curves(BoundBox &root, BoundBox &center, Hair *hair
         }
         if (bounds.valid()) {
           int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_MOTION_CURVE, k);
-          references.push_back(BVHReference(bounds, j, i, packed_type));
-          root.grow(bounds);
-          center.grow(bounds.center2());
+          refs[block.num_references++] = BVHReference(bounds, j, i, packed_type);
+          block.bounds.grow(bounds);
+          block.center.grow(bounds.center2());
         }
       }
       else {
@@ -289,9 +291,10 @@ void BVHBuild::add_reference_curves(BoundBox &root, BoundBox &center, Hair *hair
           if (bounds.valid()) {
             const float prev_time = (float)(bvh_step - 1) * num_bvh_steps_inv_1;
             int packed_type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_MOTION_CURVE, k);
-            references.push_back(BVHReference(bounds, j, i, packed_type, prev_time, curr_time));
-            root.grow(bounds);
-            center.grow(bounds.center2());
+            refs[block.num_references++] = BVHReference(
+                bounds, j, i, packed_type, prev_time, curr_time);
+            block.bounds.grow(bounds);
+            block.center.grow(bounds.center2());
           }
           /* Current time boundbox becomes previous one for the
            * next time step.
@@ -303,96 +306,171 @@ void BVHBuild::add_reference_curves(BoundBox &root, BoundBox &center, Hair *hair
   }
 }
 
-void BVHBuild::add_reference_geometry(BoundBox &root, BoundBox &center, Geometry *geom, int i)
+void BVHBuild::add_reference_geometry(BVHReferenceBlock &block, Geometry *geom)
 {
   if (geom->type == Geometry::MESH) {
     Mesh *mesh = static_cast<Mesh *>(geom);
-    add_reference_triangles(root, center, mesh, i);
+    add_reference_triangles(block, mesh);
   }
   else if (geom->type == Geometry::HAIR) {
     Hair *hair = static_cast<Hair *>(geom);
-    add_reference_curves(root, center, hair, i);
+    add_reference_curves(block, hair);
   }
 }
 
-void BVHBuild::add_reference_object(BoundBox &root, BoundBox &center, Object *ob, int i)
+void BVHBuild::add_reference_object(BVHReferenceBlock &block, Object *ob)
 {
-  references.push_back(BVHReference(ob->bounds, -1, i, 0));
-  root.grow(ob->bounds);
-  center.grow(ob->bounds.center2());
+  references[block.offset] = BVHReference(ob->bounds, -1, block.object_index, 0);
+  block.num_references = 1;
+  block.bounds.grow(ob->bounds);
+  block.center.grow(ob->bounds.center2());
 }
 
-static size_t count_curve_segments(Hair *hair)
+/* Upper bound of the number of references of a primitive, motion primitives can
+ * be split into one reference per time step. */
+static size_t max_references_per_primitive(const Geometry *geom, const BVHParams &params)
 {
-  size_t num = 0, num_curves = hair->num_curves();
-
-  for (size_t i = 0; i < num_curves; i++)
-    num += hair->get_curve(i).num_keys - 1;
-
-  return num;
+  if (!geom->has_motion_blur() || params.use_spatial_split) {
+    return 1;
+  }
+  if (geom->type == Geometry::MESH) {
+    return max(params.num_motion_triangle_steps * 2, 1);
+  }
+  else if (geom->type == Geometry::HAIR) {
+    return max(params.num_motion_curve_steps * 2, 1);
+  }
+  return 1;
 }
 
-static size_t count_primitives(Geometry *geom)
+void BVHBuild::add_reference_blocks(vector<BVHReferenceBlock> &blocks, Object *ob, int i)
 {
+  Geometry *geom = ob->geometry;
+
+  BVHReferenceBlock block;
+  block.object = ob;
+  block.object_index = i;
+  block.prim_start = 0;
+  block.prim_end = 0;
+  block.offset = 0;
+  block.size = 0;
+  block.num_references = 0;
+  block.bounds = BoundBox::empty;
+  block.center = BoundBox::empty;
+
+  if (params.top_level && geom->is_instanced()) {
+    block.size = 1;
+    blocks.push_back(block);
+    return;
+  }
+
+  const size_t num_references_per_prim = max_references_per_primitive(geom, params);
+
   if (geom->type == Geometry::MESH) {
     Mesh *mesh = static_cast<Mesh *>(geom);
-    return mesh->num_triangles();
+    const size_t num_triangles = mesh->num_triangles();
+    for (size_t j = 0; j < num_triangles; j += REFERENCE_BLOCK_SIZE) {
+      block.prim_start = j;
+      block.prim_end = min(j + REFERENCE_BLOCK_SIZE, num_triangles);
+      block.size = (block.prim_end - block.prim_start) * num_references_per_prim;
+      blocks.push_back(block);
+    }
   }
   else if (geom->type == Geometry::HAIR) {
+    /* Curves have a varying number of segments, block by segment count. */
     Hair *hair = static_cast<Hair *>(geom);
-    return count_curve_segments(hair);
+    const size_t num_curves = hair->num_curves();
+    size_t num_segments = 0;
+    for (size_t j = 0; j < num_curves; j++) {
+      num_segments += hair->get_curve(j).num_keys - 1;
+      if (num_segments >= REFERENCE_BLOCK_SIZE || j == num_curves - 1) {
+        block.prim_end = j + 1;
+        block.size = num_segments * num_references_per_prim;
+        blocks.push_back(block);
+        block.prim_start = j + 1;
+        num_segments = 0;
+      }
+    }
   }
-
-  return 0;
 }
 
-void BVHBuild::add_references(BVHRange &root)
+void BVHBuild::thread_add_references(BVHReferenceBlock *blocks, size_t num_blocks)
 {
-  /* reserve space for references */
-  size_t num_alloc_references = 0;
+  for (size_t i = 0; i < num_blocks; i++) {
+    if (progress.get_cancel()) {
+      return;
+    }
 
-  foreach (Object *ob, objects) {
-    if (params.top_level) {
-      if (!ob->is_traceable()) {
-        continue;
-      }
-      if (!ob->geometry->is_instanced()) {
-        num_alloc_references += count_primitives(ob->geometry);
-      }
-      else
-        num_alloc_references++;
+    BVHReferenceBlock &block = blocks[i];
+    Object *ob = block.object;
+    if (params.top_level && ob->geometry->is_instanced()) {
+      add_reference_object(block, ob);
     }
     else {
-      num_alloc_references += count_primitives(ob->geometry);
+      add_reference_geometry(block, ob->geometry);
     }
   }
+}
 
-  references.reserve(num_alloc_references);
-
-  /* add references from objects */
-  BoundBox bounds = BoundBox::empty, center = BoundBox::empty;
+void BVHBuild::add_references(BVHRange &root)
+{
+  /* Split objects into blocks of primitives. */
+  vector<BVHReferenceBlock> blocks;
   int i = 0;
 
   foreach (Object *ob, objects) {
-    if (params.top_level) {
-      if (!ob->is_traceable()) {
-        ++i;
-        continue;
-      }
-      if (!ob->geometry->is_instanced())
-        add_reference_geometry(bounds, center, ob->geometry, i);
-      else
-        add_reference_object(bounds, center, ob, i);
+    if (!params.top_level || ob->is_traceable()) {
+      add_reference_blocks(blocks, ob, i);
     }
-    else
-      add_reference_geometry(bounds, center, ob->geometry, i);
-
     i++;
+  }
 
-    if (progress.get_cancel())
-      return;
+  /* Give every block its own range of the reference array. */
+  size_t num_alloc_references = 0;
+
+  foreach (BVHReferenceBlock &block, blocks) {
+    block.offset = num_alloc_references;
+    num_alloc_references += block.size;
+  }
+
+  references.resize(num_alloc_references);
+
+  /* Add references in parallel, small objects are grouped into one task. */
+  TaskPool pool;
+  size_t task_start = 0, task_size = 0;
+
+  for (size_t j = 0; j < blocks.size(); j++) {
+    task_size += blocks[j].size;
+    if (task_size >= REFERENCE_BLOCK_SIZE || j == blocks.size() - 1) {
+      pool.push(function_bind(
+          &BVHBuild::thread_add_references, this, &blocks[task_start], j + 1 - task_start));
+      task_start = j + 1;
+      task_size = 0;
+    }
+  }
+
+  pool.wait_work();
+
+  if (progress.get_cancel())
+    return;
+
+  /* Close the gaps left by invalid primitives, keeping references in the same order
+   * as a serial build would add them. */
+  BoundBox bounds = BoundBox::empty, center = BoundBox::empty;
+  size_t num_references = 0;
+
+  foreach (const BVHReferenceBlock &block, blocks) {
+    if (block.offset != num_references) {
+      std::copy(references.begin() + block.offset,
+                references.begin() + block.offset + block.num_references,
+                references.begin() + num_references);
+    }
+    num_references += block.num_references;
+    bounds.grow(block.bounds);
+    center.grow(block.center);
   }
 
+  references.resize(num_references);
+
   /* happens mostly on empty meshes */
   if (!bounds.valid())
     bounds.grow(make_float3(0.0f, 0.0f, 0.0f));
@@ -407,7 +485,9 @@ BVHNode *BVHBuild::run()
   BVHRange root;
 
   /* add references */
+  double add_references_time = time_dt();
   add_references(root);
+  add_references_time = time_dt() - add_references_time;
 
   if (progress.get_cancel())
     return NULL;
@@ -490,6 +570,9 @@ BVHNode *BVHBuild::run()
     if (rootnode != NULL) {
       VLOG(1) << "BVH build statistics:\n"
               << "  Build time: " << time_dt() - build_start_time << "\n"
+              << "  Add references time: " << add_references_time << "\n"
+              << "  Number of references: "
+              << string_human_readable_number(progress_original_total) << "\n"
               << "  Total number of nodes: "
               << string_human_readable_number(rootnode->getSubtreeSize(BVH_STAT_NODE_COUNT))
               << "\n"
@@ -41,6 +41,26 @@ class Mesh;
 class Object;
 class Progress;
 
+/* Block of primitives of one object to add references for. Blocks are filled in
+ * parallel, each into its own range of the reference array. */
+
+struct BVHReferenceBlock {
+  Object *object;
+  int object_index;
+  /* Triangles or curves of the geometry, unused for object instances. */
+  size_t prim_start;
+  size_t prim_end;
+
+  /* Range in the reference array, the size is an upper bound of the number of
+   * references added. */
+  size_t offset;
+  size_t size;
+  size_t num_references;
+
+  BoundBox bounds;
+  BoundBox center;
+};
+
 /* BVH Builder */
 
 class BVHBuild {
@@ -66,10 +86,13 @@ class BVHBuild {
   friend class BVHObjectBinning;
 
   /* Adding references. */
-  void add_reference_triangles(BoundBox &root, BoundBox &center, Mesh *mesh, int i);
-  void add_reference_curves(BoundBox &root, BoundBox &center, Hair *hair, int i);
-  void add_reference_geometry(BoundBox &root, BoundBox &center, Geometry *geom, int i);
-  void add_reference_object(BoundBox &root, BoundBox &center, Object *ob, int i);
+  enum { REFERENCE_BLOCK_SIZE = 65536 };
+  void add_reference_triangles(BVHReferenceBlock &block, Mesh *mesh);
+  void add_reference_curves(BVHReferenceBlock &block, Hair *hair);
+  void add_reference_geometry(BVHReferenceBlock &block, Geometry *geom);
+  void add_reference_object(BVHReferenceBlock &block, Object *ob);
+  void add_reference_blocks(vector<BVHReferenceBlock> &blocks, Object *ob, int i);
+  void thread_add_references(BVHReferenceBlock *blocks, size_t num_blocks);
   void add_references(BVHRange &root);
 
   /* Building. */
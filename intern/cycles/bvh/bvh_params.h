@@ -74,6 +74,12 @@ class BVHParams {
    */
   bool use_unaligned_nodes;
 
+  /* Store child bounds of aligned nodes quantized to 8 bits relative to
+   * the node bounds, for lower memory usage.
+   * Only used for BVH4 and BVH8 layouts.
+   */
+  bool use_compressed_nodes;
+
   /* Split time range to this number of steps and create leaf node for each
    * of this time steps.
    *
@@ -116,6 +122,7 @@ class BVHParams {
     top_level = false;
     bvh_layout = BVH_LAYOUT_BVH2;
     use_unaligned_nodes = false;
+    use_compressed_nodes = false;
 
     num_motion_curve_steps = 0;
     num_motion_triangle_steps = 0;
@@ -599,6 +599,7 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo> &subdevices,
   info.has_volume_decoupled = true;
   info.has_adaptive_stop_per_sample = true;
   info.has_osl = true;
+  info.has_light_tree = true;
   info.has_profiling = true;
 
   foreach (const DeviceInfo &device, subdevices) {
@@ -642,6 +643,7 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo> &subdevices,
     info.has_volume_decoupled &= device.has_volume_decoupled;
     info.has_adaptive_stop_per_sample &= device.has_adaptive_stop_per_sample;
     info.has_osl &= device.has_osl;
+    info.has_light_tree &= device.has_light_tree;
     info.has_profiling &= device.has_profiling;
   }
 
@@ -80,6 +80,7 @@ class DeviceInfo {
   bool has_volume_decoupled;         /* Decoupled volume shading. */
   bool has_adaptive_stop_per_sample; /* Per-sample adaptive sampling stopping. */
   bool has_osl;                      /* Support Open Shading Language. */
+  bool has_light_tree;               /* Light tree for picking lights. */
   bool use_split_kernel;             /* Use split or mega kernel. */
   bool has_profiling;                /* Supports runtime collection of profiling info. */
   int cpu_threads;
@@ -97,6 +98,7 @@ class DeviceInfo {
     has_volume_decoupled = false;
     has_adaptive_stop_per_sample = false;
     has_osl = false;
+    has_light_tree = false;
     use_split_kernel = false;
     has_profiling = false;
   }
@@ -39,6 +39,8 @@
 
 #include "kernel/filter/filter.h"
 
+#include "kernel/kernels/cpu/kernel_cpu_texture_cache.h"
+
 #include "kernel/osl/osl_shader.h"
 #include "kernel/osl/osl_globals.h"
 // clang-format on
@@ -502,7 +504,11 @@ class CPUDevice : public Device {
     }
 
     texture_info[slot] = mem.info;
-    texture_info[slot].data = (uint64_t)mem.host_pointer;
+    /* Images in the texture cache keep pointing to their cache image, the pixels in
+     * host memory are only a placeholder. */
+    if (!mem.info.use_texture_cache) {
+      texture_info[slot].data = (uint64_t)mem.host_pointer;
+    }
     need_texture_info = true;
   }
 
@@ -1172,6 +1178,7 @@ class CPUDevice : public Device {
     }
     kg.decoupled_volume_steps_index = 0;
     kg.coverage_asset = kg.coverage_object = kg.coverage_material = NULL;
+    kg.texture_cache_tdata = NULL;
 #ifdef WITH_OSL
     OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
@@ -1194,6 +1201,7 @@ class CPUDevice : public Device {
         free(kg->decoupled_volume_steps[i]);
       }
     }
+    kernel_texture_cache_thread_free(kg);
 #ifdef WITH_OSL
     OSLShader::thread_free(kg);
 #endif
@@ -1342,6 +1350,7 @@ void device_cpu_info(vector<DeviceInfo> &devices)
   info.has_volume_decoupled = true;
   info.has_adaptive_stop_per_sample = true;
   info.has_osl = true;
+  info.has_light_tree = true;
   info.has_half_images = true;
   info.has_profiling = true;
 
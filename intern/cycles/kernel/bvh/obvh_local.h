@@ -21,12 +21,6 @@
  * BVH_MOTION: motion blur rendering
  */
 
-#if BVH_FEATURE(BVH_HAIR)
-#  define NODE_INTERSECT obvh_node_intersect
-#else
-#  define NODE_INTERSECT obvh_aligned_node_intersect
-#endif
-
 ccl_device bool BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
                                              const Ray *ray,
                                              LocalIntersection *local_isect,
@@ -66,18 +60,14 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
   }
 
   avxf tnear(0.0f), tfar(isect_t);
-#if BVH_FEATURE(BVH_HAIR)
   avx3f dir4(avxf(dir.x), avxf(dir.y), avxf(dir.z));
-#endif
   avx3f idir4(avxf(idir.x), avxf(idir.y), avxf(idir.z));
 
 #ifdef __KERNEL_AVX2__
   float3 P_idir = P * idir;
   avx3f P_idir4(P_idir.x, P_idir.y, P_idir.z);
 #endif
-#if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
   avx3f org4(avxf(P.x), avxf(P.y), avxf(P.z));
-#endif
 
   /* Offsets to select the side that becomes the lower or upper bound. */
   int near_x, near_y, near_z;
@@ -90,30 +80,29 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
       /* Traverse internal nodes. */
       while (node_addr >= 0 && node_addr != ENTRYPOINT_SENTINEL) {
         avxf dist;
-        int child_mask = NODE_INTERSECT(kg,
-                                        tnear,
-                                        tfar,
+        float4 inodes = kernel_tex_fetch(__bvh_nodes, node_addr + 0);
+        int child_mask;
+        child_mask = obvh_any_node_intersect(kg,
+                                             inodes,
+                                             BVH_FEATURE(BVH_HAIR),
+                                             tnear,
+                                             tfar,
 #ifdef __KERNEL_AVX2__
-                                        P_idir4,
-#endif
-#if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
-                                        org4,
-#endif
-#if BVH_FEATURE(BVH_HAIR)
-                                        dir4,
+                                             P_idir4,
 #endif
-                                        idir4,
-                                        near_x,
-                                        near_y,
-                                        near_z,
-                                        far_x,
-                                        far_y,
-                                        far_z,
-                                        node_addr,
-                                        &dist);
+                                             org4,
+                                             dir4,
+                                             idir4,
+                                             near_x,
+                                             near_y,
+                                             near_z,
+                                             far_x,
+                                             far_y,
+                                             far_z,
+                                             node_addr,
+                                             &dist);
 
         if (child_mask != 0) {
-          float4 inodes = kernel_tex_fetch(__bvh_nodes, node_addr + 0);
           avxf cnodes;
 #if BVH_FEATURE(BVH_HAIR)
           if (__float_as_uint(inodes.x) & PATH_RAY_NODE_UNALIGNED) {
@@ -121,7 +110,10 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
           }
           else
 #endif
-          {
+          if (__float_as_uint(inodes.x) & PATH_RAY_NODE_COMPRESSED) {
+            cnodes = kernel_tex_fetch_avxf(__bvh_nodes, node_addr + 6);
+          }
+          else {
             cnodes = kernel_tex_fetch_avxf(__bvh_nodes, node_addr + 14);
           }
 
@@ -394,5 +386,3 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
   } while (node_addr != ENTRYPOINT_SENTINEL);
   return false;
 }
-
-#undef NODE_INTERSECT
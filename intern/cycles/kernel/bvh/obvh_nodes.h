@@ -230,6 +230,69 @@ ccl_device_inline void obvh_stack_sort(OBVHStackItem *ccl_restrict s1,
   }
 }
 
+/* Compressed nodes intersection
+ *
+ * Child bounds are stored as 8 bit offsets from the node origin in units of the node
+ * scale, rounded outwards when packing. Empty child slots are not in the child mask.
+ *
+ * OBVH is only compiled for AVX2 kernels (see bvh.h), and the BVH8 layout is only used on CPUs
+ * supporting AVX2, so unlike the older functions here there is no pre-AVX2 code path.
+ */
+
+ccl_device_inline avxf obvh_compressed_plane(const ssei &bounds,
+                                             const int upper,
+                                             const float origin,
+                                             const float scale)
+{
+  /* Lower bounds of the eight children are in the first eight bytes, upper in the last. */
+  const __m128i bytes = (upper) ? _mm_srli_si128(bounds, 8) : (__m128i)bounds;
+  const avxf q = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+  return madd(q, avxf(scale), avxf(origin));
+}
+
+ccl_device_inline int obvh_compressed_node_intersect(KernelGlobals *ccl_restrict kg,
+                                                     const avxf &isect_near,
+                                                     const avxf &isect_far,
+                                                     const avx3f &org_idir,
+                                                     const avx3f &idir,
+                                                     const int near_x,
+                                                     const int near_y,
+                                                     const int near_z,
+                                                     const int far_x,
+                                                     const int far_y,
+                                                     const int far_z,
+                                                     const int node_addr,
+                                                     avxf *ccl_restrict dist)
+{
+  const float4 node = kernel_tex_fetch(__bvh_nodes, node_addr);
+  const float4 origin = kernel_tex_fetch(__bvh_nodes, node_addr + 1);
+  const float4 scale = kernel_tex_fetch(__bvh_nodes, node_addr + 2);
+  const ssei bounds_x = kernel_tex_fetch_ssei(__bvh_nodes, node_addr + 3);
+  const ssei bounds_y = kernel_tex_fetch_ssei(__bvh_nodes, node_addr + 4);
+  const ssei bounds_z = kernel_tex_fetch_ssei(__bvh_nodes, node_addr + 5);
+
+  /* Offsets to select the lower or upper bound are 0 or 1 within each axis. */
+  const avxf tnear_x = msub(
+      obvh_compressed_plane(bounds_x, near_x, origin.x, scale.x), idir.x, org_idir.x);
+  const avxf tnear_y = msub(
+      obvh_compressed_plane(bounds_y, near_y - 2, origin.y, scale.y), idir.y, org_idir.y);
+  const avxf tnear_z = msub(
+      obvh_compressed_plane(bounds_z, near_z - 4, origin.z, scale.z), idir.z, org_idir.z);
+  const avxf tfar_x = msub(
+      obvh_compressed_plane(bounds_x, far_x, origin.x, scale.x), idir.x, org_idir.x);
+  const avxf tfar_y = msub(
+      obvh_compressed_plane(bounds_y, far_y - 2, origin.y, scale.y), idir.y, org_idir.y);
+  const avxf tfar_z = msub(
+      obvh_compressed_plane(bounds_z, far_z - 4, origin.z, scale.z), idir.z, org_idir.z);
+
+  const avxf tnear = max4(tnear_x, tnear_y, tnear_z, isect_near);
+  const avxf tfar = min4(tfar_x, tfar_y, tfar_z, isect_far);
+  const avxb vmask = tnear <= tfar;
+  int mask = (int)movemask(vmask);
+  *dist = tnear;
+  return mask & __float_as_int(node.w);
+}
+
 /* Axis-aligned nodes intersection */
 
 ccl_device_inline int obvh_aligned_node_intersect(KernelGlobals *ccl_restrict kg,
@@ -408,3 +471,82 @@ ccl_device_inline int obvh_node_intersect(KernelGlobals *ccl_restrict kg,
                                        dist);
   }
 }
+
+/* Intersect the children of a node of any type, as done by the traversal loops. \a inodes is the
+ * first element of the node, already fetched by the caller. Unaligned nodes only exist in BVHs
+ * built for hair, they are only checked for when \a use_unaligned is set, which is a constant in
+ * every traversal function. */
+ccl_device_inline int obvh_any_node_intersect(KernelGlobals *ccl_restrict kg,
+                                              const float4 &inodes,
+                                              const bool use_unaligned,
+                                              const avxf &isect_near,
+                                              const avxf &isect_far,
+#ifdef __KERNEL_AVX2__
+                                              const avx3f &org_idir,
+#endif
+                                              const avx3f &org,
+                                              const avx3f &dir,
+                                              const avx3f &idir,
+                                              const int near_x,
+                                              const int near_y,
+                                              const int near_z,
+                                              const int far_x,
+                                              const int far_y,
+                                              const int far_z,
+                                              const int node_addr,
+                                              avxf *ccl_restrict dist)
+{
+  if (__float_as_uint(inodes.x) & PATH_RAY_NODE_COMPRESSED) {
+    return obvh_compressed_node_intersect(kg,
+                                          isect_near,
+                                          isect_far,
+                                          org_idir,
+                                          idir,
+                                          near_x,
+                                          near_y,
+                                          near_z,
+                                          far_x,
+                                          far_y,
+                                          far_z,
+                                          node_addr,
+                                          dist);
+  }
+  else if (use_unaligned && (__float_as_uint(inodes.x) & PATH_RAY_NODE_UNALIGNED)) {
+    return obvh_unaligned_node_intersect(kg,
+                                         isect_near,
+                                         isect_far,
+#ifdef __KERNEL_AVX2__
+                                         org_idir,
+#endif
+                                         org,
+                                         dir,
+                                         idir,
+                                         near_x,
+                                         near_y,
+                                         near_z,
+                                         far_x,
+                                         far_y,
+                                         far_z,
+                                         node_addr,
+                                         dist);
+  }
+  else {
+    return obvh_aligned_node_intersect(kg,
+                                       isect_near,
+                                       isect_far,
+#ifdef __KERNEL_AVX2__
+                                       org_idir,
+#else
+                                       org,
+#endif
+                                       idir,
+                                       near_x,
+                                       near_y,
+                                       near_z,
+                                       far_x,
+                                       far_y,
+                                       far_z,
+                                       node_addr,
+                                       dist);
+  }
+}
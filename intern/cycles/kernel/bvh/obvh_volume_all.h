@@ -22,12 +22,6 @@
  * BVH_MOTION: motion blur rendering
  */
 
-#if BVH_FEATURE(BVH_HAIR)
-#  define NODE_INTERSECT obvh_node_intersect
-#else
-#  define NODE_INTERSECT obvh_aligned_node_intersect
-#endif
-
 ccl_device uint BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
                                              const Ray *ray,
                                              Intersection *isect_array,
@@ -62,18 +56,14 @@ ccl_device uint BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
 #endif
 
   avxf tnear(0.0f), tfar(isect_t);
-#if BVH_FEATURE(BVH_HAIR)
   avx3f dir4(avxf(dir.x), avxf(dir.y), avxf(dir.z));
-#endif
   avx3f idir4(avxf(idir.x), avxf(idir.y), avxf(idir.z));
 
 #ifdef __KERNEL_AVX2__
   float3 P_idir = P * idir;
   avx3f P_idir4(P_idir.x, P_idir.y, P_idir.z);
 #endif
-#if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
   avx3f org4(avxf(P.x), avxf(P.y), avxf(P.z));
-#endif
 
   /* Offsets to select the side that becomes the lower or upper bound. */
   int near_x, near_y, near_z;
@@ -97,27 +87,26 @@ ccl_device uint BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
 #endif
 
         avxf dist;
-        int child_mask = NODE_INTERSECT(kg,
-                                        tnear,
-                                        tfar,
+        int child_mask;
+        child_mask = obvh_any_node_intersect(kg,
+                                             inodes,
+                                             BVH_FEATURE(BVH_HAIR),
+                                             tnear,
+                                             tfar,
 #ifdef __KERNEL_AVX2__
-                                        P_idir4,
-#endif
-#if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
-                                        org4,
-#endif
-#if BVH_FEATURE(BVH_HAIR)
-                                        dir4,
+                                             P_idir4,
 #endif
-                                        idir4,
-                                        near_x,
-                                        near_y,
-                                        near_z,
-                                        far_x,
-                                        far_y,
-                                        far_z,
-                                        node_addr,
-                                        &dist);
+                                             org4,
+                                             dir4,
+                                             idir4,
+                                             near_x,
+                                             near_y,
+                                             near_z,
+                                             far_x,
+                                             far_y,
+                                             far_z,
+                                             node_addr,
+                                             &dist);
 
         if (child_mask != 0) {
           avxf cnodes;
@@ -127,7 +116,10 @@ ccl_device uint BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
           }
           else
 #endif
-          {
+          if (__float_as_uint(inodes.x) & PATH_RAY_NODE_COMPRESSED) {
+            cnodes = kernel_tex_fetch_avxf(__bvh_nodes, node_addr + 6);
+          }
+          else {
             cnodes = kernel_tex_fetch_avxf(__bvh_nodes, node_addr + 14);
           }
 
@@ -465,16 +457,12 @@ ccl_device uint BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
             obvh_near_far_idx_calc(idir, &near_x, &near_y, &near_z, &far_x, &far_y, &far_z);
             tfar = avxf(isect_t);
             idir4 = avx3f(avxf(idir.x), avxf(idir.y), avxf(idir.z));
-#  if BVH_FEATURE(BVH_HAIR)
             dir4 = avx3f(avxf(dir.x), avxf(dir.y), avxf(dir.z));
-#  endif
 #  ifdef __KERNEL_AVX2__
             P_idir = P * idir;
             P_idir4 = avx3f(P_idir.x, P_idir.y, P_idir.z);
 #  endif
-#  if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
             org4 = avx3f(avxf(P.x), avxf(P.y), avxf(P.z));
-#  endif
 
             num_hits_in_instance = 0;
             isect_array->t = isect_t;
@@ -526,17 +514,13 @@ ccl_device uint BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
 
       obvh_near_far_idx_calc(idir, &near_x, &near_y, &near_z, &far_x, &far_y, &far_z);
       tfar = avxf(isect_t);
-#  if BVH_FEATURE(BVH_HAIR)
       dir4 = avx3f(avxf(dir.x), avxf(dir.y), avxf(dir.z));
-#  endif
       idir4 = avx3f(avxf(idir.x), avxf(idir.y), avxf(idir.z));
 #  ifdef __KERNEL_AVX2__
       P_idir = P * idir;
       P_idir4 = avx3f(P_idir.x, P_idir.y, P_idir.z);
 #  endif
-#  if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
       org4 = avx3f(avxf(P.x), avxf(P.y), avxf(P.z));
-#  endif
 
       object = OBJECT_NONE;
       node_addr = traversal_stack[stack_ptr].addr;
@@ -547,5 +531,3 @@ ccl_device uint BVH_FUNCTION_FULL_NAME(OBVH)(KernelGlobals *kg,
 
   return num_hits;
 }
-
-#undef NODE_INTERSECT
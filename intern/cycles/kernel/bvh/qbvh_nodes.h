@@ -125,6 +125,87 @@ ccl_device_inline void qbvh_stack_sort(QBVHStackItem *ccl_restrict s1,
   }
 }
 
+/* Compressed nodes intersection
+ *
+ * Child bounds are stored as 8 bit offsets from the node origin in units of the node
+ * scale, rounded outwards when packing. Empty child slots are not in the child mask.
+ */
+
+ccl_device_inline int qbvh_compressed_node_intersect(KernelGlobals *ccl_restrict kg,
+                                                     const ssef &isect_near,
+                                                     const ssef &isect_far,
+#ifdef __KERNEL_AVX2__
+                                                     const sse3f &org_idir,
+#else
+                                                     const sse3f &org,
+#endif
+                                                     const sse3f &idir,
+                                                     const int near_x,
+                                                     const int near_y,
+                                                     const int near_z,
+                                                     const int far_x,
+                                                     const int far_y,
+                                                     const int far_z,
+                                                     const int node_addr,
+                                                     ssef *ccl_restrict dist)
+{
+  const float4 node = kernel_tex_fetch(__bvh_nodes, node_addr);
+  const ssef origin = kernel_tex_fetch_ssef(__bvh_nodes, node_addr + 1);
+  const ssef scale = kernel_tex_fetch_ssef(__bvh_nodes, node_addr + 2);
+
+  /* One byte per child, lower and upper bound of X and Y, then of Z. */
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bounds_xy = kernel_tex_fetch_ssei(__bvh_nodes, node_addr + 3);
+  const __m128i bounds_z = _mm_setr_epi32(
+      __float_as_int(origin[3]), __float_as_int(scale[3]), 0, 0);
+  const __m128i bounds_x16 = _mm_unpacklo_epi8(bounds_xy, zero);
+  const __m128i bounds_y16 = _mm_unpackhi_epi8(bounds_xy, zero);
+  const __m128i bounds_z16 = _mm_unpacklo_epi8(bounds_z, zero);
+
+  const ssef scale_x = shuffle<0>(scale), scale_y = shuffle<1>(scale),
+             scale_z = shuffle<2>(scale);
+  const ssef origin_x = shuffle<0>(origin), origin_y = shuffle<1>(origin),
+             origin_z = shuffle<2>(origin);
+
+  const ssef planes[6] = {
+      madd(ssef(_mm_cvtepi32_ps(_mm_unpacklo_epi16(bounds_x16, zero))), scale_x, origin_x),
+      madd(ssef(_mm_cvtepi32_ps(_mm_unpackhi_epi16(bounds_x16, zero))), scale_x, origin_x),
+      madd(ssef(_mm_cvtepi32_ps(_mm_unpacklo_epi16(bounds_y16, zero))), scale_y, origin_y),
+      madd(ssef(_mm_cvtepi32_ps(_mm_unpackhi_epi16(bounds_y16, zero))), scale_y, origin_y),
+      madd(ssef(_mm_cvtepi32_ps(_mm_unpacklo_epi16(bounds_z16, zero))), scale_z, origin_z),
+      madd(ssef(_mm_cvtepi32_ps(_mm_unpackhi_epi16(bounds_z16, zero))), scale_z, origin_z)};
+
+#ifdef __KERNEL_AVX2__
+  const ssef tnear_x = msub(planes[near_x], idir.x, org_idir.x);
+  const ssef tnear_y = msub(planes[near_y], idir.y, org_idir.y);
+  const ssef tnear_z = msub(planes[near_z], idir.z, org_idir.z);
+  const ssef tfar_x = msub(planes[far_x], idir.x, org_idir.x);
+  const ssef tfar_y = msub(planes[far_y], idir.y, org_idir.y);
+  const ssef tfar_z = msub(planes[far_z], idir.z, org_idir.z);
+#else
+  const ssef tnear_x = (planes[near_x] - org.x) * idir.x;
+  const ssef tnear_y = (planes[near_y] - org.y) * idir.y;
+  const ssef tnear_z = (planes[near_z] - org.z) * idir.z;
+  const ssef tfar_x = (planes[far_x] - org.x) * idir.x;
+  const ssef tfar_y = (planes[far_y] - org.y) * idir.y;
+  const ssef tfar_z = (planes[far_z] - org.z) * idir.z;
+#endif
+
+#ifdef __KERNEL_SSE41__
+  const ssef tnear = maxi(maxi(tnear_x, tnear_y), maxi(tnear_z, isect_near));
+  const ssef tfar = mini(mini(tfar_x, tfar_y), mini(tfar_z, isect_far));
+  const sseb vmask = cast(tnear) > cast(tfar);
+  int mask = (int)movemask(vmask) ^ 0xf;
+#else
+  const ssef tnear = max4(isect_near, tnear_x, tnear_y, tnear_z);
+  const ssef tfar = min4(isect_far, tfar_x, tfar_y, tfar_z);
+  const sseb vmask = tnear <= tfar;
+  int mask = (int)movemask(vmask);
+#endif
+  *dist = tnear;
+  return mask & __float_as_int(node.w);
+}
+
 /* Axis-aligned nodes intersection */
 
 // ccl_device_inline int qbvh_aligned_node_intersect(KernelGlobals *ccl_restrict kg,
@@ -327,3 +408,86 @@ ccl_device_inline int qbvh_node_intersect(KernelGlobals *ccl_restrict kg,
                                        dist);
   }
 }
+
+/* Intersect the children of a node of any type, as done by the traversal loops. \a inodes is the
+ * first element of the node, already fetched by the caller. Unaligned nodes only exist in BVHs
+ * built for hair, they are only checked for when \a use_unaligned is set, which is a constant in
+ * every traversal function. */
+ccl_device_inline int qbvh_any_node_intersect(KernelGlobals *ccl_restrict kg,
+                                              const float4 &inodes,
+                                              const bool use_unaligned,
+                                              const ssef &isect_near,
+                                              const ssef &isect_far,
+#ifdef __KERNEL_AVX2__
+                                              const sse3f &org_idir,
+#endif
+                                              const sse3f &org,
+                                              const sse3f &dir,
+                                              const sse3f &idir,
+                                              const int near_x,
+                                              const int near_y,
+                                              const int near_z,
+                                              const int far_x,
+                                              const int far_y,
+                                              const int far_z,
+                                              const int node_addr,
+                                              ssef *ccl_restrict dist)
+{
+  if (__float_as_uint(inodes.x) & PATH_RAY_NODE_COMPRESSED) {
+    return qbvh_compressed_node_intersect(kg,
+                                          isect_near,
+                                          isect_far,
+#ifdef __KERNEL_AVX2__
+                                          org_idir,
+#else
+                                          org,
+#endif
+                                          idir,
+                                          near_x,
+                                          near_y,
+                                          near_z,
+                                          far_x,
+                                          far_y,
+                                          far_z,
+                                          node_addr,
+                                          dist);
+  }
+  else if (use_unaligned && (__float_as_uint(inodes.x) & PATH_RAY_NODE_UNALIGNED)) {
+    return qbvh_unaligned_node_intersect(kg,
+                                         isect_near,
+                                         isect_far,
+#ifdef __KERNEL_AVX2__
+                                         org_idir,
+#endif
+                                         org,
+                                         dir,
+                                         idir,
+                                         near_x,
+                                         near_y,
+                                         near_z,
+                                         far_x,
+                                         far_y,
+                                         far_z,
+                                         node_addr,
+                                         dist);
+  }
+  else {
+    return qbvh_aligned_node_intersect(kg,
+                                       isect_near,
+                                       isect_far,
+#ifdef __KERNEL_AVX2__
+                                       org_idir,
+#else
+                                       org,
+#endif
+                                       idir,
+                                       near_x,
+                                       near_y,
+                                       near_z,
+                                       far_x,
+                                       far_y,
+                                       far_z,
+                                       node_addr,
+                                       dist);
+  }
+}
@@ -23,12 +23,6 @@
  * BVH_MOTION: motion blur rendering
  */
 
-#if BVH_FEATURE(BVH_HAIR)
-#  define NODE_INTERSECT qbvh_node_intersect
-#else
-#  define NODE_INTERSECT qbvh_aligned_node_intersect
-#endif
-
 ccl_device bool BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
                                              const Ray *ray,
                                              Intersection *isect_array,
@@ -70,18 +64,14 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
 #endif
 
   ssef tnear(0.0f), tfar(isect_t);
-#if BVH_FEATURE(BVH_HAIR)
   sse3f dir4(ssef(dir.x), ssef(dir.y), ssef(dir.z));
-#endif
   sse3f idir4(ssef(idir.x), ssef(idir.y), ssef(idir.z));
 
 #ifdef __KERNEL_AVX2__
   float3 P_idir = P * idir;
   sse3f P_idir4(P_idir.x, P_idir.y, P_idir.z);
 #endif
-#if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
   sse3f org4(ssef(P.x), ssef(P.y), ssef(P.z));
-#endif
 
   /* Offsets to select the side that becomes the lower or upper bound. */
   int near_x, near_y, near_z;
@@ -111,27 +101,26 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
         }
 
         ssef dist;
-        int child_mask = NODE_INTERSECT(kg,
-                                        tnear,
-                                        tfar,
+        int child_mask;
+        child_mask = qbvh_any_node_intersect(kg,
+                                             inodes,
+                                             BVH_FEATURE(BVH_HAIR),
+                                             tnear,
+                                             tfar,
 #ifdef __KERNEL_AVX2__
-                                        P_idir4,
+                                             P_idir4,
 #endif
-#if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
-                                        org4,
-#endif
-#if BVH_FEATURE(BVH_HAIR)
-                                        dir4,
-#endif
-                                        idir4,
-                                        near_x,
-                                        near_y,
-                                        near_z,
-                                        far_x,
-                                        far_y,
-                                        far_z,
-                                        node_addr,
-                                        &dist);
+                                             org4,
+                                             dir4,
+                                             idir4,
+                                             near_x,
+                                             near_y,
+                                             near_z,
+                                             far_x,
+                                             far_y,
+                                             far_z,
+                                             node_addr,
+                                             &dist);
 
         if (child_mask != 0) {
           float4 cnodes;
@@ -141,7 +130,10 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
           }
           else
 #endif
-          {
+          if (__float_as_uint(inodes.x) & PATH_RAY_NODE_COMPRESSED) {
+            cnodes = kernel_tex_fetch(__bvh_nodes, node_addr + 4);
+          }
+          else {
             cnodes = kernel_tex_fetch(__bvh_nodes, node_addr + 7);
           }
 
@@ -376,17 +368,13 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
 
           qbvh_near_far_idx_calc(idir, &near_x, &near_y, &near_z, &far_x, &far_y, &far_z);
           tfar = ssef(isect_t);
-#  if BVH_FEATURE(BVH_HAIR)
           dir4 = sse3f(ssef(dir.x), ssef(dir.y), ssef(dir.z));
-#  endif
           idir4 = sse3f(ssef(idir.x), ssef(idir.y), ssef(idir.z));
 #  ifdef __KERNEL_AVX2__
           P_idir = P * idir;
           P_idir4 = sse3f(P_idir.x, P_idir.y, P_idir.z);
 #  endif
-#  if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
           org4 = sse3f(ssef(P.x), ssef(P.y), ssef(P.z));
-#  endif
 
           ++stack_ptr;
           kernel_assert(stack_ptr < BVH_QSTACK_SIZE);
@@ -428,17 +416,13 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
 
       qbvh_near_far_idx_calc(idir, &near_x, &near_y, &near_z, &far_x, &far_y, &far_z);
       tfar = ssef(isect_t);
-#  if BVH_FEATURE(BVH_HAIR)
       dir4 = sse3f(ssef(dir.x), ssef(dir.y), ssef(dir.z));
-#  endif
       idir4 = sse3f(ssef(idir.x), ssef(idir.y), ssef(idir.z));
 #  ifdef __KERNEL_AVX2__
       P_idir = P * idir;
       P_idir4 = sse3f(P_idir.x, P_idir.y, P_idir.z);
 #  endif
-#  if BVH_FEATURE(BVH_HAIR) || !defined(__KERNEL_AVX2__)
       org4 = sse3f(ssef(P.x), ssef(P.y), ssef(P.z));
-#  endif
 
       object = OBJECT_NONE;
       node_addr = traversal_stack[stack_ptr].addr;
@@ -449,5 +433,3 @@ ccl_device bool BVH_FUNCTION_FULL_NAME(QBVH)(KernelGlobals *kg,
 
   return false;
 }
-
-#undef NODE_INTERSECT
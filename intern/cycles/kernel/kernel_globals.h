@@ -48,6 +48,7 @@ struct OSLShadingSystem;
 typedef unordered_map<float, float> CoverageMap;
 
 struct Intersection;
+struct TextureCacheThreadData;
 struct VolumeStep;
 
 typedef struct KernelGlobals {
@@ -73,6 +74,9 @@ typedef struct KernelGlobals {
   VolumeStep *decoupled_volume_steps[2];
   int decoupled_volume_steps_index;
 
+  /* Texture cache lookup data, created on the first lookup by the thread. */
+  TextureCacheThreadData *texture_cache_tdata;
+
   /* A buffer for storing per-pixel coverage for Cryptomatte. */
   CoverageMap *coverage_object;
   CoverageMap *coverage_material;
@@ -527,6 +527,22 @@ ccl_device float background_light_pdf(KernelGlobals *kg, float3 P, float3 direct
 }
 #endif
 
+/* Probability of picking the lamp, when sampling one light for shading point P. */
+ccl_device float light_select_lamp_pdf(KernelGlobals *kg, int lamp, const float3 P)
+{
+#ifdef __LIGHT_TREE__
+  if (kernel_data.integrator.use_light_tree) {
+    const int emitter = kernel_tex_fetch(__lights, lamp).tree_emitter;
+    if (emitter != -1) {
+      return light_tree_emitter_pdf(kg, emitter, P);
+    }
+  }
+#endif
+
+  /* Lights outside the light tree use the same probability as the distribution. */
+  return kernel_data.integrator.pdf_lights;
+}
+
 /* Regular Light */
 
 ccl_device_inline bool lamp_light_sample(
@@ -645,8 +661,6 @@ ccl_device_inline bool lamp_light_sample(
     }
   }
 
-  ls->pdf *= kernel_data.integrator.pdf_lights;
-
   return (ls->pdf > 0.0f);
 }
 
@@ -783,7 +797,7 @@ ccl_device bool lamp_light_eval(
     return false;
   }
 
-  ls->pdf *= kernel_data.integrator.pdf_lights;
+  ls->pdf *= light_select_lamp_pdf(kg, lamp, P);
 
   return true;
 }
@@ -822,12 +836,27 @@ ccl_device_inline bool triangle_world_space_vertices(
   return has_motion;
 }
 
-ccl_device_inline float triangle_light_pdf_area(KernelGlobals *kg,
-                                                const float3 Ng,
+/* Probability of picking the triangle per unit of its area, when sampling one light for
+ * shading point P. */
+ccl_device_inline float triangle_light_select_pdf(KernelGlobals *kg,
+                                                  int object,
+                                                  int prim,
+                                                  const float3 P)
+{
+#ifdef __LIGHT_TREE__
+  if (kernel_data.integrator.use_light_tree) {
+    return light_tree_triangle_pdf(kg, object, prim, P);
+  }
+#endif
+
+  return kernel_data.integrator.pdf_triangles;
+}
+
+ccl_device_inline float triangle_light_pdf_area(const float3 Ng,
                                                 const float3 I,
-                                                float t)
+                                                float t,
+                                                float pdf)
 {
-  float pdf = kernel_data.integrator.pdf_triangles;
   float cos_pi = fabsf(dot(Ng, I));
 
   if (cos_pi == 0.0f)
@@ -838,6 +867,11 @@ ccl_device_inline float triangle_light_pdf_area(KernelGlobals *kg,
 
 ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *sd, float t)
 {
+  const float pdf_select = triangle_light_select_pdf(kg, sd->object, sd->prim, sd->P + sd->I * t);
+  if (pdf_select == 0.0f) {
+    return 0.0f;
+  }
+
   /* A naive heuristic to decide between costly solid angle sampling
    * and simple area sampling, comparing the distance to the triangle plane
    * to the length of the edges of the triangle. */
@@ -869,7 +903,7 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
     const float gamma = fast_acosf(dot(u02, u12));
     const float solid_angle = alpha + beta + gamma - M_PI_F;
 
-    /* pdf_triangles is calculated over triangle area, but we're not sampling over its area */
+    /* pdf_select is calculated over triangle area, but we're not sampling over its area */
     if (UNLIKELY(solid_angle == 0.0f)) {
       return 0.0f;
     }
@@ -883,12 +917,12 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
       else {
         area = 0.5f * len(N);
       }
-      const float pdf = area * kernel_data.integrator.pdf_triangles;
+      const float pdf = area * pdf_select;
       return pdf / solid_angle;
     }
   }
   else {
-    float pdf = triangle_light_pdf_area(kg, sd->Ng, sd->I, t);
+    float pdf = triangle_light_pdf_area(sd->Ng, sd->I, t, pdf_select);
     if (has_motion) {
       const float area = 0.5f * len(N);
       if (UNLIKELY(area == 0.0f)) {
@@ -896,7 +930,7 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
       }
       /* scale the PDF.
        * area = the area the sample was taken from
-       * area_pre = the are from which pdf_triangles was calculated from */
+       * area_pre = the are from which pdf_select was calculated from */
       triangle_world_space_vertices(kg, sd->object, sd->prim, -1.0f, V);
       const float area_pre = triangle_area(V[0], V[1], V[2]);
       pdf = pdf * area_pre / area;
@@ -912,7 +946,8 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
                                                   float randv,
                                                   float time,
                                                   LightSample *ls,
-                                                  const float3 P)
+                                                  const float3 P,
+                                                  const float pdf_select)
 {
   /* A naive heuristic to decide between costly solid angle sampling
    * and simple area sampling, comparing the distance to the triangle plane
@@ -1025,7 +1060,7 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
 
     ls->P = P + ls->D * ls->t;
 
-    /* pdf_triangles is calculated over triangle area, but we're sampling over solid angle */
+    /* pdf_select is calculated over triangle area, but we're sampling over solid angle */
     if (UNLIKELY(solid_angle == 0.0f)) {
       ls->pdf = 0.0f;
       return;
@@ -1036,7 +1071,7 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
         triangle_world_space_vertices(kg, object, prim, -1.0f, V);
         area = triangle_area(V[0], V[1], V[2]);
       }
-      const float pdf = area * kernel_data.integrator.pdf_triangles;
+      const float pdf = area * pdf_select;
       ls->pdf = pdf / solid_angle;
     }
   }
@@ -1050,11 +1085,11 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
     ls->P = u * V[0] + v * V[1] + t * V[2];
     /* compute incoming direction, distance and pdf */
     ls->D = normalize_len(ls->P - P, &ls->t);
-    ls->pdf = triangle_light_pdf_area(kg, ls->Ng, -ls->D, ls->t);
+    ls->pdf = triangle_light_pdf_area(ls->Ng, -ls->D, ls->t, pdf_select);
     if (has_motion && area != 0.0f) {
       /* scale the PDF.
        * area = the area the sample was taken from
-       * area_pre = the are from which pdf_triangles was calculated from */
+       * area_pre = the are from which pdf_select was calculated from */
       triangle_world_space_vertices(kg, object, prim, -1.0f, V);
       const float area_pre = triangle_area(V[0], V[1], V[2]);
       ls->pdf = ls->pdf * area_pre / area;
@@ -1118,20 +1153,52 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
                                       int bounce,
                                       LightSample *ls)
 {
+  float pdf_select = kernel_data.integrator.pdf_lights;
+
   if (lamp < 0) {
-    /* sample index */
-    int index = light_distribution_sample(kg, &randu);
+    int prim;
+    int object;
+    int shader_flag;
+
+#ifdef __LIGHT_TREE__
+    if (kernel_data.integrator.use_light_tree) {
+      /* sample index */
+      int index = light_tree_sample(kg, P, &randu, &pdf_select);
+      if (index == -1) {
+        return false;
+      }
 
-    /* fetch light data */
-    const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(
-        __light_distribution, index);
-    int prim = kdistribution->prim;
+      /* fetch light data */
+      const ccl_global KernelLightTreeEmitter *kemitter = &kernel_tex_fetch(__light_tree_emitters,
+                                                                            index);
+      prim = kemitter->prim;
+      object = kemitter->object_id;
+      shader_flag = kemitter->shader_flag;
 
-    if (prim >= 0) {
-      int object = kdistribution->mesh_light.object_id;
-      int shader_flag = kdistribution->mesh_light.shader_flag;
+      if (prim >= 0) {
+        pdf_select *= kemitter->inv_area;
+      }
+    }
+    else
+#endif
+    {
+      /* sample index */
+      int index = light_distribution_sample(kg, &randu);
+
+      /* fetch light data */
+      const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(
+          __light_distribution, index);
+      prim = kdistribution->prim;
+      object = kdistribution->mesh_light.object_id;
+      shader_flag = kdistribution->mesh_light.shader_flag;
+
+      if (prim >= 0) {
+        pdf_select = kernel_data.integrator.pdf_triangles;
+      }
+    }
 
-      triangle_light_sample(kg, prim, object, randu, randv, time, ls, P);
+    if (prim >= 0) {
+      triangle_light_sample(kg, prim, object, randu, randv, time, ls, P, pdf_select);
       ls->shader |= shader_flag;
       return (ls->pdf > 0.0f);
     }
@@ -1143,7 +1210,13 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
     return false;
   }
 
-  return lamp_light_sample(kg, lamp, randu, randv, P, ls);
+  if (!lamp_light_sample(kg, lamp, randu, randv, P, ls)) {
+    return false;
+  }
+
+  ls->pdf *= pdf_select;
+
+  return (ls->pdf > 0.0f);
 }
 
 ccl_device_inline int light_select_num_samples(KernelGlobals *kg, int index)
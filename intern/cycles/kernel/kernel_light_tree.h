@@ -0,0 +1,217 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree
+ *
+ * Picks one light out of many, with a probability proportional to an estimate
+ * of its contribution to the shading point. The estimate uses the bounds of the
+ * emitters below each node of the tree built by the light manager, and only
+ * depends on the shading position so the same probability can be computed for
+ * lights hit by BSDF rays, from the ray origin. */
+
+#ifdef __LIGHT_TREE__
+ccl_device float light_tree_importance(const float3 P,
+                                       const ccl_global KernelLightTreeBounds *bounds)
+{
+  if (bounds->energy == 0.0f) {
+    return 0.0f;
+  }
+
+  const float3 bbox_min = make_float3(
+      bounds->bbox_min[0], bounds->bbox_min[1], bounds->bbox_min[2]);
+  const float3 bbox_max = make_float3(
+      bounds->bbox_max[0], bounds->bbox_max[1], bounds->bbox_max[2]);
+  const float3 centroid = 0.5f * (bbox_min + bbox_max);
+  const float radius_sq = 0.25f * len_squared(bbox_max - bbox_min);
+  const float3 D = P - centroid;
+  const float distance_sq = len_squared(D);
+
+  /* Inside the bounding sphere light can arrive from any of the emitters, clamp
+   * the distance to avoid the singularity. */
+  if (distance_sq <= radius_sq) {
+    return (radius_sq > 0.0f) ? bounds->energy / radius_sq : bounds->energy;
+  }
+
+  /* Smallest angle between the emission directions and the direction to P, taking
+   * into account the angle the bounding sphere covers as seen from P. */
+  const float distance = sqrtf(distance_sq);
+  const float3 axis = make_float3(bounds->axis[0], bounds->axis[1], bounds->axis[2]);
+  const float theta = fast_acosf(clamp(dot(axis, D) / distance, -1.0f, 1.0f));
+  const float theta_u = fast_asinf(sqrtf(radius_sq) / distance);
+  const float theta_min = fmaxf(theta - bounds->theta_o - theta_u, 0.0f);
+
+  if (theta_min >= bounds->theta_e) {
+    return 0.0f;
+  }
+
+  return bounds->energy * fast_cosf(theta_min) / distance_sq;
+}
+
+ccl_device_inline float light_tree_node_importance(KernelGlobals *kg, int index, const float3 P)
+{
+  return light_tree_importance(P, &kernel_tex_fetch(__light_tree_nodes, index).bounds);
+}
+
+ccl_device_inline float light_tree_emitter_importance(KernelGlobals *kg,
+                                                      int index,
+                                                      const float3 P)
+{
+  return light_tree_importance(P, &kernel_tex_fetch(__light_tree_emitters, index).bounds);
+}
+
+/* Returns the index of the picked emitter, or -1 if no emitter contributes to P. */
+ccl_device int light_tree_sample(KernelGlobals *kg, const float3 P, float *randu, float *pdf)
+{
+  float r = *randu;
+
+  /* Distant and background lights have no position to bound, they are picked
+   * uniformly with a fixed probability. */
+  const float distant_pdf = kernel_data.integrator.distant_lights_pdf;
+  if (r < distant_pdf) {
+    const int num_distant = kernel_data.integrator.num_distant_lights;
+    r = r * num_distant / distant_pdf;
+    const int i = min((int)r, num_distant - 1);
+    *randu = r - i;
+    *pdf = distant_pdf / num_distant;
+    return kernel_data.integrator.distant_lights_offset + i;
+  }
+
+  r = (r - distant_pdf) / (1.0f - distant_pdf);
+  float pdf_select = 1.0f - distant_pdf;
+
+  /* Descend to a leaf, rescaling the random number to reuse it at every level. */
+  int index = 0;
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+
+  while (knode->num_emitters == 0) {
+    const int left = index + 1;
+    const int right = knode->child_index;
+    const float importance_left = light_tree_node_importance(kg, left, P);
+    const float importance_right = light_tree_node_importance(kg, right, P);
+    const float importance_total = importance_left + importance_right;
+
+    if (importance_total == 0.0f) {
+      return -1;
+    }
+
+    const float p_left = importance_left / importance_total;
+    if (r < p_left) {
+      index = left;
+      r = r / p_left;
+      pdf_select *= p_left;
+    }
+    else {
+      index = right;
+      r = (r - p_left) / (1.0f - p_left);
+      pdf_select *= 1.0f - p_left;
+    }
+
+    knode = &kernel_tex_fetch(__light_tree_nodes, index);
+  }
+
+  /* Pick an emitter in the leaf. */
+  const int first = knode->child_index;
+  const int num_emitters = knode->num_emitters;
+
+  float importance_total = 0.0f;
+  for (int i = 0; i < num_emitters; i++) {
+    importance_total += light_tree_emitter_importance(kg, first + i, P);
+  }
+
+  if (importance_total == 0.0f) {
+    return -1;
+  }
+
+  const float threshold = r * importance_total;
+  float cdf = 0.0f;
+  for (int i = 0; i < num_emitters; i++) {
+    const float importance = light_tree_emitter_importance(kg, first + i, P);
+    if (importance > 0.0f && (threshold < cdf + importance || i == num_emitters - 1)) {
+      *randu = clamp((threshold - cdf) / importance, 0.0f, 1.0f);
+      *pdf = pdf_select * importance / importance_total;
+      return first + i;
+    }
+    cdf += importance;
+  }
+
+  return -1;
+}
+
+/* Probability of light_tree_sample() picking the emitter, by walking from its leaf to the root. */
+ccl_device float light_tree_emitter_pdf(KernelGlobals *kg, int emitter, const float3 P)
+{
+  int index = kernel_tex_fetch(__light_tree_emitters, emitter).parent_index;
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+
+  float importance = 0.0f;
+  float importance_total = 0.0f;
+  for (int i = 0; i < knode->num_emitters; i++) {
+    const float importance_emitter = light_tree_emitter_importance(
+        kg, knode->child_index + i, P);
+    if (knode->child_index + i == emitter) {
+      importance = importance_emitter;
+    }
+    importance_total += importance_emitter;
+  }
+
+  if (importance == 0.0f) {
+    return 0.0f;
+  }
+
+  float pdf = importance / importance_total;
+
+  int parent = knode->parent_index;
+  while (parent != -1) {
+    knode = &kernel_tex_fetch(__light_tree_nodes, parent);
+    const int left = parent + 1;
+    const int right = knode->child_index;
+    const float importance_left = light_tree_node_importance(kg, left, P);
+    const float importance_right = light_tree_node_importance(kg, right, P);
+    const float importance_child = (index == left) ? importance_left : importance_right;
+
+    if (importance_child == 0.0f) {
+      return 0.0f;
+    }
+
+    pdf *= importance_child / (importance_left + importance_right);
+    index = parent;
+    parent = knode->parent_index;
+  }
+
+  return pdf * (1.0f - kernel_data.integrator.distant_lights_pdf);
+}
+
+/* Probability of picking the triangle per unit area. */
+ccl_device float light_tree_triangle_pdf(KernelGlobals *kg, int object, int prim, const float3 P)
+{
+  const int2 lookup = kernel_tex_fetch(__light_tree_objects, object);
+  if (lookup.x == -1) {
+    return 0.0f;
+  }
+
+  const int emitter = kernel_tex_fetch(__light_tree_triangles, lookup.x + prim - lookup.y);
+  if (emitter == -1) {
+    return 0.0f;
+  }
+
+  return light_tree_emitter_pdf(kg, emitter, P) *
+         kernel_tex_fetch(__light_tree_emitters, emitter).inv_area;
+}
+#endif /* __LIGHT_TREE__ */
+
+CCL_NAMESPACE_END
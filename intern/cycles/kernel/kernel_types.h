@@ -133,6 +133,8 @@ CCL_NAMESPACE_BEGIN
 #  endif
 #  define __VOLUME_DECOUPLED__
 #  define __VOLUME_RECORD_ALL__
+/* Only the CPU device builds the tree, see DeviceInfo.has_light_tree. */
+#  define __LIGHT_TREE__
 #endif /* __KERNEL_CPU__ */
 
 #ifdef __KERNEL_CUDA__
@@ -297,34 +299,36 @@ enum PathRayFlag {
 
   /* Special flag to tag unaligned BVH nodes. */
   PATH_RAY_NODE_UNALIGNED = (1 << 13),
+  /* Special flag to tag BVH nodes with quantized child bounds. */
+  PATH_RAY_NODE_COMPRESSED = (1 << 14),
 
-  PATH_RAY_ALL_VISIBILITY = ((1 << 14) - 1),
+  PATH_RAY_ALL_VISIBILITY = ((1 << 15) - 1),
 
   /* Don't apply multiple importance sampling weights to emission from
    * lamp or surface hits, because they were not direct light sampled. */
-  PATH_RAY_MIS_SKIP = (1 << 14),
+  PATH_RAY_MIS_SKIP = (1 << 15),
   /* Diffuse bounce earlier in the path, skip SSS to improve performance
    * and avoid branching twice with disk sampling SSS. */
-  PATH_RAY_DIFFUSE_ANCESTOR = (1 << 15),
+  PATH_RAY_DIFFUSE_ANCESTOR = (1 << 16),
   /* Single pass has been written. */
-  PATH_RAY_SINGLE_PASS_DONE = (1 << 16),
+  PATH_RAY_SINGLE_PASS_DONE = (1 << 17),
   /* Ray is behind a shadow catcher .*/
-  PATH_RAY_SHADOW_CATCHER = (1 << 17),
+  PATH_RAY_SHADOW_CATCHER = (1 << 18),
   /* Store shadow data for shadow catcher or denoising. */
-  PATH_RAY_STORE_SHADOW_INFO = (1 << 18),
+  PATH_RAY_STORE_SHADOW_INFO = (1 << 19),
   /* Zero background alpha, for camera or transparent glass rays. */
-  PATH_RAY_TRANSPARENT_BACKGROUND = (1 << 19),
+  PATH_RAY_TRANSPARENT_BACKGROUND = (1 << 20),
   /* Terminate ray immediately at next bounce. */
-  PATH_RAY_TERMINATE_IMMEDIATE = (1 << 20),
+  PATH_RAY_TERMINATE_IMMEDIATE = (1 << 21),
   /* Ray is to be terminated, but continue with transparent bounces and
    * emission as long as we encounter them. This is required to make the
    * MIS between direct and indirect light rays match, as shadow rays go
    * through transparent surfaces to reach emission too. */
-  PATH_RAY_TERMINATE_AFTER_TRANSPARENT = (1 << 21),
+  PATH_RAY_TERMINATE_AFTER_TRANSPARENT = (1 << 22),
   /* Ray is to be terminated. */
   PATH_RAY_TERMINATE = (PATH_RAY_TERMINATE_IMMEDIATE | PATH_RAY_TERMINATE_AFTER_TRANSPARENT),
   /* Path and shader is being evaluated for direct lighting emission. */
-  PATH_RAY_EMISSION = (1 << 22)
+  PATH_RAY_EMISSION = (1 << 23)
 };
 
 /* Closure Label */
@@ -1298,6 +1302,12 @@ typedef struct KernelIntegrator {
   int num_portals;
   int portal_offset;
 
+  /* light tree */
+  int use_light_tree;
+  int num_distant_lights;
+  int distant_lights_offset;
+  float distant_lights_pdf;
+
   /* bounces */
   int min_bounce;
   int max_bounce;
@@ -1501,7 +1511,8 @@ typedef struct KernelLight {
   float max_bounces;
   float random;
   float strength[3];
-  float pad1;
+  /* Index in the light tree emitters, -1 for lights sampled outside the tree. */
+  int tree_emitter;
   Transform tfm;
   Transform itfm;
   union {
@@ -1528,6 +1539,44 @@ typedef struct KernelLightDistribution {
 } KernelLightDistribution;
 static_assert_align(KernelLightDistribution, 16);
 
+/* Bounds of emitter positions and directions, with the total energy emitted.
+ * Shared by light tree nodes and emitters to estimate their importance. */
+typedef struct KernelLightTreeBounds {
+  float bbox_min[3];
+  float energy;
+  float bbox_max[3];
+  float theta_o;
+  float axis[3];
+  float theta_e;
+} KernelLightTreeBounds;
+static_assert_align(KernelLightTreeBounds, 16);
+
+typedef struct KernelLightTreeNode {
+  KernelLightTreeBounds bounds;
+  /* Inner nodes: index of the second child, the first child follows the node.
+   * Leaf nodes: index of the first emitter. */
+  int child_index;
+  /* Number of emitters in leaf nodes, zero for inner nodes. */
+  int num_emitters;
+  int parent_index;
+  int pad;
+} KernelLightTreeNode;
+static_assert_align(KernelLightTreeNode, 16);
+
+typedef struct KernelLightTreeEmitter {
+  KernelLightTreeBounds bounds;
+  /* Triangle or lamp, same as KernelLightDistribution.prim. */
+  int prim;
+  int shader_flag;
+  int object_id;
+  /* Leaf node containing the emitter. */
+  int parent_index;
+  /* Triangles are sampled uniformly over their area once picked. */
+  float inv_area;
+  float pad1, pad2, pad3;
+} KernelLightTreeEmitter;
+static_assert_align(KernelLightTreeEmitter, 16);
+
 typedef struct KernelParticle {
   int index;
   float age;
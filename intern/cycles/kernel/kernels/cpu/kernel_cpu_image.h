@@ -19,6 +19,11 @@
 
 CCL_NAMESPACE_BEGIN
 
+/* Images in the texture cache, see kernel_cpu_texture_cache.cpp. The result is returned
+ * through a float array since the layout of float4 depends on the instruction set. */
+void kernel_tex_image_interp_texture_cache(
+    KernelGlobals *kg, const TextureInfo &info, float x, float y, float result[4]);
+
 /* Make template functions private so symbols don't conflict between kernels with different
  * instruction sets. */
 namespace {
@@ -474,6 +479,12 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
 {
   const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
 
+  if (UNLIKELY(info.use_texture_cache)) {
+    float result[4];
+    kernel_tex_image_interp_texture_cache(kg, info, x, y, result);
+    return make_float4(result[0], result[1], result[2], result[3]);
+  }
+
   switch (info.data_type) {
     case IMAGE_DATA_TYPE_HALF:
       return TextureInterpolator<half>::interp(info, x, y);
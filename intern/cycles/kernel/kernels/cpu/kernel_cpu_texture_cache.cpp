@@ -0,0 +1,169 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Lookups of images in the CPU texture cache. Compiled once instead of per instruction set,
+ * kernels call into it through kernel_tex_image_interp(). */
+
+// clang-format off
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data_types.h"
+#include "kernel/kernel_globals.h"
+#include "kernel/kernels/cpu/kernel_cpu_texture_cache.h"
+// clang-format on
+
+CCL_NAMESPACE_BEGIN
+
+static TextureCacheThreadData *texture_cache_thread_data(KernelGlobals *kg,
+                                                         OIIO::TextureSystem *texture_system)
+{
+  TextureCacheThreadData *tdata = kg->texture_cache_tdata;
+
+  if (UNLIKELY(tdata == NULL)) {
+    tdata = new TextureCacheThreadData();
+    tdata->texture_system = NULL;
+    tdata->thread_info = NULL;
+    kg->texture_cache_tdata = tdata;
+  }
+
+  if (UNLIKELY(tdata->texture_system != texture_system)) {
+    if (tdata->thread_info) {
+      tdata->texture_system->destroy_thread_info(tdata->thread_info);
+    }
+    tdata->texture_system = texture_system;
+    tdata->thread_info = texture_system->create_thread_info();
+  }
+
+  return tdata;
+}
+
+void kernel_texture_cache_thread_free(KernelGlobals *kg)
+{
+  TextureCacheThreadData *tdata = kg->texture_cache_tdata;
+  if (tdata == NULL) {
+    return;
+  }
+
+  if (tdata->thread_info) {
+    tdata->texture_system->destroy_thread_info(tdata->thread_info);
+  }
+
+  delete tdata;
+  kg->texture_cache_tdata = NULL;
+}
+
+static OIIO::TextureOpt::InterpMode texture_cache_interp_mode(const uint interpolation)
+{
+  switch (interpolation) {
+    case INTERPOLATION_CLOSEST:
+      return OIIO::TextureOpt::InterpClosest;
+    case INTERPOLATION_CUBIC:
+    case INTERPOLATION_SMART:
+      return OIIO::TextureOpt::InterpBicubic;
+    case INTERPOLATION_LINEAR:
+    default:
+      return OIIO::TextureOpt::InterpBilinear;
+  }
+}
+
+static OIIO::TextureOpt::Wrap texture_cache_wrap_mode(const uint extension)
+{
+  switch (extension) {
+    case EXTENSION_REPEAT:
+      return OIIO::TextureOpt::WrapPeriodic;
+    case EXTENSION_EXTEND:
+      return OIIO::TextureOpt::WrapClamp;
+    case EXTENSION_CLIP:
+    default:
+      return OIIO::TextureOpt::WrapBlack;
+  }
+}
+
+void kernel_tex_image_interp_texture_cache(
+    KernelGlobals *kg, const TextureInfo &info, float x, float y, float result[4])
+{
+  const TextureCacheImage *image = (const TextureCacheImage *)info.data;
+  OIIO::TextureSystem *texture_system = image->texture_system;
+  TextureCacheThreadData *tdata = texture_cache_thread_data(kg, texture_system);
+
+  OIIO::TextureOpt options;
+  options.interpmode = texture_cache_interp_mode(info.interpolation);
+  options.swrap = texture_cache_wrap_mode(info.extension);
+  options.twrap = options.swrap;
+
+  /* SVM has no derivatives of the image coordinates, so lookups are done on a single
+   * level and only the tiles around the lookup are read. That is the full resolution
+   * level, unless the texture limit scaled the image down. The texture system picks the
+   * level from the filter width in texels along the image width, so a filter spanning
+   * 1.5 texels of the scaled width falls between that level and the next coarser one,
+   * and the finer of the two is used. */
+  float filter_width = 0.0f;
+  if (image->mip_scale < 1.0f) {
+    options.mipmode = OIIO::TextureOpt::MipModeOneLevel;
+    filter_width = 1.5f / (info.width * image->mip_scale);
+  }
+
+  /* Images are stored bottom-up in Cycles while the texture system uses top-down
+   * coordinates. */
+  const int nchannels = min(image->channels, 4);
+  float pixel[4];
+  if (!texture_system->texture(image->handle,
+                               tdata->thread_info,
+                               options,
+                               x,
+                               1.0f - y,
+                               filter_width,
+                               0.0f,
+                               0.0f,
+                               filter_width,
+                               nchannels,
+                               pixel)) {
+    /* Clear the error, so messages don't accumulate. */
+    texture_system->geterror();
+    result[0] = TEX_IMAGE_MISSING_R;
+    result[1] = TEX_IMAGE_MISSING_G;
+    result[2] = TEX_IMAGE_MISSING_B;
+    result[3] = TEX_IMAGE_MISSING_A;
+    return;
+  }
+
+  /* Expand to RGBA the same way file_load_image() does. */
+  switch (nchannels) {
+    case 1:
+      result[0] = result[1] = result[2] = pixel[0];
+      result[3] = 1.0f;
+      break;
+    case 2:
+      result[0] = result[1] = result[2] = pixel[0];
+      result[3] = pixel[1];
+      break;
+    case 3:
+      result[0] = pixel[0];
+      result[1] = pixel[1];
+      result[2] = pixel[2];
+      result[3] = 1.0f;
+      break;
+    default:
+      result[0] = pixel[0];
+      result[1] = pixel[1];
+      result[2] = pixel[2];
+      result[3] = pixel[3];
+      break;
+  }
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __KERNEL_CPU_TEXTURE_CACHE_H__
+#define __KERNEL_CPU_TEXTURE_CACHE_H__
+
+#include <OpenImageIO/texture.h>
+
+#include "util/util_types.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Texture Cache
+ *
+ * On the CPU, images from files can be read through an OpenImageIO texture system
+ * instead of being loaded into memory up front. Tiles are read from the file on first
+ * access and kept in a cache with a fixed memory limit, least recently used tiles are
+ * freed first. */
+
+struct KernelGlobals;
+struct TextureInfo;
+
+/* Image in the texture cache, owned by the image manager. TextureInfo.data points to it. */
+struct TextureCacheImage {
+  OIIO::TextureSystem *texture_system;
+  OIIO::TextureSystem::TextureHandle *handle;
+  /* Channels in the file, lookups are expanded to RGBA like images loaded up front. */
+  int channels;
+  /* Resolution of the MIP level used for lookups relative to the file, below one when
+   * the image is larger than the simplify texture limit. */
+  float mip_scale;
+};
+
+/* Per-thread lookup data. The OpenImageIO thread info keeps the tiles last used by the
+ * thread, so most lookups don't have to lock the shared cache. */
+struct TextureCacheThreadData {
+  OIIO::TextureSystem *texture_system;
+  OIIO::TextureSystem::Perthread *thread_info;
+};
+
+void kernel_tex_image_interp_texture_cache(
+    KernelGlobals *kg, const TextureInfo &info, float x, float y, float result[4]);
+void kernel_texture_cache_thread_free(KernelGlobals *kg);
+
+CCL_NAMESPACE_END
+
+#endif /* __KERNEL_CPU_TEXTURE_CACHE_H__ */
@@ -74,6 +74,11 @@ Geometry::Geometry(const NodeType *node_type, const Type type)
   attr_map_offset = 0;
   optix_prim_offset = 0;
   prim_offset = 0;
+
+  attr_float_offset = 0;
+  attr_float2_offset = 0;
+  attr_float3_offset = 0;
+  attr_uchar4_offset = 0;
 }
 
 Geometry::~Geometry()
@@ -209,6 +214,7 @@ void Geometry::compute_bvh(
       bparams.bvh_layout = bvh_layout;
       bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
                                     params->use_bvh_unaligned_nodes;
+      bparams.use_compressed_nodes = params->use_bvh_compressed_nodes;
       bparams.num_motion_triangle_steps = params->num_bvh_time_steps;
       bparams.num_motion_curve_steps = params->num_bvh_time_steps;
       bparams.bvh_type = params->bvh_type;
@@ -220,9 +226,6 @@ void Geometry::compute_bvh(
       MEM_GUARDED_CALL(progress, bvh->build, *progress);
     }
   }
-
-  need_update = false;
-  need_update_rebuild = false;
 }
 
 bool Geometry::has_motion_blur() const
@@ -265,10 +268,13 @@ GeometryManager::GeometryManager()
 {
   need_update = true;
   need_flags_update = true;
+  need_update_rebuild = true;
+  bvh = NULL;
 }
 
 GeometryManager::~GeometryManager()
 {
+  delete bvh;
 }
 
 void GeometryManager::update_osl_attributes(Device *device,
@@ -518,7 +524,8 @@ static void update_attribute_element_offset(Geometry *geom,
                                             Attribute *mattr,
                                             AttributePrimitive prim,
                                             TypeDesc &type,
-                                            AttributeDescriptor &desc)
+                                            AttributeDescriptor &desc,
+                                            bool copy_data)
 {
   if (mattr) {
     /* store element and type */
@@ -542,8 +549,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_uchar4_offset;
 
       assert(attr_uchar4.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_uchar4[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_uchar4[offset + k] = data[k];
+        }
       }
       attr_uchar4_offset += size;
     }
@@ -552,8 +561,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float_offset;
 
       assert(attr_float.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_float[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_float[offset + k] = data[k];
+        }
       }
       attr_float_offset += size;
     }
@@ -562,8 +573,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float2_offset;
 
       assert(attr_float2.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_float2[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_float2[offset + k] = data[k];
+        }
       }
       attr_float2_offset += size;
     }
@@ -572,8 +585,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float3_offset;
 
       assert(attr_float3.size() >= offset + size * 3);
-      for (size_t k = 0; k < size * 3; k++) {
-        attr_float3[offset + k] = (&tfm->x)[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size * 3; k++) {
+          attr_float3[offset + k] = (&tfm->x)[k];
+        }
       }
       attr_float3_offset += size * 3;
     }
@@ -582,8 +597,10 @@ static void update_attribute_element_offset(Geometry *geom,
       offset = attr_float3_offset;
 
       assert(attr_float3.size() >= offset + size);
-      for (size_t k = 0; k < size; k++) {
-        attr_float3[offset + k] = data[k];
+      if (copy_data) {
+        for (size_t k = 0; k < size; k++) {
+          attr_float3[offset + k] = data[k];
+        }
       }
       attr_float3_offset += size;
     }
@@ -634,6 +651,7 @@ static void update_attribute_element_offset(Geometry *geom,
 void GeometryManager::device_update_attributes(Device *device,
                                                DeviceScene *dscene,
                                                Scene *scene,
+                                               bool in_place,
                                                Progress &progress)
 {
   progress.set_status("Updating Mesh", "Computing attributes");
@@ -693,6 +711,12 @@ void GeometryManager::device_update_attributes(Device *device,
     }
   }
 
+  /* Arrays of the same size keep their data, only changed geometry has to be copied. */
+  in_place = in_place && dscene->attributes_float.size() == attr_float_size &&
+             dscene->attributes_float2.size() == attr_float2_size &&
+             dscene->attributes_float3.size() == attr_float3_size &&
+             dscene->attributes_uchar4.size() == attr_uchar4_size;
+
   dscene->attributes_float.alloc(attr_float_size);
   dscene->attributes_float2.alloc(attr_float2_size);
   dscene->attributes_float3.alloc(attr_float3_size);
@@ -708,6 +732,18 @@ void GeometryManager::device_update_attributes(Device *device,
     Geometry *geom = scene->geometry[i];
     AttributeRequestSet &attributes = geom_attributes[i];
 
+    /* Unchanged geometry keeps its data, unless changes before it moved the data. */
+    const bool copy_data = !in_place || geom->need_update ||
+                           geom->attr_float_offset != attr_float_offset ||
+                           geom->attr_float2_offset != attr_float2_offset ||
+                           geom->attr_float3_offset != attr_float3_offset ||
+                           geom->attr_uchar4_offset != attr_uchar4_offset;
+
+    geom->attr_float_offset = attr_float_offset;
+    geom->attr_float2_offset = attr_float2_offset;
+    geom->attr_float3_offset = attr_float3_offset;
+    geom->attr_uchar4_offset = attr_uchar4_offset;
+
     /* todo: we now store std and name attributes from requests even if
      * they actually refer to the same mesh attributes, optimize */
     foreach (AttributeRequest &req, attributes.requests) {
@@ -724,7 +760,8 @@ void GeometryManager::device_update_attributes(Device *device,
                                       attr,
                                       ATTR_PRIM_GEOMETRY,
                                       req.type,
-                                      req.desc);
+                                      req.desc,
+                                      copy_data);
 
       if (geom->type == Geometry::MESH) {
         Mesh *mesh = static_cast<Mesh *>(geom);
@@ -742,7 +779,8 @@ void GeometryManager::device_update_attributes(Device *device,
                                         subd_attr,
                                         ATTR_PRIM_SUBD,
                                         req.subd_type,
-                                        req.subd_desc);
+                                        req.subd_desc,
+                                        copy_data);
       }
 
       if (progress.get_cancel())
@@ -843,8 +881,12 @@ void GeometryManager::mesh_calc_offset(Scene *scene)
   }
 }
 
-void GeometryManager::device_update_mesh(
-    Device *, DeviceScene *dscene, Scene *scene, bool for_displacement, Progress &progress)
+void GeometryManager::device_update_mesh(Device *,
+                                         DeviceScene *dscene,
+                                         Scene *scene,
+                                         bool for_displacement,
+                                         bool in_place,
+                                         Progress &progress)
 {
   /* Count. */
   size_t vert_size = 0;
@@ -881,6 +923,53 @@ void GeometryManager::device_update_mesh(
     }
   }
 
+  if (in_place) {
+    /* The arrays and BVH kept their layout, only pack geometry that deformed. Vertex
+     * indices and patches stay valid since the topology didn't change. */
+    progress.set_status("Updating Mesh", "Computing normals");
+
+    bool meshes_updated = false;
+    bool curves_updated = false;
+
+    foreach (Geometry *geom, scene->geometry) {
+      if (!geom->need_update) {
+        continue;
+      }
+
+      if (geom->type == Geometry::MESH && tri_size != 0) {
+        Mesh *mesh = static_cast<Mesh *>(geom);
+        mesh->pack_shaders(scene, dscene->tri_shader.data() + mesh->prim_offset);
+        mesh->pack_normals(dscene->tri_vnormal.data() + mesh->vert_offset);
+        meshes_updated = true;
+      }
+      else if (geom->type == Geometry::HAIR && curve_size != 0) {
+        Hair *hair = static_cast<Hair *>(geom);
+        hair->pack_curves(scene,
+                          dscene->curve_keys.data() + hair->curvekey_offset,
+                          dscene->curves.data() + hair->prim_offset,
+                          hair->curvekey_offset);
+        curves_updated = true;
+      }
+
+      if (progress.get_cancel())
+        return;
+    }
+
+    /* Changed arrays are copied whole, devices have no API to copy part of an array. The CPU
+     * device uses the host memory directly, GPU devices upload the whole array again. */
+    progress.set_status("Updating Mesh", "Copying Mesh to device");
+
+    if (meshes_updated) {
+      dscene->tri_shader.copy_to_device();
+      dscene->tri_vnormal.copy_to_device();
+    }
+    if (curves_updated) {
+      dscene->curve_keys.copy_to_device();
+      dscene->curves.copy_to_device();
+    }
+    return;
+  }
+
   /* Create mapping from triangle to primitive triangle array. */
   vector<uint> tri_prim_index(tri_size);
   if (for_displacement) {
@@ -1009,41 +1098,62 @@ void GeometryManager::device_update_mesh(
   }
 }
 
-void GeometryManager::device_update_bvh(Device *device,
-                                        DeviceScene *dscene,
-                                        Scene *scene,
-                                        Progress &progress)
+/* Only layouts where Cycles packs the top level itself can be refit. */
+static bool bvh_layout_supports_refit(const BVHLayout bvh_layout)
 {
-  /* bvh build */
-  progress.set_status("Updating Scene BVH", "Building");
-
-  BVHParams bparams;
-  bparams.top_level = true;
-  bparams.bvh_layout = BVHParams::best_bvh_layout(scene->params.bvh_layout,
-                                                  device->get_bvh_layout_mask());
-  bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
-  bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
-                                scene->params.use_bvh_unaligned_nodes;
-  bparams.num_motion_triangle_steps = scene->params.num_bvh_time_steps;
-  bparams.num_motion_curve_steps = scene->params.num_bvh_time_steps;
-  bparams.bvh_type = scene->params.bvh_type;
-  bparams.curve_flags = dscene->data.curve.curveflags;
-  bparams.curve_subdivisions = dscene->data.curve.subdivisions;
-
-  VLOG(1) << "Using " << bvh_layout_name(bparams.bvh_layout) << " layout.";
+  return bvh_layout == BVH_LAYOUT_BVH2 || bvh_layout == BVH_LAYOUT_BVH4 ||
+         bvh_layout == BVH_LAYOUT_BVH8;
+}
 
-#ifdef WITH_EMBREE
-  if (bparams.bvh_layout == BVH_LAYOUT_EMBREE) {
-    if (dscene->data.bvh.scene) {
-      BVHEmbree::destroy(dscene->data.bvh.scene);
+void GeometryManager::device_update_bvh(
+    Device *device, DeviceScene *dscene, Scene *scene, bool refit, Progress &progress)
+{
+  if (refit) {
+    progress.set_status("Updating Scene BVH", "Refitting");
+
+    VLOG(1) << "Refitting " << bvh_layout_name(bvh->params.bvh_layout) << " layout.";
+
+    /* Take the packed arrays back from the device scene. */
+    PackedBVH &pack = bvh->pack;
+    dscene->bvh_nodes.give_data(pack.nodes);
+    dscene->bvh_leaf_nodes.give_data(pack.leaf_nodes);
+    dscene->object_node.give_data(pack.object_node);
+    dscene->prim_tri_index.give_data(pack.prim_tri_index);
+    dscene->prim_tri_verts.give_data(pack.prim_tri_verts);
+    dscene->prim_type.give_data(pack.prim_type);
+    dscene->prim_visibility.give_data(pack.prim_visibility);
+    dscene->prim_index.give_data(pack.prim_index);
+    dscene->prim_object.give_data(pack.prim_object);
+    dscene->prim_time.give_data(pack.prim_time);
+
+    bvh->refit(progress);
+
+    if (progress.get_cancel()) {
+      delete bvh;
+      bvh = NULL;
+      return;
     }
   }
-#endif
+  else {
+    /* bvh build */
+    progress.set_status("Updating Scene BVH", "Building");
 
-  BVH *bvh = BVH::create(bparams, scene->geometry, scene->objects);
-  bvh->build(progress, &device->stats);
+    BVHParams bparams;
+    bparams.top_level = true;
+    bparams.bvh_layout = BVHParams::best_bvh_layout(scene->params.bvh_layout,
+                                                    device->get_bvh_layout_mask());
+    bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
+    bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
+                                  scene->params.use_bvh_unaligned_nodes;
+    bparams.use_compressed_nodes = scene->params.use_bvh_compressed_nodes;
+    bparams.num_motion_triangle_steps = scene->params.num_bvh_time_steps;
+    bparams.num_motion_curve_steps = scene->params.num_bvh_time_steps;
+    bparams.bvh_type = scene->params.bvh_type;
+    bparams.curve_flags = dscene->data.curve.curveflags;
+    bparams.curve_subdivisions = dscene->data.curve.subdivisions;
+
+    VLOG(1) << "Using " << bvh_layout_name(bparams.bvh_layout) << " layout.";
 
-  if (progress.get_cancel()) {
 #ifdef WITH_EMBREE
     if (bparams.bvh_layout == BVH_LAYOUT_EMBREE) {
       if (dscene->data.bvh.scene) {
@@ -1051,8 +1161,23 @@ void GeometryManager::device_update_bvh(Device *device,
       }
     }
 #endif
+
     delete bvh;
-    return;
+    bvh = BVH::create(bparams, scene->geometry, scene->objects);
+    bvh->build(progress, &device->stats);
+
+    if (progress.get_cancel()) {
+#ifdef WITH_EMBREE
+      if (bparams.bvh_layout == BVH_LAYOUT_EMBREE) {
+        if (dscene->data.bvh.scene) {
+          BVHEmbree::destroy(dscene->data.bvh.scene);
+        }
+      }
+#endif
+      delete bvh;
+      bvh = NULL;
+      return;
+    }
   }
 
   /* copy to device */
@@ -1101,13 +1226,112 @@ void GeometryManager::device_update_bvh(Device *device,
     dscene->prim_time.copy_to_device();
   }
 
+  const BVHLayout bvh_layout = bvh->params.bvh_layout;
+
   dscene->data.bvh.root = pack.root_index;
-  dscene->data.bvh.bvh_layout = bparams.bvh_layout;
+  dscene->data.bvh.bvh_layout = bvh_layout;
   dscene->data.bvh.use_bvh_steps = (scene->params.num_bvh_time_steps != 0);
 
   bvh->copy_to_device(progress, dscene);
 
-  delete bvh;
+  /* Keep the BVH to refit it in the next update, when its structure stays the same. */
+  if (bvh_layout_supports_refit(bvh_layout)) {
+    bvh_objects.resize(scene->objects.size());
+    for (size_t i = 0; i < scene->objects.size(); i++) {
+      const Object *object = scene->objects[i];
+      bvh_objects[i].geometry = object->geometry;
+      bvh_objects[i].is_traceable = object->is_traceable();
+      bvh_objects[i].is_instanced = object->geometry->is_instanced();
+    }
+  }
+  else {
+    delete bvh;
+    bvh = NULL;
+  }
+}
+
+bool GeometryManager::can_update_in_place(Device *device, DeviceScene *dscene, Scene *scene)
+{
+  if (bvh == NULL || need_update_rebuild) {
+    return false;
+  }
+
+  /* Embree and OptiX build their BVH from the scene on the device, there is nothing to update
+   * in place, so they always take the full update. */
+  const BVHLayout bvh_layout = BVHParams::best_bvh_layout(scene->params.bvh_layout,
+                                                          device->get_bvh_layout_mask());
+  if (!bvh_layout_supports_refit(bvh_layout) || bvh->params.bvh_layout != bvh_layout ||
+      bvh->geometry != scene->geometry || bvh->objects != scene->objects) {
+    return false;
+  }
+
+  /* Geometry may only have deformed. Changes in topology, and geometry created on the
+   * device by displacement or tessellation, need a rebuild. */
+  foreach (Geometry *geom, scene->geometry) {
+    if (!geom->need_update) {
+      continue;
+    }
+    if (geom->need_update_rebuild || geom->has_true_displacement()) {
+      return false;
+    }
+    if (geom->type == Geometry::MESH) {
+      Mesh *mesh = static_cast<Mesh *>(geom);
+      if (mesh->subdivision_type != Mesh::SUBDIVISION_NONE ||
+          (mesh->has_volume && mesh->has_voxel_attributes())) {
+        return false;
+      }
+    }
+  }
+
+  /* Geometry must be at the same offsets in the arrays as in the last update. */
+  size_t vert_size = 0;
+  size_t tri_size = 0;
+  size_t curve_key_size = 0;
+  size_t curve_size = 0;
+
+  foreach (Geometry *geom, scene->geometry) {
+    if (geom->type == Geometry::MESH) {
+      Mesh *mesh = static_cast<Mesh *>(geom);
+      if (mesh->vert_offset != vert_size || mesh->prim_offset != tri_size) {
+        return false;
+      }
+      vert_size += mesh->verts.size();
+      tri_size += mesh->num_triangles();
+    }
+    else if (geom->type == Geometry::HAIR) {
+      Hair *hair = static_cast<Hair *>(geom);
+      if (hair->curvekey_offset != curve_key_size || hair->prim_offset != curve_size) {
+        return false;
+      }
+      curve_key_size += hair->curve_keys.size();
+      curve_size += hair->num_curves();
+    }
+  }
+
+  return dscene->tri_vindex.size() == tri_size &&
+         (tri_size == 0 || dscene->tri_vnormal.size() == vert_size) &&
+         dscene->curves.size() == curve_size &&
+         (curve_size == 0 || dscene->curve_keys.size() == curve_key_size);
+}
+
+bool GeometryManager::can_refit_bvh(Scene *scene)
+{
+  if (bvh == NULL || bvh_objects.size() != scene->objects.size()) {
+    return false;
+  }
+
+  /* The same primitives and instances must end up in the top level. */
+  for (size_t i = 0; i < scene->objects.size(); i++) {
+    const Object *object = scene->objects[i];
+    const BVHObjectState &state = bvh_objects[i];
+
+    if (state.geometry != object->geometry || state.is_traceable != object->is_traceable() ||
+        state.is_instanced != object->geometry->is_instanced()) {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 void GeometryManager::device_update_preprocess(Device *device, Scene *scene, Progress &progress)
@@ -1310,17 +1534,21 @@ void GeometryManager::device_update(Device *device,
     scene->object_manager->device_update_flags(device, dscene, scene, progress, false);
   }
 
-  /* Device update. */
-  device_free(device, dscene);
+  /* Device update. When geometry only deformed, the existing arrays are updated in place
+   * and the top level BVH is refit. */
+  const bool update_in_place = can_update_in_place(device, dscene, scene);
+  if (!update_in_place) {
+    device_free(device, dscene);
+  }
 
   mesh_calc_offset(scene);
   if (true_displacement_used) {
-    device_update_mesh(device, dscene, scene, true, progress);
+    device_update_mesh(device, dscene, scene, true, false, progress);
   }
   if (progress.get_cancel())
     return;
 
-  device_update_attributes(device, dscene, scene, progress);
+  device_update_attributes(device, dscene, scene, update_in_place, progress);
   if (progress.get_cancel())
     return;
 
@@ -1352,7 +1580,7 @@ void GeometryManager::device_update(Device *device,
   if (displacement_done) {
     device_free(device, dscene);
 
-    device_update_attributes(device, dscene, scene, progress);
+    device_update_attributes(device, dscene, scene, false, progress);
     if (progress.get_cancel())
       return;
   }
@@ -1390,15 +1618,23 @@ void GeometryManager::device_update(Device *device,
   if (progress.get_cancel())
     return;
 
-  device_update_bvh(device, dscene, scene, progress);
+  const bool refit_bvh = update_in_place && can_refit_bvh(scene);
+
+  device_update_bvh(device, dscene, scene, refit_bvh, progress);
   if (progress.get_cancel())
     return;
 
-  device_update_mesh(device, dscene, scene, false, progress);
+  device_update_mesh(device, dscene, scene, false, refit_bvh, progress);
   if (progress.get_cancel())
     return;
 
+  foreach (Geometry *geom, scene->geometry) {
+    geom->need_update = false;
+    geom->need_update_rebuild = false;
+  }
+
   need_update = false;
+  need_update_rebuild = false;
 
   if (true_displacement_used) {
     /* Re-tag flags for update, so they're re-evaluated
@@ -1413,6 +1649,10 @@ void GeometryManager::device_update(Device *device,
 
 void GeometryManager::device_free(Device *device, DeviceScene *dscene)
 {
+  delete bvh;
+  bvh = NULL;
+  bvh_objects.clear();
+
   dscene->bvh_nodes.free();
   dscene->bvh_leaf_nodes.free();
   dscene->object_node.free();
@@ -1456,6 +1696,7 @@ void GeometryManager::device_free(Device *device, DeviceScene *dscene)
 void GeometryManager::tag_update(Scene *scene)
 {
   need_update = true;
+  need_update_rebuild = true;
   scene->object_manager->need_update = true;
 }
 
@@ -81,6 +81,13 @@ class Geometry : public Node {
   size_t prim_offset;
   size_t optix_prim_offset;
 
+  /* Start of the attribute data in the device arrays, to keep it in place when
+   * the geometry didn't change. */
+  size_t attr_float_offset;
+  size_t attr_float2_offset;
+  size_t attr_float3_offset;
+  size_t attr_uchar4_offset;
+
   /* Shader Properties */
   bool has_volume;         /* Set in the device_update_flags(). */
   bool has_surface_bssrdf; /* Set in the device_update_flags(). */
@@ -147,6 +154,9 @@ class GeometryManager {
   /* Update Flags */
   bool need_update;
   bool need_flags_update;
+  /* Geometry or objects were added, removed or changed in a way that needs all device
+   * arrays and the top level BVH rebuilt, rather than updated in place. */
+  bool need_update_rebuild;
 
   /* Constructor/Destructor */
   GeometryManager();
@@ -168,6 +178,23 @@ class GeometryManager {
 
   void create_volume_mesh(Mesh *mesh, Progress &progress);
 
+  /* Top level BVH of the last update, kept to refit it when geometry only deformed.
+   * Its packed arrays are owned by the device scene in between updates. */
+  BVH *bvh;
+
+  /* Per object state the structure of the top level BVH depends on. */
+  struct BVHObjectState {
+    Geometry *geometry;
+    bool is_traceable;
+    bool is_instanced;
+  };
+  vector<BVHObjectState> bvh_objects;
+
+  /* Whether geometry only deformed since the last update, so the device arrays can be updated
+   * in place. Only for the BVH2, BVH4 and BVH8 layouts. */
+  bool can_update_in_place(Device *device, DeviceScene *dscene, Scene *scene);
+  bool can_refit_bvh(Scene *scene);
+
   /* Attributes */
   void update_osl_attributes(Device *device,
                              Scene *scene,
@@ -186,14 +213,17 @@ class GeometryManager {
                           DeviceScene *dscene,
                           Scene *scene,
                           bool for_displacement,
+                          bool in_place,
                           Progress &progress);
 
   void device_update_attributes(Device *device,
                                 DeviceScene *dscene,
                                 Scene *scene,
+                                bool in_place,
                                 Progress &progress);
 
-  void device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress &progress);
+  void device_update_bvh(
+      Device *device, DeviceScene *dscene, Scene *scene, bool refit, Progress &progress);
 
   void device_update_displacement_images(Device *device, Scene *scene, Progress &progress);
 
@@ -21,6 +21,8 @@
 #include "render/scene.h"
 #include "render/stats.h"
 
+#include "kernel/kernels/cpu/kernel_cpu_texture_cache.h"
+
 #include "util/util_foreach.h"
 #include "util/util_image.h"
 #include "util/util_image_impl.h"
@@ -267,6 +269,10 @@ ImageManager::ImageManager(const DeviceInfo &info)
 
   /* Set image limits */
   has_half_images = info.has_half_images;
+
+  /* Kernels on other devices can't call into OpenImageIO. */
+  has_texture_cache = (info.type == DEVICE_CPU);
+  texture_cache = NULL;
 }
 
 ImageManager::~ImageManager()
@@ -409,6 +415,7 @@ int ImageManager::add_image_slot(ImageLoader *loader,
   img->builtin = builtin;
   img->users = 1;
   img->mem = NULL;
+  img->texture_cache_image = NULL;
 
   images[slot] = img;
 
@@ -442,6 +449,18 @@ void ImageManager::remove_image_user(int slot)
     need_update = true;
 }
 
+/* Power of two scale for images larger than the simplify texture limit. */
+static float image_texture_limit_scale(const size_t max_size, const int texture_limit)
+{
+  float scale_factor = 1.0f;
+  if (texture_limit > 0) {
+    while (max_size * scale_factor > texture_limit) {
+      scale_factor *= 0.5f;
+    }
+  }
+  return scale_factor;
+}
+
 static bool image_associate_alpha(ImageManager::Image *img)
 {
   /* For typical RGBA images we let OIIO convert to associated alpha,
@@ -451,6 +470,111 @@ static bool image_associate_alpha(ImageManager::Image *img)
            img->params.alpha_type == IMAGE_ALPHA_CHANNEL_PACKED);
 }
 
+void ImageManager::texture_cache_update(const SceneParams &params)
+{
+  if (!(params.use_texture_cache && has_texture_cache)) {
+    return;
+  }
+
+  OIIO::TextureSystem *ts = (OIIO::TextureSystem *)texture_cache;
+  if (ts == NULL) {
+    /* Not shared with OSL, so the memory limit and statistics are for this scene only. */
+    ts = OIIO::TextureSystem::create(false);
+    ts->attribute("automip", 1);
+    ts->attribute("autotile", 64);
+    texture_cache = ts;
+  }
+
+  ts->attribute("max_memory_MB", (float)params.texture_cache_size);
+}
+
+bool ImageManager::texture_cache_load_image(Image *img, int texture_limit)
+{
+  OIIO::TextureSystem *ts = (OIIO::TextureSystem *)texture_cache;
+  if (ts == NULL) {
+    return false;
+  }
+
+  /* Only images read from files, no volumes. */
+  const ustring filepath = img->loader->osl_filepath();
+  const ImageMetaData &metadata = img->metadata;
+  if (filepath.empty() || metadata.depth > 1 || metadata.use_transform_3d) {
+    return false;
+  }
+  if (!(metadata.channels >= 1 && metadata.channels <= 4)) {
+    return false;
+  }
+
+  /* Other color spaces are converted to scene linear while loading pixels,
+   * raw and sRGB are read as is and sRGB is converted in the kernel. */
+  if (metadata.colorspace != u_colorspace_raw && metadata.colorspace != u_colorspace_srgb) {
+    return false;
+  }
+
+  /* The texture system always associates alpha. */
+  const bool has_alpha = (metadata.channels == 2 || metadata.channels == 4);
+  if (has_alpha && !image_associate_alpha(img)) {
+    return false;
+  }
+
+  OIIO::TextureSystem::TextureHandle *handle = ts->get_texture_handle(filepath);
+  if (handle == NULL || !ts->good(handle)) {
+    ts->geterror();
+    return false;
+  }
+
+  TextureCacheImage *cache_image = new TextureCacheImage();
+  cache_image->texture_system = ts;
+  cache_image->handle = handle;
+  cache_image->channels = metadata.channels;
+  cache_image->mip_scale = image_texture_limit_scale(max(metadata.width, metadata.height),
+                                                     texture_limit);
+  img->texture_cache_image = cache_image;
+
+  /* Placeholder pixel, the kernel reads through the texture cache. */
+  {
+    thread_scoped_lock device_lock(device_mutex);
+    void *pixels = img->mem->alloc(1, 1);
+    memset(pixels, 0, img->mem->memory_size());
+  }
+
+  img->mem->info.width = metadata.width;
+  img->mem->info.height = metadata.height;
+  img->mem->info.use_texture_cache = true;
+  img->mem->info.data = (uint64_t)cache_image;
+
+  VLOG(1) << "Using texture cache for image " << img->loader->name() << ", scaled by a factor of "
+          << cache_image->mip_scale << ".";
+
+  return true;
+}
+
+void ImageManager::texture_cache_free_image(Image *img)
+{
+  if (img->texture_cache_image == NULL) {
+    return;
+  }
+
+  OIIO::TextureSystem *ts = (OIIO::TextureSystem *)texture_cache;
+  ts->invalidate(img->loader->osl_filepath());
+
+  delete img->texture_cache_image;
+  img->texture_cache_image = NULL;
+}
+
+void ImageManager::texture_cache_free()
+{
+  OIIO::TextureSystem *ts = (OIIO::TextureSystem *)texture_cache;
+  if (ts == NULL) {
+    return;
+  }
+
+  VLOG(2) << "Texture cache stats:\n" << ts->getstats();
+
+  OIIO::TextureSystem::destroy(ts);
+  texture_cache = NULL;
+}
+
 template<TypeDesc::BASETYPE FileFormat, typename StorageType>
 bool ImageManager::file_load_image(Image *img, int texture_limit)
 {
@@ -575,10 +699,7 @@ bool ImageManager::file_load_image(Image *img, int texture_limit)
 
   /* Scale image down if needed. */
   if (pixels_storage.size() > 0) {
-    float scale_factor = 1.0f;
-    while (max_size * scale_factor > texture_limit) {
-      scale_factor *= 0.5f;
-    }
+    const float scale_factor = image_texture_limit_scale(max_size, texture_limit);
     VLOG(1) << "Scaling image " << img->loader->name() << " by a factor of " << scale_factor
             << ".";
     vector<StorageType> scaled_pixels;
@@ -626,6 +747,7 @@ void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Pro
   img->mem_name = string_printf("__tex_image_%s_%03d", name_from_type(type), slot);
 
   /* Free previous texture in slot. */
+  texture_cache_free_image(img);
   if (img->mem) {
     thread_scoped_lock device_lock(device_mutex);
     delete img->mem;
@@ -638,7 +760,10 @@ void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Pro
   img->mem->info.transform_3d = img->metadata.transform_3d;
 
   /* Create new texture. */
-  if (type == IMAGE_DATA_TYPE_FLOAT4) {
+  if (texture_cache_load_image(img, texture_limit)) {
+    /* Pixels are read on demand. */
+  }
+  else if (type == IMAGE_DATA_TYPE_FLOAT4) {
     if (!file_load_image<TypeDesc::FLOAT, float>(img, texture_limit)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
@@ -749,6 +874,8 @@ void ImageManager::device_free_image(Device *, int slot)
 #endif
   }
 
+  texture_cache_free_image(img);
+
   if (img->mem) {
     thread_scoped_lock device_lock(device_mutex);
     delete img->mem;
@@ -765,6 +892,8 @@ void ImageManager::device_update(Device *device, Scene *scene, Progress &progres
     return;
   }
 
+  texture_cache_update(scene->params);
+
   TaskPool pool;
   for (size_t slot = 0; slot < images.size(); slot++) {
     Image *img = images[slot];
@@ -831,6 +960,8 @@ void ImageManager::device_free(Device *device)
     device_free_image(device, slot);
   }
   images.clear();
+
+  texture_cache_free();
 }
 
 void ImageManager::collect_statistics(RenderStats *stats)
@@ -839,6 +970,36 @@ void ImageManager::collect_statistics(RenderStats *stats)
     stats->image.textures.add_entry(
         NamedSizeEntry(image->loader->name(), image->mem->memory_size()));
   }
+
+  OIIO::TextureSystem *ts = (OIIO::TextureSystem *)texture_cache;
+  if (ts == NULL) {
+    return;
+  }
+
+  TextureCacheStats &cache_stats = stats->image.texture_cache;
+  long long memory_used = 0, bytes_read = 0;
+  long long texture_queries = 0, tile_lookups = 0;
+  int tiles_created = 0, tiles_peak = 0;
+  float memory_limit = 0.0f, fileio_time = 0.0f;
+
+  ts->getattribute("max_memory_MB", TypeDesc::FLOAT, &memory_limit);
+  ts->getattribute("stat:cache_memory_used", TypeDesc::INT64, &memory_used);
+  ts->getattribute("stat:bytes_read", TypeDesc::INT64, &bytes_read);
+  ts->getattribute("stat:texture_queries", TypeDesc::INT64, &texture_queries);
+  ts->getattribute("stat:find_tile_calls", TypeDesc::INT64, &tile_lookups);
+  ts->getattribute("stat:tiles_created", TypeDesc::INT, &tiles_created);
+  ts->getattribute("stat:tiles_peak", TypeDesc::INT, &tiles_peak);
+  ts->getattribute("stat:fileio_time", TypeDesc::FLOAT, &fileio_time);
+
+  cache_stats.used = true;
+  cache_stats.memory_limit = (size_t)(memory_limit * 1024.0f * 1024.0f);
+  cache_stats.memory_used = (size_t)memory_used;
+  cache_stats.bytes_read = (size_t)bytes_read;
+  cache_stats.texture_queries = (uint64_t)texture_queries;
+  cache_stats.tile_lookups = (uint64_t)tile_lookups;
+  cache_stats.tiles_created = tiles_created;
+  cache_stats.tiles_peak = tiles_peak;
+  cache_stats.fileio_time = fileio_time;
 }
 
 CCL_NAMESPACE_END
@@ -38,7 +38,9 @@ class ImageManager;
 class Progress;
 class RenderStats;
 class Scene;
+class SceneParams;
 class ColorSpaceProcessor;
+struct TextureCacheImage;
 
 /* Image Parameters */
 class ImageParams {
@@ -198,6 +200,9 @@ class ImageManager {
     string mem_name;
     device_texture *mem;
 
+    /* Set when the pixels are read on demand through the texture cache. */
+    TextureCacheImage *texture_cache_image;
+
     int users;
     thread_mutex mutex;
   };
@@ -212,6 +217,10 @@ class ImageManager {
   vector<Image *> images;
   void *osl_texture_system;
 
+  /* OpenImageIO texture system for images loaded on demand, CPU only. */
+  bool has_texture_cache;
+  void *texture_cache;
+
   int add_image_slot(ImageLoader *loader, const ImageParams &params, const bool builtin);
   void add_image_user(int slot);
   void remove_image_user(int slot);
@@ -221,6 +230,11 @@ class ImageManager {
   template<TypeDesc::BASETYPE FileFormat, typename StorageType>
   bool file_load_image(Image *img, int texture_limit);
 
+  void texture_cache_update(const SceneParams &params);
+  bool texture_cache_load_image(Image *img, int texture_limit);
+  void texture_cache_free_image(Image *img);
+  void texture_cache_free();
+
   void device_load_image(Device *device, Scene *scene, int slot, Progress *progress);
   void device_free_image(Device *device, int slot);
 
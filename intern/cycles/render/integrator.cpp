@@ -76,6 +76,7 @@ NODE_DEFINE(Integrator)
   SOCKET_BOOLEAN(sample_all_lights_direct, "Sample All Lights Direct", true);
   SOCKET_BOOLEAN(sample_all_lights_indirect, "Sample All Lights Indirect", true);
   SOCKET_FLOAT(light_sampling_threshold, "Light Sampling Threshold", 0.05f);
+  SOCKET_BOOLEAN(use_light_tree, "Use Light Tree", false);
 
   static NodeEnum method_enum;
   method_enum.insert("path", PATH);
@@ -171,7 +172,9 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
   kintegrator->volume_samples = volume_samples;
   kintegrator->start_sample = start_sample;
 
-  if (method == BRANCHED_PATH) {
+  /* The light tree picks lights depending on the shading point, so it can't be combined
+   * with sampling all lights. */
+  if (method == BRANCHED_PATH && !(use_light_tree && device->info.has_light_tree)) {
     kintegrator->sample_all_lights_direct = sample_all_lights_direct;
     kintegrator->sample_all_lights_indirect = sample_all_lights_indirect;
   }
@@ -20,6 +20,7 @@
 #include "render/film.h"
 #include "render/graph.h"
 #include "render/integrator.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
 #include "render/object.h"
@@ -257,6 +258,27 @@ bool LightManager::object_usable_as_light(Object *object)
   return false;
 }
 
+/* Visibility flags of mesh lights, the same for all triangles of the object. */
+static int object_light_shader_flag(const Object *object)
+{
+  int shader_flag = 0;
+
+  if (!(object->visibility & PATH_RAY_DIFFUSE)) {
+    shader_flag |= SHADER_EXCLUDE_DIFFUSE;
+  }
+  if (!(object->visibility & PATH_RAY_GLOSSY)) {
+    shader_flag |= SHADER_EXCLUDE_GLOSSY;
+  }
+  if (!(object->visibility & PATH_RAY_TRANSMIT)) {
+    shader_flag |= SHADER_EXCLUDE_TRANSMIT;
+  }
+  if (!(object->visibility & PATH_RAY_VOLUME_SCATTER)) {
+    shader_flag |= SHADER_EXCLUDE_SCATTER;
+  }
+
+  return shader_flag;
+}
+
 void LightManager::device_update_distribution(Device *,
                                               DeviceScene *dscene,
                                               Scene *scene,
@@ -328,22 +350,9 @@ void LightManager::device_update_distribution(Device *,
     bool transform_applied = mesh->transform_applied;
     Transform tfm = object->tfm;
     int object_id = j;
-    int shader_flag = 0;
+    int shader_flag = object_light_shader_flag(object);
 
-    if (!(object->visibility & PATH_RAY_DIFFUSE)) {
-      shader_flag |= SHADER_EXCLUDE_DIFFUSE;
-      use_light_visibility = true;
-    }
-    if (!(object->visibility & PATH_RAY_GLOSSY)) {
-      shader_flag |= SHADER_EXCLUDE_GLOSSY;
-      use_light_visibility = true;
-    }
-    if (!(object->visibility & PATH_RAY_TRANSMIT)) {
-      shader_flag |= SHADER_EXCLUDE_TRANSMIT;
-      use_light_visibility = true;
-    }
-    if (!(object->visibility & PATH_RAY_VOLUME_SCATTER)) {
-      shader_flag |= SHADER_EXCLUDE_SCATTER;
+    if (shader_flag != 0) {
       use_light_visibility = true;
     }
 
@@ -503,6 +512,233 @@ void LightManager::device_update_distribution(Device *,
   }
 }
 
+/* Estimated radiance of emissive triangles, to weight them against other emitters. */
+static float light_tree_shader_emission(Shader *shader)
+{
+  float3 emission;
+  if (shader->is_constant_emission(&emission)) {
+    return average(fabs(emission));
+  }
+  return 1.0f;
+}
+
+void LightManager::device_update_tree(Device *device,
+                                      DeviceScene *dscene,
+                                      Scene *scene,
+                                      Progress &progress)
+{
+  KernelIntegrator *kintegrator = &dscene->data.integrator;
+  kintegrator->use_light_tree = false;
+  kintegrator->num_distant_lights = 0;
+  kintegrator->distant_lights_offset = 0;
+  kintegrator->distant_lights_pdf = 0.0f;
+
+  /* Only CPU kernels are compiled with the light tree, others use the distribution. */
+  if (!(scene->integrator->use_light_tree && kintegrator->use_direct_light &&
+        device->info.has_light_tree)) {
+    return;
+  }
+
+  progress.set_status("Updating Lights", "Building light tree");
+
+  /* Lights with a position go into the tree, distant and background lights are
+   * picked separately. */
+  vector<LightTreePrimitive> prims;
+  vector<LightTreePrimitive> distant_prims;
+
+  int light_index = 0;
+  foreach (Light *light, scene->lights) {
+    if (!light->is_enabled) {
+      continue;
+    }
+
+    LightTreePrimitive prim;
+    prim.prim = ~light_index;
+    prim.object_id = 0;
+    prim.shader_flag = 0;
+    prim.inv_area = 0.0f;
+    prim.bbox = BoundBox::empty;
+    prim.energy = average(fabs(light->strength));
+    light_index++;
+
+    if (light->type == LIGHT_DISTANT || light->type == LIGHT_BACKGROUND) {
+      distant_prims.push_back(prim);
+      continue;
+    }
+
+    if (light->type == LIGHT_AREA) {
+      const float3 axisu = light->axisu * (light->sizeu * light->size);
+      const float3 axisv = light->axisv * (light->sizev * light->size);
+      prim.bbox.grow(light->co + 0.5f * (axisu + axisv));
+      prim.bbox.grow(light->co + 0.5f * (axisu - axisv));
+      prim.bbox.grow(light->co - 0.5f * (axisu + axisv));
+      prim.bbox.grow(light->co - 0.5f * (axisu - axisv));
+      /* One sided, radiant intensity along the normal is a quarter of the strength. */
+      prim.bcone = LightTreeBoundingCone(safe_normalize(light->dir), 0.0f, M_PI_2_F);
+      prim.energy *= 0.25f;
+    }
+    else {
+      prim.bbox.grow(light->co, light->size);
+      if (light->type == LIGHT_SPOT) {
+        prim.bcone = LightTreeBoundingCone(
+            safe_normalize(light->dir), light->spot_angle * 0.5f, M_PI_2_F);
+      }
+      else {
+        prim.bcone = LightTreeBoundingCone(make_float3(0.0f, 0.0f, 1.0f), M_PI_F, M_PI_2_F);
+      }
+      prim.energy *= M_1_PI_F * 0.25f;
+    }
+
+    prims.push_back(prim);
+  }
+
+  /* Emissive triangles, with a table per object to find them from the kernel. */
+  int2 *object_lookup = dscene->light_tree_objects.alloc(scene->objects.size());
+  vector<int> triangle_lookup;
+
+  int object_id = 0;
+  foreach (Object *object, scene->objects) {
+    object_lookup[object_id] = make_int2(-1, 0);
+
+    if (progress.get_cancel()) {
+      return;
+    }
+
+    if (!object_usable_as_light(object)) {
+      object_id++;
+      continue;
+    }
+
+    Mesh *mesh = static_cast<Mesh *>(object->geometry);
+    const bool transform_applied = mesh->transform_applied;
+    const Transform &tfm = object->tfm;
+    const int shader_flag = object_light_shader_flag(object);
+    const size_t mesh_num_triangles = mesh->num_triangles();
+
+    vector<float> shader_emission(mesh->used_shaders.size(), 0.0f);
+    for (size_t i = 0; i < mesh->used_shaders.size(); i++) {
+      shader_emission[i] = light_tree_shader_emission(mesh->used_shaders[i]);
+    }
+
+    object_lookup[object_id] = make_int2(triangle_lookup.size(), mesh->prim_offset);
+    triangle_lookup.resize(triangle_lookup.size() + mesh_num_triangles, -1);
+
+    for (size_t i = 0; i < mesh_num_triangles; i++) {
+      int shader_index = mesh->shader[i];
+      Shader *shader = (shader_index < mesh->used_shaders.size()) ?
+                           mesh->used_shaders[shader_index] :
+                           scene->default_surface;
+
+      if (!(shader->use_mis && shader->has_surface_emission)) {
+        continue;
+      }
+
+      Mesh::Triangle t = mesh->get_triangle(i);
+      if (!t.valid(&mesh->verts[0])) {
+        continue;
+      }
+
+      float3 p1 = mesh->verts[t.v[0]];
+      float3 p2 = mesh->verts[t.v[1]];
+      float3 p3 = mesh->verts[t.v[2]];
+
+      if (!transform_applied) {
+        p1 = transform_point(&tfm, p1);
+        p2 = transform_point(&tfm, p2);
+        p3 = transform_point(&tfm, p3);
+      }
+
+      const float area = triangle_area(p1, p2, p3);
+      if (area == 0.0f) {
+        continue;
+      }
+
+      LightTreePrimitive prim;
+      prim.prim = i + mesh->prim_offset;
+      prim.object_id = object_id;
+      prim.shader_flag = shader_flag;
+      prim.inv_area = 1.0f / area;
+      prim.bbox = BoundBox(p1);
+      prim.bbox.grow(p2);
+      prim.bbox.grow(p3);
+      /* Triangles emit on both sides. */
+      prim.bcone = LightTreeBoundingCone(
+          safe_normalize(cross(p2 - p1, p3 - p1)), M_PI_F, M_PI_2_F);
+      prim.energy = area * ((shader_index < mesh->used_shaders.size()) ?
+                                shader_emission[shader_index] :
+                                light_tree_shader_emission(shader));
+      prims.push_back(prim);
+    }
+
+    object_id++;
+  }
+
+  /* Without emitters the tree would have no root node, keep using the distribution. */
+  if (prims.empty() && distant_prims.empty()) {
+    dscene->light_tree_objects.free();
+    return;
+  }
+
+  /* Build. */
+  LightTree tree(prims);
+  const vector<LightTreeNode> &nodes = tree.get_nodes();
+
+  if (progress.get_cancel()) {
+    return;
+  }
+
+  const size_t num_emitters = prims.size() + distant_prims.size();
+  KernelLightTreeNode *knodes = dscene->light_tree_nodes.alloc(nodes.size());
+  KernelLightTreeEmitter *kemitters = dscene->light_tree_emitters.alloc(num_emitters);
+  tree.pack(knodes, kemitters);
+
+  for (size_t i = 0; i < distant_prims.size(); i++) {
+    light_tree_pack_emitter(&kemitters[prims.size() + i], distant_prims[i], -1);
+  }
+
+  /* Lookups from lamps and triangles to their emitter, for the pdf of BSDF hits. */
+  KernelLight *klights = dscene->lights.data();
+  for (size_t i = 0; i < num_emitters; i++) {
+    const int prim = kemitters[i].prim;
+    if (prim >= 0) {
+      const int2 lookup = object_lookup[kemitters[i].object_id];
+      triangle_lookup[lookup.x + prim - lookup.y] = i;
+    }
+    else if (i < prims.size()) {
+      klights[~prim].tree_emitter = i;
+    }
+  }
+
+  int *ktriangles = dscene->light_tree_triangles.alloc(triangle_lookup.size());
+  for (size_t i = 0; i < triangle_lookup.size(); i++) {
+    ktriangles[i] = triangle_lookup[i];
+  }
+
+  VLOG(1) << "Light tree of " << prims.size() << " emitters and " << distant_prims.size()
+          << " distant lights, " << nodes.size() << " nodes.";
+
+  /* Distant lights get the same share of samples as all other lights together,
+   * like lamps and mesh lights in the distribution. */
+  const int num_distant = distant_prims.size();
+  kintegrator->use_light_tree = true;
+  kintegrator->num_distant_lights = num_distant;
+  kintegrator->distant_lights_offset = prims.size();
+  if (num_distant == 0) {
+    kintegrator->distant_lights_pdf = 0.0f;
+  }
+  else {
+    kintegrator->distant_lights_pdf = (prims.empty()) ? 1.0f : 0.5f;
+    /* Used for background and distant lights hit by BSDF rays. */
+    kintegrator->pdf_lights = kintegrator->distant_lights_pdf / num_distant;
+  }
+
+  dscene->light_tree_nodes.copy_to_device();
+  dscene->light_tree_emitters.copy_to_device();
+  dscene->light_tree_objects.copy_to_device();
+  dscene->light_tree_triangles.copy_to_device();
+  dscene->lights.copy_to_device();
+}
+
 static void background_cdf(
     int start, int end, int res_x, int res_y, const vector<float3> *pixels, float2 *cond_cdf)
 {
@@ -709,6 +945,7 @@ void LightManager::device_update_points(Device *, DeviceScene *dscene, Scene *sc
     }
 
     klights[light_index].type = light->type;
+    klights[light_index].tree_emitter = -1;
     klights[light_index].samples = light->samples;
     klights[light_index].strength[0] = light->strength.x;
     klights[light_index].strength[1] = light->strength.y;
@@ -915,6 +1152,10 @@ void LightManager::device_update(Device *device,
   if (progress.get_cancel())
     return;
 
+  device_update_tree(device, dscene, scene, progress);
+  if (progress.get_cancel())
+    return;
+
   device_update_background(device, dscene, scene, progress);
   if (progress.get_cancel())
     return;
@@ -934,6 +1175,10 @@ void LightManager::device_update(Device *device,
 void LightManager::device_free(Device *, DeviceScene *dscene)
 {
   dscene->light_distribution.free();
+  dscene->light_tree_nodes.free();
+  dscene->light_tree_emitters.free();
+  dscene->light_tree_objects.free();
+  dscene->light_tree_triangles.free();
   dscene->lights.free();
   dscene->light_background_marginal_cdf.free();
   dscene->light_background_conditional_cdf.free();
@@ -0,0 +1,293 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/light_tree.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Bounding Cone */
+
+float LightTreeBoundingCone::measure() const
+{
+  const float theta_w = min(theta_o + theta_e, M_PI_F);
+  const float cos_theta_o = cosf(theta_o);
+  const float sin_theta_o = sinf(theta_o);
+
+  return M_2PI_F * (1.0f - cos_theta_o) +
+         M_PI_2_F * (2.0f * theta_w * sin_theta_o - cosf(theta_o - 2.0f * theta_w) -
+                     2.0f * theta_o * sin_theta_o + cos_theta_o);
+}
+
+LightTreeBoundingCone merge(const LightTreeBoundingCone &cone_a,
+                            const LightTreeBoundingCone &cone_b)
+{
+  /* Let a be the wider cone. */
+  const bool swap = cone_a.theta_o < cone_b.theta_o;
+  const LightTreeBoundingCone &a = (swap) ? cone_b : cone_a;
+  const LightTreeBoundingCone &b = (swap) ? cone_a : cone_b;
+
+  const float theta_d = safe_acosf(dot(a.axis, b.axis));
+  const float theta_e = max(a.theta_e, b.theta_e);
+
+  /* One cone contains the other. */
+  if (min(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+    return LightTreeBoundingCone(a.axis, a.theta_o, theta_e);
+  }
+
+  /* Cone around both, rotated from a towards b. */
+  const float theta_o = 0.5f * (a.theta_o + theta_d + b.theta_o);
+  if (theta_o >= M_PI_F) {
+    return LightTreeBoundingCone(a.axis, M_PI_F, theta_e);
+  }
+
+  const float3 rotation_axis = cross(a.axis, b.axis);
+  if (len_squared(rotation_axis) < 1e-12f) {
+    return LightTreeBoundingCone(a.axis, M_PI_F, theta_e);
+  }
+
+  const float theta_r = theta_o - a.theta_o;
+  const float3 k = normalize(rotation_axis);
+  const float3 axis = a.axis * cosf(theta_r) + cross(k, a.axis) * sinf(theta_r);
+
+  return LightTreeBoundingCone(normalize(axis), theta_o, theta_e);
+}
+
+/* Light Tree */
+
+/* Surface area orientation heuristic, cost of a node in the tree. */
+static float light_tree_cost(const BoundBox &bbox,
+                             const LightTreeBoundingCone &bcone,
+                             const float energy)
+{
+  return energy * bbox.safe_area() * bcone.measure();
+}
+
+static const int light_tree_num_buckets = 12;
+
+static int light_tree_bucket(const LightTreePrimitive &prim,
+                             const BoundBox &centroid_bbox,
+                             const int axis)
+{
+  const float extent = centroid_bbox.max[axis] - centroid_bbox.min[axis];
+  const float t = (prim.bbox.center()[axis] - centroid_bbox.min[axis]) / extent;
+  return clamp((int)(t * light_tree_num_buckets), 0, light_tree_num_buckets - 1);
+}
+
+LightTree::LightTree(vector<LightTreePrimitive> &prims_, int max_prims_in_leaf_)
+    : prims(prims_), max_prims_in_leaf(max_prims_in_leaf_)
+{
+  if (prims.empty()) {
+    return;
+  }
+
+  nodes.reserve(2 * prims.size());
+  recursive_build(0, prims.size(), -1);
+}
+
+int LightTree::recursive_build(int start, int end, int parent_index)
+{
+  const int node_index = nodes.size();
+  nodes.push_back(LightTreeNode());
+
+  BoundBox bbox = BoundBox::empty;
+  BoundBox centroid_bbox = BoundBox::empty;
+  LightTreeBoundingCone bcone = prims[start].bcone;
+  float energy = 0.0f;
+
+  for (int i = start; i < end; i++) {
+    const LightTreePrimitive &prim = prims[i];
+    bbox.grow(prim.bbox);
+    centroid_bbox.grow(prim.bbox.center());
+    if (i != start) {
+      bcone = merge(bcone, prim.bcone);
+    }
+    energy += prim.energy;
+  }
+
+  LightTreeNode &node = nodes[node_index];
+  node.bbox = bbox;
+  node.bcone = bcone;
+  node.energy = energy;
+  node.parent_index = parent_index;
+  node.child_index = start;
+  node.num_prims = 0;
+
+  const int num_prims = end - start;
+  int split_axis = 0;
+  int split_bucket = 0;
+  const bool has_split = (num_prims > 1) &&
+                         find_split(start, end, centroid_bbox, &split_axis, &split_bucket);
+
+  /* Splitting always gives a better estimate of the contribution of the emitters, so
+   * only emitters which can't be separated share a leaf. */
+  if (num_prims == 1 || (num_prims <= max_prims_in_leaf && !has_split)) {
+    nodes[node_index].num_prims = num_prims;
+    return node_index;
+  }
+
+  int middle = (start + end) / 2;
+  if (has_split) {
+    vector<LightTreePrimitive>::iterator mid = std::partition(
+        prims.begin() + start, prims.begin() + end, [&](const LightTreePrimitive &prim) {
+          return light_tree_bucket(prim, centroid_bbox, split_axis) < split_bucket;
+        });
+    middle = mid - prims.begin();
+  }
+  /* Otherwise all centroids are in the same place, split by count. */
+
+  recursive_build(start, middle, node_index);
+  const int right_index = recursive_build(middle, end, node_index);
+
+  /* Node reference may be invalid after the vector grew. */
+  nodes[node_index].child_index = right_index;
+
+  return node_index;
+}
+
+/* Finds the bucket boundary with the lowest cost. Returns false when all centroids
+ * are in the same bucket. */
+bool LightTree::find_split(
+    int start, int end, const BoundBox &centroid_bbox, int *r_axis, int *r_bucket)
+{
+  const int num_buckets = light_tree_num_buckets;
+
+  struct Bucket {
+    BoundBox bbox = BoundBox::empty;
+    LightTreeBoundingCone bcone;
+    float energy = 0.0f;
+    int count = 0;
+
+    void add(const BoundBox &other_bbox,
+             const LightTreeBoundingCone &other_bcone,
+             const float other_energy,
+             const int other_count)
+    {
+      if (other_count == 0) {
+        return;
+      }
+      bbox.grow(other_bbox);
+      bcone = (count == 0) ? other_bcone : merge(bcone, other_bcone);
+      energy += other_energy;
+      count += other_count;
+    }
+  };
+
+  const float3 extent = centroid_bbox.size();
+  const float max_extent = max3(extent);
+
+  float best_cost = FLT_MAX;
+  bool found = false;
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (extent[axis] == 0.0f) {
+      continue;
+    }
+
+    Bucket buckets[num_buckets];
+    for (int i = start; i < end; i++) {
+      const LightTreePrimitive &prim = prims[i];
+      buckets[light_tree_bucket(prim, centroid_bbox, axis)].add(
+          prim.bbox, prim.bcone, prim.energy, 1);
+    }
+
+    /* Cost of everything right of the boundary. */
+    float right_costs[num_buckets];
+    Bucket right;
+    for (int i = num_buckets - 1; i > 0; i--) {
+      const Bucket &bucket = buckets[i];
+      right.add(bucket.bbox, bucket.bcone, bucket.energy, bucket.count);
+      right_costs[i] = light_tree_cost(right.bbox, right.bcone, right.energy);
+    }
+
+    /* Long thin nodes are penalized, splitting along their length is preferred. */
+    const float regularization = max_extent / extent[axis];
+
+    Bucket left;
+    for (int i = 1; i < num_buckets; i++) {
+      const Bucket &bucket = buckets[i - 1];
+      left.add(bucket.bbox, bucket.bcone, bucket.energy, bucket.count);
+      if (left.count == 0 || left.count == end - start) {
+        continue;
+      }
+
+      const float cost = regularization *
+                         (light_tree_cost(left.bbox, left.bcone, left.energy) + right_costs[i]);
+      if (cost < best_cost) {
+        best_cost = cost;
+        *r_axis = axis;
+        *r_bucket = i;
+        found = true;
+      }
+    }
+  }
+
+  return found;
+}
+
+/* Packing */
+
+static void light_tree_pack_bounds(KernelLightTreeBounds *kbounds,
+                                   const BoundBox &bbox,
+                                   const LightTreeBoundingCone &bcone,
+                                   const float energy)
+{
+  kbounds->bbox_min[0] = bbox.min.x;
+  kbounds->bbox_min[1] = bbox.min.y;
+  kbounds->bbox_min[2] = bbox.min.z;
+  kbounds->energy = energy;
+  kbounds->bbox_max[0] = bbox.max.x;
+  kbounds->bbox_max[1] = bbox.max.y;
+  kbounds->bbox_max[2] = bbox.max.z;
+  kbounds->theta_o = bcone.theta_o;
+  kbounds->axis[0] = bcone.axis.x;
+  kbounds->axis[1] = bcone.axis.y;
+  kbounds->axis[2] = bcone.axis.z;
+  kbounds->theta_e = bcone.theta_e;
+}
+
+void light_tree_pack_emitter(KernelLightTreeEmitter *kemitter,
+                             const LightTreePrimitive &prim,
+                             int parent_index)
+{
+  light_tree_pack_bounds(&kemitter->bounds, prim.bbox, prim.bcone, prim.energy);
+  kemitter->prim = prim.prim;
+  kemitter->shader_flag = prim.shader_flag;
+  kemitter->object_id = prim.object_id;
+  kemitter->parent_index = parent_index;
+  kemitter->inv_area = prim.inv_area;
+  kemitter->pad1 = kemitter->pad2 = kemitter->pad3 = 0.0f;
+}
+
+void LightTree::pack(KernelLightTreeNode *knodes, KernelLightTreeEmitter *kemitters) const
+{
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const LightTreeNode &node = nodes[i];
+    light_tree_pack_bounds(&knodes[i].bounds, node.bbox, node.bcone, node.energy);
+    knodes[i].child_index = node.child_index;
+    knodes[i].num_emitters = node.num_prims;
+    knodes[i].parent_index = node.parent_index;
+    knodes[i].pad = 0;
+
+    for (int j = node.child_index; j < node.child_index + node.num_prims; j++) {
+      light_tree_pack_emitter(&kemitters[j], prims[j], i);
+    }
+  }
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree
+ *
+ * Hierarchy of emitters for sampling one light out of many, based on
+ * "Importance Sampling of Many Lights with Adaptive Tree Splitting"
+ * by Conty Estevez and Kulla. Every node bounds the positions and emission
+ * directions of the emitters below it, so the kernel can estimate how much
+ * light a node contributes to a shading point and descend proportionally. */
+
+/* Directions of emission: normals within theta_o of the axis, each emitting
+ * within theta_e around the normal. */
+struct LightTreeBoundingCone {
+  float3 axis;
+  float theta_o;
+  float theta_e;
+
+  LightTreeBoundingCone() : axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(0.0f), theta_e(0.0f)
+  {
+  }
+
+  LightTreeBoundingCone(const float3 &axis, float theta_o, float theta_e)
+      : axis(axis), theta_o(theta_o), theta_e(theta_e)
+  {
+  }
+
+  /* Solid angle measure used by the orientation heuristic of the build. */
+  float measure() const;
+};
+
+LightTreeBoundingCone merge(const LightTreeBoundingCone &a, const LightTreeBoundingCone &b);
+
+struct LightTreePrimitive {
+  /* Triangle index, or ~lamp index for lamps, like KernelLightDistribution. */
+  int prim;
+  int object_id;
+  int shader_flag;
+  /* Inverse triangle area, unused for lamps. */
+  float inv_area;
+
+  BoundBox bbox;
+  LightTreeBoundingCone bcone;
+  /* Estimated emitted power, used to weight the emitter against others. */
+  float energy;
+};
+
+/* Packs an emitter for the kernel, parent_index is its leaf or -1 outside the tree. */
+void light_tree_pack_emitter(KernelLightTreeEmitter *kemitter,
+                             const LightTreePrimitive &prim,
+                             int parent_index);
+
+struct LightTreeNode {
+  BoundBox bbox;
+  LightTreeBoundingCone bcone;
+  float energy;
+
+  /* Inner nodes: index of the second child, the first child follows the node.
+   * Leaf nodes: index of the first primitive. */
+  int child_index;
+  /* Number of primitives in leaf nodes, zero for inner nodes. */
+  int num_prims;
+  /* Parent node, -1 for the root. */
+  int parent_index;
+
+  bool is_leaf() const
+  {
+    return num_prims > 0;
+  }
+};
+
+class LightTree {
+ public:
+  /* Builds the tree, reordering the primitives so every leaf references a contiguous range. */
+  LightTree(vector<LightTreePrimitive> &prims, int max_prims_in_leaf = 8);
+
+  const vector<LightTreeNode> &get_nodes() const
+  {
+    return nodes;
+  }
+
+  /* Packs the nodes, and the primitives as emitters in the same order. */
+  void pack(KernelLightTreeNode *knodes, KernelLightTreeEmitter *kemitters) const;
+
+ protected:
+  int recursive_build(int start, int end, int parent_index);
+  bool find_split(
+      int start, int end, const BoundBox &centroid_bbox, int *r_axis, int *r_bucket);
+
+  vector<LightTreePrimitive> &prims;
+  vector<LightTreeNode> nodes;
+  int max_prims_in_leaf;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
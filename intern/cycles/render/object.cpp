@@ -899,7 +899,7 @@ void ObjectManager::tag_update(Scene *scene)
 {
   need_update = true;
   scene->curve_system_manager->need_update = true;
-  scene->geometry_manager->need_update = true;
+  scene->geometry_manager->tag_update(scene);
   scene->light_manager->need_update = true;
 }
 
@@ -71,6 +71,10 @@ DeviceScene::DeviceScene(Device *device)
       attributes_float3(device, "__attributes_float3", MEM_GLOBAL),
       attributes_uchar4(device, "__attributes_uchar4", MEM_GLOBAL),
       light_distribution(device, "__light_distribution", MEM_GLOBAL),
+      light_tree_nodes(device, "__light_tree_nodes", MEM_GLOBAL),
+      light_tree_emitters(device, "__light_tree_emitters", MEM_GLOBAL),
+      light_tree_objects(device, "__light_tree_objects", MEM_GLOBAL),
+      light_tree_triangles(device, "__light_tree_triangles", MEM_GLOBAL),
       lights(device, "__lights", MEM_GLOBAL),
       light_background_marginal_cdf(device, "__light_background_marginal_cdf", MEM_GLOBAL),
       light_background_conditional_cdf(device, "__light_background_conditional_cdf", MEM_GLOBAL),
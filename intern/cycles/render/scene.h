@@ -105,6 +105,10 @@ class DeviceScene {
 
   /* lights */
   device_vector<KernelLightDistribution> light_distribution;
+  device_vector<KernelLightTreeNode> light_tree_nodes;
+  device_vector<KernelLightTreeEmitter> light_tree_emitters;
+  device_vector<int2> light_tree_objects;
+  device_vector<int> light_tree_triangles;
   device_vector<KernelLight> lights;
   device_vector<float2> light_background_marginal_cdf;
   device_vector<float2> light_background_conditional_cdf;
@@ -167,10 +171,15 @@ class SceneParams {
   BVHType bvh_type;
   bool use_bvh_spatial_split;
   bool use_bvh_unaligned_nodes;
+  bool use_bvh_compressed_nodes;
   int num_bvh_time_steps;
   bool persistent_data;
   int texture_limit;
 
+  /* Load image tiles on demand on the CPU, with a cache limited to texture_cache_size MB. */
+  bool use_texture_cache;
+  int texture_cache_size;
+
   bool background;
 
   SceneParams()
@@ -180,9 +189,12 @@ class SceneParams {
     bvh_type = BVH_DYNAMIC;
     use_bvh_spatial_split = false;
     use_bvh_unaligned_nodes = true;
+    use_bvh_compressed_nodes = false;
     num_bvh_time_steps = 0;
     persistent_data = false;
     texture_limit = 0;
+    use_texture_cache = false;
+    texture_cache_size = 4096;
     background = true;
   }
 
@@ -192,8 +204,11 @@ class SceneParams {
              bvh_type == params.bvh_type &&
              use_bvh_spatial_split == params.use_bvh_spatial_split &&
              use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes &&
+             use_bvh_compressed_nodes == params.use_bvh_compressed_nodes &&
              num_bvh_time_steps == params.num_bvh_time_steps &&
-             persistent_data == params.persistent_data && texture_limit == params.texture_limit);
+             persistent_data == params.persistent_data && texture_limit == params.texture_limit &&
+             use_texture_cache == params.use_texture_cache &&
+             texture_cache_size == params.texture_cache_size);
   }
 };
 
@@ -210,6 +210,42 @@ string MeshStats::full_report(int indent_level)
   return result;
 }
 
+/* Texture cache statistics. */
+
+TextureCacheStats::TextureCacheStats()
+    : used(false),
+      memory_limit(0),
+      memory_used(0),
+      bytes_read(0),
+      texture_queries(0),
+      tile_lookups(0),
+      tiles_created(0),
+      tiles_peak(0),
+      fileio_time(0.0f)
+{
+}
+
+string TextureCacheStats::full_report(int indent_level)
+{
+  const string indent(indent_level * kIndentNumSpaces, ' ');
+  string result = "";
+  result += string_printf("%sMemory used: %s of %s\n",
+                          indent.c_str(),
+                          string_human_readable_size(memory_used).c_str(),
+                          string_human_readable_size(memory_limit).c_str());
+  result += string_printf("%sRead from files: %s in %.2fs\n",
+                          indent.c_str(),
+                          string_human_readable_size(bytes_read).c_str(),
+                          (double)fileio_time);
+  result += string_printf(
+      "%sTiles: %d created, %d peak\n", indent.c_str(), tiles_created, tiles_peak);
+  result += string_printf("%sLookups: %s texture, %s tile\n",
+                          indent.c_str(),
+                          string_human_readable_number(texture_queries).c_str(),
+                          string_human_readable_number(tile_lookups).c_str());
+  return result;
+}
+
 /* Image statistics. */
 
 ImageStats::ImageStats()
@@ -221,6 +257,9 @@ string ImageStats::full_report(int indent_level)
   const string indent(indent_level * kIndentNumSpaces, ' ');
   string result = "";
   result += indent + "Textures:\n" + textures.full_report(indent_level + 1);
+  if (texture_cache.used) {
+    result += indent + "Texture Cache:\n" + texture_cache.full_report(indent_level + 1);
+  }
   return result;
 }
 
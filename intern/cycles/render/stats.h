@@ -124,6 +124,26 @@ class MeshStats {
   NamedSizeStats geometry;
 };
 
+/* Statistics about the texture cache, which reads image tiles on demand. */
+class TextureCacheStats {
+ public:
+  TextureCacheStats();
+
+  /* Generate full human-readable report. */
+  string full_report(int indent_level = 0);
+
+  bool used;
+  size_t memory_limit;
+  size_t memory_used;
+  size_t bytes_read;
+  uint64_t texture_queries;
+  uint64_t tile_lookups;
+  int tiles_created;
+  int tiles_peak;
+  /* In seconds, summed over all threads. */
+  float fileio_time;
+};
+
 /* Statistics about images held in memory. */
 class ImageStats {
  public:
@@ -133,6 +153,7 @@ class ImageStats {
   string full_report(int indent_level = 0);
 
   NamedSizeStats textures;
+  TextureCacheStats texture_cache;
 };
 
 /* Render process statistics. */
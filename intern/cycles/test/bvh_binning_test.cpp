@@ -0,0 +1,166 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "bvh/bvh_binning.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_hash.h"
+#include "util/util_task.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Exposes the single threaded binning and partitioning, to compare against the parallel
+ * code path used for large ranges. */
+class BVHObjectBinningTest : public BVHObjectBinning {
+ public:
+  BVHObjectBinningTest(const BVHRange &job, BVHReference *prims) : BVHObjectBinning(job, prims)
+  {
+  }
+
+  static size_t parallel_min_size()
+  {
+    return PARALLEL_MIN_SIZE;
+  }
+
+  void check_bins(const BVHReference *prims) const
+  {
+    Bins bins, bins_serial;
+    bin_prims(prims, &bins);
+    init_bins(&bins_serial);
+    bin_block(prims, start(), end(), &bins_serial);
+
+    for (size_t i = 0; i < num_bins; i++) {
+      for (int k = 0; k < 3; k++) {
+        EXPECT_EQ(bins.count[i][k], bins_serial.count[i][k]);
+        EXPECT_EQ(bins.bounds[i][k].min, bins_serial.bounds[i][k].min);
+        EXPECT_EQ(bins.bounds[i][k].max, bins_serial.bounds[i][k].max);
+      }
+    }
+  }
+
+  /* Splits prims with split(), and prims_serial in a single block. */
+  void check_split(BVHReference *prims, BVHReference *prims_serial) const
+  {
+    BVHObjectBinning left, right;
+    split(prims, left, right);
+
+    SplitBlock block;
+    block.start = start();
+    block.end = end();
+    split_block(prims_serial, &block);
+    const int num_left = (int)block.num_left;
+
+    /* Not the object median fallback, which doesn't use the blocks. */
+    ASSERT_GT(num_left, 0);
+    ASSERT_LT(num_left, size());
+
+    EXPECT_EQ(left.start(), start());
+    EXPECT_EQ(left.size(), num_left);
+    EXPECT_EQ(right.start(), start() + num_left);
+    EXPECT_EQ(right.size(), size() - num_left);
+
+    EXPECT_EQ(left.bounds().min, block.lgeom_bounds.min);
+    EXPECT_EQ(left.bounds().max, block.lgeom_bounds.max);
+    EXPECT_EQ(right.bounds().min, block.rgeom_bounds.min);
+    EXPECT_EQ(right.bounds().max, block.rgeom_bounds.max);
+    EXPECT_EQ(left.cent_bounds().min, block.lcent_bounds.min);
+    EXPECT_EQ(left.cent_bounds().max, block.lcent_bounds.max);
+    EXPECT_EQ(right.cent_bounds().min, block.rcent_bounds.min);
+    EXPECT_EQ(right.cent_bounds().max, block.rcent_bounds.max);
+
+    /* Same primitives on each side, their order within a side may differ. */
+    vector<int> left_prims, left_prims_serial;
+    for (int i = start(); i < start() + num_left; i++) {
+      left_prims.push_back(prims[i].prim_index());
+      left_prims_serial.push_back(prims_serial[i].prim_index());
+    }
+    sort(left_prims.begin(), left_prims.end());
+    sort(left_prims_serial.begin(), left_prims_serial.end());
+    EXPECT_TRUE(left_prims == left_prims_serial);
+  }
+};
+
+/* Random small primitives, with every seventh one at the same position. When sorted they
+ * are ordered along X instead, so whole blocks end up on one side of the split. The range starts
+ * after offset references, which are not part of it. */
+BVHRange references_create(vector<BVHReference> &refs,
+                           const int offset,
+                           const int size,
+                           const bool sorted)
+{
+  BoundBox bounds = BoundBox::empty;
+  BoundBox cent_bounds = BoundBox::empty;
+
+  refs.resize(offset + size);
+  for (int i = 0; i < offset + size; i++) {
+    float3 co = make_float3(hash_uint2_to_float(i, 0) * 100.0f,
+                            hash_uint2_to_float(i, 1) * 10.0f,
+                            hash_uint2_to_float(i, 2));
+    if (sorted) {
+      co.x = (float)i / (offset + size) * 100.0f;
+    }
+    else if (i % 7 == 0) {
+      co = make_float3(5.0f, 5.0f, 0.5f);
+    }
+
+    const BoundBox prim_bounds(co, co + make_float3(0.1f, 0.1f, 0.1f));
+    refs[i] = BVHReference(prim_bounds, i, 0, PRIMITIVE_TRIANGLE);
+
+    if (i >= offset) {
+      bounds.grow(prim_bounds);
+      cent_bounds.grow(prim_bounds.center2());
+    }
+  }
+
+  return BVHRange(bounds, cent_bounds, offset, size);
+}
+
+}  // namespace
+
+TEST(bvh_binning, parallel_matches_serial)
+{
+  TaskScheduler::init(0);
+
+  const int parallel_min_size = BVHObjectBinningTest::parallel_min_size();
+  const int sizes[] = {parallel_min_size, 3 * parallel_min_size + 123, 1000003};
+  const int offset = 1000;
+
+  for (const int size : sizes) {
+    for (const bool sorted : {false, true}) {
+      vector<BVHReference> refs;
+      const BVHRange range = references_create(refs, offset, size, sorted);
+      vector<BVHReference> refs_serial = refs;
+
+      const BVHObjectBinningTest binning(range, &refs[0]);
+      binning.check_bins(&refs[0]);
+      binning.check_split(&refs[0], &refs_serial[0]);
+
+      /* References outside of the range are untouched. */
+      for (int i = 0; i < offset; i++) {
+        EXPECT_EQ(refs[i].prim_index(), i);
+      }
+    }
+  }
+
+  TaskScheduler::exit();
+}
+
+CCL_NAMESPACE_END
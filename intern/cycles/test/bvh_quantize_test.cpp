@@ -0,0 +1,167 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "bvh/bvh.h"
+
+#include "util/util_boundbox.h"
+#include "util/util_hash.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Gives access to the quantization of compressed nodes. */
+class BVHQuantize : public BVH {
+ public:
+  using BVH::quantize_child_bounds;
+};
+
+/* Reconstruct the planes like the kernel does, both with and without fused multiply-add,
+ * every quantized box must contain the original one. */
+void quantize_check(const BoundBox *bounds, const int num)
+{
+  float3 origin, scale;
+  uchar lower[3][8], upper[3][8];
+  const uint child_mask = BVHQuantize::quantize_child_bounds(
+      bounds, num, origin, scale, lower, upper);
+
+  for (int i = 0; i < num; i++) {
+    const bool valid = bounds[i].valid();
+    EXPECT_EQ((child_mask & (1 << i)) != 0, valid) << "child " << i;
+    if (!valid) {
+      continue;
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+      const float o = origin[axis];
+      const float s = scale[axis];
+      const float q_lower = (float)lower[axis][i];
+      const float q_upper = (float)upper[axis][i];
+
+      EXPECT_LE(lower[axis][i], upper[axis][i]);
+      EXPECT_LE(q_lower * s + o, bounds[i].min[axis]) << "child " << i << " axis " << axis;
+      EXPECT_GE(q_upper * s + o, bounds[i].max[axis]) << "child " << i << " axis " << axis;
+      EXPECT_LE(fmaf(q_lower, s, o), bounds[i].min[axis]) << "child " << i << " axis " << axis;
+      EXPECT_GE(fmaf(q_upper, s, o), bounds[i].max[axis]) << "child " << i << " axis " << axis;
+    }
+  }
+}
+
+float3 random_float3(uint &seed, const float range)
+{
+  const float x = hash_uint2_to_float(seed, 0);
+  const float y = hash_uint2_to_float(seed, 1);
+  const float z = hash_uint2_to_float(seed, 2);
+  seed++;
+  return (make_float3(x, y, z) * 2.0f - make_float3(1.0f, 1.0f, 1.0f)) * range;
+}
+
+/* Boxes around \a center, up to \a size large, some slots are left empty. */
+void quantize_check_random(const float3 center,
+                           const float range,
+                           const float size,
+                           const int num_iterations)
+{
+  uint seed = 0;
+  for (int iteration = 0; iteration < num_iterations; iteration++) {
+    BoundBox bounds[8];
+    const int num = 1 + iteration % 8;
+    for (int i = 0; i < num; i++) {
+      if (hash_uint2_to_float(seed++, 3) < 0.1f) {
+        bounds[i] = BoundBox::empty;
+        continue;
+      }
+      const float3 p = center + random_float3(seed, range);
+      bounds[i] = BoundBox(p, p + fabs(random_float3(seed, size)));
+    }
+    quantize_check(bounds, num);
+  }
+}
+
+}  // namespace
+
+TEST(bvh_quantize, random)
+{
+  quantize_check_random(make_float3(0.0f, 0.0f, 0.0f), 100.0f, 10.0f, 10000);
+}
+
+TEST(bvh_quantize, tiny_children)
+{
+  /* Children much smaller than the node, they cover a single quantization step at most. */
+  quantize_check_random(make_float3(0.0f, 0.0f, 0.0f), 100.0f, 1e-4f, 10000);
+}
+
+TEST(bvh_quantize, large_coordinates)
+{
+  quantize_check_random(make_float3(1e6f, -3e6f, 1e7f), 1000.0f, 10.0f, 10000);
+  quantize_check_random(make_float3(-1e7f, 1e7f, 5e6f), 1.0f, 1e-2f, 10000);
+  quantize_check_random(make_float3(0.0f, 0.0f, 0.0f), 1e30f, 1e29f, 1000);
+}
+
+TEST(bvh_quantize, flat_axis)
+{
+  uint seed = 0;
+  for (int iteration = 0; iteration < 1000; iteration++) {
+    /* Flat children at different heights, and all on the same plane. */
+    BoundBox bounds[8];
+    const float plane_z = random_float3(seed, 100.0f).z;
+    for (int i = 0; i < 8; i++) {
+      const float3 p = random_float3(seed, 100.0f);
+      const float3 q = p + fabs(random_float3(seed, 10.0f));
+      const float z = (iteration % 2) ? plane_z : p.z;
+      bounds[i] = BoundBox(make_float3(p.x, p.y, z), make_float3(q.x, q.y, z));
+    }
+    quantize_check(bounds, 8);
+  }
+}
+
+TEST(bvh_quantize, zero_size)
+{
+  /* Points, at the origin where the node has no extent at all, and away from it. */
+  const float3 points[] = {make_float3(0.0f, 0.0f, 0.0f),
+                           make_float3(1.0f, -2.0f, 3.0f),
+                           make_float3(-1e6f, 1e-6f, 1e7f)};
+  for (const float3 &p : points) {
+    BoundBox bounds[4];
+    for (int i = 0; i < 4; i++) {
+      bounds[i] = BoundBox(p);
+    }
+    quantize_check(bounds, 4);
+  }
+
+  /* Points spread out in a node with extent. */
+  uint seed = 0;
+  for (int iteration = 0; iteration < 1000; iteration++) {
+    BoundBox bounds[8];
+    for (int i = 0; i < 8; i++) {
+      bounds[i] = BoundBox(random_float3(seed, 100.0f));
+    }
+    quantize_check(bounds, 8);
+  }
+}
+
+TEST(bvh_quantize, empty)
+{
+  BoundBox bounds[4] = {BoundBox::empty, BoundBox::empty, BoundBox::empty, BoundBox::empty};
+  float3 origin, scale;
+  uchar lower[3][8], upper[3][8];
+  EXPECT_EQ(BVHQuantize::quantize_child_bounds(bounds, 4, origin, scale, lower, upper), 0u);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/mock_log.h"
+#include "testing/testing.h"
+
+#include "device/device.h"
+#include "render/mesh.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/shader.h"
+#include "util/util_boundbox.h"
+#include "util/util_logging.h"
+#include "util/util_math.h"
+#include "util/util_progress.h"
+#include "util/util_stats.h"
+
+using testing::_;
+using testing::AnyNumber;
+using testing::HasSubstr;
+using testing::ScopedMockLog;
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+const int grid_resolution = 32;
+
+/* Fills the mesh with a grid of smooth triangles, displaced along Z by a wave. Like
+ * synchronization from Blender, the mesh is cleared first so normals are computed again. */
+void grid_fill(Scene *scene, Mesh *mesh, const float amplitude)
+{
+  const int res = grid_resolution;
+
+  mesh->clear();
+  mesh->used_shaders.push_back(scene->default_surface);
+  mesh->reserve_mesh((res + 1) * (res + 1), res * res * 2);
+
+  for (int y = 0; y <= res; y++) {
+    for (int x = 0; x <= res; x++) {
+      const float u = (float)x / res;
+      const float v = (float)y / res;
+      const float z = amplitude * sinf(M_2PI_F * u) * cosf(M_PI_F * v);
+      mesh->add_vertex(make_float3(u, v, z));
+    }
+  }
+
+  for (int y = 0; y < res; y++) {
+    for (int x = 0; x < res; x++) {
+      const int v0 = y * (res + 1) + x;
+      const int v1 = v0 + 1;
+      const int v2 = v0 + res + 2;
+      const int v3 = v0 + res + 1;
+      mesh->add_triangle(v0, v1, v2, 0, true);
+      mesh->add_triangle(v0, v2, v3, 0, true);
+    }
+  }
+}
+
+/* Union of the child bounds stored in the root node. */
+BoundBox bvh_root_bounds(DeviceScene &dscene)
+{
+  const int root = dscene.data.bvh.root;
+  const float4 *nodes = (const float4 *)dscene.bvh_nodes.data();
+  BoundBox bounds = BoundBox::empty;
+
+  if (dscene.data.bvh.bvh_layout == BVH_LAYOUT_BVH2) {
+    for (int i = 0; i < 2; i++) {
+      bounds.grow(make_float3(nodes[root + 1][i], nodes[root + 2][i], nodes[root + 3][i]));
+      bounds.grow(
+          make_float3(nodes[root + 1][i + 2], nodes[root + 2][i + 2], nodes[root + 3][i + 2]));
+    }
+  }
+  else {
+    /* BVH4 node, empty child slots have inverted bounds. */
+    for (int i = 0; i < 4; i++) {
+      if (nodes[root + 1][i] <= nodes[root + 2][i]) {
+        bounds.grow(make_float3(nodes[root + 1][i], nodes[root + 3][i], nodes[root + 5][i]));
+        bounds.grow(make_float3(nodes[root + 2][i], nodes[root + 4][i], nodes[root + 6][i]));
+      }
+    }
+  }
+
+  return bounds;
+}
+
+BoundBox mesh_bounds(const Mesh *mesh)
+{
+  BoundBox bounds = BoundBox::empty;
+  for (size_t i = 0; i < mesh->verts.size(); i++) {
+    bounds.grow(mesh->verts[i]);
+  }
+  return bounds;
+}
+
+}  // namespace
+
+class RenderGeometry : public testing::Test {
+ protected:
+  ScopedMockLog log;
+  Stats stats;
+  Profiler profiler;
+  DeviceInfo device_info;
+  Device *device_cpu;
+  Progress progress;
+
+  virtual void SetUp()
+  {
+    util_logging_start();
+    util_logging_verbosity_set(1);
+
+    device_cpu = Device::create(device_info, stats, profiler, true);
+  }
+
+  virtual void TearDown()
+  {
+    delete device_cpu;
+  }
+
+  Scene *scene_create(const BVHLayout bvh_layout, const float amplitude, Mesh **r_mesh)
+  {
+    SceneParams scene_params;
+    scene_params.bvh_layout = bvh_layout;
+    Scene *scene = new Scene(scene_params, device_cpu);
+
+    Mesh *mesh = new Mesh();
+    grid_fill(scene, mesh, amplitude);
+    scene->geometry.push_back(mesh);
+
+    Object *object = new Object();
+    object->geometry = mesh;
+    object->tfm = transform_identity();
+    scene->objects.push_back(object);
+
+    scene->device_update(device_cpu, progress);
+    *r_mesh = mesh;
+    return scene;
+  }
+
+  /* Deforms a mesh after the first update, and compares the device data that was updated in
+   * place to a scene created with the deformed mesh. */
+  void deform_in_place_check(const BVHLayout bvh_layout)
+  {
+    EXPECT_CALL(log, Log(_, _, _)).Times(AnyNumber());
+    /* Only the second update of the deformed scene refits. */
+    EXPECT_CALL(log, Log(google::INFO, _, HasSubstr("Refitting"))).Times(1);
+
+    Mesh *mesh;
+    Scene *scene = scene_create(bvh_layout, 0.0f, &mesh);
+    ASSERT_EQ(scene->dscene.data.bvh.bvh_layout, bvh_layout);
+    EXPECT_LT(bvh_root_bounds(scene->dscene).size().z, 1e-5f);
+
+    grid_fill(scene, mesh, 0.5f);
+    mesh->tag_update(scene, false);
+    scene->device_update(device_cpu, progress);
+
+    Mesh *mesh_expected;
+    Scene *scene_expected = scene_create(bvh_layout, 0.5f, &mesh_expected);
+
+    DeviceScene &dscene = scene->dscene;
+    DeviceScene &dscene_expected = scene_expected->dscene;
+
+    /* The BVH bounds the deformed mesh. */
+    const BoundBox bounds = bvh_root_bounds(dscene);
+    const BoundBox bounds_expected = mesh_bounds(mesh);
+    EXPECT_TRUE(bounds.valid());
+    EXPECT_NEAR(bounds.min.z, -0.5f, 1e-3f);
+    EXPECT_NEAR(bounds.max.z, 0.5f, 1e-3f);
+    EXPECT_NEAR(len(bounds.min - bounds_expected.min), 0.0f, 1e-5f);
+    EXPECT_NEAR(len(bounds.max - bounds_expected.max), 0.0f, 1e-5f);
+    EXPECT_NEAR(len(bvh_root_bounds(dscene_expected).min - bounds_expected.min), 0.0f, 1e-5f);
+    EXPECT_NEAR(len(bvh_root_bounds(dscene_expected).max - bounds_expected.max), 0.0f, 1e-5f);
+
+    /* Triangle vertices stored for intersection are the deformed ones. */
+    ASSERT_EQ(dscene.prim_index.size(), dscene_expected.prim_index.size());
+    const float4 *prim_tri_verts = dscene.prim_tri_verts.data();
+    for (size_t i = 0; i < dscene.prim_index.size(); i++) {
+      if (!(dscene.prim_type[i] & PRIMITIVE_TRIANGLE)) {
+        continue;
+      }
+
+      const Mesh::Triangle t = mesh->get_triangle(dscene.prim_index[i]);
+      for (int j = 0; j < 3; j++) {
+        const float4 P = prim_tri_verts[dscene.prim_tri_index[i] + j];
+        EXPECT_EQ(make_float3(P.x, P.y, P.z), mesh->verts[t.v[j]]);
+      }
+    }
+
+    /* Smooth normals are packed again. */
+    ASSERT_EQ(dscene.tri_vnormal.size(), dscene_expected.tri_vnormal.size());
+    for (size_t i = 0; i < dscene.tri_vnormal.size(); i++) {
+      const float4 N = dscene.tri_vnormal[i];
+      const float4 N_expected = dscene_expected.tri_vnormal[i];
+      EXPECT_NEAR(len(make_float3(N.x - N_expected.x, N.y - N_expected.y, N.z - N_expected.z)),
+                  0.0f,
+                  1e-5f);
+    }
+
+    delete scene_expected;
+    delete scene;
+  }
+};
+
+TEST_F(RenderGeometry, deform_in_place_bvh2)
+{
+  deform_in_place_check(BVH_LAYOUT_BVH2);
+}
+
+TEST_F(RenderGeometry, deform_in_place_bvh4)
+{
+  deform_in_place_check(BVH_LAYOUT_BVH4);
+}
+
+CCL_NAMESPACE_END
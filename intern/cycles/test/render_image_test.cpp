@@ -0,0 +1,189 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+// clang-format off
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+#include "kernel/kernel_globals.h"
+#include "kernel/kernels/cpu/kernel_cpu_texture_cache.h"
+// clang-format on
+
+#include "device/device.h"
+#include "render/image.h"
+#include "render/scene.h"
+#include "util/util_progress.h"
+#include "util/util_stats.h"
+#include "util/util_unique_ptr.h"
+#include "util/util_vector.h"
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+const int image_width = 256;
+const int image_height = 128;
+
+/* Checkerboard of single texels, every MIP level below the full resolution is gray. */
+float checker_value(const int x, const int y)
+{
+  return ((x + y) % 2) ? 1.0f : 0.0f;
+}
+
+bool checker_write(const string &filepath)
+{
+  unique_ptr<OIIO::ImageOutput> out(OIIO::ImageOutput::create(filepath));
+  if (!out) {
+    return false;
+  }
+
+  const OIIO::ImageSpec spec(image_width, image_height, 3, TypeDesc::FLOAT);
+  vector<float> pixels(image_width * image_height * 3);
+  for (int y = 0; y < image_height; y++) {
+    for (int x = 0; x < image_width; x++) {
+      float *pixel = &pixels[(y * image_width + x) * 3];
+      pixel[0] = pixel[1] = pixel[2] = checker_value(x, y);
+    }
+  }
+
+  const bool ok = out->open(filepath, spec) && out->write_image(TypeDesc::FLOAT, &pixels[0]);
+  return out->close() && ok;
+}
+
+}  // namespace
+
+class RenderImage : public testing::Test {
+ protected:
+  Stats stats;
+  Profiler profiler;
+  DeviceInfo device_info;
+  Device *device_cpu;
+  Progress progress;
+  string filepath;
+
+  virtual void SetUp()
+  {
+    device_cpu = Device::create(device_info, stats, profiler, true);
+
+    filepath = OIIO::Filesystem::temp_directory_path() + "/cycles-image-test-" +
+               OIIO::Filesystem::unique_path() + ".tif";
+    ASSERT_TRUE(checker_write(filepath));
+  }
+
+  virtual void TearDown()
+  {
+    OIIO::Filesystem::remove(filepath);
+    delete device_cpu;
+  }
+
+  Scene *scene_create(const bool use_texture_cache, const int texture_limit, ImageHandle *handle)
+  {
+    SceneParams scene_params;
+    scene_params.use_texture_cache = use_texture_cache;
+    scene_params.texture_limit = texture_limit;
+    Scene *scene = new Scene(scene_params, device_cpu);
+
+    ImageParams params;
+    params.interpolation = INTERPOLATION_CLOSEST;
+    *handle = scene->image_manager->add_image(filepath, params);
+    scene->image_manager->device_update(device_cpu, scene, progress);
+
+    return scene;
+  }
+
+  /* Looks up the image through the texture cache at the texel centers of a grid with the
+   * given resolution, and returns the largest difference to the expected value. */
+  float texture_cache_error(const TextureInfo &info,
+                            const int width,
+                            const int height,
+                            const bool full_resolution)
+  {
+    KernelGlobals kg;
+    kg.texture_cache_tdata = NULL;
+
+    float max_error = 0.0f;
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        float result[4];
+        kernel_tex_image_interp_texture_cache(
+            &kg, info, (x + 0.5f) / width, (y + 0.5f) / height, result);
+
+        /* Files are stored top-down, images in Cycles bottom-up. */
+        const float expected = (full_resolution) ? checker_value(x, height - 1 - y) : 0.5f;
+        for (int i = 0; i < 3; i++) {
+          max_error = max(max_error, fabsf(result[i] - expected));
+        }
+        max_error = max(max_error, fabsf(result[3] - 1.0f));
+      }
+    }
+
+    kernel_texture_cache_thread_free(&kg);
+    return max_error;
+  }
+};
+
+TEST_F(RenderImage, texture_cache_full_resolution)
+{
+  ImageHandle handle;
+  Scene *scene = scene_create(true, 0, &handle);
+
+  const TextureInfo &info = handle.image_memory()->info;
+  ASSERT_TRUE(info.use_texture_cache);
+  EXPECT_EQ(info.width, (uint)image_width);
+  EXPECT_EQ(info.height, (uint)image_height);
+  EXPECT_EQ(((const TextureCacheImage *)info.data)->mip_scale, 1.0f);
+  EXPECT_LT(texture_cache_error(info, image_width, image_height, true), 1e-5f);
+
+  handle.clear();
+  delete scene;
+}
+
+TEST_F(RenderImage, texture_cache_texture_limit)
+{
+  ImageHandle handle;
+  Scene *scene = scene_create(true, 64, &handle);
+
+  /* Lookups use the level with the same resolution as an image scaled down on load. */
+  const TextureInfo &info = handle.image_memory()->info;
+  ASSERT_TRUE(info.use_texture_cache);
+  EXPECT_EQ(((const TextureCacheImage *)info.data)->mip_scale, 0.25f);
+  EXPECT_LT(texture_cache_error(info, image_width / 4, image_height / 4, false), 1e-3f);
+
+  handle.clear();
+  delete scene;
+}
+
+TEST_F(RenderImage, texture_limit_loaded)
+{
+  ImageHandle handle;
+  Scene *scene = scene_create(false, 64, &handle);
+
+  const TextureInfo &info = handle.image_memory()->info;
+  EXPECT_FALSE(info.use_texture_cache);
+  EXPECT_EQ(info.width, (uint)image_width / 4);
+  EXPECT_EQ(info.height, (uint)image_height / 4);
+
+  handle.clear();
+  delete scene;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/light_tree.h"
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+#include "kernel/kernel_globals.h"
+#include "kernel/kernel_light_tree.h"
+
+#include "util/util_hash.h"
+#include "util/util_logging.h"
+#include "util/util_math.h"
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* A city at night: street lights along a grid of roads, and lit windows on the
+ * facades of the blocks between them. */
+void city_lights(vector<LightTreePrimitive> &prims, const int num_blocks)
+{
+  const float block_size = 50.0f;
+  uint seed = 0;
+
+  for (int y = 0; y < num_blocks; y++) {
+    for (int x = 0; x < num_blocks; x++) {
+      const float3 corner = make_float3(x * block_size, y * block_size, 0.0f);
+
+      /* Street lights, spot lights pointing down. */
+      for (int i = 0; i < 10; i++) {
+        LightTreePrimitive prim;
+        prim.prim = ~(int)prims.size();
+        prim.object_id = -1;
+        prim.shader_flag = 0;
+        prim.inv_area = 0.0f;
+        const float3 co = corner + make_float3(i * block_size * 0.1f, 0.0f, 6.0f);
+        prim.bbox = BoundBox(co - make_float3(0.1f, 0.1f, 0.1f), co + make_float3(0.1f, 0.1f, 0.1f));
+        prim.bcone = LightTreeBoundingCone(make_float3(0.0f, 0.0f, -1.0f), M_PI_4_F, M_PI_2_F);
+        prim.energy = 100.0f;
+        prims.push_back(prim);
+      }
+
+      /* Windows, two-sided emissive quads facing the roads. */
+      for (int i = 0; i < 40; i++) {
+        const float u = hash_uint2_to_float(seed++, 0);
+        const float floor_height = 3.0f * (1 + (i % 10));
+        const float3 co = corner + make_float3(5.0f + 40.0f * u, 5.0f, floor_height);
+
+        LightTreePrimitive prim;
+        prim.prim = (int)prims.size();
+        prim.object_id = 0;
+        prim.shader_flag = 0;
+        prim.inv_area = 1.0f;
+        prim.bbox = BoundBox(co, co + make_float3(1.0f, 0.0f, 1.0f));
+        prim.bcone = LightTreeBoundingCone(make_float3(0.0f, -1.0f, 0.0f), M_PI_F, M_PI_2_F);
+        prim.energy = 0.5f + hash_uint2_to_float(seed++, 1);
+        prims.push_back(prim);
+      }
+    }
+  }
+}
+
+bool cone_contains(const LightTreeBoundingCone &a, const LightTreeBoundingCone &b)
+{
+  const float theta_d = safe_acosf(dot(a.axis, b.axis));
+  return (a.theta_o >= M_PI_F - 1e-4f) || (theta_d + b.theta_o <= a.theta_o + 1e-4f);
+}
+
+bool bbox_contains(const BoundBox &a, const BoundBox &b)
+{
+  return a.min.x <= b.min.x && a.min.y <= b.min.y && a.min.z <= b.min.z && a.max.x >= b.max.x &&
+         a.max.y >= b.max.y && a.max.z >= b.max.z;
+}
+
+}  // namespace
+
+TEST(render_light_tree, merge_cones)
+{
+  const LightTreeBoundingCone up(make_float3(0.0f, 0.0f, 1.0f), 0.0f, M_PI_2_F);
+  const LightTreeBoundingCone side(make_float3(1.0f, 0.0f, 0.0f), 0.0f, M_PI_2_F);
+  const LightTreeBoundingCone down(make_float3(0.0f, 0.0f, -1.0f), 0.0f, M_PI_2_F);
+
+  const LightTreeBoundingCone up_side = merge(up, side);
+  EXPECT_NEAR(up_side.theta_o, M_PI_4_F, 1e-5f);
+  EXPECT_TRUE(cone_contains(up_side, up));
+  EXPECT_TRUE(cone_contains(up_side, side));
+
+  /* Opposite directions need the full sphere. */
+  const LightTreeBoundingCone up_down = merge(up, down);
+  EXPECT_NEAR(up_down.theta_o, M_PI_F, 1e-5f);
+
+  /* Merging a contained cone doesn't change it. */
+  const LightTreeBoundingCone same = merge(up_side, up);
+  EXPECT_NEAR(same.theta_o, up_side.theta_o, 1e-5f);
+}
+
+TEST(render_light_tree, city)
+{
+  vector<LightTreePrimitive> prims;
+  city_lights(prims, 50);
+  const int num_prims = prims.size();
+
+  double build_time = 0.0;
+  vector<LightTreeNode> nodes;
+  {
+    scoped_timer timer(&build_time);
+    LightTree tree(prims);
+    nodes = tree.get_nodes();
+  }
+  LOG(INFO) << "Light tree of " << num_prims << " emitters, " << nodes.size() << " nodes, built in "
+            << build_time << " seconds.";
+
+  ASSERT_EQ(prims.size(), num_prims);
+  ASSERT_FALSE(nodes.empty());
+  EXPECT_EQ(nodes[0].parent_index, -1);
+
+  /* Every emitter is in exactly one leaf, and nodes bound their children. */
+  vector<int> prim_leaf(num_prims, -1);
+  for (int i = 0; i < nodes.size(); i++) {
+    const LightTreeNode &node = nodes[i];
+
+    if (node.is_leaf()) {
+      EXPECT_LE(node.num_prims, 8);
+      float energy = 0.0f;
+      for (int j = node.child_index; j < node.child_index + node.num_prims; j++) {
+        ASSERT_LT(j, num_prims);
+        EXPECT_EQ(prim_leaf[j], -1);
+        prim_leaf[j] = i;
+        EXPECT_TRUE(bbox_contains(node.bbox, prims[j].bbox));
+        EXPECT_TRUE(cone_contains(node.bcone, prims[j].bcone));
+        energy += prims[j].energy;
+      }
+      EXPECT_NEAR(node.energy, energy, 1e-3f * energy);
+      continue;
+    }
+
+    const int left = i + 1;
+    const int right = node.child_index;
+    ASSERT_LT(right, nodes.size());
+    EXPECT_EQ(nodes[left].parent_index, i);
+    EXPECT_EQ(nodes[right].parent_index, i);
+    EXPECT_TRUE(bbox_contains(node.bbox, nodes[left].bbox));
+    EXPECT_TRUE(bbox_contains(node.bbox, nodes[right].bbox));
+    EXPECT_TRUE(cone_contains(node.bcone, nodes[left].bcone));
+    EXPECT_TRUE(cone_contains(node.bcone, nodes[right].bcone));
+    EXPECT_NEAR(node.energy, nodes[left].energy + nodes[right].energy, 1e-3f * node.energy);
+  }
+
+  for (int j = 0; j < num_prims; j++) {
+    EXPECT_NE(prim_leaf[j], -1);
+  }
+}
+
+TEST(render_light_tree, sample_pdf)
+{
+  vector<LightTreePrimitive> prims;
+  city_lights(prims, 5);
+  const int num_prims = prims.size();
+
+  LightTree tree(prims);
+  const vector<LightTreeNode> &nodes = tree.get_nodes();
+  ASSERT_FALSE(nodes.empty());
+
+  /* Two distant lights after the tree emitters, picked with half of the samples. */
+  const int num_distant = 2;
+  vector<KernelLightTreeNode> knodes(nodes.size());
+  vector<KernelLightTreeEmitter> kemitters(num_prims + num_distant);
+  tree.pack(knodes.data(), kemitters.data());
+
+  LightTreePrimitive distant;
+  distant.prim = ~0;
+  distant.object_id = 0;
+  distant.shader_flag = 0;
+  distant.inv_area = 0.0f;
+  distant.energy = 1.0f;
+  for (int i = 0; i < num_distant; i++) {
+    light_tree_pack_emitter(&kemitters[num_prims + i], distant, -1);
+  }
+
+  KernelGlobals kg;
+  kg.__light_tree_nodes.data = knodes.data();
+  kg.__light_tree_nodes.width = knodes.size();
+  kg.__light_tree_emitters.data = kemitters.data();
+  kg.__light_tree_emitters.width = kemitters.size();
+  kg.__data.integrator.use_light_tree = true;
+  kg.__data.integrator.num_distant_lights = num_distant;
+  kg.__data.integrator.distant_lights_offset = num_prims;
+  kg.__data.integrator.distant_lights_pdf = 0.5f;
+
+  /* Shading points between the facades and below the street lights, from where every
+   * emitter can contribute, and high above the city, where the street lights point away. */
+  const float3 points_lit[] = {make_float3(20.0f, 2.0f, 1.0f), make_float3(120.0f, 80.0f, 3.0f)};
+  const float3 points_above[] = {make_float3(125.0f, 125.0f, 1000.0f)};
+
+  for (const float3 &P : points_lit) {
+    float pdf_sum = 0.0f;
+    for (int i = 0; i < num_prims; i++) {
+      pdf_sum += light_tree_emitter_pdf(&kg, i, P);
+    }
+    EXPECT_NEAR(pdf_sum, 0.5f, 1e-4f);
+  }
+
+  /* Street lights pointing away from P are never picked. When a leaf has no emitter that
+   * can reach P sampling fails, so the probabilities can add up to less than one. */
+  for (const float3 &P : points_above) {
+    float pdf_sum = 0.0f;
+    for (int i = 0; i < num_prims; i++) {
+      const float pdf = light_tree_emitter_pdf(&kg, i, P);
+      if (prims[i].prim < 0) {
+        EXPECT_EQ(pdf, 0.0f);
+      }
+      pdf_sum += pdf;
+    }
+    EXPECT_GT(pdf_sum, 0.0f);
+    EXPECT_LE(pdf_sum, 0.5f + 1e-4f);
+  }
+
+  /* The probability of sampling an emitter matches the one evaluated for BSDF hits. */
+  for (int p = 0; p < 3; p++) {
+    const float3 P = (p < 2) ? points_lit[p] : points_above[p - 2];
+    int num_picked = 0;
+
+    for (int i = 0; i < 1000; i++) {
+      float randu = hash_uint2_to_float(i, 2);
+      float pdf = 0.0f;
+      const int emitter = light_tree_sample(&kg, P, &randu, &pdf);
+      if (emitter == -1) {
+        continue;
+      }
+
+      num_picked++;
+      EXPECT_GE(randu, 0.0f);
+      EXPECT_LE(randu, 1.0f);
+
+      if (emitter >= num_prims) {
+        EXPECT_LT(emitter, num_prims + num_distant);
+        EXPECT_FLOAT_EQ(pdf, 0.5f / num_distant);
+      }
+      else {
+        EXPECT_GT(pdf, 0.0f);
+        EXPECT_NEAR(pdf, light_tree_emitter_pdf(&kg, emitter, P), 1e-5f * pdf);
+      }
+    }
+
+    if (p < 2) {
+      EXPECT_EQ(num_picked, 1000);
+    }
+  }
+}
+
+CCL_NAMESPACE_END
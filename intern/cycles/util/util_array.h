@@ -139,6 +139,16 @@ template<typename T, size_t alignment = MIN_ALIGNMENT_CPU_DATA_TYPES> class arra
     return ptr;
   }
 
+  /* Take over memory allocated like mem_allocate(), the opposite of steal_pointer(). */
+  void set_data(T *ptr, size_t newsize)
+  {
+    clear();
+
+    data_ = ptr;
+    datasize_ = (ptr) ? newsize : 0;
+    capacity_ = datasize_;
+  }
+
   T *resize(size_t newsize)
   {
     if (newsize == 0) {
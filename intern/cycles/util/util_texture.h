@@ -103,6 +103,8 @@ typedef struct TextureInfo {
   uint width, height, depth;
   /* Transform for 3D textures. */
   uint use_transform_3d;
+  /* CPU texture cache, data points to a TextureCacheImage instead of pixels. */
+  uint use_texture_cache;
   Transform transform_3d;
 } TextureInfo;
 
@@ -245,6 +245,7 @@ void animsys_evaluate_action_group(struct PointerRNA *ptr,
 struct Depsgraph;
 
 void BKE_animsys_eval_animdata(struct Depsgraph *depsgraph, struct ID *id);
+bool BKE_animsys_eval_animdata_check_changed(struct Depsgraph *depsgraph, struct ID *id);
 void BKE_animsys_eval_driver(struct Depsgraph *depsgraph,
                              struct ID *id,
                              int driver_index,
@@ -248,6 +248,8 @@ bool bvhcache_has_tree(const BVHCache *cache, const BVHTree *tree);
 void bvhcache_insert(BVHCache **cache_p, BVHTree *tree, int type);
 void bvhcache_free(BVHCache **cache_p);
 
+BVHCache *bvhcache_reuse_take_from_mesh(struct Mesh *mesh);
+
 #ifdef __cplusplus
 }
 #endif
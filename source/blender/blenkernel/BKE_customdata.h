@@ -248,6 +248,15 @@ void CustomData_copy_data(const struct CustomData *source,
                           int source_index,
                           int dest_index,
                           int count);
+/* like CustomData_copy_data, but gathers the source elements given by src_indices
+ * into count consecutive dest elements starting at dest_index,
+ * this goes over the data one layer at a time, rather than one element at a time
+ */
+void CustomData_copy_data_indices(const struct CustomData *source,
+                                  struct CustomData *dest,
+                                  const int *src_indices,
+                                  int dest_index,
+                                  int count);
 void CustomData_copy_data_named(const struct CustomData *source,
                                 struct CustomData *dest,
                                 int source_index,
@@ -296,6 +305,19 @@ void CustomData_interp(const struct CustomData *source,
                        const float *sub_weights,
                        int count,
                        int dest_index);
+/* like CustomData_interp, for dest_count consecutive dest elements starting at dest_index,
+ * which are all interpolated from the same count source elements
+ *
+ * weights gives count weights for each dest element (dest_count * count in total)
+ * the dest elements must not be among the source elements
+ */
+void CustomData_interp_span(const struct CustomData *source,
+                            struct CustomData *dest,
+                            const int *src_indices,
+                            const float *weights,
+                            int count,
+                            int dest_index,
+                            int dest_count);
 void CustomData_bmesh_interp_n(struct CustomData *data,
                                const void **src_blocks,
                                const float *weights,
@@ -394,6 +416,7 @@ void CustomData_set_layer_stencil_index(struct CustomData *data, int type, int n
 void CustomData_set_layer_flag(struct CustomData *data, int type, int flag);
 void CustomData_clear_layer_flag(struct CustomData *data, int type, int flag);
 
+void CustomData_bmesh_alloc_block(struct CustomData *data, void **block);
 void CustomData_bmesh_set_default(struct CustomData *data, void **block);
 void CustomData_bmesh_free_block(struct CustomData *data, void **block);
 void CustomData_bmesh_free_block_data(struct CustomData *data, void *block);
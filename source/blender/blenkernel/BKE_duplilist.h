@@ -41,6 +41,14 @@ struct ListBase *object_duplilist(struct Depsgraph *depsgraph,
                                   struct Object *ob);
 void free_object_duplilist(struct ListBase *lb);
 
+struct DupliObject;
+typedef void (*DupliForeachFunc)(struct DupliObject *dob, void *userdata);
+void object_duplilist_foreach(struct Depsgraph *depsgraph,
+                              struct Scene *sce,
+                              struct Object *ob,
+                              DupliForeachFunc func,
+                              void *userdata);
+
 typedef struct DupliObject {
   struct DupliObject *next, *prev;
   struct Object *ob;
@@ -130,6 +130,12 @@ typedef struct SubdivStats {
   /* Per-value timestamp on when corresponding BKE_subdiv_stats_begin() was
    * called. */
   double begin_timestamp_[NUM_SUBDIV_STATS_VALUES];
+
+  /* Number of updates from a mesh with the same topology as the previous one, which re-used the
+   * topology refiner and evaluator without comparing topology with OpenSubdiv. */
+  int topology_cache_hits;
+  /* Number of updates from a mesh which needed a full topology comparison, or a new subdiv. */
+  int topology_cache_misses;
 } SubdivStats;
 
 /* Functor which evaluates displacement at a given (u, v) of given ptex face. */
@@ -191,6 +197,9 @@ typedef struct Subdiv {
     /* Indexed by base face index, element indicates total number of ptex
      * faces created for preceding base faces. */
     int *face_ptex_offset;
+    /* Topology of the mesh this subdiv was last updated from, see
+     * BKE_subdiv_update_from_mesh(). */
+    struct SubdivTopologyKey *topology_key;
   } cache_;
 } Subdiv;
 
@@ -1748,6 +1748,14 @@ static void mesh_build_data(struct Depsgraph *depsgraph,
    * they aren't cleaned up properly on mode switch, causing crashes, e.g T58150. */
   BLI_assert(ob->id.tag & LIB_TAG_COPIED_ON_WRITE);
 
+  /* Keep the BVH trees of the previous evaluation, they are refitted instead of built again
+   * when the topology didn't change. */
+  BVHCache *bvh_cache_reuse = NULL;
+  if (ob->runtime.data_eval != NULL && ob->runtime.is_data_eval_owned &&
+      GS(ob->runtime.data_eval->name) == ID_ME) {
+    bvh_cache_reuse = bvhcache_reuse_take_from_mesh((Mesh *)ob->runtime.data_eval);
+  }
+
   BKE_object_free_derived_caches(ob);
   if (DEG_is_active(depsgraph)) {
     BKE_sculpt_update_object_before_eval(ob);
@@ -1785,6 +1793,13 @@ static void mesh_build_data(struct Depsgraph *depsgraph,
   const bool is_mesh_eval_owned = (mesh_eval != mesh->runtime.mesh_eval);
   BKE_object_eval_assign_data(ob, &mesh_eval->id, is_mesh_eval_owned);
 
+  if (is_mesh_eval_owned && mesh_eval->runtime.bvh_cache_reuse == NULL) {
+    mesh_eval->runtime.bvh_cache_reuse = bvh_cache_reuse;
+  }
+  else {
+    bvhcache_free(&bvh_cache_reuse);
+  }
+
   ob->runtime.mesh_deform_eval = mesh_deform_eval;
   ob->runtime.last_data_mask = *dataMask;
   ob->runtime.last_need_mapping = need_mapping;
@@ -425,8 +425,11 @@ bool BKE_animsys_read_rna_setting(PathResolvedRNA *anim_rna, float *r_value)
   return true;
 }
 
-/* Write the given value to a setting using RNA, and return success */
-bool BKE_animsys_write_rna_setting(PathResolvedRNA *anim_rna, const float value)
+/* Write the given value to a setting using RNA, and return success.
+ * When r_changed is given it is set to true if the value of the setting got changed. */
+static bool animsys_write_rna_setting_ex(PathResolvedRNA *anim_rna,
+                                         const float value,
+                                         bool *r_changed)
 {
   PropertyRNA *prop = anim_rna->prop;
   PointerRNA *ptr = &anim_rna->ptr;
@@ -487,10 +490,24 @@ bool BKE_animsys_write_rna_setting(PathResolvedRNA *anim_rna, const float value)
       return false;
   }
 
+  /* Compare with the value which was actually written, after clamping and type coercion. */
+  if (r_changed != NULL && !*r_changed) {
+    float new_value;
+    if (!BKE_animsys_read_rna_setting(anim_rna, &new_value) || new_value != old_value) {
+      *r_changed = true;
+    }
+  }
+
   /* successful */
   return true;
 }
 
+/* Write the given value to a setting using RNA, and return success */
+bool BKE_animsys_write_rna_setting(PathResolvedRNA *anim_rna, const float value)
+{
+  return animsys_write_rna_setting_ex(anim_rna, value, NULL);
+}
+
 static bool animsys_construct_orig_pointer_rna(const PointerRNA *ptr, PointerRNA *ptr_orig)
 {
   *ptr_orig = *ptr;
@@ -539,7 +556,8 @@ static void animsys_write_orig_anim_rna(PointerRNA *ptr,
 static void animsys_evaluate_fcurves(PointerRNA *ptr,
                                      ListBase *list,
                                      float ctime,
-                                     bool flush_to_original)
+                                     bool flush_to_original,
+                                     bool *r_changed)
 {
   /* Calculate then execute each curve. */
   LISTBASE_FOREACH (FCurve *, fcu, list) {
@@ -558,7 +576,7 @@ static void animsys_evaluate_fcurves(PointerRNA *ptr,
     PathResolvedRNA anim_rna;
     if (BKE_animsys_store_rna_setting(ptr, fcu->rna_path, fcu->array_index, &anim_rna)) {
       const float curval = calculate_fcurve(&anim_rna, fcu, ctime);
-      BKE_animsys_write_rna_setting(&anim_rna, curval);
+      animsys_write_rna_setting_ex(&anim_rna, curval, r_changed);
       if (flush_to_original) {
         animsys_write_orig_anim_rna(ptr, fcu->rna_path, fcu->array_index, curval);
       }
@@ -681,7 +699,8 @@ void animsys_evaluate_action_group(PointerRNA *ptr, bAction *act, bActionGroup *
 static void animsys_evaluate_action_ex(PointerRNA *ptr,
                                        bAction *act,
                                        float ctime,
-                                       const bool flush_to_original)
+                                       const bool flush_to_original,
+                                       bool *r_changed)
 {
   /* check if mapper is appropriate for use here (we set to NULL if it's inappropriate) */
   if (act == NULL) {
@@ -691,7 +710,7 @@ static void animsys_evaluate_action_ex(PointerRNA *ptr,
   action_idcode_patch_check(ptr->owner_id, act);
 
   /* calculate then execute each curve */
-  animsys_evaluate_fcurves(ptr, &act->curves, ctime, flush_to_original);
+  animsys_evaluate_fcurves(ptr, &act->curves, ctime, flush_to_original, r_changed);
 }
 
 void animsys_evaluate_action(PointerRNA *ptr,
@@ -699,7 +718,7 @@ void animsys_evaluate_action(PointerRNA *ptr,
                              float ctime,
                              const bool flush_to_original)
 {
-  animsys_evaluate_action_ex(ptr, act, ctime, flush_to_original);
+  animsys_evaluate_action_ex(ptr, act, ctime, flush_to_original, NULL);
 }
 
 /* ***************************************** */
@@ -738,7 +757,7 @@ static void nlastrip_evaluate_controls(NlaStrip *strip, float ctime, const bool
     RNA_pointer_create(NULL, &RNA_NlaStrip, strip, &strip_ptr);
 
     /* execute these settings as per normal */
-    animsys_evaluate_fcurves(&strip_ptr, &strip->fcurves, ctime, flush_to_original);
+    animsys_evaluate_fcurves(&strip_ptr, &strip->fcurves, ctime, flush_to_original, NULL);
   }
 
   /* analytically generate values for influence and time (if applicable)
@@ -1946,7 +1965,8 @@ void nlastrip_evaluate(PointerRNA *ptr,
 void nladata_flush_channels(PointerRNA *ptr,
                             NlaEvalData *channels,
                             NlaEvalSnapshot *snapshot,
-                            const bool flush_to_original)
+                            const bool flush_to_original,
+                            bool *r_changed)
 {
   /* sanity checks */
   if (channels == NULL) {
@@ -1965,7 +1985,7 @@ void nladata_flush_channels(PointerRNA *ptr,
         if (nec->is_array) {
           rna.prop_index = i;
         }
-        BKE_animsys_write_rna_setting(&rna, value);
+        animsys_write_rna_setting_ex(&rna, value, r_changed);
         if (flush_to_original) {
           animsys_write_orig_anim_rna(ptr, nec->rna_path, rna.prop_index, value);
         }
@@ -2243,7 +2263,8 @@ static bool animsys_evaluate_nla(NlaEvalData *echannels,
 static void animsys_calculate_nla(PointerRNA *ptr,
                                   AnimData *adt,
                                   float ctime,
-                                  const bool flush_to_original)
+                                  const bool flush_to_original,
+                                  bool *r_changed)
 {
   NlaEvalData echannels;
 
@@ -2255,7 +2276,8 @@ static void animsys_calculate_nla(PointerRNA *ptr,
     animsys_evaluate_nla_domain(ptr, &echannels, adt);
 
     /* flush effects of accumulating channels in NLA to the actual data they affect */
-    nladata_flush_channels(ptr, &echannels, &echannels.eval_snapshot, flush_to_original);
+    nladata_flush_channels(
+        ptr, &echannels, &echannels.eval_snapshot, flush_to_original, r_changed);
   }
   else {
     /* special case - evaluate as if there isn't any NLA data */
@@ -2264,7 +2286,7 @@ static void animsys_calculate_nla(PointerRNA *ptr,
       CLOG_WARN(&LOG, "NLA Eval: Stopgap for active action on NLA Stack - no strips case");
     }
 
-    animsys_evaluate_action(ptr, adt->action, ctime, flush_to_original);
+    animsys_evaluate_action_ex(ptr, adt->action, ctime, flush_to_original, r_changed);
   }
 
   /* free temp data */
@@ -2442,7 +2464,7 @@ void BKE_animsys_free_nla_keyframing_context_cache(struct ListBase *cache)
 /* Overrides System - Public API */
 
 /* Evaluate Overrides */
-static void animsys_evaluate_overrides(PointerRNA *ptr, AnimData *adt)
+static void animsys_evaluate_overrides(PointerRNA *ptr, AnimData *adt, bool *r_changed)
 {
   AnimOverride *aor;
 
@@ -2450,7 +2472,7 @@ static void animsys_evaluate_overrides(PointerRNA *ptr, AnimData *adt)
   for (aor = adt->overrides.first; aor; aor = aor->next) {
     PathResolvedRNA anim_rna;
     if (BKE_animsys_store_rna_setting(ptr, aor->rna_path, aor->array_index, &anim_rna)) {
-      BKE_animsys_write_rna_setting(&anim_rna, aor->value);
+      animsys_write_rna_setting_ex(&anim_rna, aor->value, r_changed);
     }
   }
 }
@@ -2499,8 +2521,12 @@ static void animsys_evaluate_overrides(PointerRNA *ptr, AnimData *adt)
  * and that the flags for which parts of the anim-data settings need to be recalculated
  * have been set already by the depsgraph. Now, we use the recalc
  */
-void BKE_animsys_evaluate_animdata(
-    ID *id, AnimData *adt, float ctime, eAnimData_Recalc recalc, const bool flush_to_original)
+static void animsys_evaluate_animdata_ex(ID *id,
+                                        AnimData *adt,
+                                        float ctime,
+                                        eAnimData_Recalc recalc,
+                                        const bool flush_to_original,
+                                        bool *r_changed)
 {
   PointerRNA id_ptr;
 
@@ -2523,11 +2549,11 @@ void BKE_animsys_evaluate_animdata(
       /* evaluate NLA-stack
        * - active action is evaluated as part of the NLA stack as the last item
        */
-      animsys_calculate_nla(&id_ptr, adt, ctime, flush_to_original);
+      animsys_calculate_nla(&id_ptr, adt, ctime, flush_to_original, r_changed);
     }
     /* evaluate Active Action only */
     else if (adt->action) {
-      animsys_evaluate_action_ex(&id_ptr, adt->action, ctime, flush_to_original);
+      animsys_evaluate_action_ex(&id_ptr, adt->action, ctime, flush_to_original, r_changed);
     }
   }
 
@@ -2546,7 +2572,13 @@ void BKE_animsys_evaluate_animdata(
    * - Overrides are cleared upon frame change and/or keyframing
    * - It is best that we execute this every time, so that no errors are likely to occur.
    */
-  animsys_evaluate_overrides(&id_ptr, adt);
+  animsys_evaluate_overrides(&id_ptr, adt, r_changed);
+}
+
+void BKE_animsys_evaluate_animdata(
+    ID *id, AnimData *adt, float ctime, eAnimData_Recalc recalc, const bool flush_to_original)
+{
+  animsys_evaluate_animdata_ex(id, adt, ctime, recalc, flush_to_original, NULL);
 }
 
 /* Evaluation of all ID-blocks with Animation Data blocks - Animation Data Only
@@ -2706,6 +2738,13 @@ void BKE_animsys_evaluate_all_animation(Main *main, Depsgraph *depsgraph, float
 /* Evaluation API */
 
 void BKE_animsys_eval_animdata(Depsgraph *depsgraph, ID *id)
+{
+  BKE_animsys_eval_animdata_check_changed(depsgraph, id);
+}
+
+/* Same as BKE_animsys_eval_animdata(), but returns true when any of the animated values changed.
+ * Allows dependency graph to not propagate updates from animation which is constant over time. */
+bool BKE_animsys_eval_animdata_check_changed(Depsgraph *depsgraph, ID *id)
 {
   float ctime = DEG_get_ctime(depsgraph);
   AnimData *adt = BKE_animdata_from_id(id);
@@ -2713,7 +2752,9 @@ void BKE_animsys_eval_animdata(Depsgraph *depsgraph, ID *id)
    * which should get handled as part of the dependency graph instead. */
   DEG_debug_print_eval_time(depsgraph, __func__, id->name, id, ctime);
   const bool flush_to_original = DEG_is_active(depsgraph);
-  BKE_animsys_evaluate_animdata(id, adt, ctime, ADT_RECALC_ANIM, flush_to_original);
+  bool changed = false;
+  animsys_evaluate_animdata_ex(id, adt, ctime, ADT_RECALC_ANIM, flush_to_original, &changed);
+  return changed;
 }
 
 void BKE_animsys_update_driver_array(ID *id)
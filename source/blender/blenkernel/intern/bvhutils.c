@@ -31,6 +31,7 @@
 
 #include "BLI_linklist.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
@@ -1306,6 +1307,8 @@ static BLI_bitmap *looptri_no_hidden_map_get(const MPoly *mpoly,
   return looptri_mask;
 }
 
+static bool bvhcache_reuse_refit(Mesh *mesh, const int type, const int tree_type, BVHTree **r_tree);
+
 /**
  * Builds or queries a bvhcache for the cache bvhtree of the request type.
  */
@@ -1321,6 +1324,10 @@ BVHTree *BKE_bvhtree_from_mesh_get(struct BVHTreeFromMesh *data,
   bool is_cached = bvhcache_find(*bvh_cache, bvh_cache_type, &tree);
   BLI_rw_mutex_unlock(&cache_rwlock);
 
+  if (is_cached == false && mesh->runtime.bvh_cache_reuse != NULL) {
+    is_cached = bvhcache_reuse_refit(mesh, bvh_cache_type, tree_type, &tree);
+  }
+
   if (is_cached && tree == NULL) {
     memset(data, 0, sizeof(*data));
     return tree;
@@ -1620,10 +1627,16 @@ void free_bvhtree_from_mesh(struct BVHTreeFromMesh *data)
 /** \name BVHCache
  * \{ */
 
+typedef struct BVHCacheTopology BVHCacheTopology;
+
 typedef struct BVHCacheItem {
   int type;
   BVHTree *tree;
 
+  /** Only set for trees kept for reuse, see #bvhcache_reuse_take_from_mesh. */
+  BVHCacheTopology *topology;
+  /** Cost of the tree when it was built, zero when not computed yet, see #bvhcache_tree_cost. */
+  float build_cost;
 } BVHCacheItem;
 
 /**
@@ -1672,6 +1685,8 @@ void bvhcache_insert(BVHCache **cache_p, BVHTree *tree, int type)
 
   item->type = type;
   item->tree = tree;
+  item->topology = NULL;
+  item->build_cost = 0.0f;
 
   BLI_linklist_prepend(cache_p, item);
 }
@@ -1679,10 +1694,15 @@ void bvhcache_insert(BVHCache **cache_p, BVHTree *tree, int type)
 /**
  * frees a bvhcache
  */
+static void bvhcache_topology_free(BVHCacheTopology *topology);
+
 static void bvhcacheitem_free(void *_item)
 {
   BVHCacheItem *item = (BVHCacheItem *)_item;
 
+  if (item->topology) {
+    bvhcache_topology_free(item->topology);
+  }
   BLI_bvhtree_free(item->tree);
   MEM_freeN(item);
 }
@@ -1694,3 +1714,339 @@ void bvhcache_free(BVHCache **cache_p)
 }
 
 /** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name BVHCache Reuse
+ *
+ * Evaluated meshes are freed and created again on every update of their object, along with their
+ * #BVHCache. When only coordinates changed (e.g. an animated collision, shrinkwrap or surface
+ * deform target), the trees of the previous evaluation are still valid except for their bounds.
+ * Those trees are handed over to the new evaluated mesh with the vertices of their leaves, and
+ * #BKE_bvhtree_from_mesh_get refits them instead of building new ones when the topology matches.
+ * \{ */
+
+struct BVHCacheTopology {
+  int totvert;
+  int leaf_num;
+  int points_per_leaf;
+  /** Element index of every leaf, NULL when all elements of the mesh are in the tree. */
+  int *leaf_index;
+  /** Vertex indices of every leaf, `leaf_num * points_per_leaf` long. */
+  int *leaf_verts;
+};
+
+static void bvhcache_topology_free(BVHCacheTopology *topology)
+{
+  MEM_SAFE_FREE(topology->leaf_index);
+  MEM_SAFE_FREE(topology->leaf_verts);
+  MEM_freeN(topology);
+}
+
+/**
+ * Gather the vertices of the elements of \a mesh, in the order they are inserted into a tree of
+ * the given \a type. Returns NULL for the types which can't be refitted.
+ */
+static BVHCacheTopology *bvhcache_topology_new(Mesh *mesh, const int type)
+{
+  const MLoopTri *looptri = NULL;
+  BLI_bitmap *mask = NULL;
+  int mask_active_len = -1;
+  int elem_num, points_per_leaf;
+
+  switch (type) {
+    case BVHTREE_FROM_VERTS:
+    case BVHTREE_FROM_LOOSEVERTS:
+      elem_num = mesh->totvert;
+      points_per_leaf = 1;
+      if (type == BVHTREE_FROM_LOOSEVERTS) {
+        mask = loose_verts_map_get(
+            mesh->medge, mesh->totedge, mesh->mvert, mesh->totvert, &mask_active_len);
+      }
+      break;
+    case BVHTREE_FROM_EDGES:
+    case BVHTREE_FROM_LOOSEEDGES:
+      elem_num = mesh->totedge;
+      points_per_leaf = 2;
+      if (type == BVHTREE_FROM_LOOSEEDGES) {
+        mask = loose_edges_map_get(mesh->medge, mesh->totedge, &mask_active_len);
+      }
+      break;
+    case BVHTREE_FROM_LOOPTRI:
+    case BVHTREE_FROM_LOOPTRI_NO_HIDDEN:
+      looptri = BKE_mesh_runtime_looptri_ensure(mesh);
+      elem_num = BKE_mesh_runtime_looptri_len(mesh);
+      points_per_leaf = 3;
+      if (type == BVHTREE_FROM_LOOPTRI_NO_HIDDEN) {
+        mask = looptri_no_hidden_map_get(mesh->mpoly, elem_num, &mask_active_len);
+      }
+      break;
+    default:
+      /* Legacy faces have either 3 or 4 vertices per leaf, they are always built again. */
+      return NULL;
+  }
+
+  BVHCacheTopology *topology = MEM_mallocN(sizeof(*topology), __func__);
+  topology->totvert = mesh->totvert;
+  topology->leaf_num = mask ? mask_active_len : elem_num;
+  topology->points_per_leaf = points_per_leaf;
+  topology->leaf_index = mask ? MEM_malloc_arrayN(
+                                    (size_t)topology->leaf_num, sizeof(int), __func__) :
+                                NULL;
+  topology->leaf_verts = MEM_malloc_arrayN(
+      (size_t)topology->leaf_num * (size_t)points_per_leaf, sizeof(int), __func__);
+
+  int *leaf_verts = topology->leaf_verts;
+  int leaf = 0;
+  for (int i = 0; i < elem_num; i++) {
+    if (mask && !BLI_BITMAP_TEST_BOOL(mask, i)) {
+      continue;
+    }
+    if (mask) {
+      topology->leaf_index[leaf] = i;
+    }
+    if (points_per_leaf == 1) {
+      leaf_verts[0] = i;
+    }
+    else if (points_per_leaf == 2) {
+      leaf_verts[0] = (int)mesh->medge[i].v1;
+      leaf_verts[1] = (int)mesh->medge[i].v2;
+    }
+    else {
+      leaf_verts[0] = (int)mesh->mloop[looptri[i].tri[0]].v;
+      leaf_verts[1] = (int)mesh->mloop[looptri[i].tri[1]].v;
+      leaf_verts[2] = (int)mesh->mloop[looptri[i].tri[2]].v;
+    }
+    leaf_verts += points_per_leaf;
+    leaf++;
+  }
+  BLI_assert(leaf == topology->leaf_num);
+
+  MEM_SAFE_FREE(mask);
+  return topology;
+}
+
+static bool bvhcache_topology_equals(const BVHCacheTopology *a, const BVHCacheTopology *b)
+{
+  if (a->totvert != b->totvert || a->leaf_num != b->leaf_num ||
+      a->points_per_leaf != b->points_per_leaf ||
+      (a->leaf_index == NULL) != (b->leaf_index == NULL)) {
+    return false;
+  }
+  if (a->leaf_index &&
+      memcmp(a->leaf_index, b->leaf_index, sizeof(int) * (size_t)a->leaf_num) != 0) {
+    return false;
+  }
+  return memcmp(a->leaf_verts,
+                b->leaf_verts,
+                sizeof(int) * (size_t)a->leaf_num * (size_t)a->points_per_leaf) == 0;
+}
+
+typedef struct BVHCacheRefitData {
+  BVHTree *tree;
+  const BVHCacheTopology *topology;
+  const MVert *mvert;
+} BVHCacheRefitData;
+
+static void bvhcache_refit_leaf_cb(void *__restrict userdata,
+                                   const int leaf,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHCacheRefitData *data = userdata;
+  const int points_per_leaf = data->topology->points_per_leaf;
+  const int *leaf_verts = &data->topology->leaf_verts[leaf * points_per_leaf];
+  float co[3][3];
+
+  for (int i = 0; i < points_per_leaf; i++) {
+    copy_v3_v3(co[i], data->mvert[leaf_verts[i]].co);
+  }
+  /* Leaves are indexed in insertion order, which is the order of the topology. */
+  BLI_bvhtree_update_node(data->tree, leaf, co[0], NULL, points_per_leaf);
+}
+
+static void bvhcache_refit(BVHTree *tree, const BVHCacheTopology *topology, const MVert *mvert)
+{
+  BVHCacheRefitData data = {
+      .tree = tree,
+      .topology = topology,
+      .mvert = mvert,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (topology->leaf_num > 10000);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(0, topology->leaf_num, &data, bvhcache_refit_leaf_cb, &settings);
+
+  BLI_bvhtree_update_tree(tree);
+}
+
+/**
+ * Refitting keeps the hierarchy of the tree, when vertices move a lot relative to each other its
+ * nodes get much larger than the ones of a new tree. Rebuild when the cost grew by this factor.
+ */
+#define BVHCACHE_REFIT_COST_MAX_RATIO 2.0f
+
+typedef struct BVHCacheCostData {
+  float root_area;
+  float nodes_area;
+} BVHCacheCostData;
+
+static float bvhcache_bounds_area(const BVHTreeAxisRange *bounds)
+{
+  const float x = bounds[0].max - bounds[0].min;
+  const float y = bounds[1].max - bounds[1].min;
+  const float z = bounds[2].max - bounds[2].min;
+  return x * y + y * z + z * x;
+}
+
+static bool bvhcache_tree_cost_parent_cb(const BVHTreeAxisRange *bounds, void *userdata)
+{
+  BVHCacheCostData *data = userdata;
+  const float area = bvhcache_bounds_area(bounds);
+  if (data->root_area < 0.0f) {
+    data->root_area = area;
+  }
+  data->nodes_area += area;
+  return true;
+}
+
+static bool bvhcache_tree_cost_leaf_cb(const BVHTreeAxisRange *UNUSED(bounds),
+                                       int UNUSED(index),
+                                       void *UNUSED(userdata))
+{
+  return true;
+}
+
+static bool bvhcache_tree_cost_order_cb(const BVHTreeAxisRange *UNUSED(bounds),
+                                        char UNUSED(axis),
+                                        void *UNUSED(userdata))
+{
+  return true;
+}
+
+/**
+ * Sum of the surface areas of the inner nodes relative to the one of the root, the expected
+ * number of inner nodes a query visits. Mesh trees use 6-DOP bounds, which are the X, Y and Z
+ * ranges of the nodes.
+ */
+static float bvhcache_tree_cost(BVHTree *tree)
+{
+  BVHCacheCostData data = {.root_area = -1.0f, .nodes_area = 0.0f};
+  BLI_bvhtree_walk_dfs(tree,
+                       bvhcache_tree_cost_parent_cb,
+                       bvhcache_tree_cost_leaf_cb,
+                       bvhcache_tree_cost_order_cb,
+                       &data);
+  return (data.root_area > 0.0f) ? data.nodes_area / data.root_area : 0.0f;
+}
+
+/**
+ * Take the trees cached on \a mesh which can be refitted to the next evaluated mesh of the same
+ * object. The other trees are freed, \a mesh is left without cached trees.
+ *
+ * \return A cache to be stored in the `bvh_cache_reuse` runtime data of the next evaluated mesh.
+ */
+BVHCache *bvhcache_reuse_take_from_mesh(Mesh *mesh)
+{
+  BVHCache *cache_reuse = NULL;
+
+  BLI_rw_mutex_lock(&cache_rwlock, THREAD_LOCK_WRITE);
+  for (LinkNode *link = mesh->runtime.bvh_cache; link; link = link->next) {
+    BVHCacheItem *item = link->link;
+    if (item->tree == NULL) {
+      continue;
+    }
+    item->topology = bvhcache_topology_new(mesh, item->type);
+    if (item->topology == NULL) {
+      continue;
+    }
+    if (item->topology->leaf_num != BLI_bvhtree_get_len(item->tree)) {
+      BLI_assert(0);
+      bvhcache_topology_free(item->topology);
+      item->topology = NULL;
+      continue;
+    }
+    if (item->build_cost == 0.0f) {
+      item->build_cost = bvhcache_tree_cost(item->tree);
+    }
+    BLI_linklist_prepend(&cache_reuse, item);
+    link->link = NULL;
+  }
+  /* Only free the items which are not kept. */
+  for (LinkNode *link = mesh->runtime.bvh_cache; link; link = link->next) {
+    if (link->link) {
+      bvhcacheitem_free(link->link);
+    }
+  }
+  BLI_linklist_free(mesh->runtime.bvh_cache, NULL);
+  mesh->runtime.bvh_cache = NULL;
+  BLI_rw_mutex_unlock(&cache_rwlock);
+
+  return cache_reuse;
+}
+
+/**
+ * Look for a tree of \a type in the trees kept from the previous evaluated mesh. When it has the
+ * topology of \a mesh, refit it to the coordinates of \a mesh and move it to the cache of \a mesh.
+ *
+ * The tree is taken out of the reuse list while holding the cache lock, so no other thread uses
+ * it, the refit itself runs without holding the lock.
+ *
+ * \return true when \a r_tree was found in the cache of \a mesh.
+ */
+static bool bvhcache_reuse_refit(Mesh *mesh, const int type, const int tree_type, BVHTree **r_tree)
+{
+  BLI_rw_mutex_lock(&cache_rwlock, THREAD_LOCK_WRITE);
+
+  /* Another thread may have built or refitted the tree in the meantime. */
+  bool is_cached = bvhcache_find(mesh->runtime.bvh_cache, type, r_tree);
+
+  BVHCacheItem *item = NULL;
+  if (!is_cached) {
+    for (LinkNode **link_p = &mesh->runtime.bvh_cache_reuse; *link_p; link_p = &(*link_p)->next) {
+      if (((BVHCacheItem *)(*link_p)->link)->type == type) {
+        item = BLI_linklist_pop(link_p);
+        break;
+      }
+    }
+  }
+
+  BLI_rw_mutex_unlock(&cache_rwlock);
+
+  if (item == NULL) {
+    return is_cached;
+  }
+
+  bool is_refit = false;
+  BVHCacheTopology *topology = bvhcache_topology_new(mesh, type);
+  if (topology && BLI_bvhtree_get_tree_type(item->tree) == tree_type &&
+      bvhcache_topology_equals(topology, item->topology)) {
+    bvhcache_refit(item->tree, item->topology, mesh->mvert);
+    is_refit = (bvhcache_tree_cost(item->tree) <=
+                item->build_cost * BVHCACHE_REFIT_COST_MAX_RATIO);
+  }
+  if (topology) {
+    bvhcache_topology_free(topology);
+  }
+
+  if (is_refit) {
+    BLI_rw_mutex_lock(&cache_rwlock, THREAD_LOCK_WRITE);
+    /* A tree built by another thread meanwhile is used instead. */
+    is_cached = bvhcache_find(mesh->runtime.bvh_cache, type, r_tree);
+    if (!is_cached) {
+      bvhcache_insert(&mesh->runtime.bvh_cache, item->tree, type);
+      /* Compare later refits with the cost of the built tree, not with the one of a refit. */
+      ((BVHCacheItem *)mesh->runtime.bvh_cache->link)->build_cost = item->build_cost;
+      *r_tree = item->tree;
+      item->tree = NULL;
+      is_cached = true;
+    }
+    BLI_rw_mutex_unlock(&cache_rwlock);
+  }
+
+  bvhcacheitem_free(item);
+
+  return is_cached;
+}
+
+/** \} */
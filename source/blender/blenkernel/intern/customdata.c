@@ -169,6 +169,13 @@ typedef struct LayerTypeInfo {
   int (*layers_max)(void);
 } LayerTypeInfo;
 
+/**
+ * Variant of #LayerTypeInfo.interp for \a dest_count elements which are all interpolated from the
+ * same sources, with \a count weights per element, see #CustomData_interp_span.
+ */
+typedef void (*cd_interp_span)(
+    const void **sources, const float *weights, int count, int dest_count, void *dest);
+
 static void layerCopy_mdeformvert(const void *source, void *dest, int count)
 {
   int i, size = sizeof(MDeformVert);
@@ -1260,6 +1267,56 @@ static void layerInterp_shapekey(const void **sources,
   copy_v3_v3((float *)dest, co);
 }
 
+/**
+ * Sum of the sources weighted by each of the \a dest_count rows of \a weights, with the loop over
+ * destination elements innermost so it can be vectorized. The sources are visited in the same order
+ * as the matching #LayerTypeInfo.interp callback, so the results are identical.
+ */
+static void layerInterpSpan_floats(const void **sources,
+                                   const float *weights,
+                                   const int count,
+                                   const int dest_count,
+                                   float *dest,
+                                   const int components,
+                                   const bool reverse)
+{
+  memset(dest, 0, sizeof(float) * (size_t)dest_count * (size_t)components);
+
+  for (int k = 0; k < count; k++) {
+    const int i = reverse ? count - 1 - k : k;
+    const float *src = sources[i];
+    for (int c = 0; c < components; c++) {
+      const float value = src[c];
+      for (int j = 0; j < dest_count; j++) {
+        dest[j * components + c] += value * weights[j * count + i];
+      }
+    }
+  }
+}
+
+static void layerInterpSpan_bweight(
+    const void **sources, const float *weights, int count, int dest_count, void *dest)
+{
+  layerInterpSpan_floats(sources, weights, count, dest_count, dest, 1, false);
+}
+
+static void layerInterpSpan_shapekey(
+    const void **sources, const float *weights, int count, int dest_count, void *dest)
+{
+  layerInterpSpan_floats(sources, weights, count, dest_count, dest, 3, false);
+}
+
+static void layerInterpSpan_normal(
+    const void **sources, const float *weights, int count, int dest_count, void *dest)
+{
+  float(*no)[3] = dest;
+
+  layerInterpSpan_floats(sources, weights, count, dest_count, dest, 3, true);
+  for (int j = 0; j < dest_count; j++) {
+    normalize_v3(no[j]);
+  }
+}
+
 static void layerDefault_mvert_skin(void *data, int count)
 {
   MVertSkin *vs = data;
@@ -1638,6 +1695,24 @@ static const LayerTypeInfo LAYERTYPEINFO[CD_NUMTYPES] = {
     {sizeof(HairMapping), "HairMapping", 1, NULL, NULL, NULL, NULL, NULL, NULL},
 };
 
+/**
+ * Only layers of plain floats have a #cd_interp_span callback,
+ * the other layers call #LayerTypeInfo.interp for every element.
+ */
+static cd_interp_span layerType_getInterpSpan(const LayerTypeInfo *typeInfo)
+{
+  if (typeInfo->interp == layerInterp_bweight) {
+    return layerInterpSpan_bweight;
+  }
+  if (typeInfo->interp == layerInterp_shapekey) {
+    return layerInterpSpan_shapekey;
+  }
+  if (typeInfo->interp == layerInterp_normal) {
+    return layerInterpSpan_normal;
+  }
+  return NULL;
+}
+
 static const char *LAYERTYPENAMES[CD_NUMTYPES] = {
     /*   0-4 */ "CDMVert",
     "CDMSticky",
@@ -2793,6 +2868,105 @@ void CustomData_copy_data(
   }
 }
 
+/* Constant element sizes let the compiler inline the copy of every element. */
+BLI_INLINE void customdata_gather(
+    void *dst, const void *src, const int *src_indices, const int count, const size_t size)
+{
+  for (int i = 0; i < count; i++) {
+    memcpy(POINTER_OFFSET(dst, (size_t)i * size),
+           POINTER_OFFSET(src, (size_t)src_indices[i] * size),
+           size);
+  }
+}
+
+static void CustomData_copy_data_layer_indices(const CustomData *source,
+                                               CustomData *dest,
+                                               int src_i,
+                                               int dst_i,
+                                               const int *src_indices,
+                                               int dst_index,
+                                               int count)
+{
+  const void *src_data = source->layers[src_i].data;
+  void *dst_data = dest->layers[dst_i].data;
+
+  const LayerTypeInfo *typeInfo = layerType_getInfo(source->layers[src_i].type);
+  const size_t size = (size_t)typeInfo->size;
+
+  if (!count || !src_data || !dst_data) {
+    if (count && !(src_data == NULL && dst_data == NULL)) {
+      CLOG_WARN(&LOG,
+                "null data for %s type (%p --> %p), skipping",
+                layerType_getName(source->layers[src_i].type),
+                (void *)src_data,
+                (void *)dst_data);
+    }
+    return;
+  }
+
+  dst_data = POINTER_OFFSET(dst_data, (size_t)dst_index * size);
+
+  if (typeInfo->copy) {
+    for (int i = 0; i < count; i++) {
+      typeInfo->copy(POINTER_OFFSET(src_data, (size_t)src_indices[i] * size),
+                     POINTER_OFFSET(dst_data, (size_t)i * size),
+                     1);
+    }
+    return;
+  }
+
+  switch (size) {
+    case 4:
+      customdata_gather(dst_data, src_data, src_indices, count, 4);
+      break;
+    case 8:
+      customdata_gather(dst_data, src_data, src_indices, count, 8);
+      break;
+    case 12:
+      customdata_gather(dst_data, src_data, src_indices, count, 12);
+      break;
+    case 16:
+      customdata_gather(dst_data, src_data, src_indices, count, 16);
+      break;
+    case 20:
+      customdata_gather(dst_data, src_data, src_indices, count, 20);
+      break;
+    default:
+      customdata_gather(dst_data, src_data, src_indices, count, size);
+      break;
+  }
+}
+
+void CustomData_copy_data_indices(
+    const CustomData *source, CustomData *dest, const int *src_indices, int dest_index, int count)
+{
+  int src_i, dest_i;
+
+  /* copies a layer at a time */
+  dest_i = 0;
+  for (src_i = 0; src_i < source->totlayer; src_i++) {
+
+    /* find the first dest layer with type >= the source type
+     * (this should work because layers are ordered by type)
+     */
+    while (dest_i < dest->totlayer && dest->layers[dest_i].type < source->layers[src_i].type) {
+      dest_i++;
+    }
+
+    /* if there are no more dest layers, we're done */
+    if (dest_i >= dest->totlayer) {
+      return;
+    }
+
+    /* if we found a matching layer, copy the data */
+    if (dest->layers[dest_i].type == source->layers[src_i].type) {
+      CustomData_copy_data_layer_indices(
+          source, dest, src_i, dest_i, src_indices, dest_index, count);
+      dest_i++;
+    }
+  }
+}
+
 void CustomData_copy_layer_type_data(const CustomData *source,
                                      CustomData *destination,
                                      int type,
@@ -2903,6 +3077,73 @@ void CustomData_interp(const CustomData *source,
   }
 }
 
+void CustomData_interp_span(const CustomData *source,
+                            CustomData *dest,
+                            const int *src_indices,
+                            const float *weights,
+                            int count,
+                            int dest_index,
+                            int dest_count)
+{
+  int src_i, dest_i;
+  const void *source_buf[SOURCE_BUF_SIZE];
+  const void **sources = source_buf;
+
+  BLI_assert(weights != NULL);
+
+  /* Slow fallback in case we're interpolating a ridiculous number of elements. */
+  if (count > SOURCE_BUF_SIZE) {
+    sources = MEM_malloc_arrayN(count, sizeof(*sources), __func__);
+  }
+
+  /* interpolates a layer at a time, the sources are only looked up once per layer */
+  dest_i = 0;
+  for (src_i = 0; src_i < source->totlayer; src_i++) {
+    const LayerTypeInfo *typeInfo = layerType_getInfo(source->layers[src_i].type);
+    if (!typeInfo->interp) {
+      continue;
+    }
+
+    while (dest_i < dest->totlayer && dest->layers[dest_i].type < source->layers[src_i].type) {
+      dest_i++;
+    }
+
+    if (dest_i >= dest->totlayer) {
+      break;
+    }
+
+    if (dest->layers[dest_i].type == source->layers[src_i].type) {
+      const void *src_data = source->layers[src_i].data;
+      void *dst_data = POINTER_OFFSET(dest->layers[dest_i].data,
+                                      (size_t)dest_index * typeInfo->size);
+
+      for (int i = 0; i < count; i++) {
+        sources[i] = POINTER_OFFSET(src_data, (size_t)src_indices[i] * typeInfo->size);
+      }
+
+      const cd_interp_span interp_span = layerType_getInterpSpan(typeInfo);
+      if (interp_span) {
+        interp_span(sources, weights, count, dest_count, dst_data);
+      }
+      else {
+        for (int j = 0; j < dest_count; j++) {
+          typeInfo->interp(sources,
+                           &weights[j * count],
+                           NULL,
+                           count,
+                           POINTER_OFFSET(dst_data, (size_t)j * typeInfo->size));
+        }
+      }
+
+      dest_i++;
+    }
+  }
+
+  if (count > SOURCE_BUF_SIZE) {
+    MEM_freeN((void *)sources);
+  }
+}
+
 /**
  * Swap data inside each item, for all layers.
  * This only applies to item types that may store several sub-item data
@@ -3454,9 +3695,14 @@ void CustomData_bmesh_free_block_data(CustomData *data, void *block)
   }
 }
 
-static void CustomData_bmesh_alloc_block(CustomData *data, void **block)
+/**
+ * Allocate a (non-initialized) block from the pool of \a data, freeing \a block when set.
+ *
+ * \note Pools aren't thread-safe, callers filling in many blocks from threads
+ * can allocate them up-front and initialize them afterwards.
+ */
+void CustomData_bmesh_alloc_block(CustomData *data, void **block)
 {
-
   if (*block) {
     CustomData_bmesh_free_block(data, block);
   }
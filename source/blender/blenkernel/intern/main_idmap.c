@@ -117,7 +117,9 @@ struct IDNameLib_Map *BKE_main_idmap_create(struct Main *bmain,
 
   if (idmap_types & MAIN_IDMAP_TYPE_UUID) {
     ID *id;
-    id_map->uuid_map = BLI_ghash_int_new(__func__);
+    /* Only looked up by value, flat storage is safe and faster here. */
+    id_map->uuid_map = BLI_ghash_new_flat(
+        BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
     FOREACH_MAIN_ID_BEGIN (bmain, id) {
       BLI_assert(id->session_uuid != MAIN_ID_SESSION_UUID_UNSET);
       void **id_ptr_v;
@@ -187,7 +189,7 @@ ID *BKE_main_idmap_lookup_name(struct IDNameLib_Map *id_map,
     if (lb_len == 0) {
       return NULL;
     }
-    type_map->map = BLI_ghash_new_ex(idkey_hash, idkey_cmp, __func__, lb_len);
+    type_map->map = BLI_ghash_new_flat_ex(idkey_hash, idkey_cmp, __func__, lb_len);
     type_map->keys = MEM_mallocN(sizeof(struct IDNameLib_Key) * lb_len, __func__);
 
     GHash *map = type_map->map;
@@ -209,13 +209,127 @@ void BKE_mesh_calc_normals_mapping_ex(MVert *mverts,
   fnors = pnors = NULL;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Vertex Normal Accumulation
+ *
+ * Vertex normals are the sum of the weighted face normals stored for each of their corners.
+ * Instead of adding each corner to its vertex, which can't be done from multiple threads without
+ * atomic float additions (and gives results depending on the order of the additions), every
+ * vertex gathers its corners using a vertex to corner map, which is built in parallel.
+ * Corners are summed in order of their index, so the result doesn't depend on threading.
+ * \{ */
+
+typedef struct VertCornerMap {
+  /** Corners of vertex `v` are in `corners`, from `offsets[v]` to `offsets[v + 1]`. */
+  int *offsets;
+  int *corners;
+  /** Next free index in `corners` for every vertex, only used when building. */
+  int *fill;
+
+  /** Corners are the loops, or the three corners of every triangle when `looptri` is set. */
+  const MLoop *mloop;
+  const MLoopTri *looptri;
+} VertCornerMap;
+
+BLI_INLINE uint vert_corner_map_corner_vert(const VertCornerMap *map, const int corner)
+{
+  if (map->looptri) {
+    return map->mloop[map->looptri[corner / 3].tri[corner % 3]].v;
+  }
+  return map->mloop[corner].v;
+}
+
+static void vert_corner_map_count_cb(void *__restrict userdata,
+                                     const int corner,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  VertCornerMap *map = userdata;
+  atomic_add_and_fetch_int32(&map->offsets[vert_corner_map_corner_vert(map, corner)], 1);
+}
+
+static void vert_corner_map_fill_cb(void *__restrict userdata,
+                                    const int corner,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  VertCornerMap *map = userdata;
+  const uint v = vert_corner_map_corner_vert(map, corner);
+  map->corners[atomic_fetch_and_add_int32(&map->fill[v], 1)] = corner;
+}
+
+static void vert_corner_map_create(VertCornerMap *map,
+                                   const int numVerts,
+                                   const int numCorners,
+                                   const MLoop *mloop,
+                                   const MLoopTri *looptri,
+                                   const TaskParallelSettings *settings)
+{
+  map->offsets = MEM_calloc_arrayN((size_t)numVerts + 1, sizeof(*map->offsets), __func__);
+  map->corners = MEM_malloc_arrayN((size_t)numCorners, sizeof(*map->corners), __func__);
+  map->mloop = mloop;
+  map->looptri = looptri;
+
+  BLI_task_parallel_range(0, numCorners, map, vert_corner_map_count_cb, settings);
+
+  /* Turn the number of corners of each vertex into offsets. */
+  int offset = 0;
+  for (int v = 0; v < numVerts; v++) {
+    const int count = map->offsets[v];
+    map->offsets[v] = offset;
+    offset += count;
+  }
+  map->offsets[numVerts] = offset;
+
+  map->fill = MEM_dupallocN(map->offsets);
+  BLI_task_parallel_range(0, numCorners, map, vert_corner_map_fill_cb, settings);
+  MEM_freeN(map->fill);
+  map->fill = NULL;
+}
+
+static void vert_corner_map_free(VertCornerMap *map)
+{
+  MEM_freeN(map->offsets);
+  MEM_freeN(map->corners);
+}
+
+/**
+ * Sum the normals of all corners of vertex \a vidx.
+ * Threads only access the corners of their own vertices.
+ */
+static void vert_corner_map_accumulate(const VertCornerMap *map,
+                                       const float (*corner_nors)[3],
+                                       const int vidx,
+                                       float r_no[3])
+{
+  int *corners = &map->corners[map->offsets[vidx]];
+  const int corners_num = map->offsets[vidx + 1] - map->offsets[vidx];
+
+  /* Corners were added in any order, vertices only have a few corners usually. */
+  for (int i = 1; i < corners_num; i++) {
+    const int corner = corners[i];
+    int j = i;
+    for (; j > 0 && corners[j - 1] > corner; j--) {
+      corners[j] = corners[j - 1];
+    }
+    corners[j] = corner;
+  }
+
+  zero_v3(r_no);
+  for (int i = 0; i < corners_num; i++) {
+    add_v3_v3(r_no, corner_nors[corners[i]]);
+  }
+}
+
+/** \} */
+
 typedef struct MeshCalcNormalsData {
   const MPoly *mpolys;
   const MLoop *mloop;
   MVert *mverts;
   float (*pnors)[3];
   float (*lnors_weighted)[3];
+  /** Optional, vertex normals are only stored as short otherwise. */
   float (*vnors)[3];
+  VertCornerMap *vert_loops;
 } MeshCalcNormalsData;
 
 static void mesh_calc_normals_poly_cb(void *__restrict userdata,
@@ -272,7 +386,7 @@ static void mesh_calc_normals_poly_prepare_cb(void *__restrict userdata,
 
   /* accumulate angle weighted face normal */
   /* inline version of #accumulate_vertex_normals_poly_v3,
-   * split between this threaded callback and #mesh_calc_normals_poly_accum_cb. */
+   * split between this threaded callback and #mesh_calc_normals_poly_finalize_cb. */
   {
     const float *prev_edge = edgevecbuf[nverts - 1];
 
@@ -299,7 +413,10 @@ static void mesh_calc_normals_poly_finalize_cb(void *__restrict userdata,
   MeshCalcNormalsData *data = userdata;
 
   MVert *mv = &data->mverts[vidx];
-  float *no = data->vnors[vidx];
+  float no_buf[3];
+  float *no = data->vnors ? data->vnors[vidx] : no_buf;
+
+  vert_corner_map_accumulate(data->vert_loops, (const float(*)[3])data->lnors_weighted, vidx, no);
 
   if (UNLIKELY(normalize_v3(no) == 0.0f)) {
     /* following Mesh convention; we use vertex coordinate itself for normal in this case */
@@ -340,19 +457,9 @@ void BKE_mesh_calc_normals_poly(MVert *mverts,
     return;
   }
 
-  float(*vnors)[3] = r_vertnors;
   float(*lnors_weighted)[3] = MEM_malloc_arrayN(
       (size_t)numLoops, sizeof(*lnors_weighted), __func__);
-  bool free_vnors = false;
-
-  /* first go through and calculate normals for all the polys */
-  if (vnors == NULL) {
-    vnors = MEM_calloc_arrayN((size_t)numVerts, sizeof(*vnors), __func__);
-    free_vnors = true;
-  }
-  else {
-    memset(vnors, 0, sizeof(*vnors) * (size_t)numVerts);
-  }
+  VertCornerMap vert_loops;
 
   MeshCalcNormalsData data = {
       .mpolys = mpolys,
@@ -360,26 +467,18 @@ void BKE_mesh_calc_normals_poly(MVert *mverts,
       .mverts = mverts,
       .pnors = pnors,
       .lnors_weighted = lnors_weighted,
-      .vnors = vnors,
+      .vnors = r_vertnors,
+      .vert_loops = &vert_loops,
   };
 
   /* Compute poly normals, and prepare weighted loop normals. */
   BLI_task_parallel_range(0, numPolys, &data, mesh_calc_normals_poly_prepare_cb, &settings);
 
-  /* Actually accumulate weighted loop normals into vertex ones. */
-  /* Unfortunately, not possible to thread that
-   * (not in a reasonable, totally lock- and barrier-free fashion),
-   * since several loops will point to the same vertex... */
-  for (int lidx = 0; lidx < numLoops; lidx++) {
-    add_v3_v3(vnors[mloop[lidx].v], data.lnors_weighted[lidx]);
-  }
-
-  /* Normalize and validate computed vertex normals. */
+  /* Accumulate weighted loop normals into vertex ones, normalize and validate them. */
+  vert_corner_map_create(&vert_loops, numVerts, numLoops, mloop, NULL, &settings);
   BLI_task_parallel_range(0, numVerts, &data, mesh_calc_normals_poly_finalize_cb, &settings);
 
-  if (free_vnors) {
-    MEM_freeN(vnors);
-  }
+  vert_corner_map_free(&vert_loops);
   MEM_freeN(lnors_weighted);
 }
 
@@ -448,61 +547,93 @@ void BKE_mesh_calc_normals(Mesh *mesh)
   mesh->runtime.cd_dirty_vert &= ~CD_MASK_NORMAL;
 }
 
-void BKE_mesh_calc_normals_looptri(MVert *mverts,
-                                   int numVerts,
-                                   const MLoop *mloop,
-                                   const MLoopTri *looptri,
-                                   int looptri_num,
-                                   float (*r_tri_nors)[3])
+typedef struct MeshCalcNormalsLooptriData {
+  MVert *mverts;
+  const MLoop *mloop;
+  const MLoopTri *looptri;
+  float (*tri_nors)[3];
+  /** Angle weighted triangle normal, for each of the three corners of every triangle. */
+  float (*corner_nors)[3];
+  VertCornerMap *vert_corners;
+} MeshCalcNormalsLooptriData;
+
+static void mesh_calc_normals_looptri_prepare_cb(void *__restrict userdata,
+                                                 const int i,
+                                                 const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  float(*tnorms)[3] = MEM_calloc_arrayN((size_t)numVerts, sizeof(*tnorms), "tnorms");
-  float(*fnors)[3] = (r_tri_nors) ?
-                         r_tri_nors :
-                         MEM_calloc_arrayN((size_t)looptri_num, sizeof(*fnors), "meshnormals");
-  int i;
+  MeshCalcNormalsLooptriData *data = userdata;
+  const MLoopTri *lt = &data->looptri[i];
+  const MVert *mverts = data->mverts;
+  const MLoop *mloop = data->mloop;
+  float f_no_buf[3];
+  float *f_no = data->tri_nors ? data->tri_nors[i] : f_no_buf;
+  float(*corner_nors)[3] = &data->corner_nors[i * 3];
+  const unsigned int vtri[3] = {
+      mloop[lt->tri[0]].v,
+      mloop[lt->tri[1]].v,
+      mloop[lt->tri[2]].v,
+  };
 
-  if (!tnorms || !fnors) {
-    goto cleanup;
-  }
+  normal_tri_v3(f_no, mverts[vtri[0]].co, mverts[vtri[1]].co, mverts[vtri[2]].co);
+
+  zero_v3(corner_nors[0]);
+  zero_v3(corner_nors[1]);
+  zero_v3(corner_nors[2]);
+  accumulate_vertex_normals_tri_v3(corner_nors[0],
+                                   corner_nors[1],
+                                   corner_nors[2],
+                                   f_no,
+                                   mverts[vtri[0]].co,
+                                   mverts[vtri[1]].co,
+                                   mverts[vtri[2]].co);
+}
 
-  for (i = 0; i < looptri_num; i++) {
-    const MLoopTri *lt = &looptri[i];
-    float *f_no = fnors[i];
-    const unsigned int vtri[3] = {
-        mloop[lt->tri[0]].v,
-        mloop[lt->tri[1]].v,
-        mloop[lt->tri[2]].v,
-    };
+static void mesh_calc_normals_looptri_finalize_cb(void *__restrict userdata,
+                                                  const int vidx,
+                                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MeshCalcNormalsLooptriData *data = userdata;
+  MVert *mv = &data->mverts[vidx];
+  float no[3];
 
-    normal_tri_v3(f_no, mverts[vtri[0]].co, mverts[vtri[1]].co, mverts[vtri[2]].co);
+  vert_corner_map_accumulate(data->vert_corners, (const float(*)[3])data->corner_nors, vidx, no);
 
-    accumulate_vertex_normals_tri_v3(tnorms[vtri[0]],
-                                     tnorms[vtri[1]],
-                                     tnorms[vtri[2]],
-                                     f_no,
-                                     mverts[vtri[0]].co,
-                                     mverts[vtri[1]].co,
-                                     mverts[vtri[2]].co);
+  /* following Mesh convention; we use vertex coordinate itself for normal in this case */
+  if (UNLIKELY(normalize_v3(no) == 0.0f)) {
+    normalize_v3_v3(no, mv->co);
   }
 
-  /* following Mesh convention; we use vertex coordinate itself for normal in this case */
-  for (i = 0; i < numVerts; i++) {
-    MVert *mv = &mverts[i];
-    float *no = tnorms[i];
+  normal_float_to_short_v3(mv->no, no);
+}
 
-    if (UNLIKELY(normalize_v3(no) == 0.0f)) {
-      normalize_v3_v3(no, mv->co);
-    }
+void BKE_mesh_calc_normals_looptri(MVert *mverts,
+                                   int numVerts,
+                                   const MLoop *mloop,
+                                   const MLoopTri *looptri,
+                                   int looptri_num,
+                                   float (*r_tri_nors)[3])
+{
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
 
-    normal_float_to_short_v3(mv->no, no);
-  }
+  VertCornerMap vert_corners;
+  MeshCalcNormalsLooptriData data = {
+      .mverts = mverts,
+      .mloop = mloop,
+      .looptri = looptri,
+      .tri_nors = r_tri_nors,
+      .corner_nors = MEM_malloc_arrayN((size_t)looptri_num * 3, sizeof(float[3]), __func__),
+      .vert_corners = &vert_corners,
+  };
 
-cleanup:
-  MEM_freeN(tnorms);
+  BLI_task_parallel_range(0, looptri_num, &data, mesh_calc_normals_looptri_prepare_cb, &settings);
 
-  if (fnors != r_tri_nors) {
-    MEM_freeN(fnors);
-  }
+  vert_corner_map_create(&vert_corners, numVerts, looptri_num * 3, mloop, looptri, &settings);
+  BLI_task_parallel_range(0, numVerts, &data, mesh_calc_normals_looptri_finalize_cb, &settings);
+
+  vert_corner_map_free(&vert_corners);
+  MEM_freeN(data.corner_nors);
 }
 
 void BKE_lnor_spacearr_init(MLoopNorSpaceArray *lnors_spacearr,
@@ -27,8 +27,11 @@
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
 
+#include "BLI_bitmap.h"
 #include "BLI_edgehash.h"
-#include "BLI_ghash.h"
+#include "BLI_hash.h"
+#include "BLI_math_base.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 #include "BLI_utildefines_stack.h"
 
@@ -37,6 +40,8 @@
 #include "BKE_mesh.h"
 #include "BKE_mesh_mapping.h"
 
+#include "atomic_ops.h"
+
 /**
  * Poly compare with vtargetmap
  * Function used by #BKE_mesh_merge_verts.
@@ -177,35 +182,224 @@ static int cddm_poly_compare(MLoop *mloop_array,
   return same_loops;
 }
 
-/* Utility stuff for using GHash with polys, used by vertex merging. */
+/* -------------------------------------------------------------------- */
+/** \name Poly Filter
+ *
+ * Used by vertex merging to quickly rule out that a poly with all its vertices merged matches an
+ * existing poly. Polys are summarized by the sum and xor of their vertex indices, the summaries
+ * of all polys are stored in a bitmap (a bloom filter), which is filled from multiple threads
+ * with atomic operations. Matches are not certain, they are checked with #cddm_poly_compare.
+ * \{ */
+
+typedef struct PolyFilter {
+  BLI_bitmap *bitmap;
+  uint mask;
+} PolyFilter;
+
+static void poly_filter_hash(const uint hash_sum,
+                             const uint hash_xor,
+                             const int totloop,
+                             uint r_bits[2])
+{
+  const uint hash = BLI_hash_int_2d(hash_sum, hash_xor ^ ((uint)totloop << 24));
+  r_bits[0] = hash;
+  r_bits[1] = BLI_hash_int(hash);
+}
 
-typedef struct PolyKey {
-  int poly_index;        /* index of the MPoly within the derived mesh */
-  int totloops;          /* number of loops in the poly */
-  unsigned int hash_sum; /* Sum of all vertices indices */
-  unsigned int hash_xor; /* Xor of all vertices indices */
-} PolyKey;
+static void poly_filter_init(PolyFilter *filter, const int totpoly)
+{
+  /* Around 8 bits per poly, keeps false positives around 5%. */
+  uint bits_num = 64;
+  while (bits_num < (uint)totpoly * 8 && bits_num < (1u << 31)) {
+    bits_num <<= 1;
+  }
+  filter->bitmap = BLI_BITMAP_NEW(bits_num, __func__);
+  filter->mask = bits_num - 1;
+}
 
-static unsigned int poly_gset_hash_fn(const void *key)
+static void poly_filter_add(PolyFilter *filter, const uint bits[2])
 {
-  const PolyKey *pk = key;
-  return pk->hash_sum;
+  (void)BLI_BITMAP_TEST_AND_SET_ATOMIC(filter->bitmap, bits[0] & filter->mask);
+  (void)BLI_BITMAP_TEST_AND_SET_ATOMIC(filter->bitmap, bits[1] & filter->mask);
 }
 
-static bool poly_gset_compare_fn(const void *k1, const void *k2)
+static bool poly_filter_test(const PolyFilter *filter, const uint bits[2])
 {
-  const PolyKey *pk1 = k1;
-  const PolyKey *pk2 = k2;
-  if ((pk1->hash_sum == pk2->hash_sum) && (pk1->hash_xor == pk2->hash_xor) &&
-      (pk1->totloops == pk2->totloops)) {
-    /* Equality - note that this does not mean equality of polys */
-    return false;
+  return BLI_BITMAP_TEST_BOOL(filter->bitmap, bits[0] & filter->mask) &&
+         BLI_BITMAP_TEST_BOOL(filter->bitmap, bits[1] & filter->mask);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Parallel Callbacks
+ * \{ */
+
+typedef struct MergeVertsData {
+  const Mesh *mesh;
+  const int *vtargetmap;
+  int merge_mode;
+
+  PolyFilter poly_filter;
+  const MeshElemMap *poly_map;
+  /** Polys which are removed because all their vertices are merged. */
+  bool *poly_is_dumped;
+
+  /** New edges and loops, their vertex indices are remapped when copied. */
+  MEdge *medge;
+  MLoop *mloop;
+  const int *newv;
+} MergeVertsData;
+
+static void merge_verts_poly_filter_add_cb(void *__restrict userdata,
+                                           const int i,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MergeVertsData *data = userdata;
+  const MPoly *mp = &data->mesh->mpoly[i];
+  const MLoop *ml = &data->mesh->mloop[mp->loopstart];
+  uint hash_sum = 0, hash_xor = 0;
+  for (int j = 0; j < mp->totloop; j++, ml++) {
+    hash_sum += ml->v;
+    hash_xor ^= ml->v;
   }
-  else {
-    return true;
+  uint bits[2];
+  poly_filter_hash(hash_sum, hash_xor, mp->totloop, bits);
+  poly_filter_add(&data->poly_filter, bits);
+}
+
+static void merge_verts_poly_dump_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MergeVertsData *data = userdata;
+  const Mesh *mesh = data->mesh;
+  const int *vtargetmap = data->vtargetmap;
+  MPoly *mp = &mesh->mpoly[i];
+  const MLoop *ml = &mesh->mloop[mp->loopstart];
+  int j;
+
+  /* check faces with all vertices merged */
+  for (j = 0; j < mp->totloop; j++, ml++) {
+    if (vtargetmap[ml->v] == -1) {
+      return;
+    }
+  }
+
+  if (data->merge_mode == MESH_MERGE_VERTS_DUMP_IF_MAPPED) {
+    /* In this mode, all vertices merged is enough to dump face */
+    data->poly_is_dumped[i] = true;
+    return;
+  }
+
+  BLI_assert(data->merge_mode == MESH_MERGE_VERTS_DUMP_IF_EQUAL);
+  /* Additional condition for face dump:  target vertices must make up an identical face */
+  /* The test has 2 steps:  (1) first step is fast filter lookup, but not failproof       */
+  /*                        (2) second step is thorough but more costly poly compare      */
+  uint hash_sum = 0, hash_xor = 0;
+  ml = &mesh->mloop[mp->loopstart];
+  for (j = 0; j < mp->totloop; j++, ml++) {
+    const uint v_target = (uint)vtargetmap[ml->v]; /* Cannot be -1, they are all mapped */
+    hash_sum += v_target;
+    hash_xor ^= v_target;
+  }
+  uint bits[2];
+  poly_filter_hash(hash_sum, hash_xor, mp->totloop, bits);
+  if (!poly_filter_test(&data->poly_filter, bits)) {
+    return;
+  }
+
+  /* There might be a poly that matches this one, check whether there is an exact match.
+   * Consider the target of the poly's first vert, and see if it belongs to a poly that shares
+   * all vertices with source poly, in same order, or reverse order. */
+  const int v_target = vtargetmap[mesh->mloop[mp->loopstart].v];
+  const MeshElemMap *map = &data->poly_map[v_target];
+  for (int i_poly = 0; i_poly < map->count; i_poly++) {
+    MPoly *target_poly = &mesh->mpoly[map->indices[i_poly]];
+
+    if (cddm_poly_compare(mesh->mloop, mp, target_poly, vtargetmap, +1) ||
+        cddm_poly_compare(mesh->mloop, mp, target_poly, vtargetmap, -1)) {
+      /* Current poly's vertices are mapped to a poly that is strictly identical */
+      /* Current poly is dumped */
+      data->poly_is_dumped[i] = true;
+      return;
+    }
   }
 }
 
+static void merge_verts_copy_edges_cb(void *__restrict userdata,
+                                      const int i,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MergeVertsData *data = userdata;
+  MEdge *med = &data->medge[i];
+
+  /* update edge indices */
+  BLI_assert(data->newv[med->v1] != -1);
+  med->v1 = (uint)data->newv[med->v1];
+  BLI_assert(data->newv[med->v2] != -1);
+  med->v2 = (uint)data->newv[med->v2];
+
+  /* Can happen in case vtargetmap contains some double chains, we do not support that. */
+  BLI_assert(med->v1 != med->v2);
+}
+
+static void merge_verts_copy_loops_cb(void *__restrict userdata,
+                                      const int i,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MergeVertsData *data = userdata;
+  MLoop *ml = &data->mloop[i];
+
+  /* update loop indices */
+  /* Edge remapping has already be done in main loop handling part. */
+  BLI_assert(data->newv[ml->v] != -1);
+  ml->v = (uint)data->newv[ml->v];
+}
+
+/* Custom-data is copied in chunks of elements, one layer at a time. */
+#define MERGE_VERTS_COPY_CHUNK_SIZE 4096
+
+typedef struct MergeVertsCopyData {
+  const CustomData *source;
+  CustomData *dest;
+  const int *src_indices;
+  int len;
+} MergeVertsCopyData;
+
+static void merge_verts_copy_customdata_cb(void *__restrict userdata,
+                                           const int chunk,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MergeVertsCopyData *data = userdata;
+  const int start = chunk * MERGE_VERTS_COPY_CHUNK_SIZE;
+  const int count = min_ii(MERGE_VERTS_COPY_CHUNK_SIZE, data->len - start);
+  CustomData_copy_data_indices(
+      data->source, data->dest, &data->src_indices[start], start, count);
+}
+
+static void merge_verts_copy_customdata(const CustomData *source,
+                                        CustomData *dest,
+                                        const int *src_indices,
+                                        const int len)
+{
+  MergeVertsCopyData data = {
+      .source = source,
+      .dest = dest,
+      .src_indices = src_indices,
+      .len = len,
+  };
+  const int chunks_num = (len + MERGE_VERTS_COPY_CHUNK_SIZE - 1) / MERGE_VERTS_COPY_CHUNK_SIZE;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (len > BKE_MESH_OMP_LIMIT);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, chunks_num, &data, merge_verts_copy_customdata_cb, &settings);
+}
+
+/** \} */
+
 /**
  * Merge Verts
  *
@@ -287,11 +481,18 @@ Mesh *BKE_mesh_merge_verts(Mesh *mesh,
 
   int i, j, c;
 
-  PolyKey *poly_keys;
-  GSet *poly_gset = NULL;
+  MergeVertsData data = {
+      .mesh = mesh,
+      .vtargetmap = vtargetmap,
+      .merge_mode = merge_mode,
+  };
   MeshElemMap *poly_map = NULL;
   int *poly_map_mem = NULL;
 
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
+
   STACK_INIT(oldv, totvert_final);
   STACK_INIT(olde, totedge);
   STACK_INIT(oldl, totloop);
@@ -358,110 +559,37 @@ Mesh *BKE_mesh_merge_verts(Mesh *mesh,
     /* In this mode, we need to determine,  whenever a poly' vertices are all mapped */
     /* if the targets already make up a poly, in which case the new poly is dropped */
     /* This poly equality check is rather complex.
-     * We use a BLI_ghash to speed it up with a first level check */
-    PolyKey *mpgh;
-    poly_keys = MEM_malloc_arrayN(totpoly, sizeof(PolyKey), __func__);
-    poly_gset = BLI_gset_new_ex(poly_gset_hash_fn, poly_gset_compare_fn, __func__, totpoly);
-    /* Duplicates allowed because our compare function is not pure equality */
-    BLI_gset_flag_set(poly_gset, GHASH_FLAG_ALLOW_DUPES);
-
-    mp = mesh->mpoly;
-    mpgh = poly_keys;
-    for (i = 0; i < totpoly; i++, mp++, mpgh++) {
-      mpgh->poly_index = i;
-      mpgh->totloops = mp->totloop;
-      ml = mesh->mloop + mp->loopstart;
-      mpgh->hash_sum = mpgh->hash_xor = 0;
-      for (j = 0; j < mp->totloop; j++, ml++) {
-        mpgh->hash_sum += ml->v;
-        mpgh->hash_xor ^= ml->v;
-      }
-      BLI_gset_insert(poly_gset, mpgh);
-    }
+     * We use a filter of all polys to speed it up with a first level check */
+    poly_filter_init(&data.poly_filter, totpoly);
+    settings.use_threading = (totpoly > BKE_MESH_OMP_LIMIT);
+    BLI_task_parallel_range(0, totpoly, &data, merge_verts_poly_filter_add_cb, &settings);
 
     /* Can we optimise by reusing an old pmap ?  How do we know an old pmap is stale ?  */
     /* When called by MOD_array.c, the cddm has just been created, so it has no valid pmap.   */
     BKE_mesh_vert_poly_map_create(
         &poly_map, &poly_map_mem, mesh->mpoly, mesh->mloop, totvert, totpoly, totloop);
+    data.poly_map = poly_map;
   } /* done preparing for fast poly compare */
 
+  /* Find the polys to dump first, this only reads the mesh so it can be done in parallel,
+   * only building the new polys depends on the order. */
+  data.poly_is_dumped = MEM_calloc_arrayN(totpoly, sizeof(*data.poly_is_dumped), __func__);
+  settings.use_threading = (totpoly > BKE_MESH_OMP_LIMIT);
+  BLI_task_parallel_range(0, totpoly, &data, merge_verts_poly_dump_cb, &settings);
+
   mp = mesh->mpoly;
   mv = mesh->mvert;
   for (i = 0; i < totpoly; i++, mp++) {
     MPoly *mp_new;
 
-    ml = mesh->mloop + mp->loopstart;
-
-    /* check faces with all vertices merged */
-    bool all_vertices_merged = true;
-
-    for (j = 0; j < mp->totloop; j++, ml++) {
-      if (vtargetmap[ml->v] == -1) {
-        all_vertices_merged = false;
-        /* This will be used to check for poly using several time the same vert. */
-        mv[ml->v].flag &= ~ME_VERT_TMP_TAG;
-      }
-      else {
-        /* This will be used to check for poly using several time the same vert. */
-        mv[vtargetmap[ml->v]].flag &= ~ME_VERT_TMP_TAG;
-      }
+    if (UNLIKELY(data.poly_is_dumped[i])) {
+      continue;
     }
 
-    if (UNLIKELY(all_vertices_merged)) {
-      if (merge_mode == MESH_MERGE_VERTS_DUMP_IF_MAPPED) {
-        /* In this mode, all vertices merged is enough to dump face */
-        continue;
-      }
-      else if (merge_mode == MESH_MERGE_VERTS_DUMP_IF_EQUAL) {
-        /* Additional condition for face dump:  target vertices must make up an identical face */
-        /* The test has 2 steps:  (1) first step is fast ghash lookup, but not failproof       */
-        /*                        (2) second step is thorough but more costly poly compare     */
-        int i_poly, v_target;
-        bool found = false;
-        PolyKey pkey;
-
-        /* Use poly_gset for fast (although not 100% certain) identification of same poly */
-        /* First, make up a poly_summary structure */
-        ml = mesh->mloop + mp->loopstart;
-        pkey.hash_sum = pkey.hash_xor = 0;
-        pkey.totloops = 0;
-        for (j = 0; j < mp->totloop; j++, ml++) {
-          v_target = vtargetmap[ml->v]; /* Cannot be -1, they are all mapped */
-          pkey.hash_sum += v_target;
-          pkey.hash_xor ^= v_target;
-          pkey.totloops++;
-        }
-        if (BLI_gset_haskey(poly_gset, &pkey)) {
-
-          /* There might be a poly that matches this one.
-           * We could just leave it there and say there is, and do a "continue".
-           * ... but we are checking whether there is an exact poly match.
-           * It's not so costly in terms of CPU since it's very rare, just a lot of complex code.
-           */
-
-          /* Consider current loop again */
-          ml = mesh->mloop + mp->loopstart;
-          /* Consider the target of the loop's first vert */
-          v_target = vtargetmap[ml->v];
-          /* Now see if v_target belongs to a poly that shares all vertices with source poly,
-           * in same order, or reverse order */
-
-          for (i_poly = 0; i_poly < poly_map[v_target].count; i_poly++) {
-            MPoly *target_poly = mesh->mpoly + *(poly_map[v_target].indices + i_poly);
-
-            if (cddm_poly_compare(mesh->mloop, mp, target_poly, vtargetmap, +1) ||
-                cddm_poly_compare(mesh->mloop, mp, target_poly, vtargetmap, -1)) {
-              found = true;
-              break;
-            }
-          }
-          if (found) {
-            /* Current poly's vertices are mapped to a poly that is strictly identical */
-            /* Current poly is dumped */
-            continue;
-          }
-        }
-      }
+    ml = mesh->mloop + mp->loopstart;
+    for (j = 0; j < mp->totloop; j++, ml++) {
+      /* This will be used to check for poly using several time the same vert. */
+      mv[(vtargetmap[ml->v] != -1) ? vtargetmap[ml->v] : ml->v].flag &= ~ME_VERT_TMP_TAG;
     }
 
     /* Here either the poly's vertices were not all merged
@@ -600,52 +728,33 @@ Mesh *BKE_mesh_merge_verts(Mesh *mesh,
     STACK_PUSH(oldp, i);
   } /* end of the loop that tests polys   */
 
-  if (poly_gset) {
-    // printf("hash quality %.6f\n", BLI_gset_calc_quality(poly_gset));
-
-    BLI_gset_free(poly_gset, NULL);
-    MEM_freeN(poly_keys);
+  MEM_freeN(data.poly_is_dumped);
+  if (data.poly_filter.bitmap) {
+    MEM_freeN(data.poly_filter.bitmap);
   }
 
   /*create new cddm*/
   result = BKE_mesh_new_nomain_from_template(
       mesh, STACK_SIZE(mvert), STACK_SIZE(medge), 0, STACK_SIZE(mloop), STACK_SIZE(mpoly));
 
-  /*update edge indices and copy customdata*/
-  med = medge;
-  for (i = 0; i < result->totedge; i++, med++) {
-    BLI_assert(newv[med->v1] != -1);
-    med->v1 = newv[med->v1];
-    BLI_assert(newv[med->v2] != -1);
-    med->v2 = newv[med->v2];
+  /* Remapping indices is independent for each element. */
+  data.medge = medge;
+  data.mloop = mloop;
+  data.newv = newv;
 
-    /* Can happen in case vtargetmap contains some double chains, we do not support that. */
-    BLI_assert(med->v1 != med->v2);
+  /*update edge indices*/
+  settings.use_threading = (result->totedge > BKE_MESH_OMP_LIMIT);
+  BLI_task_parallel_range(0, result->totedge, &data, merge_verts_copy_edges_cb, &settings);
 
-    CustomData_copy_data(&mesh->edata, &result->edata, olde[i], i, 1);
-  }
+  /*update loop indices*/
+  settings.use_threading = (result->totloop > BKE_MESH_OMP_LIMIT);
+  BLI_task_parallel_range(0, result->totloop, &data, merge_verts_copy_loops_cb, &settings);
 
-  /*update loop indices and copy customdata*/
-  ml = mloop;
-  for (i = 0; i < result->totloop; i++, ml++) {
-    /* Edge remapping has already be done in main loop handling part above. */
-    BLI_assert(newv[ml->v] != -1);
-    ml->v = newv[ml->v];
-
-    CustomData_copy_data(&mesh->ldata, &result->ldata, oldl[i], i, 1);
-  }
-
-  /*copy vertex customdata*/
-  mv = mvert;
-  for (i = 0; i < result->totvert; i++, mv++) {
-    CustomData_copy_data(&mesh->vdata, &result->vdata, oldv[i], i, 1);
-  }
-
-  /*copy poly customdata*/
-  mp = mpoly;
-  for (i = 0; i < result->totpoly; i++, mp++) {
-    CustomData_copy_data(&mesh->pdata, &result->pdata, oldp[i], i, 1);
-  }
+  /*copy customdata*/
+  merge_verts_copy_customdata(&mesh->vdata, &result->vdata, oldv, result->totvert);
+  merge_verts_copy_customdata(&mesh->edata, &result->edata, olde, result->totedge);
+  merge_verts_copy_customdata(&mesh->ldata, &result->ldata, oldl, result->totloop);
+  merge_verts_copy_customdata(&mesh->pdata, &result->pdata, oldp, result->totpoly);
 
   /*copy over data.  CustomData_add_layer can do this, need to look it up.*/
   memcpy(result->mvert, mvert, sizeof(MVert) * STACK_SIZE(mvert));
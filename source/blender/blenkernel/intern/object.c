@@ -3191,6 +3191,32 @@ bool BKE_object_empty_image_data_is_visible_in_view3d(const Object *ob, const Re
   return true;
 }
 
+typedef struct MinMaxDupliData {
+  float *r_min, *r_max;
+  bool use_hidden;
+  bool ok;
+} MinMaxDupliData;
+
+static void object_minmax_dupli_cb(DupliObject *dob, void *userdata)
+{
+  MinMaxDupliData *data = userdata;
+  if ((data->use_hidden == false) && (dob->no_draw != 0)) {
+    return;
+  }
+
+  BoundBox *bb = BKE_object_boundbox_get(dob->ob);
+  if (bb) {
+    int i;
+    for (i = 0; i < 8; i++) {
+      float vec[3];
+      mul_v3_m4v3(vec, dob->mat, bb->vec[i]);
+      minmax_v3v3_v3(data->r_min, data->r_max, vec);
+    }
+
+    data->ok = true;
+  }
+}
+
 bool BKE_object_minmax_dupli(Depsgraph *depsgraph,
                              Scene *scene,
                              Object *ob,
@@ -3198,37 +3224,20 @@ bool BKE_object_minmax_dupli(Depsgraph *depsgraph,
                              float r_max[3],
                              const bool use_hidden)
 {
-  bool ok = false;
   if ((ob->transflag & OB_DUPLI) == 0) {
-    return ok;
+    return false;
   }
-  else {
-    ListBase *lb;
-    DupliObject *dob;
-    lb = object_duplilist(depsgraph, scene, ob);
-    for (dob = lb->first; dob; dob = dob->next) {
-      if ((use_hidden == false) && (dob->no_draw != 0)) {
-        /* pass */
-      }
-      else {
-        BoundBox *bb = BKE_object_boundbox_get(dob->ob);
-
-        if (bb) {
-          int i;
-          for (i = 0; i < 8; i++) {
-            float vec[3];
-            mul_v3_m4v3(vec, dob->mat, bb->vec[i]);
-            minmax_v3v3_v3(r_min, r_max, vec);
-          }
 
-          ok = true;
-        }
-      }
-    }
-    free_object_duplilist(lb); /* does restore */
-  }
+  /* Duplis are only visited, no need to store them all. */
+  MinMaxDupliData data = {
+      .r_min = r_min,
+      .r_max = r_max,
+      .use_hidden = use_hidden,
+      .ok = false,
+  };
+  object_duplilist_foreach(depsgraph, scene, ob, object_minmax_dupli_cb, &data);
 
-  return ok;
+  return data.ok;
 }
 
 void BKE_object_foreach_display_point(Object *ob,
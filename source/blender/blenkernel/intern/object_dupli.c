@@ -32,6 +32,7 @@
 
 #include "BLI_math.h"
 #include "BLI_rand.h"
+#include "BLI_task.h"
 
 #include "DNA_anim_types.h"
 #include "DNA_collection_types.h"
@@ -63,6 +64,121 @@
 
 /* Dupli-Geometry */
 
+/* -------------------------------------------------------------------- */
+/** \name Dupli Storage
+ *
+ * Duplis are allocated in chunks rather than one by one, and linked together for users of the
+ * #ListBase API, so walking the list mostly reads consecutive memory.
+ *
+ * When generated for #object_duplilist_foreach, a chunk is passed to the callback once it is
+ * full and then re-used, so only a few duplis are stored at any time.
+ * \{ */
+
+#define DUPLI_CHUNK_SIZE 256
+
+/* Parallel generation of duplis isn't worth it below this number. */
+#define DUPLI_PARALLEL_MIN 1024
+
+typedef struct DupliChunk {
+  struct DupliChunk *next;
+  int len, len_alloc;
+  DupliObject duplis[];
+} DupliChunk;
+
+typedef struct DupliList {
+  /** Must be first, #object_duplilist returns a pointer to it. */
+  ListBase list;
+  DupliChunk *chunk_first, *chunk_last;
+
+  /** Only for #object_duplilist_foreach. */
+  DupliForeachFunc foreach_func;
+  void *foreach_userdata;
+} DupliList;
+
+static DupliChunk *dupli_chunk_new(DupliList *dl, const int len_alloc)
+{
+  DupliChunk *chunk = MEM_callocN(sizeof(*chunk) + sizeof(DupliObject) * (size_t)len_alloc,
+                                  __func__);
+  chunk->len_alloc = len_alloc;
+  if (dl->chunk_last) {
+    dl->chunk_last->next = chunk;
+  }
+  else {
+    dl->chunk_first = chunk;
+  }
+  dl->chunk_last = chunk;
+  return chunk;
+}
+
+/**
+ * Pass all duplis stored so far to the foreach callback, and empty the storage.
+ * Duplis which were reserved but not used have no object, those are skipped.
+ */
+static void dupli_list_flush(DupliList *dl)
+{
+  DupliChunk *chunk = dl->chunk_last;
+  if (dl->foreach_func == NULL || chunk == NULL) {
+    return;
+  }
+  for (int i = 0; i < chunk->len; i++) {
+    if (chunk->duplis[i].ob != NULL) {
+      dl->foreach_func(&chunk->duplis[i], dl->foreach_userdata);
+    }
+  }
+  memset(chunk->duplis, 0, sizeof(DupliObject) * (size_t)chunk->len);
+  chunk->len = 0;
+}
+
+/**
+ * Get \a len consecutive zero initialized duplis.
+ * They are not linked to the list yet, see #dupli_list_link_range.
+ */
+static DupliObject *dupli_list_alloc_range(DupliList *dl, const int len)
+{
+  DupliChunk *chunk = dl->chunk_last;
+  if (chunk == NULL || chunk->len + len > chunk->len_alloc) {
+    if (dl->foreach_func && chunk) {
+      dupli_list_flush(dl);
+      if (len > chunk->len_alloc) {
+        /* Only one chunk is ever used, replace it with a big enough one. */
+        MEM_freeN(chunk);
+        dl->chunk_first = dl->chunk_last = NULL;
+        chunk = dupli_chunk_new(dl, len);
+      }
+    }
+    else {
+      chunk = dupli_chunk_new(dl, MAX2(len, DUPLI_CHUNK_SIZE));
+    }
+  }
+  DupliObject *dob = &chunk->duplis[chunk->len];
+  chunk->len += len;
+  return dob;
+}
+
+static void dupli_list_link_range(DupliList *dl, DupliObject *dob, const int len)
+{
+  if (dl->foreach_func) {
+    return;
+  }
+  for (int i = 0; i < len; i++) {
+    if (dob[i].ob != NULL) {
+      BLI_addtail(&dl->list, &dob[i]);
+    }
+  }
+}
+
+static void dupli_list_free(DupliList *dl)
+{
+  DupliChunk *chunk_next;
+  for (DupliChunk *chunk = dl->chunk_first; chunk; chunk = chunk_next) {
+    chunk_next = chunk->next;
+    MEM_freeN(chunk);
+  }
+  MEM_freeN(dl);
+}
+
+/** \} */
+
 typedef struct DupliContext {
   Depsgraph *depsgraph;
   /** XXX child objects are selected from this group if set, could be nicer. */
@@ -80,8 +196,8 @@ typedef struct DupliContext {
 
   const struct DupliGenerator *gen;
 
-  /** Result containers. */
-  ListBase *duplilist; /* legacy doubly-linked list */
+  /** Result container. */
+  DupliList *duplilist;
 } DupliContext;
 
 typedef struct DupliGenerator {
@@ -140,23 +256,15 @@ static void copy_dupli_context(
   r_ctx->gen = get_dupli_generator(r_ctx);
 }
 
-/* generate a dupli instance
+/* initialize a dupli instance, without adding it to the result container,
+ * this only reads from the context so it can be done from multiple threads.
  * mat is transform of the object relative to current context (including object obmat)
  */
-static DupliObject *make_dupli(const DupliContext *ctx, Object *ob, float mat[4][4], int index)
+static void dupli_init(
+    const DupliContext *ctx, DupliObject *dob, Object *ob, float mat[4][4], int index)
 {
-  DupliObject *dob;
   int i;
 
-  /* add a DupliObject instance to the result container */
-  if (ctx->duplilist) {
-    dob = MEM_callocN(sizeof(DupliObject), "dupli object");
-    BLI_addtail(ctx->duplilist, dob);
-  }
-  else {
-    return NULL;
-  }
-
   dob->ob = ob;
   mul_m4_m4m4(dob->mat, (float(*)[4])ctx->space_mat, mat);
   dob->type = ctx->gen->type;
@@ -197,10 +305,29 @@ static DupliObject *make_dupli(const DupliContext *ctx, Object *ob, float mat[4]
   if (ctx->object != ob) {
     dob->random_id ^= BLI_hash_int(BLI_hash_string(ctx->object->id.name + 2));
   }
+}
 
+/* generate a dupli instance
+ * mat is transform of the object relative to current context (including object obmat)
+ */
+static DupliObject *make_dupli(const DupliContext *ctx, Object *ob, float mat[4][4], int index)
+{
+  /* add a DupliObject instance to the result container */
+  DupliObject *dob = dupli_list_alloc_range(ctx->duplilist, 1);
+  dupli_init(ctx, dob, ob, mat, index);
+  dupli_list_link_range(ctx->duplilist, dob, 1);
   return dob;
 }
 
+/**
+ * Whether duplis of \a inst_ob can be generated in parallel: they can't have duplis of their own
+ * since recursion adds a variable number of duplis after each one.
+ */
+static bool dupli_use_parallel(const Object *inst_ob, const int len)
+{
+  return (len >= DUPLI_PARALLEL_MIN) && (inst_ob->transflag & OB_DUPLI) == 0;
+}
+
 /* recursive dupli objects
  * space_mat is the local dupli space (excluding dupli object obmat!)
  */
@@ -358,26 +485,35 @@ static void get_duplivert_transform(const float co[3],
   loc_quat_size_to_mat4(mat, co, quat, size);
 }
 
+static void vertex_dupli_transform(const VertexDupliData *vdd,
+                                   const float co[3],
+                                   const short no[3],
+                                   float r_obmat[4][4])
+{
+  Object *inst_ob = vdd->inst_ob;
+
+  /* obmat is transform to vertex */
+  get_duplivert_transform(co, no, vdd->use_rotation, inst_ob->trackflag, inst_ob->upflag, r_obmat);
+  /* make offset relative to inst_ob using relative child transform */
+  mul_mat3_m4_v3((float(*)[4])vdd->child_imat, r_obmat[3]);
+  /* apply obmat _after_ the local vertex transform */
+  mul_m4_m4m4(r_obmat, inst_ob->obmat, r_obmat);
+}
+
 static void vertex_dupli(const VertexDupliData *vdd,
                          int index,
                          const float co[3],
                          const short no[3])
 {
-  Object *inst_ob = vdd->inst_ob;
   DupliObject *dob;
   float obmat[4][4], space_mat[4][4];
 
-  /* obmat is transform to vertex */
-  get_duplivert_transform(co, no, vdd->use_rotation, inst_ob->trackflag, inst_ob->upflag, obmat);
-  /* make offset relative to inst_ob using relative child transform */
-  mul_mat3_m4_v3((float(*)[4])vdd->child_imat, obmat[3]);
-  /* apply obmat _after_ the local vertex transform */
-  mul_m4_m4m4(obmat, inst_ob->obmat, obmat);
+  vertex_dupli_transform(vdd, co, no, obmat);
 
   /* space matrix is constructed by removing obmat transform,
    * this yields the worldspace transform for recursive duplis
    */
-  mul_m4_m4m4(space_mat, obmat, inst_ob->imat);
+  mul_m4_m4m4(space_mat, obmat, vdd->inst_ob->imat);
 
   dob = make_dupli(vdd->ctx, vdd->inst_ob, obmat, index);
 
@@ -389,6 +525,29 @@ static void vertex_dupli(const VertexDupliData *vdd,
   make_recursive_duplis(vdd->ctx, vdd->inst_ob, space_mat, index);
 }
 
+typedef struct VertexDupliParallelData {
+  const VertexDupliData *vdd;
+  const MVert *mvert;
+  DupliObject *duplis;
+} VertexDupliParallelData;
+
+static void vertex_dupli_parallel_cb(void *__restrict userdata,
+                                     const int index,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const VertexDupliParallelData *data = userdata;
+  const VertexDupliData *vdd = data->vdd;
+  DupliObject *dob = &data->duplis[index];
+  float obmat[4][4];
+
+  vertex_dupli_transform(vdd, data->mvert[index].co, data->mvert[index].no, obmat);
+  dupli_init(vdd->ctx, dob, vdd->inst_ob, obmat, index);
+
+  if (vdd->orco) {
+    copy_v3_v3(dob->orco, vdd->orco[index]);
+  }
+}
+
 static void make_child_duplis_verts(const DupliContext *ctx, void *userdata, Object *child)
 {
   VertexDupliData *vdd = userdata;
@@ -400,6 +559,20 @@ static void make_child_duplis_verts(const DupliContext *ctx, void *userdata, Obj
   mul_m4_m4m4(vdd->child_imat, child->imat, ctx->object->obmat);
 
   const MVert *mvert = me_eval->mvert;
+  if (dupli_use_parallel(child, me_eval->totvert)) {
+    VertexDupliParallelData data = {
+        .vdd = vdd,
+        .mvert = mvert,
+        .duplis = dupli_list_alloc_range(ctx->duplilist, me_eval->totvert),
+    };
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = DUPLI_PARALLEL_MIN / 4;
+    BLI_task_parallel_range(0, me_eval->totvert, &data, vertex_dupli_parallel_cb, &settings);
+    dupli_list_link_range(ctx->duplilist, data.duplis, me_eval->totvert);
+    return;
+  }
+
   for (int i = 0; i < me_eval->totvert; i++) {
     vertex_dupli(vdd, i, mvert[i].co, mvert[i].no);
   }
@@ -615,14 +788,84 @@ static void get_dupliface_transform(
   loc_quat_size_to_mat4(mat, loc, quat, size);
 }
 
+static void face_dupli_transform(const DupliContext *ctx,
+                                 const FaceDupliData *fdd,
+                                 Object *inst_ob,
+                                 const float child_imat[4][4],
+                                 const MPoly *mp,
+                                 float r_obmat[4][4])
+{
+  /* obmat is transform to face */
+  get_dupliface_transform((MPoly *)mp,
+                          fdd->mloop + mp->loopstart,
+                          fdd->mvert,
+                          fdd->use_scale,
+                          ctx->object->instance_faces_scale,
+                          r_obmat);
+  /* make offset relative to inst_ob using relative child transform */
+  mul_mat3_m4_v3(child_imat, r_obmat[3]);
+
+  /* XXX ugly hack to ensure same behavior as in master
+   * this should not be needed, parentinv is not consistent
+   * outside of parenting.
+   */
+  {
+    float imat[3][3];
+    copy_m3_m4(imat, inst_ob->parentinv);
+    mul_m4_m3m4(r_obmat, imat, r_obmat);
+  }
+
+  /* apply obmat _after_ the local face transform */
+  mul_m4_m4m4(r_obmat, inst_ob->obmat, r_obmat);
+}
+
+static void face_dupli_texture(const FaceDupliData *fdd, const MPoly *mp, DupliObject *dob)
+{
+  const MLoop *loopstart = fdd->mloop + mp->loopstart;
+  const float w = 1.0f / (float)mp->totloop;
+  if (fdd->orco) {
+    for (int j = 0; j < mp->totloop; j++) {
+      madd_v3_v3fl(dob->orco, fdd->orco[loopstart[j].v], w);
+    }
+  }
+  if (fdd->mloopuv) {
+    for (int j = 0; j < mp->totloop; j++) {
+      madd_v2_v2fl(dob->uv, fdd->mloopuv[mp->loopstart + j].uv, w);
+    }
+  }
+}
+
+typedef struct FaceDupliParallelData {
+  const DupliContext *ctx;
+  const FaceDupliData *fdd;
+  Object *inst_ob;
+  float child_imat[4][4];
+  DupliObject *duplis;
+} FaceDupliParallelData;
+
+static void face_dupli_parallel_cb(void *__restrict userdata,
+                                   const int index,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const FaceDupliParallelData *data = userdata;
+  const MPoly *mp = &data->fdd->mpoly[index];
+  DupliObject *dob = &data->duplis[index];
+  float obmat[4][4];
+
+  if (UNLIKELY(mp->totloop < 3)) {
+    /* Left without object, skipped when linking. */
+    return;
+  }
+
+  face_dupli_transform(data->ctx, data->fdd, data->inst_ob, data->child_imat, mp, obmat);
+  dupli_init(data->ctx, dob, data->inst_ob, obmat, index);
+  face_dupli_texture(data->fdd, mp, dob);
+}
+
 static void make_child_duplis_faces(const DupliContext *ctx, void *userdata, Object *inst_ob)
 {
   FaceDupliData *fdd = userdata;
   MPoly *mpoly = fdd->mpoly, *mp;
-  MLoop *mloop = fdd->mloop;
-  MVert *mvert = fdd->mvert;
-  float(*orco)[3] = fdd->orco;
-  MLoopUV *mloopuv = fdd->mloopuv;
   int a, totface = fdd->totface;
   float child_imat[4][4];
   DupliObject *dob;
@@ -631,32 +874,30 @@ static void make_child_duplis_faces(const DupliContext *ctx, void *userdata, Obj
   /* relative transform from parent to child space */
   mul_m4_m4m4(child_imat, inst_ob->imat, ctx->object->obmat);
 
+  if (dupli_use_parallel(inst_ob, totface)) {
+    FaceDupliParallelData data = {
+        .ctx = ctx,
+        .fdd = fdd,
+        .inst_ob = inst_ob,
+        .duplis = dupli_list_alloc_range(ctx->duplilist, totface),
+    };
+    copy_m4_m4(data.child_imat, child_imat);
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = DUPLI_PARALLEL_MIN / 4;
+    BLI_task_parallel_range(0, totface, &data, face_dupli_parallel_cb, &settings);
+    dupli_list_link_range(ctx->duplilist, data.duplis, totface);
+    return;
+  }
+
   for (a = 0, mp = mpoly; a < totface; a++, mp++) {
-    MLoop *loopstart = mloop + mp->loopstart;
     float space_mat[4][4], obmat[4][4];
 
     if (UNLIKELY(mp->totloop < 3)) {
       continue;
     }
 
-    /* obmat is transform to face */
-    get_dupliface_transform(
-        mp, loopstart, mvert, fdd->use_scale, ctx->object->instance_faces_scale, obmat);
-    /* make offset relative to inst_ob using relative child transform */
-    mul_mat3_m4_v3(child_imat, obmat[3]);
-
-    /* XXX ugly hack to ensure same behavior as in master
-     * this should not be needed, parentinv is not consistent
-     * outside of parenting.
-     */
-    {
-      float imat[3][3];
-      copy_m3_m4(imat, inst_ob->parentinv);
-      mul_m4_m3m4(obmat, imat, obmat);
-    }
-
-    /* apply obmat _after_ the local face transform */
-    mul_m4_m4m4(obmat, inst_ob->obmat, obmat);
+    face_dupli_transform(ctx, fdd, inst_ob, child_imat, mp, obmat);
 
     /* space matrix is constructed by removing obmat transform,
      * this yields the worldspace transform for recursive duplis
@@ -664,18 +905,7 @@ static void make_child_duplis_faces(const DupliContext *ctx, void *userdata, Obj
     mul_m4_m4m4(space_mat, obmat, inst_ob->imat);
 
     dob = make_dupli(ctx, inst_ob, obmat, a);
-
-    const float w = 1.0f / (float)mp->totloop;
-    if (orco) {
-      for (int j = 0; j < mp->totloop; j++) {
-        madd_v3_v3fl(dob->orco, orco[loopstart[j].v], w);
-      }
-    }
-    if (mloopuv) {
-      for (int j = 0; j < mp->totloop; j++) {
-        madd_v2_v2fl(dob->uv, mloopuv[mp->loopstart + j].uv, w);
-      }
-    }
+    face_dupli_texture(fdd, mp, dob);
 
     /* recursion */
     make_recursive_duplis(ctx, inst_ob, space_mat, a);
@@ -1123,7 +1353,7 @@ static const DupliGenerator *get_dupli_generator(const DupliContext *ctx)
 /* Returns a list of DupliObject */
 ListBase *object_duplilist(Depsgraph *depsgraph, Scene *sce, Object *ob)
 {
-  ListBase *duplilist = MEM_callocN(sizeof(ListBase), "duplilist");
+  DupliList *duplilist = MEM_callocN(sizeof(DupliList), "duplilist");
   DupliContext ctx;
   init_context(&ctx, depsgraph, sce, ob, NULL);
   if (ctx.gen) {
@@ -1131,11 +1361,32 @@ ListBase *object_duplilist(Depsgraph *depsgraph, Scene *sce, Object *ob)
     ctx.gen->make_duplis(&ctx);
   }
 
-  return duplilist;
+  return &duplilist->list;
 }
 
 void free_object_duplilist(ListBase *lb)
 {
-  BLI_freelistN(lb);
-  MEM_freeN(lb);
+  dupli_list_free((DupliList *)lb);
+}
+
+/**
+ * Call \a func for every dupli of \a ob, without storing all of them like #object_duplilist.
+ * The dupli is only valid during the call, and isn't linked to other duplis (next/prev are NULL).
+ */
+void object_duplilist_foreach(
+    Depsgraph *depsgraph, Scene *sce, Object *ob, DupliForeachFunc func, void *userdata)
+{
+  DupliList *duplilist = MEM_callocN(sizeof(DupliList), "duplilist");
+  duplilist->foreach_func = func;
+  duplilist->foreach_userdata = userdata;
+
+  DupliContext ctx;
+  init_context(&ctx, depsgraph, sce, ob, NULL);
+  if (ctx.gen) {
+    ctx.duplilist = duplilist;
+    ctx.gen->make_duplis(&ctx);
+    dupli_list_flush(duplilist);
+  }
+
+  dupli_list_free(duplilist);
 }
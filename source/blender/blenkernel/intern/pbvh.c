@@ -51,8 +51,17 @@
 
 #define LEAF_LIMIT 10000
 
+/* Subtrees with more primitives than this many leaves are built in their own task. */
+#define BUILD_TASK_LEAF_NUM 16
+
 //#define PERFCNTRS
 
+// #define DEBUG_BUILD_TIME
+
+#ifdef DEBUG_BUILD_TIME
+#  include "PIL_time_utildefines.h"
+#endif
+
 #define STACK_FIXED_DEPTH 100
 
 typedef struct PBVHStack {
@@ -253,18 +262,36 @@ void pbvh_grow_nodes(PBVH *bvh, int totnode)
   bvh->totnode = totnode;
 }
 
+/* Vertices are unique in the first leaf using them, in the order leaves would be built serially.
+ * Leaves are built in parallel, so they first store the lowest index of the leaves using each
+ * vertex. */
+static void vert_leaf_owner_set(int *vert_owner, const int leaf_index)
+{
+  int owner = *vert_owner;
+  while (leaf_index < owner) {
+    const int owner_prev = atomic_cas_int32(vert_owner, owner, leaf_index);
+    if (owner_prev == owner) {
+      break;
+    }
+    owner = owner_prev;
+  }
+}
+
 /* Add a vertex to the map, with a positive value for unique vertices and
  * a negative value for additional vertices */
-static int map_insert_vert(
-    PBVH *bvh, GHash *map, unsigned int *face_verts, unsigned int *uniq_verts, int vertex)
+static int map_insert_vert(PBVH *bvh,
+                           GHash *map,
+                           unsigned int *face_verts,
+                           unsigned int *uniq_verts,
+                           int vertex,
+                           int leaf_index)
 {
   void *key, **value_p;
 
   key = POINTER_FROM_INT(vertex);
   if (!BLI_ghash_ensure_p(map, key, &value_p)) {
     int value_i;
-    if (BLI_BITMAP_TEST(bvh->vert_bitmap, vertex) == 0) {
-      BLI_BITMAP_ENABLE(bvh->vert_bitmap, vertex);
+    if (bvh->vert_leaf_owner[vertex] == leaf_index) {
       value_i = *uniq_verts;
       (*uniq_verts)++;
     }
@@ -281,7 +308,7 @@ static int map_insert_vert(
 }
 
 /* Find vertices used by the faces in this node and update the draw buffers */
-static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node)
+static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node, int leaf_index)
 {
   bool has_visible = false;
 
@@ -298,8 +325,12 @@ static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node)
   for (int i = 0; i < totface; i++) {
     const MLoopTri *lt = &bvh->looptri[node->prim_indices[i]];
     for (int j = 0; j < 3; j++) {
-      face_vert_indices[i][j] = map_insert_vert(
-          bvh, map, &node->face_verts, &node->uniq_verts, bvh->mloop[lt->tri[j]].v);
+      face_vert_indices[i][j] = map_insert_vert(bvh,
+                                                map,
+                                                &node->face_verts,
+                                                &node->uniq_verts,
+                                                bvh->mloop[lt->tri[j]].v,
+                                                leaf_index);
     }
 
     if (!paint_is_face_hidden(lt, bvh->verts, bvh->mloop)) {
@@ -410,21 +441,16 @@ static void build_grid_leaf_node(PBVH *bvh, PBVHNode *node)
   BKE_pbvh_node_mark_rebuild_draw(node);
 }
 
-static void build_leaf(PBVH *bvh, int node_index, BBC *prim_bbc, int offset, int count)
+static void build_leaf(PBVH *bvh, PBVHNode *node, BBC *prim_bbc, int leaf_index)
 {
-  bvh->nodes[node_index].flag |= PBVH_Leaf;
-
-  bvh->nodes[node_index].prim_indices = bvh->prim_indices + offset;
-  bvh->nodes[node_index].totprim = count;
-
   /* Still need vb for searches */
-  update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count);
+  update_vb(bvh, node, prim_bbc, (int)(node->prim_indices - bvh->prim_indices), node->totprim);
 
   if (bvh->looptri) {
-    build_mesh_leaf_node(bvh, bvh->nodes + node_index);
+    build_mesh_leaf_node(bvh, node, leaf_index);
   }
   else {
-    build_grid_leaf_node(bvh, bvh->nodes + node_index);
+    build_grid_leaf_node(bvh, node);
   }
 }
 
@@ -462,19 +488,51 @@ static bool leaf_needs_material_split(PBVH *bvh, int offset, int count)
   return false;
 }
 
-/* Recursively build a node in the tree
+/* -------------------------------------------------------------------- */
+/** \name Build
  *
- * vb is the voxel box around all of the primitives contained in
- * this node.
+ * The tree is built in three steps:
+ * - Primitives are partitioned recursively, large subtrees in parallel tasks.
+ *   Every task works on its own range of primitive indices, so the partitioning is the same as
+ *   when building on a single thread.
+ * - The partitioning is turned into PBVH nodes on a single thread, in depth-first order.
+ * - Leaves are built in parallel, then bounds of the other nodes are updated bottom-up.
+ * \{ */
+
+typedef struct PBVHBuildNode {
+  /* Both NULL for leaves. */
+  struct PBVHBuildNode *children[2];
+  /* Range of primitive indices. */
+  int offset, count;
+} PBVHBuildNode;
+
+typedef struct PBVHBuildData {
+  PBVH *bvh;
+  BBC *prim_bbc;
+  TaskPool *task_pool;
+  int leaves_num;
+  /* Node index of every leaf, in depth-first order. */
+  int *leaves;
+} PBVHBuildData;
+
+static void build_sub(PBVHBuildData *data, PBVHBuildNode *build_node, BB *cb);
+
+static void build_sub_task(TaskPool *__restrict pool, void *taskdata)
+{
+  build_sub(BLI_task_pool_user_data(pool), taskdata, NULL);
+}
+
+/* Recursively partition the primitives of a node in the tree
  *
  * cb is the bounding box around all the centroids of the primitives
  * contained in this node
- *
- * offset and start indicate a range in the array of primitive indices
  */
-
-static void build_sub(PBVH *bvh, int node_index, BB *cb, BBC *prim_bbc, int offset, int count)
+static void build_sub(PBVHBuildData *data, PBVHBuildNode *build_node, BB *cb)
 {
+  PBVH *bvh = data->bvh;
+  BBC *prim_bbc = data->prim_bbc;
+  const int offset = build_node->offset;
+  const int count = build_node->count;
   int end;
   BB cb_backing;
 
@@ -482,18 +540,11 @@ static void build_sub(PBVH *bvh, int node_index, BB *cb, BBC *prim_bbc, int offs
   const bool below_leaf_limit = count <= bvh->leaf_limit;
   if (below_leaf_limit) {
     if (!leaf_needs_material_split(bvh, offset, count)) {
-      build_leaf(bvh, node_index, prim_bbc, offset, count);
+      atomic_add_and_fetch_int32(&data->leaves_num, 1);
       return;
     }
   }
 
-  /* Add two child nodes */
-  bvh->nodes[node_index].children_offset = bvh->totnode;
-  pbvh_grow_nodes(bvh, bvh->totnode + 2);
-
-  /* Update parent node bounding box */
-  update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count);
-
   if (!below_leaf_limit) {
     /* Find axis with widest range of primitive centroids */
     if (!cb) {
@@ -518,10 +569,75 @@ static void build_sub(PBVH *bvh, int node_index, BB *cb, BBC *prim_bbc, int offs
     end = partition_indices_material(bvh, offset, offset + count - 1);
   }
 
+  /* Add two child nodes */
+  PBVHBuildNode *child_a = MEM_callocN(sizeof(*child_a), __func__);
+  PBVHBuildNode *child_b = MEM_callocN(sizeof(*child_b), __func__);
+  child_a->offset = offset;
+  child_a->count = end - offset;
+  child_b->offset = end;
+  child_b->count = offset + count - end;
+  build_node->children[0] = child_a;
+  build_node->children[1] = child_b;
+
   /* Build children */
-  build_sub(bvh, bvh->nodes[node_index].children_offset, NULL, prim_bbc, offset, end - offset);
-  build_sub(
-      bvh, bvh->nodes[node_index].children_offset + 1, NULL, prim_bbc, end, offset + count - end);
+  if (child_a->count > bvh->leaf_limit * BUILD_TASK_LEAF_NUM) {
+    BLI_task_pool_push(data->task_pool, build_sub_task, child_a, false, NULL);
+  }
+  else {
+    build_sub(data, child_a, NULL);
+  }
+  build_sub(data, child_b, NULL);
+}
+
+/* Create the nodes for the partitioned primitives, in the same order as they were created before
+ * partitioning was done in parallel. */
+static void build_nodes(PBVHBuildData *data, PBVHBuildNode *build_node, int node_index)
+{
+  PBVH *bvh = data->bvh;
+
+  if (build_node->children[0] == NULL) {
+    PBVHNode *node = &bvh->nodes[node_index];
+    node->flag |= PBVH_Leaf;
+    node->prim_indices = bvh->prim_indices + build_node->offset;
+    node->totprim = build_node->count;
+    data->leaves[data->leaves_num++] = node_index;
+    return;
+  }
+
+  /* Add two child nodes */
+  const int children_offset = bvh->totnode;
+  bvh->nodes[node_index].children_offset = children_offset;
+  pbvh_grow_nodes(bvh, bvh->totnode + 2);
+
+  for (int i = 0; i < 2; i++) {
+    build_nodes(data, build_node->children[i], children_offset + i);
+    MEM_freeN(build_node->children[i]);
+  }
+}
+
+static void build_leaf_vert_owner_cb(void *__restrict userdata,
+                                     const int leaf_index,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PBVHBuildData *data = userdata;
+  PBVH *bvh = data->bvh;
+  const PBVHNode *node = &bvh->nodes[data->leaves[leaf_index]];
+
+  for (int i = 0; i < node->totprim; i++) {
+    const MLoopTri *lt = &bvh->looptri[node->prim_indices[i]];
+    for (int j = 0; j < 3; j++) {
+      vert_leaf_owner_set(&bvh->vert_leaf_owner[bvh->mloop[lt->tri[j]].v], leaf_index);
+    }
+  }
+}
+
+static void build_leaf_cb(void *__restrict userdata,
+                          const int leaf_index,
+                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PBVHBuildData *data = userdata;
+  PBVH *bvh = data->bvh;
+  build_leaf(bvh, &bvh->nodes[data->leaves[leaf_index]], data->prim_bbc, leaf_index);
 }
 
 static void pbvh_build(PBVH *bvh, BB *cb, BBC *prim_bbc, int totprim)
@@ -545,10 +661,128 @@ static void pbvh_build(PBVH *bvh, BB *cb, BBC *prim_bbc, int totprim)
     }
   }
 
+  PBVHBuildData data = {
+      .bvh = bvh,
+      .prim_bbc = prim_bbc,
+  };
+  PBVHBuildNode build_root = {
+      .offset = 0,
+      .count = totprim,
+  };
+
+  data.task_pool = BLI_task_pool_create(&data, TASK_PRIORITY_HIGH);
+  build_sub(&data, &build_root, cb);
+  BLI_task_pool_work_and_wait(data.task_pool);
+  BLI_task_pool_free(data.task_pool);
+
+  data.leaves = MEM_malloc_arrayN(data.leaves_num, sizeof(*data.leaves), __func__);
+  data.leaves_num = 0;
   bvh->totnode = 1;
-  build_sub(bvh, 0, cb, prim_bbc, 0, totprim);
+  build_nodes(&data, &build_root, 0);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+
+  if (bvh->looptri) {
+    copy_vn_i(bvh->vert_leaf_owner, bvh->totvert, INT_MAX);
+    BLI_task_parallel_range(0, data.leaves_num, &data, build_leaf_vert_owner_cb, &settings);
+  }
+  BLI_task_parallel_range(0, data.leaves_num, &data, build_leaf_cb, &settings);
+
+  /* Children always come after their parent. */
+  for (int i = bvh->totnode - 1; i >= 0; i--) {
+    PBVHNode *node = &bvh->nodes[i];
+    if (!(node->flag & PBVH_Leaf)) {
+      node->vb = bvh->nodes[node->children_offset].vb;
+      BB_expand_with_bb(&node->vb, &bvh->nodes[node->children_offset + 1].vb);
+      node->orig_vb = node->vb;
+    }
+  }
+
+  MEM_freeN(data.leaves);
+}
+
+typedef struct PBVHBuildBBCData {
+  PBVH *bvh;
+  BBC *prim_bbc;
+} PBVHBuildBBCData;
+
+static void pbvh_build_mesh_bbc_cb(void *__restrict userdata,
+                                   const int i,
+                                   const TaskParallelTLS *__restrict tls)
+{
+  PBVHBuildBBCData *data = userdata;
+  PBVH *bvh = data->bvh;
+  const MLoopTri *lt = &bvh->looptri[i];
+  const int sides = 3;
+  BBC *bbc = &data->prim_bbc[i];
+
+  BB_reset((BB *)bbc);
+
+  for (int j = 0; j < sides; j++) {
+    BB_expand((BB *)bbc, bvh->verts[bvh->mloop[lt->tri[j]].v].co);
+  }
+
+  BBC_update_centroid(bbc);
+
+  BB_expand(tls->userdata_chunk, bbc->bcentroid);
+}
+
+static void pbvh_build_grids_bbc_cb(void *__restrict userdata,
+                                    const int i,
+                                    const TaskParallelTLS *__restrict tls)
+{
+  PBVHBuildBBCData *data = userdata;
+  PBVH *bvh = data->bvh;
+  const CCGKey *key = &bvh->gridkey;
+  CCGElem *grid = bvh->grids[i];
+  BBC *bbc = &data->prim_bbc[i];
+
+  BB_reset((BB *)bbc);
+
+  for (int j = 0; j < key->grid_area; j++) {
+    BB_expand((BB *)bbc, CCG_elem_offset_co(key, grid, j));
+  }
+
+  BBC_update_centroid(bbc);
+
+  BB_expand(tls->userdata_chunk, bbc->bcentroid);
+}
+
+static void pbvh_build_bbc_reduce(const void *__restrict UNUSED(userdata),
+                                  void *__restrict chunk_join,
+                                  void *__restrict chunk)
+{
+  BB_expand_with_bb(chunk_join, chunk);
 }
 
+/* For each primitive, store the AABB and the AABB centroid, and find the bounds of all
+ * centroids. */
+static void pbvh_build_bbc(PBVH *bvh,
+                           BBC *prim_bbc,
+                           int totprim,
+                           TaskParallelRangeFunc func,
+                           BB *r_cb)
+{
+  PBVHBuildBBCData data = {
+      .bvh = bvh,
+      .prim_bbc = prim_bbc,
+  };
+
+  BB_reset(r_cb);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
+  settings.userdata_chunk = r_cb;
+  settings.userdata_chunk_size = sizeof(*r_cb);
+  settings.func_reduce = pbvh_build_bbc_reduce;
+  BLI_task_parallel_range(0, totprim, &data, func, &settings);
+}
+
+/** \} */
+
 /**
  * Do a full rebuild with on Mesh data structure.
  *
@@ -570,13 +804,17 @@ void BKE_pbvh_build_mesh(PBVH *bvh,
   BBC *prim_bbc = NULL;
   BB cb;
 
+#ifdef DEBUG_BUILD_TIME
+  TIMEIT_START(BKE_pbvh_build_mesh);
+#endif
+
   bvh->mesh = mesh;
   bvh->type = PBVH_FACES;
   bvh->mpoly = mpoly;
   bvh->mloop = mloop;
   bvh->looptri = looptri;
   bvh->verts = verts;
-  bvh->vert_bitmap = BLI_BITMAP_NEW(totvert, "bvh->vert_bitmap");
+  bvh->vert_leaf_owner = MEM_malloc_arrayN(totvert, sizeof(int), "bvh->vert_leaf_owner");
   bvh->totvert = totvert;
   bvh->leaf_limit = LEAF_LIMIT;
   bvh->vdata = vdata;
@@ -586,33 +824,21 @@ void BKE_pbvh_build_mesh(PBVH *bvh,
   bvh->face_sets_color_seed = mesh->face_sets_color_seed;
   bvh->face_sets_color_default = mesh->face_sets_color_default;
 
-  BB_reset(&cb);
-
   /* For each face, store the AABB and the AABB centroid */
   prim_bbc = MEM_mallocN(sizeof(BBC) * looptri_num, "prim_bbc");
-
-  for (int i = 0; i < looptri_num; i++) {
-    const MLoopTri *lt = &looptri[i];
-    const int sides = 3;
-    BBC *bbc = prim_bbc + i;
-
-    BB_reset((BB *)bbc);
-
-    for (int j = 0; j < sides; j++) {
-      BB_expand((BB *)bbc, verts[bvh->mloop[lt->tri[j]].v].co);
-    }
-
-    BBC_update_centroid(bbc);
-
-    BB_expand(&cb, bbc->bcentroid);
-  }
+  pbvh_build_bbc(bvh, prim_bbc, looptri_num, pbvh_build_mesh_bbc_cb, &cb);
 
   if (looptri_num) {
     pbvh_build(bvh, &cb, prim_bbc, looptri_num);
   }
 
   MEM_freeN(prim_bbc);
-  MEM_freeN(bvh->vert_bitmap);
+  MEM_freeN(bvh->vert_leaf_owner);
+  bvh->vert_leaf_owner = NULL;
+
+#ifdef DEBUG_BUILD_TIME
+  TIMEIT_END(BKE_pbvh_build_mesh);
+#endif
 }
 
 /* Do a full rebuild with on Grids data structure */
@@ -626,6 +852,10 @@ void BKE_pbvh_build_grids(PBVH *bvh,
 {
   const int gridsize = key->grid_size;
 
+#ifdef DEBUG_BUILD_TIME
+  TIMEIT_START(BKE_pbvh_build_grids);
+#endif
+
   bvh->type = PBVH_GRIDS;
   bvh->grids = grids;
   bvh->gridfaces = gridfaces;
@@ -636,31 +866,20 @@ void BKE_pbvh_build_grids(PBVH *bvh,
   bvh->leaf_limit = max_ii(LEAF_LIMIT / ((gridsize - 1) * (gridsize - 1)), 1);
 
   BB cb;
-  BB_reset(&cb);
 
   /* For each grid, store the AABB and the AABB centroid */
   BBC *prim_bbc = MEM_mallocN(sizeof(BBC) * totgrid, "prim_bbc");
-
-  for (int i = 0; i < totgrid; i++) {
-    CCGElem *grid = grids[i];
-    BBC *bbc = prim_bbc + i;
-
-    BB_reset((BB *)bbc);
-
-    for (int j = 0; j < gridsize * gridsize; j++) {
-      BB_expand((BB *)bbc, CCG_elem_offset_co(key, grid, j));
-    }
-
-    BBC_update_centroid(bbc);
-
-    BB_expand(&cb, bbc->bcentroid);
-  }
+  pbvh_build_bbc(bvh, prim_bbc, totgrid, pbvh_build_grids_bbc_cb, &cb);
 
   if (totgrid) {
     pbvh_build(bvh, &cb, prim_bbc, totgrid);
   }
 
   MEM_freeN(prim_bbc);
+
+#ifdef DEBUG_BUILD_TIME
+  TIMEIT_END(BKE_pbvh_build_grids);
+#endif
 }
 
 PBVH *BKE_pbvh_new(void)
@@ -150,7 +150,8 @@ struct PBVH {
 
   /* Only used during BVH build and update,
    * don't need to remain valid after */
-  BLI_bitmap *vert_bitmap;
+  /* For every vertex, the first leaf using it (in build order), where it's a unique vertex. */
+  int *vert_leaf_owner;
 
 #ifdef PERFCNTRS
   int perf_modified;
@@ -23,12 +23,17 @@
 
 #include "BKE_subdiv.h"
 
+#include <string.h>
+
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
 #include "DNA_modifier_types.h"
 
+#include "BLI_hash_mm2a.h"
 #include "BLI_utildefines.h"
 
+#include "BKE_customdata.h"
+
 #include "MEM_guardedalloc.h"
 
 #include "subdiv_converter.h"
@@ -137,6 +142,82 @@ Subdiv *BKE_subdiv_new_from_mesh(const SubdivSettings *settings, const Mesh *mes
   return subdiv;
 }
 
+/* Topology key.
+ *
+ * Counts and hashes of all the mesh data which the mesh converter reads to define topology. When
+ * they are equal to the ones of a new mesh, the topology refiner and evaluator can be used for it
+ * without creating a converter and comparing it with the refiner. This is the common case of a
+ * deforming mesh, where only coordinates change from frame to frame.
+ *
+ * The data is hashed twice with different seeds, so a different topology with the same counts is
+ * very unlikely to be taken for the cached one. */
+
+#define SUBDIV_TOPOLOGY_KEY_NUM_HASHES 2
+
+typedef struct SubdivTopologyKey {
+  int totvert, totedge, totloop, totpoly;
+  int num_uv_layers;
+  uint hash[SUBDIV_TOPOLOGY_KEY_NUM_HASHES];
+} SubdivTopologyKey;
+
+typedef struct SubdivTopologyHash {
+  BLI_HashMurmur2A mm2[SUBDIV_TOPOLOGY_KEY_NUM_HASHES];
+} SubdivTopologyHash;
+
+static void subdiv_topology_hash_add(SubdivTopologyHash *hash, const void *data, size_t len)
+{
+  for (int i = 0; i < SUBDIV_TOPOLOGY_KEY_NUM_HASHES; i++) {
+    BLI_hash_mm2a_add(&hash->mm2[i], data, len);
+  }
+}
+
+static void subdiv_topology_key_calc(const Mesh *mesh, SubdivTopologyKey *r_key)
+{
+  r_key->totvert = mesh->totvert;
+  r_key->totedge = mesh->totedge;
+  r_key->totloop = mesh->totloop;
+  r_key->totpoly = mesh->totpoly;
+  r_key->num_uv_layers = CustomData_number_of_layers(&mesh->ldata, CD_MLOOPUV);
+
+  SubdivTopologyHash hash;
+  for (int i = 0; i < SUBDIV_TOPOLOGY_KEY_NUM_HASHES; i++) {
+    BLI_hash_mm2a_init(&hash.mm2[i], (uint32_t)i * 0x9e3779b9u);
+  }
+  subdiv_topology_hash_add(&hash, mesh->mloop, sizeof(MLoop) * (size_t)mesh->totloop);
+  for (int i = 0; i < mesh->totpoly; i++) {
+    const MPoly *poly = &mesh->mpoly[i];
+    const int poly_key[2] = {poly->loopstart, poly->totloop};
+    subdiv_topology_hash_add(&hash, poly_key, sizeof(poly_key));
+  }
+  for (int i = 0; i < mesh->totedge; i++) {
+    const MEdge *edge = &mesh->medge[i];
+    const uint edge_key[3] = {edge->v1, edge->v2, (uint)edge->crease};
+    subdiv_topology_hash_add(&hash, edge_key, sizeof(edge_key));
+  }
+  /* UV topology depends on UV coordinates. */
+  for (int layer_index = 0; layer_index < r_key->num_uv_layers; layer_index++) {
+    const MLoopUV *mloopuv = CustomData_get_layer_n(&mesh->ldata, CD_MLOOPUV, layer_index);
+    for (int i = 0; i < mesh->totloop; i++) {
+      subdiv_topology_hash_add(&hash, mloopuv[i].uv, sizeof(mloopuv[i].uv));
+    }
+  }
+  for (int i = 0; i < SUBDIV_TOPOLOGY_KEY_NUM_HASHES; i++) {
+    r_key->hash[i] = BLI_hash_mm2a_end(&hash.mm2[i]);
+  }
+}
+
+static bool subdiv_topology_key_matches(const SubdivTopologyKey *key, const Mesh *mesh)
+{
+  if (key->totvert != mesh->totvert || key->totedge != mesh->totedge ||
+      key->totloop != mesh->totloop || key->totpoly != mesh->totpoly ||
+      key->num_uv_layers != CustomData_number_of_layers(&mesh->ldata, CD_MLOOPUV)) {
+    return false;
+  }
+  SubdivTopologyKey mesh_key;
+  subdiv_topology_key_calc(mesh, &mesh_key);
+  return memcmp(key->hash, mesh_key.hash, sizeof(key->hash)) == 0;
+}
+
 /* Creation with cached-aware semantic. */
 
 Subdiv *BKE_subdiv_update_from_converter(Subdiv *subdiv,
@@ -173,10 +254,39 @@ Subdiv *BKE_subdiv_update_from_mesh(Subdiv *subdiv,
                                     const SubdivSettings *settings,
                                     const Mesh *mesh)
 {
+  /* Fast path: same topology as the mesh the subdiv was last used for. */
+  if (subdiv != NULL && subdiv->topology_refiner != NULL && subdiv->cache_.topology_key != NULL &&
+      BKE_subdiv_settings_equal(&subdiv->settings, settings)) {
+    BKE_subdiv_stats_begin(&subdiv->stats, SUBDIV_STATS_TOPOLOGY_COMPARE);
+    const bool is_same_topology = subdiv_topology_key_matches(subdiv->cache_.topology_key, mesh);
+    BKE_subdiv_stats_end(&subdiv->stats, SUBDIV_STATS_TOPOLOGY_COMPARE);
+    if (is_same_topology) {
+      subdiv->stats.topology_cache_hits++;
+      return subdiv;
+    }
+  }
+
+  int topology_cache_hits = 0, topology_cache_misses = 0;
+  if (subdiv != NULL) {
+    topology_cache_hits = subdiv->stats.topology_cache_hits;
+    topology_cache_misses = subdiv->stats.topology_cache_misses;
+  }
+
   OpenSubdiv_Converter converter;
   BKE_subdiv_converter_init_for_mesh(&converter, settings, mesh);
   subdiv = BKE_subdiv_update_from_converter(subdiv, settings, &converter);
   BKE_subdiv_converter_free(&converter);
+
+  if (subdiv != NULL) {
+    /* Keep counting over re-created descriptors. */
+    subdiv->stats.topology_cache_hits = topology_cache_hits;
+    subdiv->stats.topology_cache_misses = topology_cache_misses + 1;
+
+    if (subdiv->cache_.topology_key == NULL) {
+      subdiv->cache_.topology_key = MEM_mallocN(sizeof(SubdivTopologyKey), __func__);
+    }
+    subdiv_topology_key_calc(mesh, subdiv->cache_.topology_key);
+  }
   return subdiv;
 }
 
@@ -194,6 +304,9 @@ void BKE_subdiv_free(Subdiv *subdiv)
   if (subdiv->cache_.face_ptex_offset != NULL) {
     MEM_freeN(subdiv->cache_.face_ptex_offset);
   }
+  if (subdiv->cache_.topology_key != NULL) {
+    MEM_freeN(subdiv->cache_.topology_key);
+  }
   MEM_freeN(subdiv);
 }
 
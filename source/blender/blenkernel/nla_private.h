@@ -179,7 +179,8 @@ void nlastrip_evaluate(PointerRNA *ptr,
 void nladata_flush_channels(PointerRNA *ptr,
                             NlaEvalData *channels,
                             NlaEvalSnapshot *snapshot,
-                            const bool flush_to_original);
+                            const bool flush_to_original,
+                            bool *r_changed);
 
 #ifdef __cplusplus
 }
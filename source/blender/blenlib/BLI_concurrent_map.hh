@@ -0,0 +1,384 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __BLI_CONCURRENT_MAP_HH__
+#define __BLI_CONCURRENT_MAP_HH__
+
+/** \file
+ * \ingroup bli
+ *
+ * This file provides a map which can be filled and queried from multiple threads at the same
+ * time, without locks. It is meant for parallel builders, e.g. deduplicating edges of a mesh from
+ * all its faces at once.
+ *
+ * The map uses open addressing with linear probing. Every slot has an atomic state, a thread
+ * inserting a key claims an empty slot with a compare-and-swap, constructs the key and value in
+ * it, and then publishes the slot. Other threads only wait when they probe a slot which is being
+ * constructed at that moment, which is very short and rare.
+ *
+ * To keep inserts lock-free, the map does not grow while it is used concurrently: the maximum
+ * number of keys has to be known when constructing it (or passed to #reserve). Parallel builders
+ * generally know such a bound (e.g. a mesh can't have more unique edges than face corners).
+ * Keys can't be removed.
+ */
+
+#include <atomic>
+
+#include "BLI_allocator.hh"
+#include "BLI_array_ref.hh"
+#include "BLI_hash.hh"
+#include "BLI_memory_utils.hh"
+#include "BLI_task.h"
+
+namespace BLI {
+
+template<typename KeyT, typename ValueT, typename Allocator = GuardedAllocator>
+class ConcurrentMap {
+ private:
+  static constexpr uint8_t IS_EMPTY = 0;
+  static constexpr uint8_t IS_BUSY = 1;
+  static constexpr uint8_t IS_SET = 2;
+
+  class Slot {
+   private:
+    std::atomic<uint8_t> m_state;
+    AlignedBuffer<sizeof(KeyT), alignof(KeyT)> m_key_buffer;
+    AlignedBuffer<sizeof(ValueT), alignof(ValueT)> m_value_buffer;
+
+   public:
+    uint8_t state() const
+    {
+      return m_state.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Wait until another thread is done constructing this slot.
+     */
+    uint8_t state_wait_not_busy() const
+    {
+      uint8_t state;
+      while ((state = this->state()) == IS_BUSY) {
+        /* Spin, constructing a key and value is very short. */
+      }
+      return state;
+    }
+
+    bool try_claim()
+    {
+      uint8_t expected = IS_EMPTY;
+      return m_state.compare_exchange_strong(
+          expected, IS_BUSY, std::memory_order_acquire, std::memory_order_acquire);
+    }
+
+    void publish()
+    {
+      m_state.store(IS_SET, std::memory_order_release);
+    }
+
+    void init_empty()
+    {
+      m_state.store(IS_EMPTY, std::memory_order_relaxed);
+    }
+
+    KeyT *key() const
+    {
+      return (KeyT *)m_key_buffer.ptr();
+    }
+
+    ValueT *value() const
+    {
+      return (ValueT *)m_value_buffer.ptr();
+    }
+  };
+
+  Slot *m_slots = nullptr;
+  /* Number of slots minus one, the number of slots is a power of two. */
+  uint32_t m_slot_mask = 0;
+  /* Maximum number of keys, keeps the load factor at or below 1/2. */
+  uint32_t m_max_size = 0;
+  Allocator m_allocator;
+
+ public:
+  ConcurrentMap() = default;
+
+  /**
+   * Allocate a map which can hold up to \a max_size keys.
+   */
+  explicit ConcurrentMap(uint32_t max_size)
+  {
+    this->reserve(max_size);
+  }
+
+  ~ConcurrentMap()
+  {
+    this->free_slots();
+  }
+
+  ConcurrentMap(const ConcurrentMap &other) = delete;
+  ConcurrentMap &operator=(const ConcurrentMap &other) = delete;
+
+  /**
+   * Allow up to \a max_size keys to be added. Keys which are already in the map are kept.
+   * Not thread-safe, this must not be called while other threads use the map.
+   */
+  void reserve(uint32_t max_size)
+  {
+    if (max_size <= m_max_size) {
+      return;
+    }
+    uint32_t slots_len = 16;
+    while (slots_len / 2 < max_size) {
+      BLI_assert(slots_len < (1u << 31));
+      slots_len *= 2;
+    }
+
+    Slot *slots_old = m_slots;
+    const uint32_t slots_len_old = m_slots ? m_slot_mask + 1 : 0;
+
+    BLI_assert((uint64_t)slots_len * sizeof(Slot) <= UINT32_MAX);
+    m_slots = (Slot *)m_allocator.allocate_aligned(
+        (uint)(slots_len * sizeof(Slot)), (uint)alignof(Slot), __func__);
+    m_slot_mask = slots_len - 1;
+    m_max_size = slots_len / 2;
+    for (uint32_t i = 0; i < slots_len; i++) {
+      m_slots[i].init_empty();
+    }
+
+    for (uint32_t i = 0; i < slots_len_old; i++) {
+      Slot &slot_old = slots_old[i];
+      if (slot_old.state() == IS_SET) {
+        Slot &slot = this->find_empty_slot(*slot_old.key());
+        new (slot.key()) KeyT(std::move(*slot_old.key()));
+        new (slot.value()) ValueT(std::move(*slot_old.value()));
+        slot.publish();
+        slot_old.key()->~KeyT();
+        slot_old.value()->~ValueT();
+      }
+    }
+    if (slots_old) {
+      m_allocator.deallocate(slots_old);
+    }
+  }
+
+  /**
+   * Maximum number of keys the map can hold without calling #reserve.
+   */
+  uint32_t max_size() const
+  {
+    return m_max_size;
+  }
+
+  /**
+   * Add a key-value-pair, unless the key is in the map already.
+   * Thread-safe with other adds and lookups.
+   *
+   * \return true when the key has been added.
+   */
+  bool add(const KeyT &key, const ValueT &value)
+  {
+    bool is_new;
+    this->lookup_or_add_slot(key, value, &is_new);
+    return is_new;
+  }
+
+  /**
+   * Get the value of \a key, adding it with \a value first if it is not in the map yet.
+   * When multiple threads add the same key at the same time, all of them get the value which
+   * was added first. Thread-safe with other adds and lookups.
+   */
+  const ValueT &lookup_or_add(const KeyT &key, const ValueT &value)
+  {
+    bool is_new;
+    return *this->lookup_or_add_slot(key, value, &is_new).value();
+  }
+
+  /**
+   * Get a pointer to the value of \a key, or null when it is not in the map.
+   * Thread-safe with adds: keys added by other threads are found once their add returned.
+   */
+  const ValueT *lookup_ptr(const KeyT &key) const
+  {
+    if (m_slots == nullptr) {
+      return nullptr;
+    }
+    const uint32_t hash = DefaultHash<KeyT>{}(key);
+    for (uint32_t i = 0, slot_index = this->first_slot_index(hash); i <= m_slot_mask;
+         i++, slot_index = (slot_index + 1) & m_slot_mask) {
+      const Slot &slot = m_slots[slot_index];
+      const uint8_t state = slot.state_wait_not_busy();
+      if (state == IS_EMPTY) {
+        return nullptr;
+      }
+      if (*slot.key() == key) {
+        return slot.value();
+      }
+    }
+    return nullptr;
+  }
+
+  const ValueT &lookup(const KeyT &key) const
+  {
+    const ValueT *ptr = this->lookup_ptr(key);
+    BLI_assert(ptr != nullptr);
+    return *ptr;
+  }
+
+  ValueT lookup_default(const KeyT &key, ValueT default_value) const
+  {
+    const ValueT *ptr = this->lookup_ptr(key);
+    return (ptr != nullptr) ? *ptr : default_value;
+  }
+
+  bool contains(const KeyT &key) const
+  {
+    return this->lookup_ptr(key) != nullptr;
+  }
+
+  /**
+   * Number of keys in the map. This iterates over all slots, it is meant to be called once
+   * the map is built rather than to be maintained with every (concurrent) add.
+   */
+  uint32_t size() const
+  {
+    uint32_t size = 0;
+    for (uint32_t i = 0; m_slots && i <= m_slot_mask; i++) {
+      size += (m_slots[i].state() == IS_SET);
+    }
+    return size;
+  }
+
+  bool is_empty() const
+  {
+    return this->size() == 0;
+  }
+
+  /**
+   * Call \a func with every key and value, in no particular order.
+   * Not thread-safe with concurrent adds.
+   */
+  template<typename FuncT> void foreach_item(const FuncT &func) const
+  {
+    for (uint32_t i = 0; m_slots && i <= m_slot_mask; i++) {
+      const Slot &slot = m_slots[i];
+      if (slot.state() == IS_SET) {
+        func(*slot.key(), *slot.value());
+      }
+    }
+  }
+
+  /**
+   * Add all \a keys with the value at the same index in \a values, from multiple threads.
+   * Keys which are in the map already (or multiple times in \a keys) keep the first value which
+   * was added. Grows the map first when needed.
+   */
+  void add_parallel(ArrayRef<KeyT> keys, ArrayRef<ValueT> values)
+  {
+    BLI_assert(keys.size() == values.size());
+    /* Keys already in the map may be given again, #reserve is cheap when nothing has to be done. */
+    this->reserve(this->size() + keys.size());
+
+    AddParallelData data = {this, keys, values};
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = (keys.size() >= 4096);
+    settings.min_iter_per_thread = 1024;
+    BLI_task_parallel_range(0, (int)keys.size(), &data, add_parallel_fn, &settings);
+  }
+
+ private:
+  struct AddParallelData {
+    ConcurrentMap *map;
+    ArrayRef<KeyT> keys;
+    ArrayRef<ValueT> values;
+  };
+
+  static void add_parallel_fn(void *__restrict userdata,
+                              const int index,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
+  {
+    AddParallelData *data = (AddParallelData *)userdata;
+    data->map->add(data->keys[index], data->values[index]);
+  }
+
+  /**
+   * Most hash functions of #DefaultHash are trivial, mix all bits into the high bits which are
+   * then used as slot index.
+   */
+  uint32_t first_slot_index(uint32_t hash) const
+  {
+    const uint64_t mix = (uint64_t)hash * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(mix >> 32) & m_slot_mask;
+  }
+
+  Slot &lookup_or_add_slot(const KeyT &key, const ValueT &value, bool *r_is_new)
+  {
+    BLI_assert(m_slots != nullptr);
+    const uint32_t hash = DefaultHash<KeyT>{}(key);
+    for (uint32_t i = 0, slot_index = this->first_slot_index(hash); i <= m_slot_mask;
+         i++, slot_index = (slot_index + 1) & m_slot_mask) {
+      Slot &slot = m_slots[slot_index];
+      if (slot.state() == IS_EMPTY && slot.try_claim()) {
+        new (slot.key()) KeyT(key);
+        new (slot.value()) ValueT(value);
+        slot.publish();
+        *r_is_new = true;
+        return slot;
+      }
+      /* Either set, or claimed by another thread which may be adding the same key. */
+      slot.state_wait_not_busy();
+      if (*slot.key() == key) {
+        *r_is_new = false;
+        return slot;
+      }
+    }
+    /* More keys than the size given to #reserve were added. */
+    BLI_assert(!"ConcurrentMap is full");
+    abort();
+  }
+
+  /**
+   * Only used when rebuilding the map, on a single thread.
+   */
+  Slot &find_empty_slot(const KeyT &key)
+  {
+    const uint32_t hash = DefaultHash<KeyT>{}(key);
+    uint32_t slot_index = this->first_slot_index(hash);
+    while (m_slots[slot_index].state() != IS_EMPTY) {
+      slot_index = (slot_index + 1) & m_slot_mask;
+    }
+    return m_slots[slot_index];
+  }
+
+  void free_slots()
+  {
+    if (m_slots == nullptr) {
+      return;
+    }
+    for (uint32_t i = 0; i <= m_slot_mask; i++) {
+      Slot &slot = m_slots[i];
+      if (slot.state() == IS_SET) {
+        slot.key()->~KeyT();
+        slot.value()->~ValueT();
+      }
+    }
+    m_allocator.deallocate(m_slots);
+    m_slots = nullptr;
+  }
+};
+
+}  // namespace BLI
+
+#endif /* __BLI_CONCURRENT_MAP_HH__ */
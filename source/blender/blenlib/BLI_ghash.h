@@ -72,6 +72,8 @@ enum {
   /* Internal usage only */
   /* Whether the GHash is actually used as GSet (no value storage). */
   GHASH_FLAG_IS_GSET = (1 << 16),
+  /* Whether entries are stored in flat open addressing storage (see #BLI_ghash_new_flat_ex). */
+  GHASH_FLAG_IS_FLAT = (1 << 17),
 #endif
 };
 
@@ -87,6 +89,14 @@ GHash *BLI_ghash_new_ex(GHashHashFP hashfp,
 GHash *BLI_ghash_new(GHashHashFP hashfp,
                      GHashCmpFP cmpfp,
                      const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHash *BLI_ghash_new_flat_ex(GHashHashFP hashfp,
+                             GHashCmpFP cmpfp,
+                             const char *info,
+                             const unsigned int nentries_reserve) ATTR_MALLOC
+    ATTR_WARN_UNUSED_RESULT;
+GHash *BLI_ghash_new_flat(GHashHashFP hashfp,
+                          GHashCmpFP cmpfp,
+                          const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 GHash *BLI_ghash_copy(GHash *gh,
                       GHashKeyCopyFP keycopyfp,
                       GHashValCopyFP valcopyfp) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
@@ -200,6 +210,13 @@ GSet *BLI_gset_new_ex(GSetHashFP hashfp,
 GSet *BLI_gset_new(GSetHashFP hashfp,
                    GSetCmpFP cmpfp,
                    const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GSet *BLI_gset_new_flat_ex(GSetHashFP hashfp,
+                           GSetCmpFP cmpfp,
+                           const char *info,
+                           const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GSet *BLI_gset_new_flat(GSetHashFP hashfp,
+                        GSetCmpFP cmpfp,
+                        const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 GSet *BLI_gset_copy(GSet *gs, GSetKeyCopyFP keycopyfp) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 unsigned int BLI_gset_len(GSet *gs) ATTR_WARN_UNUSED_RESULT;
 void BLI_gset_flag_set(GSet *gs, unsigned int flag);
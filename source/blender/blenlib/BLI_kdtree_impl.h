@@ -44,6 +44,11 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
                                  const float co[KD_DIMS],
                                  KDTreeNearest *r_nearest) ATTR_NONNULL(1, 2);
 
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        KDTreeNearest *r_nearest) ATTR_NONNULL(1, 2, 4);
+
 int BLI_kdtree_nd_(find_nearest_n)(const KDTree *tree,
                                    const float co[KD_DIMS],
                                    KDTreeNearest *r_nearest,
@@ -97,6 +97,36 @@ void *BLI_task_pool_user_data(TaskPool *pool);
 /* optional mutex to use from run function */
 ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool);
 
+/* Task Graph
+ *
+ * Directed acyclic graph of tasks, where each node runs once all nodes it depends on
+ * (its predecessors) are done. Nodes share the central task scheduler with task pools.
+ *
+ * Dependencies are counted per node, the last predecessor to finish schedules the node.
+ * The first successor which becomes ready continues on the same thread.
+ *
+ * Work is started by pushing nodes without predecessors, the graph can be run again
+ * once #BLI_task_graph_work_and_wait returns. Nodes and edges must not be created while
+ * the graph is running.
+ */
+
+struct TaskGraph;
+struct TaskNode;
+
+typedef void (*TaskGraphNodeRunFunction)(void *__restrict task_data);
+typedef void (*TaskGraphNodeFreeFunction)(void *task_data);
+
+struct TaskGraph *BLI_task_graph_create(void);
+void BLI_task_graph_work_and_wait(struct TaskGraph *task_graph);
+void BLI_task_graph_free(struct TaskGraph *task_graph);
+struct TaskNode *BLI_task_graph_node_create(struct TaskGraph *task_graph,
+                                            TaskGraphNodeRunFunction run,
+                                            void *user_data,
+                                            TaskGraphNodeFreeFunction free_func);
+/* Schedule a node which has no pending predecessors, returns false otherwise. */
+bool BLI_task_graph_node_push_work(struct TaskNode *task_node);
+void BLI_task_graph_edge_create(struct TaskNode *from_node, struct TaskNode *to_node);
+
 /* Parallel for routines */
 
 /* Per-thread specific data passed to the callback. */
@@ -22,6 +22,9 @@
  *
  * A general (pointer -> pointer) chaining hash table
  * for 'Abstract Data Types' (known as an ADT Hash Table).
+ *
+ * Optionally (see #BLI_ghash_new_flat_ex), entries are stored in a flat open addressing table
+ * instead, see "Flat Storage" below.
  */
 
 #include <limits.h>
@@ -31,9 +34,15 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_utildefines.h"
+
+#include "BLI_math_bits.h"
 #include "BLI_mempool.h"
 #include "BLI_sys_types.h" /* for intptr_t support */
-#include "BLI_utildefines.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
 
 #define GHASH_INTERNAL_API
 #include "BLI_ghash.h" /* own include */
@@ -112,6 +121,13 @@ struct GHash {
 
   uint nentries;
   uint flag;
+
+  /* Flat storage only, see #GHASH_FLAG_IS_FLAT. */
+  uchar *ctrl;
+  void *slots;
+  uint group_mask;
+  uint growth_left;
+  uint capacity_min;
 };
 
 /** \} */
@@ -419,12 +435,404 @@ BLI_INLINE Entry *ghash_lookup_entry_prev_ex(GHash *gh,
   return NULL;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Flat Storage
+ *
+ * Open addressing storage, with the same layout as "Swiss Tables":
+ * entries are stored in a flat array of slots, and every slot has a control byte,
+ * either empty, deleted, or the 7 bits of the key hash which are not used to find its group.
+ * Slots are probed by groups of #GHASH_FLAT_GROUP_SIZE, comparing all the control bytes
+ * of a group at once (using SSE2 when available), so most lookups only compare one key
+ * and touch two cache lines, without any pointer chasing.
+ *
+ * Slots have the same layout as chained entries, the full hash of the key is stored
+ * instead of the next entry, which avoids hashing keys again when growing the table.
+ *
+ * \note Unlike with chained storage, pointers to keys and values (#BLI_ghash_lookup_p,
+ * #BLI_ghash_ensure_p...) are only valid until the next insertion or removal.
+ * \{ */
+
+#define GHASH_FLAT_GROUP_SIZE 16
+#define GHASH_FLAT_CAPACITY_MIN GHASH_FLAT_GROUP_SIZE
+
+#define GHASH_FLAT_CTRL_EMPTY ((uchar)0x80)
+#define GHASH_FLAT_CTRL_DELETED ((uchar)0xFE)
+/* Full slots are the only ones with the high bit of their control byte cleared. */
+#define GHASH_FLAT_CTRL_IS_FULL(_ctrl) (((_ctrl)&0x80) == 0)
+
+/* Unlike for chained storage, the load factor can be high since probing is cheap. */
+#define GHASH_FLAT_LIMIT_GROW(_capacity) ((_capacity) - ((_capacity) / 8))
+#define GHASH_FLAT_LIMIT_SHRINK(_capacity) (((_capacity)*3) / 16)
+
+typedef struct FlatSlot {
+  /** Full hash of the key, where #Entry.next is for chained storage. */
+  uintptr_t hash;
+  void *key;
+  /** Only allocated when not used as GSet. */
+  void *val;
+} FlatSlot;
+
+/* Slots are given to #GHashIterator as entries. */
+BLI_STATIC_ASSERT(offsetof(FlatSlot, key) == offsetof(Entry, key), "Invalid FlatSlot layout");
+BLI_STATIC_ASSERT(offsetof(FlatSlot, val) == offsetof(GHashEntry, val), "Invalid FlatSlot layout");
+
+BLI_INLINE size_t ghash_flat_slot_size(const GHash *gh)
+{
+  return GHASH_ENTRY_SIZE(gh->flag & GHASH_FLAG_IS_GSET);
+}
+
+BLI_INLINE FlatSlot *ghash_flat_slot(const GHash *gh, const uint index)
+{
+  return (FlatSlot *)POINTER_OFFSET(gh->slots, (size_t)index * ghash_flat_slot_size(gh));
+}
+
+/**
+ * Split the hash in the group to start probing from and the control byte of the key.
+ * Hashes are mixed first, since a lot of hashing functions (pointers, integers...)
+ * give poorly distributed lower bits.
+ */
+BLI_INLINE uint ghash_flat_hash_split(const uint hash, uchar *r_ctrl)
+{
+  const uint64_t mix = (uint64_t)hash * 0x9E3779B97F4A7C15ull;
+  *r_ctrl = (uchar)((mix >> 25) & 0x7F);
+  return (uint)(mix >> 32);
+}
+
+/**
+ * Bit-mask of the slots of the group at \a ctrl which control byte is \a value.
+ */
+BLI_INLINE uint ghash_flat_group_match(const uchar *ctrl, const uchar value)
+{
+#ifdef __SSE2__
+  const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+  return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+#else
+  uint mask = 0;
+  for (uint i = 0; i < GHASH_FLAT_GROUP_SIZE; i++) {
+    mask |= (uint)(ctrl[i] == value) << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+ * Bit-mask of the empty or deleted slots of the group at \a ctrl.
+ */
+BLI_INLINE uint ghash_flat_group_match_free(const uchar *ctrl)
+{
+#ifdef __SSE2__
+  return (uint)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+  uint mask = 0;
+  for (uint i = 0; i < GHASH_FLAT_GROUP_SIZE; i++) {
+    mask |= (uint)!GHASH_FLAT_CTRL_IS_FULL(ctrl[i]) << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+ * Next group to probe, triangular probing visits all groups since their number is a power of 2.
+ */
+BLI_INLINE uint ghash_flat_group_next(const GHash *gh, const uint group, const uint step)
+{
+  return (group + step) & gh->group_mask;
+}
+
+BLI_INLINE uint ghash_flat_capacity_for(const uint nentries)
+{
+  uint capacity = GHASH_FLAT_CAPACITY_MIN;
+  while (GHASH_FLAT_LIMIT_GROW(capacity) < nentries) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+static void ghash_flat_alloc(GHash *gh, const uint capacity)
+{
+  BLI_assert((capacity & (capacity - 1)) == 0 && capacity >= GHASH_FLAT_CAPACITY_MIN);
+  gh->ctrl = MEM_mallocN(capacity, "GHash flat ctrl");
+  memset(gh->ctrl, GHASH_FLAT_CTRL_EMPTY, capacity);
+  gh->slots = MEM_mallocN(ghash_flat_slot_size(gh) * capacity, "GHash flat slots");
+  gh->nbuckets = capacity;
+  gh->group_mask = (capacity / GHASH_FLAT_GROUP_SIZE) - 1;
+  gh->growth_left = GHASH_FLAT_LIMIT_GROW(capacity) - gh->nentries;
+}
+
+/**
+ * Index of the first free slot in the probing sequence of \a hash.
+ */
+static uint ghash_flat_find_free(const GHash *gh, const uint hash, uchar *r_ctrl)
+{
+  uint group = ghash_flat_hash_split(hash, r_ctrl) & gh->group_mask;
+  for (uint step = 1;; step++) {
+    const uint mask = ghash_flat_group_match_free(&gh->ctrl[group * GHASH_FLAT_GROUP_SIZE]);
+    if (mask) {
+      return group * GHASH_FLAT_GROUP_SIZE + bitscan_forward_uint(mask);
+    }
+    group = ghash_flat_group_next(gh, group, step);
+  }
+}
+
+/**
+ * Rebuild the table with given capacity, also getting rid of deleted slots.
+ */
+static void ghash_flat_resize(GHash *gh, const uint capacity)
+{
+  uchar *ctrl_old = gh->ctrl;
+  void *slots_old = gh->slots;
+  const uint capacity_old = gh->nbuckets;
+  const size_t slot_size = ghash_flat_slot_size(gh);
+
+  BLI_assert(GHASH_FLAT_LIMIT_GROW(capacity) >= gh->nentries);
+  ghash_flat_alloc(gh, capacity);
+
+  for (uint i = 0; i < capacity_old; i++) {
+    if (GHASH_FLAT_CTRL_IS_FULL(ctrl_old[i])) {
+      const FlatSlot *slot_old = POINTER_OFFSET(slots_old, (size_t)i * slot_size);
+      uchar ctrl;
+      const uint index = ghash_flat_find_free(gh, (uint)slot_old->hash, &ctrl);
+      gh->ctrl[index] = ctrl;
+      memcpy(ghash_flat_slot(gh, index), slot_old, slot_size);
+    }
+  }
+
+  MEM_freeN(ctrl_old);
+  MEM_freeN(slots_old);
+}
+
+static FlatSlot *ghash_flat_lookup(const GHash *gh, const void *key, const uint hash)
+{
+  uchar ctrl;
+  uint group = ghash_flat_hash_split(hash, &ctrl) & gh->group_mask;
+  for (uint step = 1;; step++) {
+    const uchar *group_ctrl = &gh->ctrl[group * GHASH_FLAT_GROUP_SIZE];
+    for (uint mask = ghash_flat_group_match(group_ctrl, ctrl); mask; mask &= mask - 1) {
+      const uint index = group * GHASH_FLAT_GROUP_SIZE + bitscan_forward_uint(mask);
+      FlatSlot *slot = ghash_flat_slot(gh, index);
+      if ((uint)slot->hash == hash && UNLIKELY(gh->cmpfp(key, slot->key) == false)) {
+        return slot;
+      }
+    }
+    /* Keys are never inserted past a group with empty slots. */
+    if (ghash_flat_group_match(group_ctrl, GHASH_FLAT_CTRL_EMPTY)) {
+      return NULL;
+    }
+    group = ghash_flat_group_next(gh, group, step);
+  }
+}
+
+/**
+ * Insert \a key without checking whether it's already in the table,
+ * the value is left uninitialized.
+ */
+static FlatSlot *ghash_flat_insert(GHash *gh, void *key, const uint hash)
+{
+  BLI_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (BLI_ghash_haskey(gh, key) == 0));
+
+  if (UNLIKELY(gh->growth_left == 0)) {
+    /* When many slots are only deleted, rebuilding at the same size is enough. */
+    const uint capacity = (gh->nentries < GHASH_FLAT_LIMIT_GROW(gh->nbuckets) / 2) ?
+                              gh->nbuckets :
+                              gh->nbuckets * 2;
+    ghash_flat_resize(gh, capacity);
+  }
+
+  uchar ctrl;
+  const uint index = ghash_flat_find_free(gh, hash, &ctrl);
+  if (gh->ctrl[index] == GHASH_FLAT_CTRL_EMPTY) {
+    gh->growth_left--;
+  }
+  gh->ctrl[index] = ctrl;
+  gh->nentries++;
+
+  FlatSlot *slot = ghash_flat_slot(gh, index);
+  slot->hash = hash;
+  slot->key = key;
+  return slot;
+}
+
+/**
+ * Remove the slot at \a index, its content is kept until the next insertion or resize.
+ */
+static void ghash_flat_remove_index(GHash *gh, const uint index)
+{
+  const uint group_index = index & ~(uint)(GHASH_FLAT_GROUP_SIZE - 1);
+  BLI_assert(GHASH_FLAT_CTRL_IS_FULL(gh->ctrl[index]));
+  /* A group with empty slots never made any probing continue past it,
+   * so the slot can become empty again. Otherwise it has to be kept as deleted. */
+  if (ghash_flat_group_match(&gh->ctrl[group_index], GHASH_FLAT_CTRL_EMPTY)) {
+    gh->ctrl[index] = GHASH_FLAT_CTRL_EMPTY;
+    gh->growth_left++;
+  }
+  else {
+    gh->ctrl[index] = GHASH_FLAT_CTRL_DELETED;
+  }
+  gh->nentries--;
+}
+
+static void ghash_flat_contract(GHash *gh, const bool force_shrink)
+{
+  if (!(force_shrink || (gh->flag & GHASH_FLAG_ALLOW_SHRINK))) {
+    return;
+  }
+  if (LIKELY(gh->nentries >= GHASH_FLAT_LIMIT_SHRINK(gh->nbuckets))) {
+    return;
+  }
+  const uint capacity = MAX2(ghash_flat_capacity_for(gh->nentries), gh->capacity_min);
+  if (capacity < gh->nbuckets) {
+    ghash_flat_resize(gh, capacity);
+  }
+}
+
+static bool ghash_flat_remove(GHash *gh,
+                              const void *key,
+                              GHashKeyFreeFP keyfreefp,
+                              GHashValFreeFP valfreefp,
+                              void **r_key,
+                              void **r_val)
+{
+  FlatSlot *slot = ghash_flat_lookup(gh, key, ghash_keyhash(gh, key));
+
+  BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
+
+  if (slot == NULL) {
+    return false;
+  }
+  if (keyfreefp) {
+    keyfreefp(slot->key);
+  }
+  if (valfreefp) {
+    valfreefp(slot->val);
+  }
+  if (r_key) {
+    *r_key = slot->key;
+  }
+  if (r_val) {
+    *r_val = slot->val;
+  }
+  const uint index = (uint)((size_t)((char *)slot - (char *)gh->slots) /
+                            ghash_flat_slot_size(gh));
+  ghash_flat_remove_index(gh, index);
+  ghash_flat_contract(gh, false);
+  return true;
+}
+
+/**
+ * Index of the first full slot starting from \a index, or the capacity when there is none.
+ */
+static uint ghash_flat_find_next_full(const GHash *gh, uint index)
+{
+  while (index < gh->nbuckets) {
+    const uint group_index = index & ~(uint)(GHASH_FLAT_GROUP_SIZE - 1);
+    uint mask = ~ghash_flat_group_match_free(&gh->ctrl[group_index]) &
+                ((1u << GHASH_FLAT_GROUP_SIZE) - 1);
+    mask &= ~0u << (index - group_index);
+    if (mask) {
+      return group_index + bitscan_forward_uint(mask);
+    }
+    index = group_index + GHASH_FLAT_GROUP_SIZE;
+  }
+  return gh->nbuckets;
+}
+
+static bool ghash_flat_pop(GHash *gh, GHashIterState *state, void **r_key, void **r_val)
+{
+  if (gh->nentries == 0) {
+    return false;
+  }
+  uint index = ghash_flat_find_next_full(gh, state->curr_bucket);
+  if (index == gh->nbuckets) {
+    index = ghash_flat_find_next_full(gh, 0);
+  }
+  const FlatSlot *slot = ghash_flat_slot(gh, index);
+  *r_key = slot->key;
+  if (r_val) {
+    *r_val = slot->val;
+  }
+  ghash_flat_remove_index(gh, index);
+  ghash_flat_contract(gh, false);
+  state->curr_bucket = index;
+  return true;
+}
+
+static void ghash_flat_free_cb(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+  BLI_assert(keyfreefp || valfreefp);
+  BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
+
+  for (uint i = 0; i < gh->nbuckets; i++) {
+    if (GHASH_FLAT_CTRL_IS_FULL(gh->ctrl[i])) {
+      FlatSlot *slot = ghash_flat_slot(gh, i);
+      if (keyfreefp) {
+        keyfreefp(slot->key);
+      }
+      if (valfreefp) {
+        valfreefp(slot->val);
+      }
+    }
+  }
+}
+
+static void ghash_flat_reset(GHash *gh, const uint nentries_reserve)
+{
+  MEM_SAFE_FREE(gh->ctrl);
+  MEM_SAFE_FREE(gh->slots);
+  gh->nentries = 0;
+  const uint capacity = ghash_flat_capacity_for(nentries_reserve);
+  gh->capacity_min = nentries_reserve ? capacity : GHASH_FLAT_CAPACITY_MIN;
+  ghash_flat_alloc(gh, capacity);
+}
+
+static GHash *ghash_flat_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP valcopyfp)
+{
+  GHash *gh_new = MEM_dupallocN(gh);
+  const size_t slot_size = ghash_flat_slot_size(gh);
+
+  /* Same capacity, slots can be copied as they are. */
+  gh_new->ctrl = MEM_dupallocN(gh->ctrl);
+  gh_new->slots = MEM_dupallocN(gh->slots);
+
+  if (keycopyfp || valcopyfp) {
+    for (uint i = 0; i < gh->nbuckets; i++) {
+      if (GHASH_FLAT_CTRL_IS_FULL(gh->ctrl[i])) {
+        FlatSlot *slot = POINTER_OFFSET(gh_new->slots, (size_t)i * slot_size);
+        if (keycopyfp) {
+          slot->key = keycopyfp(slot->key);
+        }
+        if (valcopyfp) {
+          slot->val = valcopyfp(slot->val);
+        }
+      }
+    }
+  }
+  return gh_new;
+}
+
+static void ghash_flat_reserve(GHash *gh, const uint nentries_reserve)
+{
+  const uint capacity = ghash_flat_capacity_for(MAX2(nentries_reserve, gh->nentries));
+  gh->capacity_min = capacity;
+  if (capacity > gh->nbuckets) {
+    ghash_flat_resize(gh, capacity);
+  }
+  else {
+    ghash_flat_contract(gh, false);
+  }
+}
+
+/** \} */
+
 /**
  * Internal lookup function. Only wraps #ghash_lookup_entry_ex
+ * (or #ghash_flat_lookup, slots have the same layout as entries).
  */
 BLI_INLINE Entry *ghash_lookup_entry(GHash *gh, const void *key)
 {
   const uint hash = ghash_keyhash(gh, key);
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    return (Entry *)ghash_flat_lookup(gh, key, hash);
+  }
   const uint bucket_index = ghash_bucket_index(gh, hash);
   return ghash_lookup_entry_ex(gh, key, bucket_index);
 }
@@ -443,6 +851,15 @@ static GHash *ghash_new(GHashHashFP hashfp,
   gh->buckets = NULL;
   gh->flag = flag;
 
+  gh->ctrl = NULL;
+  gh->slots = NULL;
+
+  if (flag & GHASH_FLAG_IS_FLAT) {
+    gh->entrypool = NULL;
+    ghash_flat_reset(gh, nentries_reserve);
+    return gh;
+  }
+
   ghash_buckets_reset(gh, nentries_reserve);
   gh->entrypool = BLI_mempool_create(
       GHASH_ENTRY_SIZE(flag & GHASH_FLAG_IS_GSET), 64, 64, BLI_MEMPOOL_NOP);
@@ -507,6 +924,11 @@ BLI_INLINE void ghash_insert_ex_keyonly(GHash *gh, void *key, const uint bucket_
 BLI_INLINE void ghash_insert(GHash *gh, void *key, void *val)
 {
   const uint hash = ghash_keyhash(gh, key);
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+    ghash_flat_insert(gh, key, hash)->val = val;
+    return;
+  }
   const uint bucket_index = ghash_bucket_index(gh, hash);
 
   ghash_insert_ex(gh, key, val, bucket_index);
@@ -520,8 +942,10 @@ BLI_INLINE bool ghash_insert_safe(GHash *gh,
                                   GHashValFreeFP valfreefp)
 {
   const uint hash = ghash_keyhash(gh, key);
-  const uint bucket_index = ghash_bucket_index(gh, hash);
-  GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
+  const bool is_flat = (gh->flag & GHASH_FLAG_IS_FLAT) != 0;
+  const uint bucket_index = is_flat ? 0 : ghash_bucket_index(gh, hash);
+  GHashEntry *e = is_flat ? (GHashEntry *)ghash_flat_lookup(gh, key, hash) :
+                            (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
 
   BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 
@@ -538,6 +962,10 @@ BLI_INLINE bool ghash_insert_safe(GHash *gh,
     }
     return false;
   }
+  else if (is_flat) {
+    ghash_flat_insert(gh, key, hash)->val = val;
+    return true;
+  }
   else {
     ghash_insert_ex(gh, key, val, bucket_index);
     return true;
@@ -550,8 +978,10 @@ BLI_INLINE bool ghash_insert_safe_keyonly(GHash *gh,
                                           GHashKeyFreeFP keyfreefp)
 {
   const uint hash = ghash_keyhash(gh, key);
-  const uint bucket_index = ghash_bucket_index(gh, hash);
-  Entry *e = ghash_lookup_entry_ex(gh, key, bucket_index);
+  const bool is_flat = (gh->flag & GHASH_FLAG_IS_FLAT) != 0;
+  const uint bucket_index = is_flat ? 0 : ghash_bucket_index(gh, hash);
+  Entry *e = is_flat ? (Entry *)ghash_flat_lookup(gh, key, hash) :
+                       ghash_lookup_entry_ex(gh, key, bucket_index);
 
   BLI_assert((gh->flag & GHASH_FLAG_IS_GSET) != 0);
 
@@ -564,6 +994,10 @@ BLI_INLINE bool ghash_insert_safe_keyonly(GHash *gh,
     }
     return false;
   }
+  else if (is_flat) {
+    ghash_flat_insert(gh, key, hash);
+    return true;
+  }
   else {
     ghash_insert_ex_keyonly(gh, key, bucket_index);
     return true;
@@ -639,6 +1073,11 @@ static void ghash_free_cb(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP va
   BLI_assert(keyfreefp || valfreefp);
   BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    ghash_flat_free_cb(gh, keyfreefp, valfreefp);
+    return;
+  }
+
   for (i = 0; i < gh->nbuckets; i++) {
     Entry *e;
 
@@ -665,6 +1104,10 @@ static GHash *ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP val
 
   BLI_assert(!valcopyfp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    return ghash_flat_copy(gh, keycopyfp, valcopyfp);
+  }
+
   gh_new = ghash_new(gh->hashfp, gh->cmpfp, __func__, 0, gh->flag);
   ghash_buckets_expand(gh_new, reserve_nentries_new, false);
 
@@ -724,6 +1167,30 @@ GHash *BLI_ghash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info)
   return BLI_ghash_new_ex(hashfp, cmpfp, info, 0);
 }
 
+/**
+ * Creates a new, empty GHash, using flat open addressing storage.
+ *
+ * Faster to fill, lookup and iterate over than #BLI_ghash_new_ex, and uses less memory.
+ *
+ * \warning Pointers to keys and values (#BLI_ghash_lookup_p, #BLI_ghash_ensure_p, ...)
+ * are only valid until the next insertion or removal.
+ */
+GHash *BLI_ghash_new_flat_ex(GHashHashFP hashfp,
+                             GHashCmpFP cmpfp,
+                             const char *info,
+                             const uint nentries_reserve)
+{
+  return ghash_new(hashfp, cmpfp, info, nentries_reserve, GHASH_FLAG_IS_FLAT);
+}
+
+/**
+ * Wraps #BLI_ghash_new_flat_ex with zero entries reserved.
+ */
+GHash *BLI_ghash_new_flat(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info)
+{
+  return BLI_ghash_new_flat_ex(hashfp, cmpfp, info, 0);
+}
+
 /**
  * Copy given GHash. Keys and values are also copied if relevant callback is provided,
  * else pointers remain the same.
@@ -738,6 +1205,10 @@ GHash *BLI_ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP valcop
  */
 void BLI_ghash_reserve(GHash *gh, const uint nentries_reserve)
 {
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    ghash_flat_reserve(gh, nentries_reserve);
+    return;
+  }
   ghash_buckets_expand(gh, nentries_reserve, true);
   ghash_buckets_contract(gh, nentries_reserve, true, false);
 }
@@ -784,9 +1255,7 @@ bool BLI_ghash_reinsert(
  */
 void *BLI_ghash_replace_key(GHash *gh, void *key)
 {
-  const uint hash = ghash_keyhash(gh, key);
-  const uint bucket_index = ghash_bucket_index(gh, hash);
-  GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
+  GHashEntry *e = (GHashEntry *)ghash_lookup_entry(gh, key);
   if (e != NULL) {
     void *key_prev = e->e.key;
     e->e.key = key;
@@ -857,6 +1326,15 @@ void **BLI_ghash_lookup_p(GHash *gh, const void *key)
 bool BLI_ghash_ensure_p(GHash *gh, void *key, void ***r_val)
 {
   const uint hash = ghash_keyhash(gh, key);
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    FlatSlot *slot = ghash_flat_lookup(gh, key, hash);
+    const bool haskey = (slot != NULL);
+    if (!haskey) {
+      slot = ghash_flat_insert(gh, key, hash);
+    }
+    *r_val = &slot->val;
+    return haskey;
+  }
   const uint bucket_index = ghash_bucket_index(gh, hash);
   GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
   const bool haskey = (e != NULL);
@@ -879,6 +1357,17 @@ bool BLI_ghash_ensure_p(GHash *gh, void *key, void ***r_val)
 bool BLI_ghash_ensure_p_ex(GHash *gh, const void *key, void ***r_key, void ***r_val)
 {
   const uint hash = ghash_keyhash(gh, key);
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    FlatSlot *slot = ghash_flat_lookup(gh, key, hash);
+    const bool haskey = (slot != NULL);
+    if (!haskey) {
+      slot = ghash_flat_insert(gh, (void *)key, hash);
+      slot->key = NULL; /* caller must re-assign */
+    }
+    *r_key = &slot->key;
+    *r_val = &slot->val;
+    return haskey;
+  }
   const uint bucket_index = ghash_bucket_index(gh, hash);
   GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
   const bool haskey = (e != NULL);
@@ -908,6 +1397,9 @@ bool BLI_ghash_remove(GHash *gh,
                       GHashKeyFreeFP keyfreefp,
                       GHashValFreeFP valfreefp)
 {
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    return ghash_flat_remove(gh, key, keyfreefp, valfreefp, NULL, NULL);
+  }
   const uint hash = ghash_keyhash(gh, key);
   const uint bucket_index = ghash_bucket_index(gh, hash);
   Entry *e = ghash_remove_ex(gh, key, keyfreefp, valfreefp, bucket_index);
@@ -931,6 +1423,12 @@ bool BLI_ghash_remove(GHash *gh,
  */
 void *BLI_ghash_popkey(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp)
 {
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    void *val = NULL;
+    BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+    ghash_flat_remove(gh, key, keyfreefp, NULL, NULL, &val);
+    return val;
+  }
   const uint hash = ghash_keyhash(gh, key);
   const uint bucket_index = ghash_bucket_index(gh, hash);
   GHashEntry *e = (GHashEntry *)ghash_remove_ex(gh, key, keyfreefp, NULL, bucket_index);
@@ -964,6 +1462,14 @@ bool BLI_ghash_haskey(GHash *gh, const void *key)
  */
 bool BLI_ghash_pop(GHash *gh, GHashIterState *state, void **r_key, void **r_val)
 {
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+    if (ghash_flat_pop(gh, state, r_key, r_val)) {
+      return true;
+    }
+    *r_key = *r_val = NULL;
+    return false;
+  }
   GHashEntry *e = (GHashEntry *)ghash_pop(gh, state);
 
   BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
@@ -997,6 +1503,11 @@ void BLI_ghash_clear_ex(GHash *gh,
     ghash_free_cb(gh, keyfreefp, valfreefp);
   }
 
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    ghash_flat_reset(gh, nentries_reserve);
+    return;
+  }
+
   ghash_buckets_reset(gh, nentries_reserve);
   BLI_mempool_clear_ex(gh->entrypool, nentries_reserve ? (int)nentries_reserve : -1);
 }
@@ -1018,13 +1529,19 @@ void BLI_ghash_clear(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfree
  */
 void BLI_ghash_free(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
-  BLI_assert((int)gh->nentries == BLI_mempool_len(gh->entrypool));
+  BLI_assert(!gh->entrypool || (int)gh->nentries == BLI_mempool_len(gh->entrypool));
   if (keyfreefp || valfreefp) {
     ghash_free_cb(gh, keyfreefp, valfreefp);
   }
 
-  MEM_freeN(gh->buckets);
-  BLI_mempool_destroy(gh->entrypool);
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    MEM_freeN(gh->ctrl);
+    MEM_freeN(gh->slots);
+  }
+  else {
+    MEM_freeN(gh->buckets);
+    BLI_mempool_destroy(gh->entrypool);
+  }
   MEM_freeN(gh);
 }
 
@@ -1078,6 +1595,13 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
   ghi->gh = gh;
   ghi->curEntry = NULL;
   ghi->curBucket = UINT_MAX; /* wraps to zero */
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    ghi->curBucket = ghash_flat_find_next_full(gh, 0);
+    if (ghi->curBucket != gh->nbuckets) {
+      ghi->curEntry = (Entry *)ghash_flat_slot(gh, ghi->curBucket);
+    }
+    return;
+  }
   if (gh->nentries) {
     do {
       ghi->curBucket++;
@@ -1096,6 +1620,15 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
  */
 void BLI_ghashIterator_step(GHashIterator *ghi)
 {
+  if (ghi->gh->flag & GHASH_FLAG_IS_FLAT) {
+    if (ghi->curEntry) {
+      ghi->curBucket = ghash_flat_find_next_full(ghi->gh, ghi->curBucket + 1);
+      ghi->curEntry = (ghi->curBucket != ghi->gh->nbuckets) ?
+                          (Entry *)ghash_flat_slot(ghi->gh, ghi->curBucket) :
+                          NULL;
+    }
+    return;
+  }
   if (ghi->curEntry) {
     ghi->curEntry = ghi->curEntry->next;
     while (!ghi->curEntry) {
@@ -1138,6 +1671,23 @@ GSet *BLI_gset_new(GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info)
   return BLI_gset_new_ex(hashfp, cmpfp, info, 0);
 }
 
+/**
+ * Set counterpart to #BLI_ghash_new_flat_ex, same restrictions on key pointers apply.
+ */
+GSet *BLI_gset_new_flat_ex(GSetHashFP hashfp,
+                           GSetCmpFP cmpfp,
+                           const char *info,
+                           const uint nentries_reserve)
+{
+  return (GSet *)ghash_new(
+      hashfp, cmpfp, info, nentries_reserve, GHASH_FLAG_IS_GSET | GHASH_FLAG_IS_FLAT);
+}
+
+GSet *BLI_gset_new_flat(GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info)
+{
+  return BLI_gset_new_flat_ex(hashfp, cmpfp, info, 0);
+}
+
 /**
  * Copy given GSet. Keys are also copied if callback is provided, else pointers remain the same.
  */
@@ -1158,6 +1708,10 @@ uint BLI_gset_len(GSet *gs)
 void BLI_gset_insert(GSet *gs, void *key)
 {
   const uint hash = ghash_keyhash((GHash *)gs, key);
+  if (((GHash *)gs)->flag & GHASH_FLAG_IS_FLAT) {
+    ghash_flat_insert((GHash *)gs, key, hash);
+    return;
+  }
   const uint bucket_index = ghash_bucket_index((GHash *)gs, hash);
   ghash_insert_ex_keyonly((GHash *)gs, key, bucket_index);
 }
@@ -1182,6 +1736,16 @@ bool BLI_gset_add(GSet *gs, void *key)
 bool BLI_gset_ensure_p_ex(GSet *gs, const void *key, void ***r_key)
 {
   const uint hash = ghash_keyhash((GHash *)gs, key);
+  if (((GHash *)gs)->flag & GHASH_FLAG_IS_FLAT) {
+    FlatSlot *slot = ghash_flat_lookup((GHash *)gs, key, hash);
+    const bool haskey = (slot != NULL);
+    if (!haskey) {
+      slot = ghash_flat_insert((GHash *)gs, (void *)key, hash);
+      slot->key = NULL; /* caller must re-assign */
+    }
+    *r_key = &slot->key;
+    return haskey;
+  }
   const uint bucket_index = ghash_bucket_index((GHash *)gs, hash);
   GSetEntry *e = (GSetEntry *)ghash_lookup_entry_ex((GHash *)gs, key, bucket_index);
   const bool haskey = (e != NULL);
@@ -1238,6 +1802,13 @@ bool BLI_gset_haskey(GSet *gs, const void *key)
  */
 bool BLI_gset_pop(GSet *gs, GSetIterState *state, void **r_key)
 {
+  if (((GHash *)gs)->flag & GHASH_FLAG_IS_FLAT) {
+    if (ghash_flat_pop((GHash *)gs, (GHashIterState *)state, r_key, NULL)) {
+      return true;
+    }
+    *r_key = NULL;
+    return false;
+  }
   GSetEntry *e = (GSetEntry *)ghash_pop((GHash *)gs, (GHashIterState *)state);
 
   if (e) {
@@ -1301,6 +1872,11 @@ void *BLI_gset_lookup(GSet *gs, const void *key)
  */
 void *BLI_gset_pop_key(GSet *gs, const void *key)
 {
+  if (((GHash *)gs)->flag & GHASH_FLAG_IS_FLAT) {
+    void *key_ret = NULL;
+    ghash_flat_remove((GHash *)gs, key, NULL, NULL, &key_ret, NULL);
+    return key_ret;
+  }
   const uint hash = ghash_keyhash((GHash *)gs, key);
   const uint bucket_index = ghash_bucket_index((GHash *)gs, hash);
   Entry *e = ghash_remove_ex((GHash *)gs, key, NULL, NULL, bucket_index);
@@ -1334,6 +1910,59 @@ int BLI_gset_buckets_len(GSet *gs)
   return BLI_ghash_buckets_len((GHash *)gs);
 }
 
+/**
+ * Flat storage has no buckets, stats are about the number of groups probed to find each entry.
+ * The returned quality is the average of that number (1.0 is best).
+ */
+static double ghash_flat_calc_quality_ex(GHash *gh,
+                                         double *r_load,
+                                         double *r_variance,
+                                         double *r_prop_empty_buckets,
+                                         double *r_prop_overloaded_buckets,
+                                         int *r_biggest_bucket)
+{
+  /* Empty tables are handled by the caller. */
+  BLI_assert(gh->nentries != 0);
+
+  uint64_t sum = 0, sum_sq = 0, sum_overloaded = 0;
+  uint probe_max = 0;
+
+  for (uint i = 0; i < gh->nbuckets; i++) {
+    if (!GHASH_FLAT_CTRL_IS_FULL(gh->ctrl[i])) {
+      continue;
+    }
+    const FlatSlot *slot = ghash_flat_slot(gh, i);
+    uchar ctrl;
+    uint group = ghash_flat_hash_split((uint)slot->hash, &ctrl) & gh->group_mask;
+    uint probe = 1;
+    while (group != i / GHASH_FLAT_GROUP_SIZE) {
+      group = ghash_flat_group_next(gh, group, probe++);
+    }
+    sum += probe;
+    sum_sq += (uint64_t)probe * probe;
+    sum_overloaded += (probe > 1);
+    probe_max = MAX2(probe_max, probe);
+  }
+
+  const double mean = (double)sum / (double)gh->nentries;
+  if (r_load) {
+    *r_load = (double)gh->nentries / (double)gh->nbuckets;
+  }
+  if (r_variance) {
+    *r_variance = (double)sum_sq / (double)gh->nentries - mean * mean;
+  }
+  if (r_prop_empty_buckets) {
+    *r_prop_empty_buckets = (double)(gh->nbuckets - gh->nentries) / (double)gh->nbuckets;
+  }
+  if (r_prop_overloaded_buckets) {
+    *r_prop_overloaded_buckets = (double)sum_overloaded / (double)gh->nentries;
+  }
+  if (r_biggest_bucket) {
+    *r_biggest_bucket = (int)probe_max;
+  }
+  return mean;
+}
+
 /**
  * Measure how well the hash function performs (1.0 is approx as good as random distribution),
  * and return a few other stats like load,
@@ -1371,6 +2000,11 @@ double BLI_ghash_calc_quality_ex(GHash *gh,
     return 0.0;
   }
 
+  if (gh->flag & GHASH_FLAG_IS_FLAT) {
+    return ghash_flat_calc_quality_ex(
+        gh, r_load, r_variance, r_prop_empty_buckets, r_prop_overloaded_buckets, r_biggest_bucket);
+  }
+
   mean = (double)gh->nentries / (double)gh->nbuckets;
   if (r_load) {
     *r_load = mean;
@@ -30,8 +30,10 @@
  *
  * - Ray-cast:
  *   #BLI_bvhtree_ray_cast, #BVHRayCastData
+ * - Batched ray-cast (packets of rays):
+ *   #BLI_bvhtree_ray_cast_batch, #BVHRayPacket
  * - Nearest point on surface:
- *   #BLI_bvhtree_find_nearest, #BVHNearestData
+ *   #BLI_bvhtree_find_nearest, #BLI_bvhtree_find_nearest_batch, #BVHNearestData
  * - Overlapping 2 trees:
  *   #BLI_bvhtree_overlap, #BVHOverlapData_Shared, #BVHOverlapData_Thread
  * - Range Query:
@@ -46,6 +48,7 @@
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_math_bits.h"
 #include "BLI_stack.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
@@ -72,6 +75,10 @@
 #  define KDOPBVH_THREAD_LEAF_THRESHOLD 1024
 #endif
 
+/* Number of rays traversing the tree together in #BLI_bvhtree_ray_cast_batch,
+ * must fit in the bits of an int. */
+#define BVH_RAY_PACKET_SIZE 8
+
 /* -------------------------------------------------------------------- */
 /** \name Struct Definitions
  * \{ */
@@ -134,6 +141,8 @@ typedef struct BVHNearestData {
   void *userdata;
   float proj[13]; /* coordinates projection over axis */
   BVHTreeNearest nearest;
+  /* Leaf of the nearest result, only used by #BLI_bvhtree_find_nearest_batch. */
+  const BVHNode *nearest_leaf;
 
 } BVHNearestData;
 
@@ -1427,6 +1436,9 @@ static void dfs_find_nearest_dfs(BVHNearestData *data, BVHNode *node)
       data->nearest.index = node->index;
       data->nearest.dist_sq = calc_nearest_point_squared(data->proj, node, data->nearest.co);
     }
+    if (data->nearest.index == node->index) {
+      data->nearest_leaf = node;
+    }
   }
   else {
     /* Better heuristic to pick the closest node to dive on */
@@ -1476,6 +1488,9 @@ static void heap_find_nearest_inner(BVHNearestData *data, HeapSimple *heap, BVHN
       data->nearest.index = node->index;
       data->nearest.dist_sq = calc_nearest_point_squared(data->proj, node, data->nearest.co);
     }
+    if (data->nearest.index == node->index) {
+      data->nearest_leaf = node;
+    }
   }
   else {
     float nearest[3];
@@ -1510,46 +1525,61 @@ static void heap_find_nearest_begin(BVHNearestData *data, BVHNode *root)
   }
 }
 
-int BLI_bvhtree_find_nearest_ex(BVHTree *tree,
-                                const float co[3],
-                                BVHTreeNearest *nearest,
-                                BVHTree_NearestPointCallback callback,
-                                void *userdata,
-                                int flag)
+static void bvhtree_find_nearest_data_init(BVHNearestData *data,
+                                           const BVHTree *tree,
+                                           const float co[3],
+                                           const BVHTreeNearest *nearest,
+                                           BVHTree_NearestPointCallback callback,
+                                           void *userdata)
 {
   axis_t axis_iter;
 
-  BVHNearestData data;
-  BVHNode *root = tree->nodes[tree->totleaf];
-
   /* init data to search */
-  data.tree = tree;
-  data.co = co;
+  data->tree = tree;
+  data->co = co;
 
-  data.callback = callback;
-  data.userdata = userdata;
+  data->callback = callback;
+  data->userdata = userdata;
 
-  for (axis_iter = data.tree->start_axis; axis_iter != data.tree->stop_axis; axis_iter++) {
-    data.proj[axis_iter] = dot_v3v3(data.co, bvhtree_kdop_axes[axis_iter]);
+  for (axis_iter = data->tree->start_axis; axis_iter != data->tree->stop_axis; axis_iter++) {
+    data->proj[axis_iter] = dot_v3v3(data->co, bvhtree_kdop_axes[axis_iter]);
   }
 
   if (nearest) {
-    memcpy(&data.nearest, nearest, sizeof(*nearest));
+    memcpy(&data->nearest, nearest, sizeof(*nearest));
   }
   else {
-    data.nearest.index = -1;
-    data.nearest.dist_sq = FLT_MAX;
+    data->nearest.index = -1;
+    data->nearest.dist_sq = FLT_MAX;
   }
+  data->nearest_leaf = NULL;
+}
 
+static void bvhtree_find_nearest_search(BVHNearestData *data, BVHNode *root, int flag)
+{
   /* dfs search */
   if (root) {
     if (flag & BVH_NEAREST_OPTIMAL_ORDER) {
-      heap_find_nearest_begin(&data, root);
+      heap_find_nearest_begin(data, root);
     }
     else {
-      dfs_find_nearest_begin(&data, root);
+      dfs_find_nearest_begin(data, root);
     }
   }
+}
+
+int BLI_bvhtree_find_nearest_ex(BVHTree *tree,
+                                const float co[3],
+                                BVHTreeNearest *nearest,
+                                BVHTree_NearestPointCallback callback,
+                                void *userdata,
+                                int flag)
+{
+  BVHNearestData data;
+  BVHNode *root = tree->nodes[tree->totleaf];
+
+  bvhtree_find_nearest_data_init(&data, tree, co, nearest, callback, userdata);
+  bvhtree_find_nearest_search(&data, root, flag);
 
   /* copy back results */
   if (nearest) {
@@ -1568,6 +1598,100 @@ int BLI_bvhtree_find_nearest(BVHTree *tree,
   return BLI_bvhtree_find_nearest_ex(tree, co, nearest, callback, userdata, 0);
 }
 
+typedef struct BVHNearestBatchData {
+  BVHTree *tree;
+  const float (*co)[3];
+  BVHTreeNearest *r_nearest;
+  BVHTree_NearestPointCallback callback;
+  void *userdata;
+  int flag;
+} BVHNearestBatchData;
+
+typedef struct BVHNearestBatchTLS {
+  /* Leaf nearest to the previous coordinate searched by this thread. */
+  const BVHNode *nearest_leaf_prev;
+} BVHNearestBatchTLS;
+
+static void bvhtree_find_nearest_batch_cb(void *__restrict userdata,
+                                          const int i,
+                                          const TaskParallelTLS *__restrict tls)
+{
+  const BVHNearestBatchData *batch_data = userdata;
+  BVHNearestBatchTLS *batch_tls = tls->userdata_chunk;
+  BVHTreeNearest *nearest = &batch_data->r_nearest[i];
+  BVHNode *root = batch_data->tree->nodes[batch_data->tree->totleaf];
+
+  BVHNearestData data;
+  bvhtree_find_nearest_data_init(&data,
+                                 batch_data->tree,
+                                 batch_data->co[i],
+                                 nearest,
+                                 batch_data->callback,
+                                 batch_data->userdata);
+
+  /* Consecutive coordinates are usually close to each other, the leaf nearest to the previous
+   * coordinate gives a small search distance to start with, culling most of the tree. */
+  const BVHNode *leaf_prev = batch_tls->nearest_leaf_prev;
+  if (leaf_prev) {
+    if (data.callback) {
+      data.callback(data.userdata, leaf_prev->index, data.co, &data.nearest);
+    }
+    else {
+      float co_leaf[3];
+      const float dist_sq = calc_nearest_point_squared(data.proj, (BVHNode *)leaf_prev, co_leaf);
+      if (dist_sq < data.nearest.dist_sq) {
+        data.nearest.index = leaf_prev->index;
+        data.nearest.dist_sq = dist_sq;
+        copy_v3_v3(data.nearest.co, co_leaf);
+      }
+    }
+    if (data.nearest.index == leaf_prev->index) {
+      data.nearest_leaf = leaf_prev;
+    }
+  }
+
+  bvhtree_find_nearest_search(&data, root, batch_data->flag);
+
+  if (data.nearest_leaf) {
+    batch_tls->nearest_leaf_prev = data.nearest_leaf;
+  }
+  memcpy(nearest, &data.nearest, sizeof(*nearest));
+}
+
+/**
+ * Find the nearest node of every coordinate in \a co, using multiple threads.
+ * Consecutive coordinates which are close to each other are found faster.
+ *
+ * \param r_nearest: An array of \a co_num nearest, initialized by the caller like the nearest
+ * passed to #BLI_bvhtree_find_nearest_ex.
+ * \param callback: Called from multiple threads at once.
+ */
+void BLI_bvhtree_find_nearest_batch(BVHTree *tree,
+                                    const float (*co)[3],
+                                    const int co_num,
+                                    BVHTreeNearest *r_nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata,
+                                    int flag)
+{
+  BVHNearestBatchData data = {
+      .tree = tree,
+      .co = co,
+      .r_nearest = r_nearest,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+  BVHNearestBatchTLS tls = {NULL};
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 256;
+  settings.userdata_chunk = &tls;
+  settings.userdata_chunk_size = sizeof(tls);
+  BLI_task_parallel_range(0, co_num, &data, bvhtree_find_nearest_batch_cb, &settings);
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -1989,6 +2113,248 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch
+ *
+ * Rays are cast in packets of #BVH_RAY_PACKET_SIZE, which traverse the tree together: every node
+ * is loaded once for all rays of the packet, and tested against all of them at once. This works
+ * best when rays of a packet are coherent, e.g. cast from neighbor vertices.
+ *
+ * \{ */
+
+typedef struct BVHRayPacket {
+  const BVHTree *tree;
+
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+
+  int rays_num;
+  BVHTreeRay ray[BVH_RAY_PACKET_SIZE];
+  BVHTreeRayHit *hit[BVH_RAY_PACKET_SIZE];
+
+#ifdef USE_KDOPBVH_WATERTIGHT
+  struct IsectRayPrecalc isect_precalc[BVH_RAY_PACKET_SIZE];
+#endif
+
+  /* Rays as a structure of arrays, so the node tests can be vectorized. */
+  float origin[3][BVH_RAY_PACKET_SIZE];
+  float idot_axis[3][BVH_RAY_PACKET_SIZE];
+  float ray_dot_axis[3][BVH_RAY_PACKET_SIZE];
+  float hit_dist[BVH_RAY_PACKET_SIZE];
+} BVHRayPacket;
+
+/**
+ * Same test as #fast_ray_nearest_hit for all rays of the packet.
+ * \return the mask of rays in \a ray_mask hitting the node closer than their current hit.
+ */
+static int ray_packet_nearest_hit(const BVHRayPacket *packet,
+                                  const BVHNode *node,
+                                  const int ray_mask,
+                                  float r_dist[BVH_RAY_PACKET_SIZE])
+{
+  const float *bv = node->bv;
+  float t_far[BVH_RAY_PACKET_SIZE];
+  int hit_mask = 0;
+
+  for (int i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+    r_dist[i] = -FLT_MAX;
+    t_far[i] = FLT_MAX;
+  }
+
+  /* Loop over the rays last, so the compiler can vectorize it. */
+  for (int axis = 0; axis < 3; axis++) {
+    const float bv_min = bv[axis * 2], bv_max = bv[axis * 2 + 1];
+    const float *origin = packet->origin[axis];
+    const float *idot_axis = packet->idot_axis[axis];
+    for (int i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+      const float t1 = (bv_min - origin[i]) * idot_axis[i];
+      const float t2 = (bv_max - origin[i]) * idot_axis[i];
+      r_dist[i] = max_ff(r_dist[i], min_ff(t1, t2));
+      t_far[i] = min_ff(t_far[i], max_ff(t1, t2));
+    }
+  }
+
+  for (int i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+    hit_mask |= ((r_dist[i] <= t_far[i]) && (t_far[i] >= 0.0f) &&
+                 (r_dist[i] < packet->hit_dist[i]))
+                << i;
+  }
+
+  return hit_mask & ray_mask;
+}
+
+static void dfs_raycast_packet(BVHRayPacket *packet, const BVHNode *node, int ray_mask)
+{
+  float dist[BVH_RAY_PACKET_SIZE];
+  ray_mask = ray_packet_nearest_hit(packet, node, ray_mask, dist);
+  if (ray_mask == 0) {
+    return;
+  }
+
+  if (node->totnode == 0) {
+    for (int i = 0; i < packet->rays_num; i++) {
+      if ((ray_mask & (1 << i)) == 0) {
+        continue;
+      }
+      BVHTreeRayHit *hit = packet->hit[i];
+      if (packet->callback) {
+        packet->callback(packet->userdata, node->index, &packet->ray[i], hit);
+      }
+      else {
+        hit->index = node->index;
+        hit->dist = dist[i];
+        madd_v3_v3v3fl(hit->co, packet->ray[i].origin, packet->ray[i].direction, dist[i]);
+      }
+      packet->hit_dist[i] = hit->dist;
+    }
+  }
+  else {
+    /* pick loop direction to dive into the tree (based on the direction of the first ray and
+     * split axis) */
+    const int ray_first = bitscan_forward_i(ray_mask);
+    if (node->main_axis < 3 && packet->ray_dot_axis[node->main_axis][ray_first] <= 0.0f) {
+      for (int i = node->totnode - 1; i >= 0; i--) {
+        dfs_raycast_packet(packet, node->children[i], ray_mask);
+      }
+    }
+    else {
+      for (int i = 0; i != node->totnode; i++) {
+        dfs_raycast_packet(packet, node->children[i], ray_mask);
+      }
+    }
+  }
+}
+
+typedef struct BVHRayCastBatchData {
+  BVHTree *tree;
+  const float (*co)[3];
+  const float (*dir)[3];
+  int rays_num;
+  float radius;
+  BVHTreeRayHit *r_hits;
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+  int flag;
+} BVHRayCastBatchData;
+
+static void bvhtree_ray_cast_batch_cb(void *__restrict userdata,
+                                      const int packet_index,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *batch_data = userdata;
+  const int ray_start = packet_index * BVH_RAY_PACKET_SIZE;
+  BVHNode *root = batch_data->tree->nodes[batch_data->tree->totleaf];
+
+  if (batch_data->radius != 0.0f) {
+    /* The packet test doesn't support a radius (like #fast_ray_nearest_hit). */
+    for (int i = ray_start; i < min_ii(ray_start + BVH_RAY_PACKET_SIZE, batch_data->rays_num);
+         i++) {
+      BLI_bvhtree_ray_cast_ex(batch_data->tree,
+                              batch_data->co[i],
+                              batch_data->dir[i],
+                              batch_data->radius,
+                              &batch_data->r_hits[i],
+                              batch_data->callback,
+                              batch_data->userdata,
+                              batch_data->flag);
+    }
+    return;
+  }
+
+  BVHRayPacket packet;
+  packet.tree = batch_data->tree;
+  packet.callback = batch_data->callback;
+  packet.userdata = batch_data->userdata;
+  packet.rays_num = min_ii(BVH_RAY_PACKET_SIZE, batch_data->rays_num - ray_start);
+
+  for (int i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+    /* Unused rays of the last packet copy the last ray, they are masked out. */
+    const int ray_index = ray_start + min_ii(i, packet.rays_num - 1);
+    BVHTreeRay *ray = &packet.ray[i];
+
+    BLI_ASSERT_UNIT_V3(batch_data->dir[ray_index]);
+    copy_v3_v3(ray->origin, batch_data->co[ray_index]);
+    copy_v3_v3(ray->direction, batch_data->dir[ray_index]);
+    ray->radius = 0.0f;
+
+    for (int axis = 0; axis < 3; axis++) {
+      /* Same as #bvhtree_ray_cast_data_precalc. */
+      float ray_dot_axis = dot_v3v3(ray->direction, bvhtree_kdop_axes[axis]);
+      float idot_axis;
+      if (fabsf(ray_dot_axis) < FLT_EPSILON) {
+        ray_dot_axis = 0.0f;
+        idot_axis = FLT_MAX;
+      }
+      else {
+        idot_axis = 1.0f / ray_dot_axis;
+      }
+      packet.origin[axis][i] = ray->origin[axis];
+      packet.ray_dot_axis[axis][i] = ray_dot_axis;
+      packet.idot_axis[axis][i] = idot_axis;
+    }
+
+#ifdef USE_KDOPBVH_WATERTIGHT
+    if (batch_data->flag & BVH_RAYCAST_WATERTIGHT) {
+      isect_ray_tri_watertight_v3_precalc(&packet.isect_precalc[i], ray->direction);
+      ray->isect_precalc = &packet.isect_precalc[i];
+    }
+    else {
+      ray->isect_precalc = NULL;
+    }
+#endif
+
+    packet.hit[i] = &batch_data->r_hits[ray_index];
+    packet.hit_dist[i] = packet.hit[i]->dist;
+  }
+
+  if (root) {
+    dfs_raycast_packet(&packet, root, (1 << packet.rays_num) - 1);
+  }
+}
+
+/**
+ * Cast all rays in \a co and \a dir, using multiple threads.
+ * Hits are the same as with #BLI_bvhtree_ray_cast_ex for each ray,
+ * except for the order in which the callback is called for nodes at the same distance.
+ *
+ * \param r_hits: An array of \a rays_num hits, initialized by the caller like the hit passed to
+ * #BLI_bvhtree_ray_cast_ex (the index is untouched when there is no hit).
+ * \param callback: Called from multiple threads at once.
+ */
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_num,
+                                float radius,
+                                BVHTreeRayHit *r_hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag)
+{
+  BVHRayCastBatchData data = {
+      .tree = tree,
+      .co = co,
+      .dir = dir,
+      .rays_num = rays_num,
+      .radius = radius,
+      .r_hits = r_hits,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 32;
+  BLI_task_parallel_range(0,
+                          (rays_num + BVH_RAY_PACKET_SIZE - 1) / BVH_RAY_PACKET_SIZE,
+                          &data,
+                          bvhtree_ray_cast_batch_cb,
+                          &settings);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
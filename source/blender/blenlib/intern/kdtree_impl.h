@@ -22,6 +22,7 @@
 
 #include "BLI_kdtree_impl.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_strict_flags.h"
 #include "BLI_utildefines.h"
 
@@ -64,6 +65,9 @@ struct KDTree {
  */
 #define KD_NODE_ROOT_IS_INIT ((uint)-2)
 
+/* Balance sub-trees with more nodes than this in their own task. */
+#define KD_BALANCE_TASK_NODES_MIN 8192
+
 /* -------------------------------------------------------------------- */
 /** \name Local Math API
  * \{ */
@@ -145,7 +149,52 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+/* -------------------------------------------------------------------- */
+/** \name Balance
+ *
+ * Nodes are partitioned around the median recursively, large sub-trees are balanced in parallel
+ * since they don't overlap. Afterwards nodes are laid out breadth first.
+ * \{ */
+
+typedef struct KDTreeBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+} KDTreeBalanceTask;
+
+static uint kdtree_balance(TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, uint ofs);
+
+static void kdtree_balance_task(TaskPool *__restrict pool, void *taskdata)
+{
+  const KDTreeBalanceTask *task = taskdata;
+  kdtree_balance(pool, task->nodes, task->nodes_len, task->axis, task->ofs);
+}
+
+/**
+ * Balance a sub-tree, in a new task when it's large enough.
+ * \return the root of the sub-tree, known before it's balanced.
+ */
+static uint kdtree_balance_subtree(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  if (pool == NULL || nodes_len < KD_BALANCE_TASK_NODES_MIN) {
+    return kdtree_balance(pool, nodes, nodes_len, axis, ofs);
+  }
+
+  KDTreeBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+  task->nodes = nodes;
+  task->nodes_len = nodes_len;
+  task->axis = axis;
+  task->ofs = ofs;
+  BLI_task_pool_push(pool, kdtree_balance_task, task, true, NULL);
+
+  /* Matches the median used by #kdtree_balance. */
+  return (nodes_len / 2) + ofs;
+}
+
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
 {
   KDTreeNode *node;
   float co;
@@ -194,13 +243,48 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   node = &nodes[median];
   node->d = axis;
   axis = (axis + 1) % KD_DIMS;
-  node->left = kdtree_balance(nodes, median, axis, ofs);
+  node->left = kdtree_balance_subtree(pool, nodes, median, axis, ofs);
   node->right = kdtree_balance(
-      nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+      pool, nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
 
   return median + ofs;
 }
 
+/**
+ * Reorder nodes breadth first (Eytzinger layout). The upper levels of the tree, which all queries
+ * visit, are packed at the start of the array and both children of a node are next to each other.
+ *
+ * \return the new root.
+ */
+static uint kdtree_layout_breadth_first(KDTreeNode *nodes, const uint nodes_len, const uint root)
+{
+  if (nodes_len == 0) {
+    return root;
+  }
+
+  KDTreeNode *nodes_src = MEM_mallocN(sizeof(*nodes_src) * nodes_len, __func__);
+  memcpy(nodes_src, nodes, sizeof(*nodes_src) * nodes_len);
+
+  /* The nodes already added are the queue of nodes to add the children of. */
+  nodes[0] = nodes_src[root];
+  uint nodes_added = 1;
+  for (uint i = 0; i < nodes_len; i++) {
+    KDTreeNode *node = &nodes[i];
+    if (node->left != KD_NODE_UNSET) {
+      nodes[nodes_added] = nodes_src[node->left];
+      node->left = nodes_added++;
+    }
+    if (node->right != KD_NODE_UNSET) {
+      nodes[nodes_added] = nodes_src[node->right];
+      node->right = nodes_added++;
+    }
+  }
+  BLI_assert(nodes_added == nodes_len);
+
+  MEM_freeN(nodes_src);
+  return 0;
+}
+
 void BLI_kdtree_nd_(balance)(KDTree *tree)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
@@ -210,13 +294,25 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (tree->nodes_len >= KD_BALANCE_TASK_NODES_MIN * 2) {
+    TaskPool *pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+    tree->root = kdtree_balance(pool, tree->nodes, tree->nodes_len, 0, 0);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+  else {
+    tree->root = kdtree_balance(NULL, tree->nodes, tree->nodes_len, 0, 0);
+  }
+
+  tree->root = kdtree_layout_breadth_first(tree->nodes, tree->nodes_len, tree->root);
 
 #ifdef DEBUG
   tree->is_balanced = true;
 #endif
 }
 
+/** \} */
+
 static uint *realloc_nodes(uint *stack, uint *stack_len_capacity, const bool is_alloc)
 {
   uint *stack_new = MEM_mallocN((*stack_len_capacity + KD_NEAR_ALLOC_INC) * sizeof(uint),
@@ -238,10 +334,18 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
                                  KDTreeNearest *r_nearest)
 {
   const KDTreeNode *nodes = tree->nodes;
-  const KDTreeNode *root, *min_node;
-  uint *stack, stack_default[KD_STACK_INIT];
-  float min_dist, cur_dist;
-  uint stack_len_capacity, cur = 0;
+  const KDTreeNode *min_node = NULL;
+  float min_dist = FLT_MAX;
+
+  /* Sub-trees on the far side of a split plane, checked once the near side has been searched.
+   * Every node descended into is deeper than the ones left on the stack, so it's never larger
+   * than the depth of the (balanced) tree. */
+  struct {
+    uint node_index;
+    /* Squared distance to the split plane, a lower bound for the distance to the sub-tree. */
+    float dist_sq;
+  } stack[sizeof(uint) * 8];
+  uint cur = 0;
 
 #ifdef DEBUG
   BLI_assert(tree->is_balanced == true);
@@ -251,72 +355,45 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
     return -1;
   }
 
-  stack = stack_default;
-  stack_len_capacity = KD_STACK_INIT;
-
-  root = &nodes[tree->root];
-  min_node = root;
-  min_dist = len_squared_vnvn(root->co, co);
-
-  if (co[root->d] < root->co[root->d]) {
-    if (root->right != KD_NODE_UNSET) {
-      stack[cur++] = root->right;
-    }
-    if (root->left != KD_NODE_UNSET) {
-      stack[cur++] = root->left;
-    }
-  }
-  else {
-    if (root->left != KD_NODE_UNSET) {
-      stack[cur++] = root->left;
-    }
-    if (root->right != KD_NODE_UNSET) {
-      stack[cur++] = root->right;
-    }
-  }
+  stack[cur].node_index = tree->root;
+  stack[cur].dist_sq = 0.0f;
+  cur++;
 
   while (cur--) {
-    const KDTreeNode *node = &nodes[stack[cur]];
+    if (stack[cur].dist_sq >= min_dist) {
+      continue;
+    }
 
-    cur_dist = node->co[node->d] - co[node->d];
+    uint node_index = stack[cur].node_index;
+    do {
+      const KDTreeNode *node = &nodes[node_index];
 
-    if (cur_dist < 0.0f) {
-      cur_dist = -cur_dist * cur_dist;
+      const float dist_sq = len_squared_vnvn(node->co, co);
+      if (dist_sq < min_dist) {
+        min_dist = dist_sq;
+        min_node = node;
+      }
 
-      if (-cur_dist < min_dist) {
-        cur_dist = len_squared_vnvn(node->co, co);
-        if (cur_dist < min_dist) {
-          min_dist = cur_dist;
-          min_node = node;
-        }
-        if (node->left != KD_NODE_UNSET) {
-          stack[cur++] = node->left;
-        }
+      /* Descend into the near side, search the far side later. */
+      const float plane_dist = co[node->d] - node->co[node->d];
+      const float plane_dist_sq = plane_dist * plane_dist;
+      uint node_far;
+      if (plane_dist < 0.0f) {
+        node_index = node->left;
+        node_far = node->right;
       }
-      if (node->right != KD_NODE_UNSET) {
-        stack[cur++] = node->right;
+      else {
+        node_index = node->right;
+        node_far = node->left;
       }
-    }
-    else {
-      cur_dist = cur_dist * cur_dist;
 
-      if (cur_dist < min_dist) {
-        cur_dist = len_squared_vnvn(node->co, co);
-        if (cur_dist < min_dist) {
-          min_dist = cur_dist;
-          min_node = node;
-        }
-        if (node->right != KD_NODE_UNSET) {
-          stack[cur++] = node->right;
-        }
+      if (node_far != KD_NODE_UNSET && plane_dist_sq < min_dist) {
+        BLI_assert(cur < ARRAY_SIZE(stack));
+        stack[cur].node_index = node_far;
+        stack[cur].dist_sq = plane_dist_sq;
+        cur++;
       }
-      if (node->left != KD_NODE_UNSET) {
-        stack[cur++] = node->left;
-      }
-    }
-    if (UNLIKELY(cur + KD_DIMS > stack_len_capacity)) {
-      stack = realloc_nodes(stack, &stack_len_capacity, stack_default != stack);
-    }
+    } while (node_index != KD_NODE_UNSET);
   }
 
   if (r_nearest) {
@@ -325,11 +402,45 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
     copy_vn_vn(r_nearest->co, min_node->co);
   }
 
-  if (stack != stack_default) {
-    MEM_freeN(stack);
+  return min_node->index;
+}
+
+typedef struct KDTreeFindNearestBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  KDTreeNearest *r_nearest;
+} KDTreeFindNearestBatchData;
+
+static void kdtree_find_nearest_batch_cb(void *__restrict userdata,
+                                         const int i,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeFindNearestBatchData *data = userdata;
+  if (BLI_kdtree_nd_(find_nearest)(data->tree, data->co[i], &data->r_nearest[i]) == -1) {
+    data->r_nearest[i].index = -1;
   }
+}
 
-  return min_node->index;
+/**
+ * Find the nearest node of every coordinate in \a co, using multiple threads.
+ *
+ * \param r_nearest: An array of \a co_len nearest, the index is -1 when the tree is empty.
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        KDTreeNearest *r_nearest)
+{
+  KDTreeFindNearestBatchData data = {
+      .tree = tree,
+      .co = co,
+      .r_nearest = r_nearest,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 256;
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_find_nearest_batch_cb, &settings);
 }
 
 /**
@@ -820,6 +931,34 @@ static uint *kdtree_order(const KDTree *tree)
   return order;
 }
 
+/**
+ * Use when we want to loop over nodes in the order of their coordinates on the split axes
+ * (an in-order traversal), which doesn't depend on the memory layout of the tree.
+ */
+static uint *kdtree_order_in_order(const KDTree *tree)
+{
+  const KDTreeNode *nodes = tree->nodes;
+  uint *order = MEM_mallocN(sizeof(uint) * tree->nodes_len, __func__);
+  /* The tree is balanced, its depth is less than the bits in #uint. */
+  uint stack[sizeof(uint) * 8];
+  uint order_len = 0, cur = 0;
+  uint node_index = tree->root;
+
+  while (cur || node_index != KD_NODE_UNSET) {
+    while (node_index != KD_NODE_UNSET) {
+      BLI_assert(cur < ARRAY_SIZE(stack));
+      stack[cur++] = node_index;
+      node_index = nodes[node_index].left;
+    }
+    node_index = stack[--cur];
+    order[order_len++] = node_index;
+    node_index = nodes[node_index].right;
+  }
+  BLI_assert(order_len == tree->nodes_len);
+
+  return order;
+}
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_kdtree_3d_calc_duplicates_fast
  * \{ */
@@ -917,8 +1056,9 @@ int BLI_kdtree_nd_(calc_duplicates_fast)(const KDTree *tree,
     MEM_freeN(order);
   }
   else {
+    uint *order = kdtree_order_in_order(tree);
     for (uint i = 0; i < tree->nodes_len; i++) {
-      const uint node_index = i;
+      const uint node_index = order[i];
       const int index = p.nodes[node_index].index;
       if (ELEM(duplicates[index], -1, index)) {
         p.search = index;
@@ -931,6 +1071,7 @@ int BLI_kdtree_nd_(calc_duplicates_fast)(const KDTree *tree,
         }
       }
     }
+    MEM_freeN(order);
   }
   return found;
 }
@@ -0,0 +1,164 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ *
+ * Task graph, running tasks once all the tasks they depend on are done.
+ */
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_task.h"
+#include "BLI_vector.hh"
+
+#include "atomic_ops.h"
+
+/* Task Node
+ *
+ * Nodes count how many of their predecessors still have to run, the last predecessor to finish
+ * schedules the node. The counter is reset when the node runs, so a graph can run again. */
+
+struct TaskNode {
+  TaskGraph *task_graph;
+  TaskGraphNodeRunFunction run_func;
+  void *task_data;
+  TaskGraphNodeFreeFunction free_func;
+
+  BLI::Vector<TaskNode *> successors;
+  /** Number of nodes this node depends on. */
+  int num_predecessors = 0;
+  /** Number of predecessors which didn't run yet. */
+  int num_pending = 0;
+
+  TaskNode(TaskGraph *task_graph,
+           TaskGraphNodeRunFunction run_func,
+           void *task_data,
+           TaskGraphNodeFreeFunction free_func)
+      : task_graph(task_graph), run_func(run_func), task_data(task_data), free_func(free_func)
+  {
+  }
+
+  ~TaskNode()
+  {
+    if (task_data && free_func) {
+      free_func(task_data);
+    }
+  }
+
+  MEM_CXX_CLASS_ALLOC_FUNCS("TaskNode")
+};
+
+/* Task Graph */
+
+struct TaskGraph {
+  TaskPool *task_pool;
+  BLI::Vector<TaskNode *> nodes;
+
+  TaskGraph()
+  {
+    task_pool = BLI_task_pool_create(this, TASK_PRIORITY_HIGH);
+  }
+
+  ~TaskGraph()
+  {
+    BLI_task_pool_free(task_pool);
+    for (TaskNode *task_node : nodes) {
+      delete task_node;
+    }
+  }
+
+  MEM_CXX_CLASS_ALLOC_FUNCS("TaskGraph")
+};
+
+static void task_graph_node_run(TaskPool *__restrict pool, void *taskdata);
+
+/**
+ * Run a node, then its successors which become ready. The first ready successor continues on
+ * this thread, avoiding a round-trip through the scheduler for chains of nodes.
+ */
+static void task_graph_node_run_chain(TaskNode *task_node)
+{
+  while (task_node != nullptr) {
+    task_node->run_func(task_node->task_data);
+
+    /* All predecessors are done, ready for the next run of the graph. */
+    task_node->num_pending = task_node->num_predecessors;
+
+    TaskNode *continuation = nullptr;
+    for (TaskNode *successor : task_node->successors) {
+      if (atomic_sub_and_fetch_int32(&successor->num_pending, 1) == 0) {
+        if (continuation == nullptr) {
+          continuation = successor;
+        }
+        else {
+          BLI_task_pool_push(
+              task_node->task_graph->task_pool, task_graph_node_run, successor, false, nullptr);
+        }
+      }
+    }
+    task_node = continuation;
+  }
+}
+
+static void task_graph_node_run(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  task_graph_node_run_chain(static_cast<TaskNode *>(taskdata));
+}
+
+TaskGraph *BLI_task_graph_create(void)
+{
+  return new TaskGraph();
+}
+
+void BLI_task_graph_free(TaskGraph *task_graph)
+{
+  delete task_graph;
+}
+
+void BLI_task_graph_work_and_wait(TaskGraph *task_graph)
+{
+  BLI_task_pool_work_and_wait(task_graph->task_pool);
+}
+
+TaskNode *BLI_task_graph_node_create(struct TaskGraph *task_graph,
+                                     TaskGraphNodeRunFunction run,
+                                     void *user_data,
+                                     TaskGraphNodeFreeFunction free_func)
+{
+  TaskNode *task_node = new TaskNode(task_graph, run, user_data, free_func);
+  task_graph->nodes.append(task_node);
+  return task_node;
+}
+
+bool BLI_task_graph_node_push_work(struct TaskNode *task_node)
+{
+  if (task_node->num_pending != 0) {
+    /* Node still waits for its predecessors. */
+    return false;
+  }
+  BLI_task_pool_push(
+      task_node->task_graph->task_pool, task_graph_node_run, task_node, false, nullptr);
+  return true;
+}
+
+void BLI_task_graph_edge_create(struct TaskNode *from_node, struct TaskNode *to_node)
+{
+  BLI_assert(from_node->task_graph == to_node->task_graph);
+  from_node->successors.append(to_node);
+  to_node->num_predecessors++;
+  to_node->num_pending++;
+}
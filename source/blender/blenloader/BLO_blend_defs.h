@@ -73,4 +73,17 @@ enum {
 
 #define BLEN_THUMB_MEMSIZE_FILE(_x, _y) (sizeof(int) * (2 + (size_t)(_x) * (size_t)(_y)))
 
+/**
+ * Compressed files are written as a sequence of independent gzip members ("frames"),
+ * so they can be compressed and decompressed in parallel,
+ * while remaining a valid gzip stream for other readers.
+ *
+ * Each frame header stores an extra field (sub-field ID `BL`) containing
+ * two little-endian 32 bit integers: the size of the whole gzip member
+ * and the size of its uncompressed data. Other gzip members are not frames.
+ */
+#define BLEND_ZLIB_FRAME_RAW_SIZE (1 << 20)
+#define BLEND_ZLIB_FRAME_HEADER_SIZE 24
+#define BLEND_ZLIB_FRAME_FOOTER_SIZE 8
+
 #endif /* __BLO_BLEND_DEFS_H__ */
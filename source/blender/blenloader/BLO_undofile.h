@@ -25,6 +25,7 @@
  * \ingroup blenloader
  */
 
+struct GHash;
 struct Scene;
 
 typedef struct {
@@ -32,6 +33,12 @@ typedef struct {
   const char *buf;
   /** Size in bytes. */
   unsigned int size;
+  /** Hash of the content of #buf, to avoid comparing chunks which differ. */
+  unsigned int hash;
+  /** Session uuid of the ID this chunk was written for (#MAIN_ID_SESSION_UUID_UNSET if none). */
+  unsigned int id_session_uuid;
+  /** Hash of the ID struct this chunk was written for, see #memfile_id_begin. */
+  unsigned int id_hash;
   /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
   bool is_identical;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
@@ -51,11 +58,35 @@ typedef struct MemFileUndoData {
   size_t undo_size;
 } MemFileUndoData;
 
+typedef struct MemFileWriteData {
+  MemFile *written_memfile;
+  MemFile *reference_memfile;
+
+  /** Use to de-duplicate chunks when writing. */
+  MemFileChunk *reference_current_chunk;
+  /** Maps an ID session uuid to its first chunk in #reference_memfile. */
+  struct GHash *id_session_uuid_mapping;
+
+  /** ID being written (#MAIN_ID_SESSION_UUID_UNSET when writing other data). */
+  unsigned int current_id_session_uuid;
+  unsigned int current_id_hash;
+} MemFileWriteData;
+
 /* actually only used writefile.c */
-extern void memfile_chunk_add(MemFile *memfile,
-                              const char *buf,
-                              unsigned int size,
-                              MemFileChunk **compchunk_step);
+extern void memfile_write_init(MemFileWriteData *mem_data,
+                               MemFile *written_memfile,
+                               MemFile *reference_memfile);
+extern void memfile_write_finalize(MemFileWriteData *mem_data);
+
+extern void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, unsigned int size);
+
+extern void memfile_id_begin(MemFileWriteData *mem_data,
+                             unsigned int id_session_uuid,
+                             unsigned int id_hash);
+extern void memfile_id_end(MemFileWriteData *mem_data);
+extern bool memfile_id_reuse(MemFileWriteData *mem_data,
+                             unsigned int id_session_uuid,
+                             unsigned int id_hash);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
@@ -33,7 +33,8 @@
 
 #include "BLI_utildefines.h"
 #ifndef WIN32
-#  include <unistd.h>  // for read close
+#  include <sys/mman.h> /* for mmap. */
+#  include <unistd.h>   // for read close
 #else
 #  include "BLI_winstuff.h"
 #  include "winsock2.h"
@@ -105,6 +106,7 @@
 #include "BLI_linklist.h"
 #include "BLI_math.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BLT_translation.h"
@@ -233,9 +235,30 @@
  */
 #define USE_BHEAD_READ_ON_DEMAND
 
+/**
+ * Map uncompressed files into memory instead of using `read()`/`lseek()` for every block.
+ *
+ * Reading a block becomes a `memcpy` from the mapping (no system calls), and blocks that need
+ * #DNA_struct_reconstruct are reconstructed directly from the mapping,
+ * without first being copied into a temporary #BHeadN.
+ *
+ * \note Only blocks that need an endian switch still need a temporary copy,
+ * since that conversion is done in-place.
+ */
+#if defined(USE_BHEAD_READ_ON_DEMAND) && !defined(WIN32)
+#  define USE_BHEAD_READ_MMAP
+#endif
+
 /* use GHash for BHead name-based lookups (speeds up linking) */
 #define USE_GHASH_BHEAD
 
+/**
+ * When reading a file (not undo), defer direct linking of data-blocks which only access
+ * their own data, so it can run in parallel once all blocks of the file have been read.
+ * Each deferred data-block keeps its own data map, see #direct_link_id_can_defer.
+ */
+#define USE_DIRECT_LINK_PARALLEL
+
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
@@ -1008,6 +1031,27 @@ static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
   }
   return &new_bhead_data->bhead;
 }
+
+/**
+ * Access the data of a block which hasn't been read yet without copying it.
+ *
+ * \return A read-only pointer into the memory mapped file,
+ * or NULL when the file isn't mapped (the data then needs to be read).
+ */
+static const void *blo_bhead_data_peek(const FileData *fd, const BHead *thisblock)
+{
+#  ifdef USE_BHEAD_READ_MMAP
+  const BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
+  BLI_assert(new_bhead->has_data == false);
+  if (fd->mmap_buffer != NULL) {
+    BLI_assert((size_t)(new_bhead->file_offset + new_bhead->bhead.len) <= fd->mmap_size);
+    return fd->mmap_buffer + new_bhead->file_offset;
+  }
+#  else
+  UNUSED_VARS(fd, thisblock);
+#  endif
+  return NULL;
+}
 #endif /* USE_BHEAD_READ_ON_DEMAND */
 
 /* Warning! Caller's responsibility to ensure given bhead **is** and ID one! */
@@ -1088,6 +1132,8 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
       if (fd->filesdna) {
         blo_do_versions_dna(fd->filesdna, fd->fileversion, subversion);
         fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
+        fd->reconstruct_info = DNA_reconstruct_info_create(
+            fd->filesdna, fd->memsdna, fd->compflags);
         /* used to retrieve ID names from (bhead+1) */
         fd->id_name_offs = DNA_elem_offset(fd->filesdna, "ID", "char", "name[]");
 
@@ -1177,6 +1223,80 @@ static off64_t fd_seek_data_from_file(FileData *filedata, off64_t offset, int wh
   return filedata->file_offset;
 }
 
+#ifdef USE_BHEAD_READ_MMAP
+
+/* Memory mapped file reading. */
+
+static int fd_read_from_mmap(FileData *filedata,
+                             void *buffer,
+                             uint size,
+                             bool *UNUSED(r_is_memchunck_identical))
+{
+  /* Don't read more bytes than there are available in the mapping. */
+  const size_t offset = (size_t)filedata->file_offset;
+  const size_t readsize = (offset < filedata->mmap_size) ?
+                              MIN2((size_t)size, filedata->mmap_size - offset) :
+                              0;
+
+  memcpy(buffer, filedata->mmap_buffer + offset, readsize);
+  filedata->file_offset += (int64_t)readsize;
+
+  return (int)readsize;
+}
+
+static off64_t fd_seek_from_mmap(FileData *filedata, off64_t offset, int whence)
+{
+  off64_t offset_new;
+  switch (whence) {
+    case SEEK_SET:
+      offset_new = offset;
+      break;
+    case SEEK_CUR:
+      offset_new = filedata->file_offset + offset;
+      break;
+    case SEEK_END:
+      offset_new = (off64_t)filedata->mmap_size + offset;
+      break;
+    default:
+      return -1;
+  }
+  if (offset_new < 0 || (size_t)offset_new > filedata->mmap_size) {
+    return -1;
+  }
+  filedata->file_offset = offset_new;
+  return offset_new;
+}
+
+/**
+ * Map the whole file into memory, on success reading and seeking
+ * is done from the mapping instead of the file descriptor.
+ */
+static bool fd_mmap_file(FileData *fd)
+{
+  BLI_assert(fd->filedes != -1 && fd->mmap_buffer == NULL);
+
+  const size_t size = BLI_file_descriptor_size(fd->filedes);
+  if (size == 0 || size == (size_t)-1) {
+    return false;
+  }
+
+  void *mem = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd->filedes, 0);
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+
+  fd->mmap_buffer = mem;
+  fd->mmap_size = size;
+  fd->read = fd_read_from_mmap;
+  fd->seek = fd_seek_from_mmap;
+  /* The mapping is independent from the file position of the descriptor. */
+  fd->file_offset = 0;
+
+  return true;
+}
+
+#endif /* USE_BHEAD_READ_MMAP */
+
 /* GZip file reading. */
 
 static int fd_read_gzip_from_file(FileData *filedata,
@@ -1196,6 +1316,270 @@ static int fd_read_gzip_from_file(FileData *filedata,
   return (readsize);
 }
 
+/* Frame compressed file reading (see #BLEND_ZLIB_FRAME_RAW_SIZE). */
+
+typedef struct ZlibFrameRead {
+  /** Gzip member in the compressed file. */
+  const uchar *member;
+  uint member_len;
+  /** Destination of the uncompressed data. */
+  char *buf;
+  uint buf_len;
+  bool is_ok;
+} ZlibFrameRead;
+
+static uint zlib_frame_uint32_decode(const uchar *src)
+{
+  return (uint)src[0] | ((uint)src[1] << 8) | ((uint)src[2] << 16) | ((uint)src[3] << 24);
+}
+
+/**
+ * \param member_len_max: Number of bytes available at \a member.
+ * \return true when \a member is the start of a frame.
+ */
+static bool zlib_frame_header_decode(const uchar *member,
+                                     const size_t member_len_max,
+                                     uint *r_member_len,
+                                     uint *r_buf_len)
+{
+  if (member_len_max < BLEND_ZLIB_FRAME_HEADER_SIZE) {
+    return false;
+  }
+  /* Gzip magic, deflate, only the extra field flag, 12 bytes of extra field. */
+  if (!(member[0] == 0x1f && member[1] == 0x8b && member[2] == 8 && member[3] == 4 &&
+        member[10] == 12 && member[11] == 0)) {
+    return false;
+  }
+  /* Sub-field ID and length. */
+  if (!(member[12] == 'B' && member[13] == 'L' && member[14] == 8 && member[15] == 0)) {
+    return false;
+  }
+  *r_member_len = zlib_frame_uint32_decode(&member[16]);
+  *r_buf_len = zlib_frame_uint32_decode(&member[20]);
+  return (*r_member_len >= BLEND_ZLIB_FRAME_HEADER_SIZE + BLEND_ZLIB_FRAME_FOOTER_SIZE) &&
+         (*r_member_len <= member_len_max);
+}
+
+static void zlib_frame_decompress_fn(void *__restrict userdata,
+                                     const int index,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ZlibFrameRead *frame = &((ZlibFrameRead *)userdata)[index];
+
+  z_stream strm = {NULL};
+  if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+    return;
+  }
+  strm.next_in = (Bytef *)frame->member + BLEND_ZLIB_FRAME_HEADER_SIZE;
+  strm.avail_in = frame->member_len - BLEND_ZLIB_FRAME_HEADER_SIZE - BLEND_ZLIB_FRAME_FOOTER_SIZE;
+  strm.next_out = (Bytef *)frame->buf;
+  strm.avail_out = frame->buf_len;
+  const int ret = inflate(&strm, Z_FINISH);
+  const uLong buf_len = strm.total_out;
+  inflateEnd(&strm);
+
+  if ((ret == Z_STREAM_END) && (buf_len == frame->buf_len)) {
+    const uchar *footer = frame->member + frame->member_len - BLEND_ZLIB_FRAME_FOOTER_SIZE;
+    frame->is_ok = (zlib_frame_uint32_decode(&footer[0]) ==
+                    (uint)crc32(0, (const Bytef *)frame->buf, frame->buf_len)) &&
+                   (zlib_frame_uint32_decode(&footer[4]) == frame->buf_len);
+  }
+}
+
+/**
+ * Read a frame compressed file into memory, decompressing all frames in parallel.
+ *
+ * \return The uncompressed file contents, or NULL when the file isn't frame compressed
+ * (the file position is restored in this case, so it can be read as a regular gzip file).
+ */
+/** \return true when \a file starts with a frame, the file position is restored. */
+static bool zlib_frames_file_check(int file)
+{
+  uchar header[BLEND_ZLIB_FRAME_HEADER_SIZE];
+  uint member_len, buf_len;
+
+  const bool is_frame = (read(file, header, sizeof(header)) == sizeof(header)) &&
+                        zlib_frame_header_decode(header, SIZE_MAX, &member_len, &buf_len);
+  BLI_lseek(file, 0, SEEK_SET);
+  return is_frame;
+}
+
+static char *fd_read_zlib_frames_from_file(int file, size_t *r_buf_len)
+{
+  uint member_len, buf_len;
+
+  if (!zlib_frames_file_check(file)) {
+    return NULL;
+  }
+
+  const size_t file_len = BLI_file_descriptor_size(file);
+  if (file_len == (size_t)-1) {
+    return NULL;
+  }
+
+  uchar *file_buf = MEM_mallocN(file_len, __func__);
+  size_t file_read = 0;
+  while (file_read < file_len) {
+    const int len = read(file, file_buf + file_read, (uint)MIN2(file_len - file_read, INT_MAX));
+    if (len <= 0) {
+      break;
+    }
+    file_read += (size_t)len;
+  }
+  BLI_lseek(file, 0, SEEK_SET);
+  if (file_read != file_len) {
+    MEM_freeN(file_buf);
+    return NULL;
+  }
+
+  /* Locate all frames, any other data makes this a regular gzip file. */
+  int frames_len = 0;
+  size_t buf_len_all = 0;
+  for (size_t offset = 0; offset < file_len; offset += member_len) {
+    if (!zlib_frame_header_decode(file_buf + offset, file_len - offset, &member_len, &buf_len)) {
+      MEM_freeN(file_buf);
+      return NULL;
+    }
+    buf_len_all += buf_len;
+    frames_len++;
+  }
+
+  ZlibFrameRead *frames = MEM_mallocN(sizeof(*frames) * (size_t)frames_len, __func__);
+  char *buf = MEM_mallocN(MAX2(buf_len_all, 1), __func__);
+  {
+    size_t offset = 0, buf_offset = 0;
+    for (int i = 0; i < frames_len; i++) {
+      ZlibFrameRead *frame = &frames[i];
+      zlib_frame_header_decode(file_buf + offset, file_len - offset, &member_len, &buf_len);
+      frame->member = file_buf + offset;
+      frame->member_len = member_len;
+      frame->buf = buf + buf_offset;
+      frame->buf_len = buf_len;
+      frame->is_ok = false;
+      offset += member_len;
+      buf_offset += buf_len;
+    }
+  }
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (frames_len > 1);
+  BLI_task_parallel_range(0, frames_len, frames, zlib_frame_decompress_fn, &settings);
+
+  bool is_ok = true;
+  for (int i = 0; i < frames_len; i++) {
+    is_ok &= frames[i].is_ok;
+  }
+
+  MEM_freeN(frames);
+  MEM_freeN(file_buf);
+
+  if (!is_ok) {
+    MEM_freeN(buf);
+    return NULL;
+  }
+
+  *r_buf_len = buf_len_all;
+  return buf;
+}
+
+/**
+ * Sequential reading of a frame compressed file, only decompressing the frames up to the data
+ * which is actually read. Used for light access (header and thumbnail reading), where
+ * decompressing the whole file up-front would be wasted.
+ */
+typedef struct ZlibFrameStream {
+  /** Compressed frame, including its header and footer. */
+  uchar *member;
+  uint member_alloc;
+  /** Uncompressed data of the current frame. */
+  char *buf;
+  uint buf_alloc;
+  uint buf_len;
+  /** Read position in \a buf. */
+  uint buf_offset;
+} ZlibFrameStream;
+
+static void zlib_frame_stream_free(ZlibFrameStream *stream)
+{
+  MEM_SAFE_FREE(stream->member);
+  MEM_SAFE_FREE(stream->buf);
+  MEM_freeN(stream);
+}
+
+/**
+ * Read and decompress the next frame of the file into \a stream.
+ * \return false at the end of the file or on corrupt data.
+ */
+static bool zlib_frame_stream_next(ZlibFrameStream *stream, int file)
+{
+  uchar header[BLEND_ZLIB_FRAME_HEADER_SIZE];
+  uint member_len, buf_len;
+
+  if ((read(file, header, sizeof(header)) != sizeof(header)) ||
+      !zlib_frame_header_decode(header, SIZE_MAX, &member_len, &buf_len)) {
+    return false;
+  }
+
+  if (stream->member_alloc < member_len) {
+    MEM_SAFE_FREE(stream->member);
+    stream->member = MEM_mallocN(member_len, __func__);
+    stream->member_alloc = member_len;
+  }
+  if (stream->buf_alloc < buf_len) {
+    MEM_SAFE_FREE(stream->buf);
+    stream->buf = MEM_mallocN(buf_len, __func__);
+    stream->buf_alloc = buf_len;
+  }
+
+  memcpy(stream->member, header, sizeof(header));
+  const uint remaining_len = member_len - (uint)sizeof(header);
+  if (read(file, stream->member + sizeof(header), remaining_len) != (int)remaining_len) {
+    return false;
+  }
+
+  ZlibFrameRead frame = {
+      .member = stream->member,
+      .member_len = member_len,
+      .buf = stream->buf,
+      .buf_len = buf_len,
+      .is_ok = false,
+  };
+  zlib_frame_decompress_fn(&frame, 0, NULL);
+  if (!frame.is_ok) {
+    return false;
+  }
+
+  stream->buf_len = buf_len;
+  stream->buf_offset = 0;
+  return true;
+}
+
+static int fd_read_zlib_frames_lazy(FileData *filedata,
+                                    void *buffer,
+                                    uint size,
+                                    bool *UNUSED(r_is_memchunck_identical))
+{
+  ZlibFrameStream *stream = filedata->zlib_frame_stream;
+  uint readsize = 0;
+
+  while (readsize < size) {
+    if (stream->buf_offset == stream->buf_len) {
+      if (!zlib_frame_stream_next(stream, filedata->filedes)) {
+        break;
+      }
+      continue;
+    }
+    const uint len = MIN2(size - readsize, stream->buf_len - stream->buf_offset);
+    memcpy(POINTER_OFFSET(buffer, readsize), stream->buf + stream->buf_offset, len);
+    stream->buf_offset += len;
+    readsize += len;
+  }
+
+  filedata->file_offset += readsize;
+  return (int)readsize;
+}
+
 /* Memory reading. */
 
 static int fd_read_from_memory(FileData *filedata,
@@ -1204,12 +1588,38 @@ static int fd_read_from_memory(FileData *filedata,
                                bool *UNUSED(r_is_memchunck_identical))
 {
   /* don't read more bytes then there are available in the buffer */
-  int readsize = (int)MIN2(size, (uint)(filedata->buffersize - filedata->file_offset));
+  const size_t offset = (size_t)filedata->file_offset;
+  const size_t readsize = (offset < filedata->buffersize) ?
+                              MIN2((size_t)size, filedata->buffersize - offset) :
+                              0;
 
-  memcpy(buffer, filedata->buffer + filedata->file_offset, readsize);
-  filedata->file_offset += readsize;
+  memcpy(buffer, filedata->buffer + offset, readsize);
+  filedata->file_offset += (int64_t)readsize;
 
-  return (readsize);
+  return (int)readsize;
+}
+
+static off64_t fd_seek_from_memory(FileData *filedata, off64_t offset, int whence)
+{
+  off64_t offset_new;
+  switch (whence) {
+    case SEEK_SET:
+      offset_new = offset;
+      break;
+    case SEEK_CUR:
+      offset_new = filedata->file_offset + offset;
+      break;
+    case SEEK_END:
+      offset_new = (off64_t)filedata->buffersize + offset;
+      break;
+    default:
+      return -1;
+  }
+  if (offset_new < 0 || (size_t)offset_new > filedata->buffersize) {
+    return -1;
+  }
+  filedata->file_offset = offset_new;
+  return offset_new;
 }
 
 /* MemFile reading. */
@@ -1329,16 +1739,24 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
   return fd;
 }
 
+/**
+ * \param is_minimal: Only the start of the file will be read,
+ * frame compressed files are decompressed as they are read instead of all at once.
+ */
 static FileData *blo_filedata_from_file_descriptor(const char *filepath,
                                                    ReportList *reports,
-                                                   int file)
+                                                   int file,
+                                                   const bool is_minimal)
 {
   FileDataReadFn *read_fn = NULL;
   FileDataSeekFn *seek_fn = NULL; /* Optional. */
 
   gzFile gzfile = (gzFile)Z_NULL;
+  char *buffer = NULL;
+  size_t buffersize = 0;
+  ZlibFrameStream *zlib_frame_stream = NULL;
 
-  char header[7];
+  uchar header[7];
 
   /* Regular file. */
   errno = 0;
@@ -1360,6 +1778,25 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
     seek_fn = fd_seek_data_from_file;
   }
 
+  /* Frame compressed file, decompressed into memory in parallel,
+   * or one frame at a time when only the start of the file is read. */
+  if ((read_fn == NULL) && (header[0] == 0x1f && header[1] == 0x8b)) {
+    if (is_minimal) {
+      if (zlib_frames_file_check(file)) {
+        zlib_frame_stream = MEM_callocN(sizeof(*zlib_frame_stream), __func__);
+        /* Sequential only, like gzip reading. */
+        read_fn = fd_read_zlib_frames_lazy;
+      }
+    }
+    else {
+      buffer = fd_read_zlib_frames_from_file(file, &buffersize);
+      if (buffer != NULL) {
+        read_fn = fd_read_from_memory;
+        seek_fn = fd_seek_from_memory;
+      }
+    }
+  }
+
   /* Gzip file. */
   errno = 0;
   if ((read_fn == NULL) &&
@@ -1391,14 +1828,26 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   fd->filedes = file;
   fd->gzfiledes = gzfile;
+  fd->buffer = buffer;
+  fd->buffersize = buffersize;
+  fd->zlib_frame_stream = zlib_frame_stream;
 
   fd->read = read_fn;
   fd->seek = seek_fn;
 
+#ifdef USE_BHEAD_READ_MMAP
+  if (read_fn == fd_read_data_from_file) {
+    /* Fall back to regular file reading when mapping fails. */
+    fd_mmap_file(fd);
+  }
+#endif
+
   return fd;
 }
 
-static FileData *blo_filedata_from_file_open(const char *filepath, ReportList *reports)
+static FileData *blo_filedata_from_file_open(const char *filepath,
+                                             ReportList *reports,
+                                             const bool is_minimal)
 {
   errno = 0;
   const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
@@ -1410,7 +1859,7 @@ static FileData *blo_filedata_from_file_open(const char *filepath, ReportList *r
                 errno ? strerror(errno) : TIP_("unknown error reading file"));
     return NULL;
   }
-  FileData *fd = blo_filedata_from_file_descriptor(filepath, reports, file);
+  FileData *fd = blo_filedata_from_file_descriptor(filepath, reports, file, is_minimal);
   if ((fd == NULL) || (fd->filedes == -1)) {
     close(file);
   }
@@ -1421,7 +1870,7 @@ static FileData *blo_filedata_from_file_open(const char *filepath, ReportList *r
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_filedata_from_file(const char *filepath, ReportList *reports)
 {
-  FileData *fd = blo_filedata_from_file_open(filepath, reports);
+  FileData *fd = blo_filedata_from_file_open(filepath, reports, false);
   if (fd != NULL) {
     /* needed for library_append and read_libraries */
     BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
@@ -1437,7 +1886,7 @@ FileData *blo_filedata_from_file(const char *filepath, ReportList *reports)
  */
 static FileData *blo_filedata_from_file_minimal(const char *filepath)
 {
-  FileData *fd = blo_filedata_from_file_open(filepath, NULL);
+  FileData *fd = blo_filedata_from_file_open(filepath, NULL, true);
   if (fd != NULL) {
     decode_blender_header(fd);
     if (fd->flags & FD_FLAGS_FILE_OK) {
@@ -1478,7 +1927,7 @@ static int fd_read_gzip_from_memory_init(FileData *fd)
 {
 
   fd->strm.next_in = (Bytef *)fd->buffer;
-  fd->strm.avail_in = fd->buffersize;
+  fd->strm.avail_in = (uInt)fd->buffersize;
   fd->strm.total_out = 0;
   fd->strm.zalloc = Z_NULL;
   fd->strm.zfree = Z_NULL;
@@ -1564,6 +2013,18 @@ void blo_filedata_free(FileData *fd)
       fd->buffer = NULL;
     }
 
+    if (fd->zlib_frame_stream) {
+      zlib_frame_stream_free(fd->zlib_frame_stream);
+      fd->zlib_frame_stream = NULL;
+    }
+
+#ifdef USE_BHEAD_READ_MMAP
+    if (fd->mmap_buffer) {
+      munmap((void *)fd->mmap_buffer, fd->mmap_size);
+      fd->mmap_buffer = NULL;
+    }
+#endif
+
     /* Free all BHeadN data blocks */
 #ifndef NDEBUG
     BLI_freelistN(&fd->bhead_list);
@@ -1580,6 +2041,9 @@ void blo_filedata_free(FileData *fd)
     if (fd->filesdna) {
       DNA_sdna_free(fd->filesdna);
     }
+    if (fd->reconstruct_info) {
+      DNA_reconstruct_info_free(fd->reconstruct_info);
+    }
     if (fd->compflags) {
       MEM_freeN((void *)fd->compflags);
     }
@@ -2342,17 +2806,22 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 
     if (fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED) {
       if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+        const void *data = (bh + 1);
 #ifdef USE_BHEAD_READ_ON_DEMAND
         if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
-          bh = blo_bhead_read_full(fd, bh);
-          if (UNLIKELY(bh == NULL)) {
-            fd->flags &= ~FD_FLAGS_FILE_OK;
-            return NULL;
+          /* Reconstruct directly from the mapped file when possible. */
+          data = blo_bhead_data_peek(fd, bh);
+          if (data == NULL) {
+            bh = blo_bhead_read_full(fd, bh);
+            if (UNLIKELY(bh == NULL)) {
+              fd->flags &= ~FD_FLAGS_FILE_OK;
+              return NULL;
+            }
+            data = (bh + 1);
           }
         }
 #endif
-        temp = DNA_struct_reconstruct(
-            fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh + 1));
+        temp = DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, data);
       }
       else {
         /* SDNA_CMP_EQUAL */
@@ -9476,6 +9945,87 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
   return success;
 }
 
+#ifdef USE_DIRECT_LINK_PARALLEL
+
+/** A data-block read from file, which still needs to be direct linked. */
+typedef struct DirectLinkDeferred {
+  struct DirectLinkDeferred *next, *prev;
+  Main *main;
+  ID *id;
+  int tag;
+  /** Data associated with this data-block only (moved from #FileData.datamap). */
+  OldNewMap *datamap;
+} DirectLinkDeferred;
+
+/**
+ * Data-block types whose direct linking only accesses the data-block's own data
+ * (no other data-blocks, global maps or reports), so they can be linked in any order.
+ */
+static bool direct_link_id_can_defer(const short idcode)
+{
+  return ELEM(idcode,
+              ID_ME,
+              ID_CU,
+              ID_MB,
+              ID_LT,
+              ID_KE,
+              ID_MA,
+              ID_TE,
+              ID_IM,
+              ID_LA,
+              ID_CA,
+              ID_WO,
+              ID_AC,
+              ID_SPK,
+              ID_LP);
+}
+
+static void direct_link_id_defer(FileData *fd, Main *main, const int tag, ID *id)
+{
+  DirectLinkDeferred *deferred = MEM_mallocN(sizeof(*deferred), __func__);
+  deferred->main = main;
+  deferred->id = id;
+  deferred->tag = tag;
+  deferred->datamap = fd->datamap;
+  BLI_addtail(&fd->direct_link_deferred, deferred);
+
+  fd->datamap = oldnewmap_new();
+}
+
+static void direct_link_id_deferred_cb(void *__restrict userdata,
+                                       void *item,
+                                       int UNUSED(index),
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const FileData *fd = userdata;
+  DirectLinkDeferred *deferred = item;
+
+  /* Direct linking only reads the file data, except for the data map,
+   * so each data-block can use its own copy with its own data map. */
+  FileData fd_id = *fd;
+  fd_id.datamap = deferred->datamap;
+
+  const bool success = direct_link_id(&fd_id, deferred->main, deferred->tag, deferred->id, NULL);
+  BLI_assert(success);
+  UNUSED_VARS_NDEBUG(success);
+
+  oldnewmap_clear(deferred->datamap);
+  oldnewmap_free(deferred->datamap);
+}
+
+/** Direct link all deferred data-blocks, in parallel. */
+static void direct_link_id_deferred_all(FileData *fd)
+{
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = !BLI_listbase_is_single(&fd->direct_link_deferred);
+  BLI_task_parallel_listbase(&fd->direct_link_deferred, fd, direct_link_id_deferred_cb, &settings);
+
+  BLI_freelistN(&fd->direct_link_deferred);
+}
+
+#endif /* USE_DIRECT_LINK_PARALLEL */
+
 /* Read all data associated with a datablock into datamap. */
 static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *allocname)
 {
@@ -9829,6 +10379,15 @@ static BHead *read_libblock(FileData *fd,
    * Use convenient malloc name for debugging and better memory link prints. */
   const char *allocname = dataname(idcode);
   bhead = read_data_into_datamap(fd, bhead, allocname);
+
+#ifdef USE_DIRECT_LINK_PARALLEL
+  if (fd->use_direct_link_deferred && direct_link_id_can_defer(idcode)) {
+    BLI_assert(id_old == NULL);
+    direct_link_id_defer(fd, main, id_tag, id);
+    return bhead;
+  }
+#endif
+
   const bool success = direct_link_id(fd, main, id_tag, id, id_old);
   oldnewmap_clear(fd->datamap);
 
@@ -10361,6 +10920,11 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+#ifdef USE_DIRECT_LINK_PARALLEL
+  /* Undo reads data-blocks at existing addresses, keep it simple. */
+  fd->use_direct_link_deferred = (fd->memfile == NULL);
+#endif
+
   while (bhead) {
     switch (bhead->code) {
       case DATA:
@@ -10412,6 +10976,11 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+#ifdef USE_DIRECT_LINK_PARALLEL
+  fd->use_direct_link_deferred = false;
+  direct_link_id_deferred_all(fd);
+#endif
+
   /* do before read_libraries, but skip undo case */
   if (fd->memfile == NULL) {
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
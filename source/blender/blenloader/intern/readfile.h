@@ -30,6 +30,7 @@
 #include "DNA_windowmanager_types.h" /* for ReportType */
 #include "zlib.h"
 
+struct DNA_ReconstructInfo;
 struct GSet;
 struct IDNameLib_Map;
 struct Key;
@@ -72,7 +73,7 @@ typedef struct FileData {
   ListBase bhead_list;
   enum eFileDataFlag flags;
   bool is_eof;
-  int buffersize;
+  size_t buffersize;
   int64_t file_offset;
 
   FileDataReadFn *read;
@@ -80,6 +81,9 @@ typedef struct FileData {
 
   /** Regular file reading. */
   int filedes;
+  /** Memory mapped file reading (read-only, uncompressed files), see #USE_BHEAD_READ_MMAP. */
+  const char *mmap_buffer;
+  size_t mmap_size;
 
   /** Variables needed for reading from memory / stream. */
   const char *buffer;
@@ -93,6 +97,8 @@ typedef struct FileData {
   gzFile gzfiledes;
   /** Gzip stream for memory decompression. */
   z_stream strm;
+  /** Frame compressed file, decompressed one frame at a time as it's read. */
+  struct ZlibFrameStream *zlib_frame_stream;
 
   /** Now only in use for library appending. */
   char relabase[FILE_MAX];
@@ -102,6 +108,8 @@ typedef struct FileData {
   const struct SDNA *memsdna;
   /** Array of #eSDNA_StructCompare. */
   const char *compflags;
+  /** Compiled conversion steps for structs which differ, see #DNA_struct_reconstruct. */
+  struct DNA_ReconstructInfo *reconstruct_info;
 
   int fileversion;
   /** Used to retrieve ID names from (bhead+1). */
@@ -113,6 +121,9 @@ typedef struct FileData {
   eBLOReadSkip skip_flags;
 
   struct OldNewMap *datamap;
+  /** Data-blocks which direct linking is deferred (see #USE_DIRECT_LINK_PARALLEL). */
+  ListBase direct_link_deferred;
+  bool use_direct_link_deferred;
   struct OldNewMap *globmap;
   struct OldNewMap *libmap;
   struct OldNewMap *imamap;
@@ -41,10 +41,13 @@
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 
 #include "BLO_readfile.h"
 #include "BLO_undofile.h"
 
+#include "BKE_lib_id.h"
 #include "BKE_main.h"
 
 /* keep last */
@@ -70,25 +73,31 @@ void BLO_memfile_free(MemFile *memfile)
 /* result is that 'first' is being freed */
 void BLO_memfile_merge(MemFile *first, MemFile *second)
 {
-  MemFileChunk *fc, *sc;
+  /* Chunks of the second memfile may share the memory of any chunk of the first one
+   * (not only the one at the same position), map the shared buffers to their chunks. */
+  GHash *buffer_to_second_chunk = BLI_ghash_new_flat(
+      BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, __func__);
 
-  fc = first->chunks.first;
-  sc = second->chunks.first;
-  while (fc || sc) {
-    if (fc && sc) {
-      if (sc->is_identical) {
+  LISTBASE_FOREACH (MemFileChunk *, sc, &second->chunks) {
+    if (sc->is_identical) {
+      BLI_ghash_reinsert(buffer_to_second_chunk, (void *)sc->buf, sc, NULL, NULL);
+    }
+  }
+
+  /* Transfer ownership of buffers owned by the first memfile and used by the second one. */
+  LISTBASE_FOREACH (MemFileChunk *, fc, &first->chunks) {
+    if (fc->is_identical == false) {
+      MemFileChunk *sc = BLI_ghash_lookup(buffer_to_second_chunk, fc->buf);
+      if (sc != NULL) {
+        BLI_assert(sc->is_identical);
         sc->is_identical = false;
         fc->is_identical = true;
       }
     }
-    if (fc) {
-      fc = fc->next;
-    }
-    if (sc) {
-      sc = sc->next;
-    }
   }
 
+  BLI_ghash_free(buffer_to_second_chunk, NULL, NULL);
+
   BLO_memfile_free(first);
 }
 
@@ -100,11 +109,56 @@ void BLO_memfile_clear_future(MemFile *memfile)
   }
 }
 
-void memfile_chunk_add(MemFile *memfile, const char *buf, uint size, MemFileChunk **compchunk_step)
+void memfile_write_init(MemFileWriteData *mem_data,
+                        MemFile *written_memfile,
+                        MemFile *reference_memfile)
 {
+  mem_data->written_memfile = written_memfile;
+  mem_data->reference_memfile = reference_memfile;
+  mem_data->reference_current_chunk = reference_memfile ? reference_memfile->chunks.first : NULL;
+  mem_data->current_id_session_uuid = MAIN_ID_SESSION_UUID_UNSET;
+  mem_data->current_id_hash = 0;
+
+  /* Map the IDs of the reference memfile to their first chunk, so their data can still be found
+   * when IDs are added, removed or re-ordered in current Main. */
+  mem_data->id_session_uuid_mapping = NULL;
+  if (reference_memfile != NULL) {
+    mem_data->id_session_uuid_mapping = BLI_ghash_new_flat(
+        BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+    uint id_session_uuid_prev = MAIN_ID_SESSION_UUID_UNSET;
+    LISTBASE_FOREACH (MemFileChunk *, chunk, &reference_memfile->chunks) {
+      if (!ELEM(chunk->id_session_uuid, MAIN_ID_SESSION_UUID_UNSET, id_session_uuid_prev)) {
+        void **entry;
+        if (!BLI_ghash_ensure_p(mem_data->id_session_uuid_mapping,
+                                POINTER_FROM_UINT(chunk->id_session_uuid),
+                                &entry)) {
+          *entry = chunk;
+        }
+      }
+      id_session_uuid_prev = chunk->id_session_uuid;
+    }
+  }
+}
+
+void memfile_write_finalize(MemFileWriteData *mem_data)
+{
+  if (mem_data->id_session_uuid_mapping != NULL) {
+    BLI_ghash_free(mem_data->id_session_uuid_mapping, NULL, NULL);
+    mem_data->id_session_uuid_mapping = NULL;
+  }
+}
+
+void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint size)
+{
+  MemFile *memfile = mem_data->written_memfile;
+  MemFileChunk **compchunk_step = &mem_data->reference_current_chunk;
+
   MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
   curchunk->size = size;
   curchunk->buf = NULL;
+  curchunk->hash = BLI_hash_mm2((const uchar *)buf, size, 0);
+  curchunk->id_session_uuid = mem_data->current_id_session_uuid;
+  curchunk->id_hash = mem_data->current_id_hash;
   curchunk->is_identical = false;
   /* This is unsafe in the sense that an app handler or other code that does not
    * perform an undo push may make changes after the last undo push that
@@ -115,7 +169,9 @@ void memfile_chunk_add(MemFile *memfile, const char *buf, uint size, MemFileChun
   /* we compare compchunk with buf */
   if (*compchunk_step != NULL) {
     MemFileChunk *compchunk = *compchunk_step;
-    if (compchunk->size == curchunk->size) {
+    /* Only compare the content when the hashes match,
+     * this avoids reading the previous step's memory for changed chunks. */
+    if ((compchunk->size == curchunk->size) && (compchunk->hash == curchunk->hash)) {
       if (memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
         curchunk->is_identical = true;
@@ -134,6 +190,66 @@ void memfile_chunk_add(MemFile *memfile, const char *buf, uint size, MemFileChun
   }
 }
 
+static MemFileChunk *memfile_id_chunk_first(MemFileWriteData *mem_data, const uint id_session_uuid)
+{
+  if (mem_data->id_session_uuid_mapping == NULL) {
+    return NULL;
+  }
+  return BLI_ghash_lookup(mem_data->id_session_uuid_mapping, POINTER_FROM_UINT(id_session_uuid));
+}
+
+/**
+ * Start writing the data of an ID, all chunks added until #memfile_id_end belong to it.
+ *
+ * \param id_hash: Hash of the ID struct, used by #memfile_id_reuse on the next undo step.
+ */
+void memfile_id_begin(MemFileWriteData *mem_data, const uint id_session_uuid, const uint id_hash)
+{
+  mem_data->current_id_session_uuid = id_session_uuid;
+  mem_data->current_id_hash = id_hash;
+
+  /* Compare with the data of the same ID in the reference memfile, if any. */
+  MemFileChunk *chunk = memfile_id_chunk_first(mem_data, id_session_uuid);
+  if (chunk != NULL) {
+    mem_data->reference_current_chunk = chunk;
+  }
+}
+
+void memfile_id_end(MemFileWriteData *mem_data)
+{
+  mem_data->current_id_session_uuid = MAIN_ID_SESSION_UUID_UNSET;
+  mem_data->current_id_hash = 0;
+}
+
+/**
+ * Add the chunks of an unchanged ID by re-using them from the reference memfile,
+ * instead of writing and comparing its data again.
+ *
+ * \return false when the ID isn't in the reference memfile or its struct changed
+ * (the ID must be written then).
+ */
+bool memfile_id_reuse(MemFileWriteData *mem_data, const uint id_session_uuid, const uint id_hash)
+{
+  MemFileChunk *compchunk = memfile_id_chunk_first(mem_data, id_session_uuid);
+  if ((compchunk == NULL) || (compchunk->id_hash != id_hash)) {
+    return false;
+  }
+
+  for (; compchunk && (compchunk->id_session_uuid == id_session_uuid);
+       compchunk = compchunk->next) {
+    MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
+    *curchunk = *compchunk;
+    curchunk->is_identical = true;
+    curchunk->is_identical_future = true;
+    BLI_addtail(&mem_data->written_memfile->chunks, curchunk);
+
+    compchunk->is_identical_future = true;
+  }
+  mem_data->reference_current_chunk = compchunk;
+
+  return true;
+}
+
 struct Main *BLO_memfile_main_get(struct MemFile *memfile,
                                   struct Main *oldmain,
                                   struct Scene **r_scene)
@@ -147,7 +147,10 @@
 
 #include "BLI_bitmap.h"
 #include "BLI_blenlib.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "MEM_guardedalloc.h"  // MEM_freeN
 
 #include "BKE_action.h"
@@ -199,6 +202,12 @@
 /** Use if we want to store how many bytes have been written to the file. */
 // #define USE_WRITE_DATA_LEN
 
+/**
+ * On undo, re-use the data of IDs which didn't change since the previous undo step,
+ * instead of writing and comparing it again, see #mywrite_id_begin.
+ */
+#define USE_MEMFILE_ID_REUSE
+
 /* -------------------------------------------------------------------- */
 /** \name Internal Write Wrapper's (Abstracts Compression)
  * \{ */
@@ -206,8 +215,11 @@
 typedef enum {
   WW_WRAP_NONE = 1,
   WW_WRAP_ZLIB,
+  WW_WRAP_ZLIB_FRAMES,
 } eWriteWrapType;
 
+struct ZlibFramesWrite;
+
 typedef struct WriteWrap WriteWrap;
 struct WriteWrap {
   /* callbacks */
@@ -222,6 +234,7 @@ struct WriteWrap {
   union {
     int file_handle;
     gzFile gz_handle;
+    struct ZlibFramesWrite *zlib_frames;
   } _user_data;
 };
 
@@ -279,6 +292,186 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* zlib frames (see #BLEND_ZLIB_FRAME_RAW_SIZE) */
+#define FILE_HANDLE(ww) (ww)->_user_data.zlib_frames
+
+typedef struct ZlibFrame {
+  struct ZlibFrame *next, *prev;
+  /** Uncompressed data, replaced by the compressed gzip member once compressed. */
+  char *buf;
+  size_t buf_len;
+  bool is_ok;
+} ZlibFrame;
+
+typedef struct ZlibFramesWrite {
+  int file_handle;
+  TaskPool *task_pool;
+  /** Frames being compressed, in file order. */
+  ListBase frames;
+  int frames_len;
+  /** Number of frames to compress before writing them. */
+  int frames_len_max;
+  /** Frame being filled. */
+  char *buf;
+  size_t buf_used;
+  bool has_error;
+} ZlibFramesWrite;
+
+static void ww_zlib_frame_uint32_encode(uchar *dst, const uint value)
+{
+  dst[0] = (uchar)(value & 0xff);
+  dst[1] = (uchar)((value >> 8) & 0xff);
+  dst[2] = (uchar)((value >> 16) & 0xff);
+  dst[3] = (uchar)((value >> 24) & 0xff);
+}
+
+static void ww_zlib_frame_compress_fn(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  ZlibFrame *frame = taskdata;
+  const Bytef *buf_raw = (const Bytef *)frame->buf;
+  const uint buf_raw_len = (uint)frame->buf_len;
+
+  z_stream strm = {NULL};
+  if (deflateInit2(&strm, 1, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return;
+  }
+
+  const uLong deflate_len_max = deflateBound(&strm, buf_raw_len);
+  uchar *member = MEM_mallocN(
+      BLEND_ZLIB_FRAME_HEADER_SIZE + deflate_len_max + BLEND_ZLIB_FRAME_FOOTER_SIZE, __func__);
+
+  strm.next_in = (Bytef *)buf_raw;
+  strm.avail_in = buf_raw_len;
+  strm.next_out = member + BLEND_ZLIB_FRAME_HEADER_SIZE;
+  strm.avail_out = (uInt)deflate_len_max;
+  const int ret = deflate(&strm, Z_FINISH);
+  const uLong deflate_len = strm.total_out;
+  deflateEnd(&strm);
+
+  if (ret != Z_STREAM_END) {
+    MEM_freeN(member);
+    return;
+  }
+
+  const uint member_len = (uint)(BLEND_ZLIB_FRAME_HEADER_SIZE + deflate_len +
+                                 BLEND_ZLIB_FRAME_FOOTER_SIZE);
+
+  /* Gzip header: magic, deflate, extra field present, no time-stamp, unknown OS. */
+  const uchar header[12] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 255, 12, 0};
+  memcpy(member, header, sizeof(header));
+  /* Extra field: sub-field ID and length, followed by the frame sizes. */
+  member[12] = 'B';
+  member[13] = 'L';
+  member[14] = 8;
+  member[15] = 0;
+  ww_zlib_frame_uint32_encode(&member[16], member_len);
+  ww_zlib_frame_uint32_encode(&member[20], buf_raw_len);
+
+  /* Gzip footer. */
+  uchar *footer = member + BLEND_ZLIB_FRAME_HEADER_SIZE + deflate_len;
+  ww_zlib_frame_uint32_encode(&footer[0], (uint)crc32(0, buf_raw, buf_raw_len));
+  ww_zlib_frame_uint32_encode(&footer[4], buf_raw_len);
+
+  MEM_freeN(frame->buf);
+  frame->buf = (char *)member;
+  frame->buf_len = member_len;
+  frame->is_ok = true;
+}
+
+static void ww_zlib_frame_push(ZlibFramesWrite *zf)
+{
+  ZlibFrame *frame = MEM_callocN(sizeof(*frame), __func__);
+  frame->buf = zf->buf;
+  frame->buf_len = zf->buf_used;
+  BLI_addtail(&zf->frames, frame);
+  zf->frames_len++;
+
+  zf->buf = NULL;
+  zf->buf_used = 0;
+
+  BLI_task_pool_push(zf->task_pool, ww_zlib_frame_compress_fn, frame, false, NULL);
+}
+
+/** Wait for all frames to be compressed and write them in order. */
+static void ww_zlib_frames_flush(ZlibFramesWrite *zf)
+{
+  BLI_task_pool_work_and_wait(zf->task_pool);
+
+  LISTBASE_FOREACH_MUTABLE (ZlibFrame *, frame, &zf->frames) {
+    if (!zf->has_error) {
+      if (!frame->is_ok ||
+          (size_t)write(zf->file_handle, frame->buf, frame->buf_len) != frame->buf_len) {
+        zf->has_error = true;
+      }
+    }
+    MEM_freeN(frame->buf);
+    MEM_freeN(frame);
+  }
+  BLI_listbase_clear(&zf->frames);
+  zf->frames_len = 0;
+}
+
+static bool ww_open_zlib_frames(WriteWrap *ww, const char *filepath)
+{
+  int file;
+
+  file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+
+  if (file != -1) {
+    ZlibFramesWrite *zf = MEM_callocN(sizeof(*zf), __func__);
+    zf->file_handle = file;
+    zf->task_pool = BLI_task_pool_create(zf, TASK_PRIORITY_HIGH);
+    /* Enough frames to keep all threads busy, while bounding memory usage. */
+    zf->frames_len_max = BLI_system_thread_count() * 2;
+    FILE_HANDLE(ww) = zf;
+    return true;
+  }
+  else {
+    return false;
+  }
+}
+static bool ww_close_zlib_frames(WriteWrap *ww)
+{
+  ZlibFramesWrite *zf = FILE_HANDLE(ww);
+
+  if (zf->buf_used != 0) {
+    ww_zlib_frame_push(zf);
+  }
+  ww_zlib_frames_flush(zf);
+  BLI_task_pool_free(zf->task_pool);
+  MEM_SAFE_FREE(zf->buf);
+
+  const bool ok = (close(zf->file_handle) != -1) && !zf->has_error;
+  MEM_freeN(zf);
+  return ok;
+}
+static size_t ww_write_zlib_frames(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+  ZlibFramesWrite *zf = FILE_HANDLE(ww);
+  const size_t buf_len_all = buf_len;
+
+  while (buf_len != 0) {
+    if (zf->buf == NULL) {
+      zf->buf = MEM_mallocN(BLEND_ZLIB_FRAME_RAW_SIZE, __func__);
+    }
+    const size_t len = MIN2(buf_len, BLEND_ZLIB_FRAME_RAW_SIZE - zf->buf_used);
+    memcpy(zf->buf + zf->buf_used, buf, len);
+    zf->buf_used += len;
+    buf += len;
+    buf_len -= len;
+
+    if (zf->buf_used == BLEND_ZLIB_FRAME_RAW_SIZE) {
+      ww_zlib_frame_push(zf);
+      if (zf->frames_len >= zf->frames_len_max) {
+        ww_zlib_frames_flush(zf);
+      }
+    }
+  }
+
+  return zf->has_error ? 0 : buf_len_all;
+}
+#undef FILE_HANDLE
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -293,6 +486,13 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
       r_ww->use_buf = false;
       break;
     }
+    case WW_WRAP_ZLIB_FRAMES: {
+      r_ww->open = ww_open_zlib_frames;
+      r_ww->close = ww_close_zlib_frames;
+      r_ww->write = ww_write_zlib_frames;
+      r_ww->use_buf = false;
+      break;
+    }
     default: {
       r_ww->open = ww_open_none;
       r_ww->close = ww_close_none;
@@ -326,14 +526,13 @@ typedef struct {
   bool error;
 
   /** #MemFile writing (used for undo). */
-  struct {
-    MemFile *current;
-    MemFile *compare;
-    /** Use to de-duplicate chunks when writing. */
-    MemFileChunk *compare_chunk;
-  } mem;
+  MemFileWriteData mem;
   /** When true, write to #WriteData.current, could also call 'is_undo'. */
   bool use_memfile;
+#ifdef USE_MEMFILE_ID_REUSE
+  /** When true, data of unchanged IDs is re-used from #MemFileWriteData.reference_memfile. */
+  bool use_memfile_id_reuse;
+#endif
 
   /**
    * Wrap writing, so we can use zlib or
@@ -370,7 +569,7 @@ static void writedata_do_write(WriteData *wd, const void *mem, int memlen)
 
   /* memory based save */
   if (wd->use_memfile) {
-    memfile_chunk_add(wd->mem.current, mem, memlen, &wd->mem.compare_chunk);
+    memfile_chunk_add(&wd->mem, mem, memlen);
   }
   else {
     if (wd->ww->write(wd->ww, mem, memlen) != memlen) {
@@ -471,9 +670,7 @@ static WriteData *mywrite_begin(WriteWrap *ww, MemFile *compare, MemFile *curren
   WriteData *wd = writedata_new(ww);
 
   if (current != NULL) {
-    wd->mem.current = current;
-    wd->mem.compare = compare;
-    wd->mem.compare_chunk = compare ? compare->chunks.first : NULL;
+    memfile_write_init(&wd->mem, current, compare);
     wd->use_memfile = true;
   }
 
@@ -493,12 +690,98 @@ static bool mywrite_end(WriteData *wd)
     wd->buf_used_len = 0;
   }
 
+  if (wd->use_memfile) {
+    memfile_write_finalize(&wd->mem);
+  }
+
   const bool err = wd->error;
   writedata_free(wd);
 
   return err;
 }
 
+#ifdef USE_MEMFILE_ID_REUSE
+/**
+ * Whether the recalc flags tell the ID didn't change since the previous undo push.
+ * Only trusted for ID types which changes are reliably tagged for update.
+ */
+static bool mywrite_id_is_unchanged(ID *id)
+{
+  if (!ELEM(GS(id->name),
+            ID_OB,
+            ID_ME,
+            ID_CU,
+            ID_MB,
+            ID_LT,
+            ID_AR,
+            ID_MA,
+            ID_TE,
+            ID_LA,
+            ID_CA,
+            ID_WO,
+            ID_SPK,
+            ID_LP,
+            ID_HA,
+            ID_PT,
+            ID_VO)) {
+    return false;
+  }
+  if (id->recalc_up_to_undo_push != 0) {
+    return false;
+  }
+  bNodeTree *nodetree = ntreeFromID(id);
+  if ((nodetree != NULL) && (nodetree->id.recalc_up_to_undo_push != 0)) {
+    return false;
+  }
+  return true;
+}
+#endif
+
+/**
+ * Start writing an ID, when writing undo data, all chunks until #mywrite_id_end belong to it.
+ *
+ * \param id_struct: Copy of the ID struct which is written.
+ * \return true when the ID data has been re-used from the previous undo step,
+ * in which case it must not be written.
+ */
+static bool mywrite_id_begin(WriteData *wd, ID *id, const void *id_struct, size_t id_struct_size)
+{
+  if (!wd->use_memfile) {
+    return false;
+  }
+
+  mywrite_flush(wd);
+
+  /* The address is part of the written data, IDs re-allocated (e.g. re-read on undo)
+   * never match their previous data. */
+  BLI_HashMurmur2A mm2;
+  BLI_hash_mm2a_init(&mm2, 0);
+  BLI_hash_mm2a_add(&mm2, (const uchar *)&id, sizeof(id));
+  BLI_hash_mm2a_add(&mm2, id_struct, id_struct_size);
+  const uint id_hash = BLI_hash_mm2a_end(&mm2);
+
+#ifdef USE_MEMFILE_ID_REUSE
+  if (wd->use_memfile_id_reuse && mywrite_id_is_unchanged(id)) {
+    if (memfile_id_reuse(&wd->mem, id->session_uuid, id_hash)) {
+      return true;
+    }
+  }
+#endif
+
+  memfile_id_begin(&wd->mem, id->session_uuid, id_hash);
+  return false;
+}
+
+static void mywrite_id_end(WriteData *wd)
+{
+  if (wd->use_memfile) {
+    /* Very important to do it after every ID write now, otherwise we cannot know whether a
+     * specific ID changed or not. */
+    mywrite_flush(wd);
+    memfile_id_end(&wd->mem);
+  }
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -4060,6 +4343,19 @@ static bool write_file_handle(Main *mainvar,
   OverrideLibraryStorage *override_storage =
       wd->use_memfile ? NULL : BKE_lib_override_library_operations_store_initialize();
 
+#ifdef USE_MEMFILE_ID_REUSE
+  if (wd->use_memfile && !mainvar->use_memfile_full_barrier) {
+    /* Edit and paint modes modify data without tagging it for update. */
+    wd->use_memfile_id_reuse = true;
+    LISTBASE_FOREACH (Object *, ob, &mainvar->objects) {
+      if (ob->mode != OB_MODE_OBJECT) {
+        wd->use_memfile_id_reuse = false;
+        break;
+      }
+    }
+  }
+#endif
+
 #define ID_BUFFER_STATIC_SIZE 8192
   /* This outer loop allows to save first data-blocks from real mainvar,
    * then the temp ones from override process,
@@ -4121,6 +4417,11 @@ static bool write_file_handle(Main *mainvar,
 
         ((ID *)id_buffer)->tag = 0;
 
+        if (mywrite_id_begin(wd, id, id_buffer, idtype_struct_size)) {
+          BLI_assert(!do_override);
+          continue;
+        }
+
         switch ((ID_Type)GS(id->name)) {
           case ID_WM:
             write_windowmanager(wd, (wmWindowManager *)id_buffer, id);
@@ -4253,11 +4554,7 @@ static bool write_file_handle(Main *mainvar,
           BKE_lib_override_library_operations_store_end(override_storage, id);
         }
 
-        if (wd->use_memfile) {
-          /* Very important to do it after every ID write now, otherwise we cannot know whether a
-           * specific ID changed or not. */
-          mywrite_flush(wd);
-        }
+        mywrite_id_end(wd);
       }
 
       if (id_buffer != id_buffer_static) {
@@ -4374,7 +4671,7 @@ bool BLO_write_file(Main *mainvar,
   BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
   if (write_flags & G_FILE_COMPRESS) {
-    ww_type = WW_WRAP_ZLIB;
+    ww_type = WW_WRAP_ZLIB_FRAMES;
   }
   else {
     ww_type = WW_WRAP_NONE;
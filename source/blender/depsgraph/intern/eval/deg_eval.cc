@@ -27,6 +27,8 @@
 
 #include "PIL_time.h"
 
+#include <algorithm>
+
 #include "BLI_compiler_attrs.h"
 #include "BLI_gsqueue.h"
 #include "BLI_task.h"
@@ -68,9 +70,36 @@ void schedule_children(DepsgraphEvalState *state,
                        ScheduleFunction *schedule_function,
                        ScheduleFunctionArgs... schedule_function_args);
 
-void schedule_node_to_pool(OperationNode *node, const int UNUSED(thread_id), TaskPool *pool)
+/* Weight of the latest measurement in the running average of operation evaluation time. */
+#define EVAL_TIME_AVERAGE_FACTOR 0.25f
+/* Estimated evaluation time of operations which were never timed yet (in seconds). Makes longer
+ * chains of operations preferred over shorter ones on the first evaluation of the graph. */
+#define EVAL_TIME_UNKNOWN 1e-6f
+
+void schedule_node_to_vector(OperationNode *node,
+                             const int UNUSED(thread_id),
+                             Vector<OperationNode *> *nodes)
+{
+  nodes->append(node);
+}
+
+bool critical_path_time_greater(const OperationNode *a, const OperationNode *b)
 {
-  BLI_task_pool_push(pool, deg_task_run_func, node, false, NULL);
+  return a->critical_path_time > b->critical_path_time;
+}
+
+/* Push nodes which are ready for evaluation to the pool, so the ones heading the longest chains
+ * of dependent operations start first. Those chains bound the total evaluation time, so they
+ * should start as early as possible, while shorter chains fill the remaining threads.
+ *
+ * A thread runs the tasks it pushed itself in last-in-first-out order, so the nodes are pushed
+ * in ascending order of their critical path time. */
+void push_nodes_to_pool(TaskPool *pool, OperationNode **nodes, int num_nodes)
+{
+  std::sort(nodes, nodes + num_nodes, critical_path_time_greater);
+  for (int i = num_nodes - 1; i >= 0; i--) {
+    BLI_task_pool_push(pool, deg_task_run_func, nodes[i], false, NULL);
+  }
 }
 
 /* Denotes which part of dependency graph is being evaluated. */
@@ -103,14 +132,20 @@ void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_nod
 
   /* Sanity checks. */
   BLI_assert(!operation_node->is_noop() && "NOOP nodes should not actually be scheduled");
-  /* Perform operation. */
+  /* Perform operation. Timing is always done, since it is used to prioritize operations on the
+   * critical path of the next evaluation. */
+  const double start_time = PIL_check_seconds_timer();
+  operation_node->evaluate(depsgraph);
+  const double eval_time = PIL_check_seconds_timer() - start_time;
   if (state->do_stats) {
-    const double start_time = PIL_check_seconds_timer();
-    operation_node->evaluate(depsgraph);
-    operation_node->stats.current_time += PIL_check_seconds_timer() - start_time;
+    operation_node->stats.current_time += eval_time;
+  }
+  if (operation_node->eval_time_average == 0.0f) {
+    operation_node->eval_time_average = (float)eval_time;
   }
   else {
-    operation_node->evaluate(depsgraph);
+    operation_node->eval_time_average += ((float)eval_time - operation_node->eval_time_average) *
+                                         EVAL_TIME_AVERAGE_FACTOR;
   }
 }
 
@@ -118,13 +153,25 @@ void deg_task_run_func(TaskPool *pool, void *taskdata)
 {
   void *userdata_v = BLI_task_pool_user_data(pool);
   DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
+  Vector<OperationNode *> ready_nodes;
 
-  /* Evaluate node. */
   OperationNode *operation_node = reinterpret_cast<OperationNode *>(taskdata);
-  evaluate_node(state, operation_node);
+  while (operation_node != NULL) {
+    /* Evaluate node. */
+    evaluate_node(state, operation_node);
 
-  /* Schedule children. */
-  schedule_children(state, operation_node, schedule_node_to_pool, pool);
+    /* Schedule children. The child with the longest critical path continues on this thread,
+     * which avoids going through the scheduler for chains of operations. */
+    ready_nodes.clear();
+    schedule_children(state, operation_node, schedule_node_to_vector, &ready_nodes);
+    if (ready_nodes.is_empty()) {
+      break;
+    }
+    OperationNode **nodes = ready_nodes.begin();
+    std::swap(nodes[0], *std::min_element(nodes, ready_nodes.end(), critical_path_time_greater));
+    operation_node = nodes[0];
+    push_nodes_to_pool(pool, nodes + 1, ready_nodes.size() - 1);
+  }
 }
 
 bool check_operation_node_visible(OperationNode *op_node)
@@ -177,10 +224,63 @@ void calculate_pending_parents(Depsgraph *graph)
   }
 }
 
+bool need_evaluate_operation(const OperationNode *node)
+{
+  return check_operation_node_visible(const_cast<OperationNode *>(node)) &&
+         (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0;
+}
+
+/* Estimate, for every operation which is to be evaluated, the time needed to evaluate it together
+ * with the longest chain of operations depending on it, based on timing of previous evaluations.
+ *
+ * Operations are visited in reverse topological order, which is found by a traversal following
+ * the same pending parents rules as the actual evaluation. Cyclic relations are ignored. */
+void calculate_critical_path_times(Depsgraph *graph)
+{
+  Vector<OperationNode *> sorted_nodes;
+  for (OperationNode *node : graph->operations) {
+    if (!need_evaluate_operation(node)) {
+      continue;
+    }
+    node->custom_flags = node->num_links_pending;
+    if (node->custom_flags == 0) {
+      sorted_nodes.append(node);
+    }
+  }
+  for (uint i = 0; i < sorted_nodes.size(); i++) {
+    for (Relation *rel : sorted_nodes[i]->outlinks) {
+      OperationNode *child = (OperationNode *)rel->to;
+      if ((rel->flag & RELATION_FLAG_CYCLIC) != 0 || !need_evaluate_operation(child)) {
+        continue;
+      }
+      if (--child->custom_flags == 0) {
+        sorted_nodes.append(child);
+      }
+    }
+  }
+  for (int i = sorted_nodes.size() - 1; i >= 0; i--) {
+    OperationNode *node = sorted_nodes[i];
+    float children_time = 0.0f;
+    for (Relation *rel : node->outlinks) {
+      OperationNode *child = (OperationNode *)rel->to;
+      if ((rel->flag & RELATION_FLAG_CYCLIC) != 0 || !need_evaluate_operation(child)) {
+        continue;
+      }
+      children_time = max(children_time, child->critical_path_time);
+    }
+    float eval_time = 0.0f;
+    if (!node->is_noop()) {
+      eval_time = (node->eval_time_average != 0.0f) ? node->eval_time_average : EVAL_TIME_UNKNOWN;
+    }
+    node->critical_path_time = eval_time + children_time;
+  }
+}
+
 void initialize_execution(DepsgraphEvalState *state, Depsgraph *graph)
 {
   const bool do_stats = state->do_stats;
   calculate_pending_parents(graph);
+  calculate_critical_path_times(graph);
   /* Clear tags and other things which needs to be clear. */
   for (OperationNode *node : graph->operations) {
     if (do_stats) {
@@ -306,6 +406,13 @@ void schedule_children(DepsgraphEvalState *state,
   }
 }
 
+void schedule_graph_to_pool(DepsgraphEvalState *state, TaskPool *pool)
+{
+  Vector<OperationNode *> ready_nodes;
+  schedule_graph(state, schedule_node_to_vector, &ready_nodes);
+  push_nodes_to_pool(pool, ready_nodes.begin(), ready_nodes.size());
+}
+
 void schedule_node_to_queue(OperationNode *node,
                             const int /*thread_id*/,
                             GSQueue *evaluation_queue)
@@ -387,14 +494,14 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   /* First, process all Copy-On-Write nodes. */
   state.stage = EvaluationStage::COPY_ON_WRITE;
   TaskPool *task_pool = deg_evaluate_task_pool_create(&state);
-  schedule_graph(&state, schedule_node_to_pool, task_pool);
+  schedule_graph_to_pool(&state, task_pool);
   BLI_task_pool_work_and_wait(task_pool);
   BLI_task_pool_free(task_pool);
 
   /* After that, process all other nodes. */
   state.stage = EvaluationStage::THREADED_EVALUATION;
   task_pool = deg_evaluate_task_pool_create(&state);
-  schedule_graph(&state, schedule_node_to_pool, task_pool);
+  schedule_graph_to_pool(&state, task_pool);
   BLI_task_pool_work_and_wait(task_pool);
   BLI_task_pool_free(task_pool);
 
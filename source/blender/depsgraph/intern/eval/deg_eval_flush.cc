@@ -32,6 +32,7 @@
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
 
+#include "BKE_animsys.h"
 #include "BKE_object.h"
 #include "BKE_scene.h"
 
@@ -69,6 +70,15 @@ extern "C" {
 // catch usage of invalid state.
 #undef INVALIDATE_ON_FLUSH
 
+// Only flush updates from animation which changed animated values on frame change.
+//
+// Animation of data-blocks which are only tagged for update because of the time
+// change is evaluated as part of the flush, and updates are only flushed further
+// when any of the animated properties got a different value. This avoids
+// re-evaluating everything what depends on animation which is constant over some
+// range of frames (held keys, stepped animation and such).
+#define USE_ANIMATION_CHANGE_DETECTION
+
 namespace DEG {
 
 enum {
@@ -83,6 +93,7 @@ enum {
 };
 
 typedef deque<OperationNode *> FlushQueue;
+typedef Vector<OperationNode *> FlushAnimationDeferred;
 
 namespace {
 
@@ -102,6 +113,7 @@ BLI_INLINE void flush_prepare(Depsgraph *graph)
 {
   for (OperationNode *node : graph->operations) {
     node->scheduled = false;
+    node->custom_flags = 0;
   }
 
   {
@@ -162,13 +174,34 @@ BLI_INLINE void flush_handle_component_node(IDNode *id_node,
   }
 }
 
+#ifdef USE_ANIMATION_CHANGE_DETECTION
+/* Check whether flush from the given operation to the entry of data-block's animation
+ * can be postponed until it is known whether the animation changes anything. This is
+ * the case when an action is flushed because of time change only. */
+BLI_INLINE bool flush_can_defer_animation(const OperationNode *op_node,
+                                          const OperationNode *to_node)
+{
+  if (to_node->opcode != OperationCode::ANIMATION_ENTRY ||
+      to_node->owner->type != NodeType::ANIMATION) {
+    return false;
+  }
+  if (op_node->flag & DEPSOP_FLAG_USER_MODIFIED) {
+    return false;
+  }
+  const ComponentNode *comp_node = op_node->owner;
+  return comp_node->type == NodeType::ANIMATION && GS(comp_node->owner->id_orig->name) == ID_AC;
+}
+#endif
+
 /* Schedule children of the given operation node for traversal.
  *
  * One of the children will by-pass the queue and will be returned as a function
  * return value, so it can start being handled right away, without building too
  * much of a queue.
  */
-BLI_INLINE OperationNode *flush_schedule_children(OperationNode *op_node, FlushQueue *queue)
+BLI_INLINE OperationNode *flush_schedule_children(OperationNode *op_node,
+                                                  FlushQueue *queue,
+                                                  FlushAnimationDeferred *animation_deferred)
 {
   if (op_node->flag & DEPSOP_FLAG_USER_MODIFIED) {
     IDNode *id_node = op_node->owner->owner;
@@ -195,6 +228,17 @@ BLI_INLINE OperationNode *flush_schedule_children(OperationNode *op_node, FlushQ
     if (to_node->scheduled) {
       continue;
     }
+#ifdef USE_ANIMATION_CHANGE_DETECTION
+    if (animation_deferred != nullptr && flush_can_defer_animation(op_node, to_node)) {
+      if (to_node->custom_flags == 0) {
+        to_node->custom_flags = 1;
+        animation_deferred->append(to_node);
+      }
+      continue;
+    }
+#else
+    UNUSED_VARS(animation_deferred);
+#endif
     if (result != nullptr) {
       queue->push_front(to_node);
     }
@@ -206,6 +250,137 @@ BLI_INLINE OperationNode *flush_schedule_children(OperationNode *op_node, FlushQ
   return result;
 }
 
+void flush_queue(FlushQueue *queue, FlushAnimationDeferred *animation_deferred)
+{
+  while (!queue->empty()) {
+    OperationNode *op_node = queue->front();
+    queue->pop_front();
+    while (op_node != nullptr) {
+      /* Tag operation as required for update. */
+      op_node->flag |= DEPSOP_FLAG_NEEDS_UPDATE;
+      /* Inform corresponding ID and component nodes about the change. */
+      ComponentNode *comp_node = op_node->owner;
+      IDNode *id_node = comp_node->owner;
+      flush_handle_id_node(id_node);
+      flush_handle_component_node(id_node, comp_node, queue);
+      /* Flush to nodes along links. */
+      op_node = flush_schedule_children(op_node, queue, animation_deferred);
+    }
+  }
+}
+
+#ifdef USE_ANIMATION_CHANGE_DETECTION
+/* Check whether animation component can be evaluated ahead of the graph evaluation: it is
+ * to be evaluated, its copy-on-write data-block is up to date and it does not depend on
+ * anything other than actions and copy-on-write. */
+bool flush_can_evaluate_animation(const ComponentNode *comp_node)
+{
+  if (!comp_node->affects_directly_visible) {
+    return false;
+  }
+  const IDNode *id_node = comp_node->owner;
+  if (!deg_copy_on_write_is_expanded(id_node->id_cow)) {
+    return false;
+  }
+  for (const OperationNode *op_node : comp_node->operations) {
+    for (const Relation *rel : op_node->inlinks) {
+      if (rel->from->type != NodeType::OPERATION) {
+        return false;
+      }
+      const OperationNode *from = (const OperationNode *)rel->from;
+      const ComponentNode *from_comp_node = from->owner;
+      if (from_comp_node == comp_node) {
+        continue;
+      }
+      if (from_comp_node->type == NodeType::ANIMATION &&
+          GS(from_comp_node->owner->id_orig->name) == ID_AC) {
+        continue;
+      }
+      if (from_comp_node->type == NodeType::COPY_ON_WRITE &&
+          (from->flag & DEPSOP_FLAG_NEEDS_UPDATE) == 0) {
+        continue;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+struct FlushAnimationData {
+  Depsgraph *graph;
+  Vector<OperationNode *> entry_nodes;
+  Vector<bool> changed;
+};
+
+void flush_evaluate_animation_func(void *__restrict data_v,
+                                   const int i,
+                                   const TaskParallelTLS *__restrict /*tls*/)
+{
+  FlushAnimationData *data = (FlushAnimationData *)data_v;
+  const IDNode *id_node = data->entry_nodes[i]->owner->owner;
+  data->changed[i] = BKE_animsys_eval_animdata_check_changed((::Depsgraph *)data->graph,
+                                                             id_node->id_cow);
+}
+
+/* Evaluate animation which flush was deferred, and only continue flushing from the
+ * animation which changed some values. Animation which can not be evaluated ahead of
+ * the graph evaluation is flushed as usual.
+ *
+ * The evaluated animation components are not tagged for update, so they are not
+ * evaluated again. */
+void flush_deferred_animation(Depsgraph *graph,
+                              const FlushAnimationDeferred &animation_deferred,
+                              FlushQueue *queue)
+{
+  FlushAnimationData data;
+  data.graph = graph;
+  for (OperationNode *op_node : animation_deferred) {
+    if (op_node->scheduled) {
+      /* Was flushed from other changes. */
+      continue;
+    }
+    if (!flush_can_evaluate_animation(op_node->owner)) {
+      queue->push_back(op_node);
+      op_node->scheduled = true;
+      continue;
+    }
+    data.entry_nodes.append(op_node);
+  }
+  if (data.entry_nodes.is_empty()) {
+    return;
+  }
+  data.changed.append_n_times(false, data.entry_nodes.size());
+
+  graph->is_evaluating = true;
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 8;
+  BLI_task_parallel_range(
+      0, data.entry_nodes.size(), &data, flush_evaluate_animation_func, &settings);
+  graph->is_evaluating = false;
+
+  for (uint i = 0; i < data.entry_nodes.size(); i++) {
+    ComponentNode *comp_node = data.entry_nodes[i]->owner;
+    if (!data.changed[i]) {
+      DEG_DEBUG_PRINTF((::Depsgraph *)graph,
+                       EVAL,
+                       "Animation did not change, not flushing: %s\n",
+                       comp_node->owner->id_orig->name);
+      continue;
+    }
+    /* Mark component as changed without tagging its operations, and flush from its exit. */
+    flush_handle_id_node(comp_node->owner);
+    comp_node->custom_flags = COMPONENT_STATE_DONE;
+    OperationNode *exit_node = comp_node->get_exit_operation();
+    exit_node->scheduled = true;
+    OperationNode *child = flush_schedule_children(exit_node, queue, nullptr);
+    if (child != nullptr) {
+      queue->push_front(child);
+    }
+  }
+}
+#endif
+
 void flush_engine_data_update(ID *id)
 {
   DrawDataList *draw_data_list = DRW_drawdatalist_from_id(id);
@@ -358,21 +533,14 @@ void deg_graph_flush_updates(Main *bmain, Depsgraph *graph)
   update_ctx.scene = graph->scene;
   update_ctx.view_layer = graph->view_layer;
   /* Do actual flush. */
-  while (!queue.empty()) {
-    OperationNode *op_node = queue.front();
-    queue.pop_front();
-    while (op_node != nullptr) {
-      /* Tag operation as required for update. */
-      op_node->flag |= DEPSOP_FLAG_NEEDS_UPDATE;
-      /* Inform corresponding ID and component nodes about the change. */
-      ComponentNode *comp_node = op_node->owner;
-      IDNode *id_node = comp_node->owner;
-      flush_handle_id_node(id_node);
-      flush_handle_component_node(id_node, comp_node, &queue);
-      /* Flush to nodes along links. */
-      op_node = flush_schedule_children(op_node, &queue);
-    }
+#ifdef USE_ANIMATION_CHANGE_DETECTION
+  if (graph->need_update_time) {
+    FlushAnimationDeferred animation_deferred;
+    flush_queue(&queue, &animation_deferred);
+    flush_deferred_animation(graph, animation_deferred, &queue);
   }
+#endif
+  flush_queue(&queue, nullptr);
   /* Inform editors about all changes. */
   flush_editors_id_update(graph, &update_ctx);
   /* Reset evaluation result tagged which is tagged for update to some state
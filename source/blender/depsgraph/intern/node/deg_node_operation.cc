@@ -199,7 +199,8 @@ const char *operationCodeAsString(OperationCode opcode)
   return "UNKNOWN";
 }
 
-OperationNode::OperationNode() : name_tag(-1), flag(0)
+OperationNode::OperationNode()
+    : eval_time_average(0.0f), critical_path_time(0.0f), name_tag(-1), flag(0)
 {
 }
 
@@ -258,6 +258,13 @@ struct OperationNode : public Node {
   uint32_t num_links_pending;
   bool scheduled;
 
+  /* Running average of the time spent evaluating this operation (in seconds). Kept across graph
+   * evaluations, so that the scheduler can estimate the cost of the next evaluation. */
+  float eval_time_average;
+  /* Estimated time to evaluate this operation and the longest chain of operations depending on
+   * it. Calculated for tagged operations prior to every evaluation. */
+  float critical_path_time;
+
   /* Identifier for the operation being performed. */
   OperationCode opcode;
   int name_tag;
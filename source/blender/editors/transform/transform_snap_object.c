@@ -366,6 +366,25 @@ typedef void (*IterSnapObjsCallback)(SnapObjectContext *sctx,
                                      float obmat[4][4],
                                      void *data);
 
+typedef struct IterDupliData {
+  SnapObjectContext *sctx;
+  bool use_object_edit_cage;
+  bool use_backface_culling;
+  IterSnapObjsCallback sob_callback;
+  void *data;
+} IterDupliData;
+
+static void iter_snap_objects_dupli_cb(DupliObject *dob, void *userdata)
+{
+  IterDupliData *dupli_data = userdata;
+  dupli_data->sob_callback(dupli_data->sctx,
+                           dupli_data->use_object_edit_cage,
+                           dupli_data->use_backface_culling,
+                           dob->ob,
+                           dob->mat,
+                           dupli_data->data);
+}
+
 /**
  * Walks through all objects in the scene to create the list of objects to snap.
  *
@@ -411,13 +430,15 @@ static void iter_snap_objects(SnapObjectContext *sctx,
 
     Object *obj_eval = DEG_get_evaluated_object(depsgraph, base->object);
     if (obj_eval->transflag & OB_DUPLI) {
-      DupliObject *dupli_ob;
-      ListBase *lb = object_duplilist(depsgraph, sctx->scene, obj_eval);
-      for (dupli_ob = lb->first; dupli_ob; dupli_ob = dupli_ob->next) {
-        sob_callback(
-            sctx, use_object_edit_cage, use_backface_culling, dupli_ob->ob, dupli_ob->mat, data);
-      }
-      free_object_duplilist(lb);
+      IterDupliData dupli_data = {
+          .sctx = sctx,
+          .use_object_edit_cage = use_object_edit_cage,
+          .use_backface_culling = use_backface_culling,
+          .sob_callback = sob_callback,
+          .data = data,
+      };
+      object_duplilist_foreach(
+          depsgraph, sctx->scene, obj_eval, iter_snap_objects_dupli_cb, &dupli_data);
     }
 
     sob_callback(
@@ -112,6 +112,9 @@ static int memfile_undosys_step_id_reused_cb(LibraryIDLinkCallbackData *cb_data)
 
   ID *id = *id_pointer;
   if (id != NULL && id->lib == NULL && (id->tag & LIB_TAG_UNDO_OLD_ID_REUSED) == 0) {
+    /* The re-used ID now points to another address, its undo data changed too. */
+    id_self->tag |= LIB_TAG_DOIT;
+
     bool do_stop_iter = true;
     if (GS(id_self->name) == ID_OB) {
       Object *ob_self = (Object *)id_self;
@@ -214,6 +217,7 @@ static void memfile_undosys_step_decode(struct bContext *C,
      * data-blocks, at least COW evaluated copies need to be updated... */
     ID *id = NULL;
     FOREACH_MAIN_ID_BEGIN (bmain, id) {
+      id->tag &= ~LIB_TAG_DOIT;
       if (id->tag & LIB_TAG_UNDO_OLD_ID_REUSED) {
         BKE_library_foreach_ID_link(
             bmain, id, memfile_undosys_step_id_reused_cb, bmain, IDWALK_READONLY);
@@ -235,6 +239,11 @@ static void memfile_undosys_step_decode(struct bContext *C,
        * are already part of the current undo state. This is done in a second
        * loop because DEG_id_tag_update may set tags on other datablocks. */
       id->recalc_after_undo_push = 0;
+      if (id->tag & LIB_TAG_DOIT) {
+        /* Don't let the next undo push re-use the data written for this ID. */
+        id->recalc_after_undo_push = ID_RECALC_COPY_ON_WRITE;
+        id->tag &= ~LIB_TAG_DOIT;
+      }
       bNodeTree *nodetree = ntreeFromID(id);
       if (nodetree != NULL) {
         nodetree->id.recalc_after_undo_push = 0;
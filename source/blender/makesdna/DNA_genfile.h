@@ -28,6 +28,7 @@
 #include "intern/dna_utils.h"
 
 struct SDNA;
+typedef struct DNA_ReconstructInfo DNA_ReconstructInfo;
 
 /**
  * DNAstr contains the prebuilt SDNA structure defining the layouts of the types
@@ -94,9 +95,12 @@ int DNA_struct_find_nr_ex(const struct SDNA *sdna, const char *str, unsigned int
 int DNA_struct_find_nr(const struct SDNA *sdna, const char *str);
 void DNA_struct_switch_endian(const struct SDNA *oldsdna, int oldSDNAnr, char *data);
 const char *DNA_struct_get_compareflags(const struct SDNA *sdna, const struct SDNA *newsdna);
-void *DNA_struct_reconstruct(const struct SDNA *newsdna,
-                             const struct SDNA *oldsdna,
-                             const char *compflags,
+
+struct DNA_ReconstructInfo *DNA_reconstruct_info_create(const struct SDNA *oldsdna,
+                                                        const struct SDNA *newsdna,
+                                                        const char *compflags);
+void DNA_reconstruct_info_free(struct DNA_ReconstructInfo *reconstruct_info);
+void *DNA_struct_reconstruct(const struct DNA_ReconstructInfo *reconstruct_info,
                              int oldSDNAnr,
                              int blocks,
                              const void *data);
@@ -101,6 +101,8 @@ typedef struct Mesh_Runtime {
 
   /** 'BVHCache', for 'BKE_bvhutil.c' */
   struct LinkNode *bvh_cache;
+  /** Trees of the previous evaluated mesh, refitted when the topology matches. */
+  struct LinkNode *bvh_cache_reuse;
 
   /** Non-manifold boundary data for Shrinkwrap Target Project. */
   struct ShrinkwrapBoundaryData *shrinkwrap_data;
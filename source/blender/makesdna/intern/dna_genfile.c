@@ -799,27 +799,23 @@ static eSDNA_Type sdna_type_nr(const char *dna_type)
  * Note there is no optimization for the case where otype and ctype are the same:
  * assumption is that caller will handle this case.
  *
- * \param ctype: Name of type to convert to
- * \param otype: Name of type to convert from
+ * \param ctypenr: Type to convert to
+ * \param otypenr: Type to convert from
  * \param name_array_len: Result of #DNA_elem_array_size for this element.
  * \param curdata: Where to put converted data
  * \param olddata: Data of type otype to convert
  */
-static void cast_elem(
-    const char *ctype, const char *otype, int name_array_len, char *curdata, const char *olddata)
+static void cast_elem(const eSDNA_Type ctypenr,
+                      const eSDNA_Type otypenr,
+                      int name_array_len,
+                      char *curdata,
+                      const char *olddata)
 {
   double val = 0.0;
-  int curlen = 1, oldlen = 1;
-
-  eSDNA_Type ctypenr, otypenr;
-
-  if ((otypenr = sdna_type_nr(otype)) == -1 || (ctypenr = sdna_type_nr(ctype)) == -1) {
-    return;
-  }
 
   /* define lengths */
-  oldlen = DNA_elem_type_size(otypenr);
-  curlen = DNA_elem_type_size(ctypenr);
+  const int oldlen = DNA_elem_type_size(otypenr);
+  const int curlen = DNA_elem_type_size(ctypenr);
 
   while (name_array_len > 0) {
     switch (otypenr) {
@@ -1023,31 +1019,25 @@ static bool elem_exists_alias(const SDNA *sdna,
 }
 
 /**
- * Returns the address of the data for the specified field within olddata
- * according to the struct format pointed to by old, or NULL if no such
- * field can be found.
- *
- * Passing olddata=NULL doesn't work reliably for existence checks; it will
- * return NULL both when the field is found at offset 0 and when it is not
- * found at all. For field existence checks, use #elem_exists() instead.
+ * Returns the offset of the specified field within the struct format pointed to by old,
+ * or -1 if no such field can be found.
  *
  * \param sdna: Old SDNA
  * \param type: Current field type name
  * \param name: Current field name
  * \param old: Pointer to struct information in sdna
- * \param olddata: Struct data
  * \param sppo: Optional place to return pointer to field info in sdna
- * \return Data address.
+ * \return Data offset.
  */
-static const char *find_elem(const SDNA *sdna,
-                             const char *type,
-                             const char *name,
-                             const short *old,
-                             const char *olddata,
-                             const short **sppo)
+static int find_elem_offset(const SDNA *sdna,
+                            const char *type,
+                            const char *name,
+                            const short *old,
+                            const short **sppo)
 {
   int a, elemcount, len;
   const char *otype, *oname;
+  int offset = 0;
 
   /* without arraypart, so names can differ: return old namenr and type */
 
@@ -1066,36 +1056,205 @@ static const char *find_elem(const SDNA *sdna,
         if (sppo) {
           *sppo = old;
         }
-        return olddata;
+        return offset;
       }
 
-      return NULL;
+      return -1;
     }
 
-    olddata += len;
+    offset += len;
   }
-  return NULL;
+  return -1;
 }
 
 /**
- * Converts the contents of a single field of a struct, of a non-struct type,
+ * Returns the address of the data for the specified field within olddata
+ * according to the struct format pointed to by old, or NULL if no such
+ * field can be found.
+ *
+ * Passing olddata=NULL doesn't work reliably for existence checks; it will
+ * return NULL both when the field is found at offset 0 and when it is not
+ * found at all. For field existence checks, use #elem_exists() instead.
+ *
+ * \param sdna: Old SDNA
+ * \param type: Current field type name
+ * \param name: Current field name
+ * \param old: Pointer to struct information in sdna
+ * \param olddata: Struct data
+ * \param sppo: Optional place to return pointer to field info in sdna
+ * \return Data address.
+ */
+static const char *find_elem(const SDNA *sdna,
+                             const char *type,
+                             const char *name,
+                             const short *old,
+                             const char *olddata,
+                             const short **sppo)
+{
+  const int offset = find_elem_offset(sdna, type, name, old, sppo);
+  return (offset != -1) ? olddata + offset : NULL;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Struct Reconstruction
+ *
+ * Converting structs from oldsdna to newsdna is done in two passes:
+ * first, for every struct that differs, the conversion is compiled into a flat list of
+ * #ReconstructStep (memory copies, casts and nested struct conversions),
+ * this is done once per (oldsdna, newsdna) pair by #DNA_reconstruct_info_create.
+ * These steps are then executed for every block read from the file,
+ * avoiding the (slow) name lookups and string comparisons for each struct instance.
+ * \{ */
+
+typedef enum eReconstructStepType {
+  RECONSTRUCT_STEP_MEMCPY,
+  RECONSTRUCT_STEP_CAST_PRIMITIVE,
+  RECONSTRUCT_STEP_CAST_POINTER_64_TO_32,
+  RECONSTRUCT_STEP_CAST_POINTER_32_TO_64,
+  RECONSTRUCT_STEP_SUBSTRUCT,
+} eReconstructStepType;
+
+typedef struct ReconstructStep {
+  eReconstructStepType type;
+  union {
+    struct {
+      int old_offset;
+      int new_offset;
+      int size;
+    } memcpy;
+    struct {
+      int old_offset;
+      int new_offset;
+      int array_len;
+      eSDNA_Type old_type;
+      eSDNA_Type new_type;
+    } cast_primitive;
+    struct {
+      int old_offset;
+      int new_offset;
+      int array_len;
+    } cast_pointer;
+    struct {
+      int old_offset;
+      int new_offset;
+      int array_len;
+      short old_struct_nr;
+      short new_struct_nr;
+    } substruct;
+  } data;
+} ReconstructStep;
+
+struct DNA_ReconstructInfo {
+  const SDNA *oldsdna;
+  const SDNA *newsdna;
+  const char *compflags;
+
+  /** Per struct in oldsdna (NULL for structs which don't need reconstruction). */
+  ReconstructStep **steps;
+  int *steps_len;
+};
+
+/**
+ * Add a memory copy step, merging it with the previous step when both
+ * the old and new memory ranges are contiguous.
+ */
+static void reconstruct_step_add_memcpy(ReconstructStep *steps,
+                                        int *steps_len,
+                                        const int old_offset,
+                                        const int new_offset,
+                                        const int size)
+{
+  if (size <= 0) {
+    return;
+  }
+  if (*steps_len > 0) {
+    ReconstructStep *step_prev = &steps[*steps_len - 1];
+    if (step_prev->type == RECONSTRUCT_STEP_MEMCPY &&
+        step_prev->data.memcpy.old_offset + step_prev->data.memcpy.size == old_offset &&
+        step_prev->data.memcpy.new_offset + step_prev->data.memcpy.size == new_offset) {
+      step_prev->data.memcpy.size += size;
+      return;
+    }
+  }
+  ReconstructStep *step = &steps[(*steps_len)++];
+  step->type = RECONSTRUCT_STEP_MEMCPY;
+  step->data.memcpy.old_offset = old_offset;
+  step->data.memcpy.new_offset = new_offset;
+  step->data.memcpy.size = size;
+}
+
+static void reconstruct_step_add_cast_pointer(ReconstructStep *steps,
+                                              int *steps_len,
+                                              const SDNA *oldsdna,
+                                              const SDNA *newsdna,
+                                              const int old_offset,
+                                              const int new_offset,
+                                              const int array_len)
+{
+  if (newsdna->pointer_size == oldsdna->pointer_size) {
+    reconstruct_step_add_memcpy(
+        steps, steps_len, old_offset, new_offset, array_len * newsdna->pointer_size);
+    return;
+  }
+  ReconstructStep *step = &steps[(*steps_len)++];
+  if (newsdna->pointer_size == 4 && oldsdna->pointer_size == 8) {
+    step->type = RECONSTRUCT_STEP_CAST_POINTER_64_TO_32;
+  }
+  else if (newsdna->pointer_size == 8 && oldsdna->pointer_size == 4) {
+    step->type = RECONSTRUCT_STEP_CAST_POINTER_32_TO_64;
+  }
+  else {
+    /* Pointer sizes are validated by #init_structDNA. */
+    BLI_assert(!"Unsupported pointer size");
+    (*steps_len)--;
+    return;
+  }
+  step->data.cast_pointer.old_offset = old_offset;
+  step->data.cast_pointer.new_offset = new_offset;
+  step->data.cast_pointer.array_len = array_len;
+}
+
+static void reconstruct_step_add_cast_primitive(ReconstructStep *steps,
+                                                int *steps_len,
+                                                const char *otype,
+                                                const char *type,
+                                                const int old_offset,
+                                                const int new_offset,
+                                                const int array_len)
+{
+  const eSDNA_Type otypenr = sdna_type_nr(otype);
+  const eSDNA_Type ctypenr = sdna_type_nr(type);
+  if (otypenr == -1 || ctypenr == -1) {
+    return;
+  }
+  ReconstructStep *step = &steps[(*steps_len)++];
+  step->type = RECONSTRUCT_STEP_CAST_PRIMITIVE;
+  step->data.cast_primitive.old_offset = old_offset;
+  step->data.cast_primitive.new_offset = new_offset;
+  step->data.cast_primitive.array_len = array_len;
+  step->data.cast_primitive.old_type = otypenr;
+  step->data.cast_primitive.new_type = ctypenr;
+}
+
+/**
+ * Compile the steps converting a single field of a struct, of a non-struct type,
  * from oldsdna to newsdna format.
  *
  * \param newsdna: SDNA of current Blender
  * \param oldsdna: SDNA of Blender that saved file
  * \param type: current field type name
  * \param new_name_nr: current field name number.
- * \param curdata: put field data converted to newsdna here
+ * \param new_offset: offset of the field in the current struct
  * \param old: pointer to struct info in oldsdna
- * \param olddata: struct contents laid out according to oldsdna
  */
-static void reconstruct_elem(const SDNA *newsdna,
-                             const SDNA *oldsdna,
-                             const char *type,
-                             const int new_name_nr,
-                             char *curdata,
-                             const short *old,
-                             const char *olddata)
+static void reconstruct_elem_compile(const SDNA *newsdna,
+                                     const SDNA *oldsdna,
+                                     const char *type,
+                                     const int new_name_nr,
+                                     const int new_offset,
+                                     const short *old,
+                                     ReconstructStep *steps,
+                                     int *steps_len)
 {
   /* rules: test for NAME:
    *      - name equal:
@@ -1108,6 +1267,7 @@ static void reconstruct_elem(const SDNA *newsdna,
    */
   int a, elemcount, len, countpos, mul;
   const char *otype, *oname, *cp;
+  int old_offset = 0;
 
   /* is 'name' an array? */
   const char *name = newsdna->names[new_name_nr];
@@ -1133,17 +1293,25 @@ static void reconstruct_elem(const SDNA *newsdna,
     if (strcmp(name, oname) == 0) { /* name equal */
 
       if (ispointer(name)) { /* pointer of functionpointer afhandelen */
-        cast_pointer(newsdna->pointer_size,
-                     oldsdna->pointer_size,
-                     newsdna->names_array_len[new_name_nr],
-                     curdata,
-                     olddata);
+        reconstruct_step_add_cast_pointer(steps,
+                                          steps_len,
+                                          oldsdna,
+                                          newsdna,
+                                          old_offset,
+                                          new_offset,
+                                          newsdna->names_array_len[new_name_nr]);
       }
       else if (strcmp(type, otype) == 0) { /* type equal */
-        memcpy(curdata, olddata, len);
+        reconstruct_step_add_memcpy(steps, steps_len, old_offset, new_offset, len);
       }
       else {
-        cast_elem(type, otype, newsdna->names_array_len[new_name_nr], curdata, olddata);
+        reconstruct_step_add_cast_primitive(steps,
+                                            steps_len,
+                                            otype,
+                                            type,
+                                            old_offset,
+                                            new_offset,
+                                            newsdna->names_array_len[new_name_nr]);
       }
 
       return;
@@ -1156,8 +1324,8 @@ static void reconstruct_elem(const SDNA *newsdna,
         const int min_name_array_len = MIN2(new_name_array_len, old_name_array_len);
 
         if (ispointer(name)) { /* handle pointer or functionpointer */
-          cast_pointer(
-              newsdna->pointer_size, oldsdna->pointer_size, min_name_array_len, curdata, olddata);
+          reconstruct_step_add_cast_pointer(
+              steps, steps_len, oldsdna, newsdna, old_offset, new_offset, min_name_array_len);
         }
         else if (strcmp(type, otype) == 0) { /* type equal */
           /* size of single old array element */
@@ -1165,75 +1333,51 @@ static void reconstruct_elem(const SDNA *newsdna,
           /* smaller of sizes of old and new arrays */
           mul *= min_name_array_len;
 
-          memcpy(curdata, olddata, mul);
-
           if (old_name_array_len > new_name_array_len && strcmp(type, "char") == 0) {
-            /* string had to be truncated, ensure it's still null-terminated */
-            curdata[mul - 1] = '\0';
+            /* String had to be truncated, leave the last (zero initialized) byte
+             * so it's still null-terminated. */
+            mul -= 1;
           }
+
+          reconstruct_step_add_memcpy(steps, steps_len, old_offset, new_offset, mul);
         }
         else {
-          cast_elem(type, otype, min_name_array_len, curdata, olddata);
+          reconstruct_step_add_cast_primitive(
+              steps, steps_len, otype, type, old_offset, new_offset, min_name_array_len);
         }
         return;
       }
     }
-    olddata += len;
+    old_offset += len;
   }
 }
 
 /**
- * Converts the contents of an entire struct from oldsdna to newsdna format.
+ * Compile the steps converting the contents of an entire struct from oldsdna to newsdna format.
  *
  * \param newsdna: SDNA of current Blender
  * \param oldsdna: SDNA of Blender that saved file
- * \param compflags:
- *
- * Result from DNA_struct_get_compareflags to avoid needless conversions.
  * \param oldSDNAnr: Index of old struct definition in oldsdna
- * \param data: Struct contents laid out according to oldsdna
  * \param curSDNAnr: Index of current struct definition in newsdna
- * \param cur: Where to put converted struct contents
+ * \param r_steps_len: Return the number of steps.
+ * \return The allocated steps.
  */
-static void reconstruct_struct(const SDNA *newsdna,
-                               const SDNA *oldsdna,
-                               const char *compflags,
-
-                               int oldSDNAnr,
-                               const char *data,
-                               int curSDNAnr,
-                               char *cur)
+static ReconstructStep *reconstruct_struct_compile(const SDNA *newsdna,
+                                                   const SDNA *oldsdna,
+                                                   const char *compflags,
+                                                   const int oldSDNAnr,
+                                                   const int curSDNAnr,
+                                                   int *r_steps_len)
 {
-  /* Recursive!
-   * Per element from cur_struct, read data from old_struct.
-   * If element is a struct, call recursive.
-   */
   int a, elemcount, elen, eleno, mul, mulo, firststructtypenr;
   const short *spo, *spc, *sppo;
   const char *type;
-  const char *cpo;
-  char *cpc;
   const char *name;
+  int cpo, cpc;
 
   unsigned int oldsdna_index_last = UINT_MAX;
   unsigned int cursdna_index_last = UINT_MAX;
 
-  if (oldSDNAnr == -1) {
-    return;
-  }
-  if (curSDNAnr == -1) {
-    return;
-  }
-
-  if (compflags[oldSDNAnr] == SDNA_CMP_EQUAL) {
-    /* if recursive: test for equal */
-    spo = oldsdna->structs[oldSDNAnr];
-    elen = oldsdna->types_size[spo[0]];
-    memcpy(cur, data, elen);
-
-    return;
-  }
-
   firststructtypenr = *(newsdna->structs[0]);
 
   spo = oldsdna->structs[oldSDNAnr];
@@ -1241,8 +1385,13 @@ static void reconstruct_struct(const SDNA *newsdna,
 
   elemcount = spc[1];
 
+  /* At most one step per field of the current struct. */
+  ReconstructStep *steps = MEM_malloc_arrayN(
+      MAX2(elemcount, 1), sizeof(*steps), "ReconstructStep");
+  int steps_len = 0;
+
   spc += 2;
-  cpc = cur;
+  cpc = 0;
   for (a = 0; a < elemcount; a++, spc += 2) { /* convert each field */
     type = newsdna->types[spc[0]];
     name = newsdna->names[spc[1]];
@@ -1253,17 +1402,17 @@ static void reconstruct_struct(const SDNA *newsdna,
      * for exact rules. Note that if we fail to skip a pad byte it's harmless,
      * this just avoids unnecessary reconstruction. */
     if (name[0] == '_' || (name[0] == '*' && name[1] == '_')) {
-      cpc += elen;
+      /* pass */
     }
     else if (spc[0] >= firststructtypenr && !ispointer(name)) {
       /* struct field type */
 
       /* where does the old struct data start (and is there an old one?) */
-      cpo = (char *)find_elem(oldsdna, type, name, spo, data, &sppo);
+      cpo = find_elem_offset(oldsdna, type, name, spo, &sppo);
 
-      if (cpo) {
-        oldSDNAnr = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
-        curSDNAnr = DNA_struct_find_nr_ex(newsdna, type, &cursdna_index_last);
+      if (cpo != -1) {
+        const int oldSDNAnr_sub = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
+        const int curSDNAnr_sub = DNA_struct_find_nr_ex(newsdna, type, &cursdna_index_last);
 
         /* array! */
         mul = newsdna->names_array_len[spc[1]];
@@ -1271,33 +1420,156 @@ static void reconstruct_struct(const SDNA *newsdna,
 
         eleno = DNA_elem_size_nr(oldsdna, sppo[0], sppo[1]);
 
-        elen /= mul;
         eleno /= mulo;
 
-        while (mul--) {
-          reconstruct_struct(newsdna, oldsdna, compflags, oldSDNAnr, cpo, curSDNAnr, cpc);
-          cpo += eleno;
-          cpc += elen;
-
-          /* new struct array larger than old */
-          mulo--;
-          if (mulo <= 0) {
-            break;
-          }
+        /* New struct array may be larger or smaller than the old one. */
+        const int array_len = MIN2(mul, mulo);
+
+        if (oldSDNAnr_sub == -1 || curSDNAnr_sub == -1) {
+          /* pass */
+        }
+        else if (compflags[oldSDNAnr_sub] == SDNA_CMP_EQUAL) {
+          BLI_assert(elen / mul == eleno);
+          reconstruct_step_add_memcpy(&steps[0], &steps_len, cpo, cpc, eleno * array_len);
+        }
+        else {
+          ReconstructStep *step = &steps[steps_len++];
+          step->type = RECONSTRUCT_STEP_SUBSTRUCT;
+          step->data.substruct.old_offset = cpo;
+          step->data.substruct.new_offset = cpc;
+          step->data.substruct.array_len = array_len;
+          step->data.substruct.old_struct_nr = (short)oldSDNAnr_sub;
+          step->data.substruct.new_struct_nr = (short)curSDNAnr_sub;
         }
-      }
-      else {
-        cpc += elen; /* skip field no longer present */
       }
     }
     else {
       /* non-struct field type */
-      reconstruct_elem(newsdna, oldsdna, type, spc[1], cpc, spo, data);
-      cpc += elen;
+      reconstruct_elem_compile(newsdna, oldsdna, type, spc[1], cpc, spo, steps, &steps_len);
     }
+    cpc += elen;
   }
+
+  *r_steps_len = steps_len;
+  return steps;
 }
 
+/**
+ * Pre-compute the steps needed to reconstruct all structs which differ between both SDNA's.
+ *
+ * \param oldsdna: SDNA of Blender that saved file
+ * \param newsdna: SDNA of current Blender
+ * \param compflags: Result from #DNA_struct_get_compareflags,
+ * must remain valid while the returned info is in use.
+ */
+DNA_ReconstructInfo *DNA_reconstruct_info_create(const SDNA *oldsdna,
+                                                 const SDNA *newsdna,
+                                                 const char *compflags)
+{
+  DNA_ReconstructInfo *reconstruct_info = MEM_callocN(sizeof(*reconstruct_info), __func__);
+  reconstruct_info->oldsdna = oldsdna;
+  reconstruct_info->newsdna = newsdna;
+  reconstruct_info->compflags = compflags;
+  reconstruct_info->steps = MEM_calloc_arrayN(
+      oldsdna->structs_len, sizeof(*reconstruct_info->steps), __func__);
+  reconstruct_info->steps_len = MEM_calloc_arrayN(
+      oldsdna->structs_len, sizeof(*reconstruct_info->steps_len), __func__);
+
+  unsigned int newsdna_index_last = 0;
+  for (int oldSDNAnr = 0; oldSDNAnr < oldsdna->structs_len; oldSDNAnr++) {
+    if (compflags[oldSDNAnr] != SDNA_CMP_NOT_EQUAL) {
+      continue;
+    }
+    const short *spo = oldsdna->structs[oldSDNAnr];
+    const int curSDNAnr = DNA_struct_find_nr_ex(
+        newsdna, oldsdna->types[spo[0]], &newsdna_index_last);
+    if (curSDNAnr == -1) {
+      continue;
+    }
+    reconstruct_info->steps[oldSDNAnr] = reconstruct_struct_compile(
+        newsdna,
+        oldsdna,
+        compflags,
+        oldSDNAnr,
+        curSDNAnr,
+        &reconstruct_info->steps_len[oldSDNAnr]);
+  }
+
+  return reconstruct_info;
+}
+
+void DNA_reconstruct_info_free(DNA_ReconstructInfo *reconstruct_info)
+{
+  for (int a = 0; a < reconstruct_info->oldsdna->structs_len; a++) {
+    if (reconstruct_info->steps[a] != NULL) {
+      MEM_freeN(reconstruct_info->steps[a]);
+    }
+  }
+  MEM_freeN(reconstruct_info->steps);
+  MEM_freeN(reconstruct_info->steps_len);
+  MEM_freeN(reconstruct_info);
+}
+
+/**
+ * Converts the contents of an entire struct from oldsdna to newsdna format,
+ * by running the steps compiled by #DNA_reconstruct_info_create.
+ *
+ * \param oldSDNAnr: Index of old struct definition in oldsdna
+ * \param data: Struct contents laid out according to oldsdna
+ * \param cur: Where to put converted struct contents (must be zero initialized).
+ */
+static void reconstruct_struct(const DNA_ReconstructInfo *reconstruct_info,
+                               const int oldSDNAnr,
+                               const char *data,
+                               char *cur)
+{
+  const ReconstructStep *step = reconstruct_info->steps[oldSDNAnr];
+  const int steps_len = reconstruct_info->steps_len[oldSDNAnr];
+  const SDNA *oldsdna = reconstruct_info->oldsdna;
+  const SDNA *newsdna = reconstruct_info->newsdna;
+
+  for (int a = 0; a < steps_len; a++, step++) {
+    switch (step->type) {
+      case RECONSTRUCT_STEP_MEMCPY:
+        memcpy(cur + step->data.memcpy.new_offset,
+               data + step->data.memcpy.old_offset,
+               step->data.memcpy.size);
+        break;
+      case RECONSTRUCT_STEP_CAST_PRIMITIVE:
+        cast_elem(step->data.cast_primitive.new_type,
+                  step->data.cast_primitive.old_type,
+                  step->data.cast_primitive.array_len,
+                  cur + step->data.cast_primitive.new_offset,
+                  data + step->data.cast_primitive.old_offset);
+        break;
+      case RECONSTRUCT_STEP_CAST_POINTER_64_TO_32:
+      case RECONSTRUCT_STEP_CAST_POINTER_32_TO_64:
+        cast_pointer(newsdna->pointer_size,
+                     oldsdna->pointer_size,
+                     step->data.cast_pointer.array_len,
+                     cur + step->data.cast_pointer.new_offset,
+                     data + step->data.cast_pointer.old_offset);
+        break;
+      case RECONSTRUCT_STEP_SUBSTRUCT: {
+        const int old_struct_nr = step->data.substruct.old_struct_nr;
+        const int new_struct_nr = step->data.substruct.new_struct_nr;
+        const int old_size = oldsdna->types_size[oldsdna->structs[old_struct_nr][0]];
+        const int new_size = newsdna->types_size[newsdna->structs[new_struct_nr][0]];
+        const char *cpo = data + step->data.substruct.old_offset;
+        char *cpc = cur + step->data.substruct.new_offset;
+        for (int i = 0; i < step->data.substruct.array_len; i++) {
+          reconstruct_struct(reconstruct_info, old_struct_nr, cpo, cpc);
+          cpo += old_size;
+          cpc += new_size;
+        }
+        break;
+      }
+    }
+  }
+}
+
+/** \} */
+
 /**
  * Does endian swapping on the fields of a struct value.
  *
@@ -1392,23 +1664,19 @@ void DNA_struct_switch_endian(const SDNA *oldsdna, int oldSDNAnr, char *data)
 }
 
 /**
- * \param newsdna: SDNA of current Blender
- * \param oldsdna: SDNA of Blender that saved file
- * \param compflags:
- *
- * Result from DNA_struct_get_compareflags to avoid needless conversions
+ * \param reconstruct_info: Result from #DNA_reconstruct_info_create.
  * \param oldSDNAnr: Index of struct info within oldsdna
  * \param blocks: The number of array elements
  * \param data: Array of struct data
  * \return An allocated reconstructed struct
  */
-void *DNA_struct_reconstruct(const SDNA *newsdna,
-                             const SDNA *oldsdna,
-                             const char *compflags,
+void *DNA_struct_reconstruct(const DNA_ReconstructInfo *reconstruct_info,
                              int oldSDNAnr,
                              int blocks,
                              const void *data)
 {
+  const SDNA *oldsdna = reconstruct_info->oldsdna;
+  const SDNA *newsdna = reconstruct_info->newsdna;
   int a, curSDNAnr, curlen = 0, oldlen;
   const short *spo, *spc;
   char *cur, *cpc;
@@ -1433,8 +1701,15 @@ void *DNA_struct_reconstruct(const SDNA *newsdna,
   cur = MEM_callocN(blocks * curlen, "reconstruct");
   cpc = cur;
   cpo = data;
+
+  if (reconstruct_info->compflags[oldSDNAnr] == SDNA_CMP_EQUAL) {
+    BLI_assert(oldlen == curlen);
+    memcpy(cur, data, (size_t)oldlen * blocks);
+    return cur;
+  }
+
   for (a = 0; a < blocks; a++) {
-    reconstruct_struct(newsdna, oldsdna, compflags, oldSDNAnr, cpo, curSDNAnr, cpc);
+    reconstruct_struct(reconstruct_info, oldSDNAnr, cpo, cpc);
     cpc += curlen;
     cpo += oldlen;
   }
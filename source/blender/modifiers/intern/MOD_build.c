@@ -238,6 +238,7 @@ static Mesh *modifyMesh(ModifierData *md, const ModifierEvalContext *ctx, struct
   ml_dst = result->mloop;
 
   /* copy the faces across, remapping indices */
+  CustomData_copy_data_indices(&mesh->pdata, &result->pdata, faceMap, 0, numFaces_dst);
   k = 0;
   for (i = 0; i < numFaces_dst; i++) {
     MPoly *source;
@@ -245,7 +246,6 @@ static Mesh *modifyMesh(ModifierData *md, const ModifierEvalContext *ctx, struct
 
     source = mpoly_src + faceMap[i];
     dest = mpoly_dst + i;
-    CustomData_copy_data(&mesh->pdata, &result->pdata, faceMap[i], i, 1);
 
     *dest = *source;
     dest->loopstart = k;
@@ -0,0 +1,212 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_timeit.hh"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_math.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_bvhutils.h"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh_runtime.h"
+}
+
+#include "mesh_test_util.h"
+
+#define GRID_SIZE 500
+
+/* A grid of quads, displaced along Z by a wave which moves with \a time. */
+static Mesh *mesh_grid_new(const int size, const float time)
+{
+  Mesh *mesh = test_mesh_grid_new(size);
+  for (int i = 0; i < mesh->totvert; i++) {
+    MVert *mv = &mesh->mvert[i];
+    mv->co[0] /= (float)size;
+    mv->co[1] /= (float)size;
+    mv->co[2] = 0.1f * sinf(mv->co[0] * 10.0f + time);
+  }
+  return mesh;
+}
+
+/* Hand the trees of \a mesh_prev over to \a mesh, like the evaluation of an animated object. */
+static void mesh_bvh_cache_hand_over(Mesh *mesh_prev, Mesh *mesh)
+{
+  mesh->runtime.bvh_cache_reuse = bvhcache_reuse_take_from_mesh(mesh_prev);
+}
+
+static bool bvh_area_parent_cb(const BVHTreeAxisRange *bounds, void *userdata)
+{
+  float *area = (float *)userdata;
+  const float x = bounds[0].max - bounds[0].min;
+  const float y = bounds[1].max - bounds[1].min;
+  const float z = bounds[2].max - bounds[2].min;
+  *area += x * y + y * z + z * x;
+  return true;
+}
+
+static bool bvh_area_leaf_cb(const BVHTreeAxisRange *UNUSED(bounds),
+                             int UNUSED(index),
+                             void *UNUSED(userdata))
+{
+  return true;
+}
+
+static bool bvh_area_order_cb(const BVHTreeAxisRange *UNUSED(bounds),
+                              char UNUSED(axis),
+                              void *UNUSED(userdata))
+{
+  return true;
+}
+
+/* Sum of the surface areas of all inner nodes, lower for trees fitting the mesh better. */
+static float bvh_inner_nodes_area(BVHTree *tree)
+{
+  float area = 0.0f;
+  BLI_bvhtree_walk_dfs(tree, bvh_area_parent_cb, bvh_area_leaf_cb, bvh_area_order_cb, &area);
+  return area;
+}
+
+/* Nearest surface points found with the cached tree of \a mesh and with a new tree must match.
+ * Returns the inner nodes area of the new tree. */
+static float mesh_bvh_nearest_check(Mesh *mesh,
+                                    BVHTreeFromMesh *treedata,
+                                    const int bvh_cache_type)
+{
+  BVHTreeFromMesh treedata_new;
+  const MLoopTri *looptri = BKE_mesh_runtime_looptri_ensure(mesh);
+  bvhtree_from_mesh_looptri_ex(&treedata_new,
+                               mesh->mvert,
+                               false,
+                               mesh->mloop,
+                               false,
+                               looptri,
+                               BKE_mesh_runtime_looptri_len(mesh),
+                               false,
+                               NULL,
+                               -1,
+                               0.0f,
+                               4,
+                               6,
+                               bvh_cache_type,
+                               NULL);
+
+  for (int i = 0; i < 1000; i++) {
+    const float co[3] = {
+        (float)(i % 37) / 37.0f, (float)(i % 101) / 101.0f, (float)(i % 7) / 7.0f - 0.5f};
+    BVHTreeNearest nearest, nearest_new;
+    nearest.index = nearest_new.index = -1;
+    nearest.dist_sq = nearest_new.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(
+        treedata->tree, co, &nearest, treedata->nearest_callback, treedata);
+    BLI_bvhtree_find_nearest(
+        treedata_new.tree, co, &nearest_new, treedata_new.nearest_callback, &treedata_new);
+    EXPECT_FLOAT_EQ(nearest.dist_sq, nearest_new.dist_sq);
+  }
+
+  const float area_new = bvh_inner_nodes_area(treedata_new.tree);
+  free_bvhtree_from_mesh(&treedata_new);
+  return area_new;
+}
+
+TEST(bvhutils, RefitDeformedMesh)
+{
+  BKE_idtype_init();
+  Mesh *mesh_prev = mesh_grid_new(GRID_SIZE, 0.0f);
+
+  BVHTreeFromMesh treedata;
+  BVHTree *tree_prev;
+  {
+    SCOPED_TIMER("bvh build");
+    tree_prev = BKE_bvhtree_from_mesh_get(&treedata, mesh_prev, BVHTREE_FROM_LOOPTRI, 4);
+  }
+  free_bvhtree_from_mesh(&treedata);
+
+  Mesh *mesh = mesh_grid_new(GRID_SIZE, 1.0f);
+  mesh_bvh_cache_hand_over(mesh_prev, mesh);
+  BKE_id_free(NULL, mesh_prev);
+
+  BVHTree *tree;
+  {
+    SCOPED_TIMER("bvh refit");
+    tree = BKE_bvhtree_from_mesh_get(&treedata, mesh, BVHTREE_FROM_LOOPTRI, 4);
+  }
+  /* The tree of the previous mesh is used again. */
+  EXPECT_EQ(tree, tree_prev);
+  EXPECT_EQ(mesh->runtime.bvh_cache_reuse, nullptr);
+  mesh_bvh_nearest_check(mesh, &treedata, BVHTREE_FROM_LOOPTRI);
+
+  free_bvhtree_from_mesh(&treedata);
+  BKE_id_free(NULL, mesh);
+}
+
+TEST(bvhutils, RefitTopologyChanged)
+{
+  BKE_idtype_init();
+  Mesh *mesh_prev = mesh_grid_new(GRID_SIZE / 10, 0.0f);
+
+  BVHTreeFromMesh treedata;
+  BKE_bvhtree_from_mesh_get(&treedata, mesh_prev, BVHTREE_FROM_LOOPTRI, 4);
+  free_bvhtree_from_mesh(&treedata);
+
+  /* A different number of faces, the tree has to be built again. */
+  Mesh *mesh = mesh_grid_new(GRID_SIZE / 10 + 1, 1.0f);
+  mesh_bvh_cache_hand_over(mesh_prev, mesh);
+  BKE_id_free(NULL, mesh_prev);
+
+  BKE_bvhtree_from_mesh_get(&treedata, mesh, BVHTREE_FROM_LOOPTRI, 4);
+  EXPECT_EQ(BLI_bvhtree_get_len(treedata.tree), BKE_mesh_runtime_looptri_len(mesh));
+  mesh_bvh_nearest_check(mesh, &treedata, BVHTREE_FROM_LOOPTRI);
+
+  free_bvhtree_from_mesh(&treedata);
+  BKE_id_free(NULL, mesh);
+}
+
+TEST(bvhutils, RefitScrambledMesh)
+{
+  BKE_idtype_init();
+  Mesh *mesh_prev = mesh_grid_new(GRID_SIZE / 10, 0.0f);
+
+  BVHTreeFromMesh treedata;
+  BKE_bvhtree_from_mesh_get(&treedata, mesh_prev, BVHTREE_FROM_LOOPTRI, 4);
+  free_bvhtree_from_mesh(&treedata);
+
+  /* Same topology, but rows and columns of the grid are shuffled, a refitted tree would have
+   * nodes spanning almost the whole mesh. Faces stay rectangles, so their triangulation doesn't
+   * change. */
+  const int size = GRID_SIZE / 10;
+  Mesh *mesh = mesh_grid_new(size, 1.0f);
+  int order[GRID_SIZE / 10];
+  for (int i = 0; i < size; i++) {
+    order[i] = i;
+  }
+  unsigned int seed = 1;
+  for (int i = size - 1; i > 0; i--) {
+    seed = seed * 1103515245u + 12345u;
+    SWAP(int, order[i], order[(seed >> 8) % (unsigned int)(i + 1)]);
+  }
+  for (int i = 0; i < mesh->totvert; i++) {
+    MVert *mv = &mesh->mvert[i];
+    mv->co[0] = (float)order[i % size] / (float)size;
+    mv->co[1] = (float)order[i / size] / (float)size;
+  }
+  mesh_bvh_cache_hand_over(mesh_prev, mesh);
+  BKE_id_free(NULL, mesh_prev);
+
+  BKE_bvhtree_from_mesh_get(&treedata, mesh, BVHTREE_FROM_LOOPTRI, 4);
+  EXPECT_EQ(mesh->runtime.bvh_cache_reuse, nullptr);
+  /* The tree was built again, like the one built from scratch. */
+  const float area_new = mesh_bvh_nearest_check(mesh, &treedata, BVHTREE_FROM_LOOPTRI);
+  EXPECT_FLOAT_EQ(bvh_inner_nodes_area(treedata.tree), area_new);
+
+  free_bvhtree_from_mesh(&treedata);
+  BKE_id_free(NULL, mesh);
+}
@@ -0,0 +1,114 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "DNA_customdata_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_math.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_customdata.h"
+}
+
+#define ELEMS_NUM 64
+#define SOURCES_NUM 4
+#define SPAN_NUM 16
+
+/* Vertex layers with a span callback (normals, shape keys, bevel weights) and one without. */
+static void customdata_test_init(CustomData *data, const int totelem)
+{
+  CustomData_reset(data);
+  CustomData_add_layer(data, CD_NORMAL, CD_CALLOC, NULL, totelem);
+  CustomData_add_layer(data, CD_SHAPEKEY, CD_CALLOC, NULL, totelem);
+  CustomData_add_layer(data, CD_BWEIGHT, CD_CALLOC, NULL, totelem);
+  CustomData_add_layer(data, CD_MVERT_SKIN, CD_CALLOC, NULL, totelem);
+}
+
+static void customdata_test_fill(CustomData *data, const int totelem)
+{
+  float(*no)[3] = (float(*)[3])CustomData_get_layer(data, CD_NORMAL);
+  float(*co)[3] = (float(*)[3])CustomData_get_layer(data, CD_SHAPEKEY);
+  float *bweight = (float *)CustomData_get_layer(data, CD_BWEIGHT);
+  MVertSkin *skin = (MVertSkin *)CustomData_get_layer(data, CD_MVERT_SKIN);
+  for (int i = 0; i < totelem; i++) {
+    const float f = (float)i;
+    const float v[3] = {sinf(f), cosf(f * 0.3f), 0.5f + f / totelem};
+    normalize_v3_v3(no[i], v);
+    copy_v3_v3(co[i], v);
+    bweight[i] = f / totelem;
+    mul_v3_v3fl(skin[i].radius, v, 2.0f);
+  }
+}
+
+static bool customdata_test_layer_equal(const CustomData *a, const CustomData *b, const int type)
+{
+  const int size = CustomData_sizeof(type);
+  return memcmp(CustomData_get_layer(a, type),
+                CustomData_get_layer(b, type),
+                (size_t)size * SPAN_NUM) == 0;
+}
+
+TEST(customdata, InterpSpanMatchesInterp)
+{
+  CustomData source, dest, dest_span;
+  customdata_test_init(&source, ELEMS_NUM);
+  customdata_test_fill(&source, ELEMS_NUM);
+  customdata_test_init(&dest, SPAN_NUM);
+  customdata_test_init(&dest_span, SPAN_NUM);
+
+  const int src_indices[SOURCES_NUM] = {3, 17, 42, 8};
+  float weights[SPAN_NUM][SOURCES_NUM];
+  for (int j = 0; j < SPAN_NUM; j++) {
+    const float u = (float)j / SPAN_NUM, v = 1.0f - u * u;
+    weights[j][0] = (1.0f - u) * (1.0f - v);
+    weights[j][1] = u * (1.0f - v);
+    weights[j][2] = u * v;
+    weights[j][3] = (1.0f - u) * v;
+  }
+
+  for (int j = 0; j < SPAN_NUM; j++) {
+    CustomData_interp(&source, &dest, src_indices, weights[j], NULL, SOURCES_NUM, j);
+  }
+  CustomData_interp_span(
+      &source, &dest_span, src_indices, &weights[0][0], SOURCES_NUM, 0, SPAN_NUM);
+
+  EXPECT_TRUE(customdata_test_layer_equal(&dest, &dest_span, CD_NORMAL));
+  EXPECT_TRUE(customdata_test_layer_equal(&dest, &dest_span, CD_SHAPEKEY));
+  EXPECT_TRUE(customdata_test_layer_equal(&dest, &dest_span, CD_BWEIGHT));
+  EXPECT_TRUE(customdata_test_layer_equal(&dest, &dest_span, CD_MVERT_SKIN));
+
+  CustomData_free(&source, ELEMS_NUM);
+  CustomData_free(&dest, SPAN_NUM);
+  CustomData_free(&dest_span, SPAN_NUM);
+}
+
+TEST(customdata, CopyDataIndices)
+{
+  CustomData source, dest;
+  customdata_test_init(&source, ELEMS_NUM);
+  customdata_test_fill(&source, ELEMS_NUM);
+  customdata_test_init(&dest, ELEMS_NUM);
+
+  int src_indices[ELEMS_NUM - 1];
+  for (int i = 0; i < ELEMS_NUM - 1; i++) {
+    src_indices[i] = (i * 7) % ELEMS_NUM;
+  }
+  CustomData_copy_data_indices(&source, &dest, src_indices, 1, ELEMS_NUM - 1);
+
+  for (int i = 0; i < ELEMS_NUM - 1; i++) {
+    for (int type : {CD_NORMAL, CD_SHAPEKEY, CD_BWEIGHT, CD_MVERT_SKIN}) {
+      const int size = CustomData_sizeof(type);
+      EXPECT_EQ(memcmp(POINTER_OFFSET(CustomData_get_layer(&dest, type), (i + 1) * size),
+                       POINTER_OFFSET(CustomData_get_layer(&source, type), src_indices[i] * size),
+                       (size_t)size),
+                0);
+    }
+  }
+
+  CustomData_free(&source, ELEMS_NUM);
+  CustomData_free(&dest, ELEMS_NUM);
+}
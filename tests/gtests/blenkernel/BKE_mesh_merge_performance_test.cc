@@ -0,0 +1,66 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_timeit.hh"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_utildefines.h"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+}
+
+#include "mesh_test_util.h"
+
+/* A grid of quads, twice on top of each other, the vertices of the second copy are merged into
+ * the first one, like the mirror modifier merging both sides of a symmetrical mesh. */
+
+#define GRID_SIZE 1000
+
+static void mesh_merge_verts_test(const int merge_mode, const char *id)
+{
+  BKE_idtype_init();
+
+  const int verts_num = GRID_SIZE * GRID_SIZE;
+  const int polys_num = (GRID_SIZE - 1) * (GRID_SIZE - 1);
+  Mesh *mesh = test_mesh_grid_new(GRID_SIZE, 2);
+
+  int *vtargetmap = (int *)MEM_malloc_arrayN(
+      (size_t)mesh->totvert, sizeof(*vtargetmap), __func__);
+  for (int i = 0; i < verts_num; i++) {
+    vtargetmap[i] = -1;
+    vtargetmap[i + verts_num] = i;
+  }
+
+  Mesh *result;
+  {
+    SCOPED_TIMER(id);
+    result = BKE_mesh_merge_verts(mesh, vtargetmap, verts_num, merge_mode);
+  }
+
+  /* The second copy of the grid is dumped entirely, the input mesh has been freed. */
+  EXPECT_EQ(result->totvert, verts_num);
+  EXPECT_EQ(result->totpoly, polys_num);
+  EXPECT_EQ(result->totloop, polys_num * 4);
+  EXPECT_EQ(result->totedge, 2 * GRID_SIZE * (GRID_SIZE - 1));
+
+  BKE_id_free(NULL, result);
+  MEM_freeN(vtargetmap);
+}
+
+TEST(mesh_merge, MergeVertsDumpIfMapped)
+{
+  mesh_merge_verts_test(MESH_MERGE_VERTS_DUMP_IF_MAPPED, "merge verts, dump if mapped");
+}
+
+TEST(mesh_merge, MergeVertsDumpIfEqual)
+{
+  mesh_merge_verts_test(MESH_MERGE_VERTS_DUMP_IF_EQUAL, "merge verts, dump if equal");
+}
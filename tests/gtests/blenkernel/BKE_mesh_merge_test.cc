@@ -0,0 +1,125 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_utildefines.h"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+}
+
+#include "mesh_test_util.h"
+
+#define GRID_SIZE 8
+
+/* Merge the second copy of a double grid into the first one, the vertex at (x, y) of the second
+ * copy is merged into the vertex at (x + offset, y) of the first copy. Frees the given mesh. */
+static Mesh *mesh_merge_verts_offset(Mesh *mesh, const int offset, const int merge_mode)
+{
+  const int verts_num = GRID_SIZE * GRID_SIZE;
+  int *vtargetmap = (int *)MEM_malloc_arrayN(
+      (size_t)mesh->totvert, sizeof(*vtargetmap), __func__);
+  int vtargetmap_num = 0;
+  for (int i = 0; i < verts_num; i++) {
+    const int x = i % GRID_SIZE;
+    vtargetmap[i] = -1;
+    if (x + offset < GRID_SIZE) {
+      vtargetmap[i + verts_num] = i + offset;
+      vtargetmap_num++;
+    }
+    else {
+      vtargetmap[i + verts_num] = -1;
+    }
+  }
+
+  Mesh *result = BKE_mesh_merge_verts(mesh, vtargetmap, vtargetmap_num, merge_mode);
+  MEM_freeN(vtargetmap);
+  return result;
+}
+
+/* Merging the second copy onto the first one leaves the first copy untouched. */
+static void mesh_merge_verts_overlap_test(const int merge_mode)
+{
+  BKE_idtype_init();
+
+  const int verts_num = GRID_SIZE * GRID_SIZE;
+  const int polys_num = (GRID_SIZE - 1) * (GRID_SIZE - 1);
+  /* The merge frees its input, compare with a single grid instead. */
+  Mesh *expected = test_mesh_grid_new(GRID_SIZE, 1);
+  Mesh *result = mesh_merge_verts_offset(test_mesh_grid_new(GRID_SIZE, 2), 0, merge_mode);
+
+  EXPECT_EQ(result->totvert, verts_num);
+  EXPECT_EQ(result->totpoly, polys_num);
+  EXPECT_EQ(result->totloop, polys_num * 4);
+  EXPECT_EQ(result->totedge, 2 * GRID_SIZE * (GRID_SIZE - 1));
+
+  for (int i = 0; i < result->totvert && i < verts_num; i++) {
+    EXPECT_EQ(result->mvert[i].co[0], expected->mvert[i].co[0]);
+    EXPECT_EQ(result->mvert[i].co[1], expected->mvert[i].co[1]);
+  }
+  for (int i = 0; i < result->totpoly && i < polys_num; i++) {
+    EXPECT_EQ(result->mpoly[i].loopstart, expected->mpoly[i].loopstart);
+    EXPECT_EQ(result->mpoly[i].totloop, expected->mpoly[i].totloop);
+  }
+  for (int i = 0; i < result->totloop && i < polys_num * 4; i++) {
+    EXPECT_EQ(result->mloop[i].v, expected->mloop[i].v);
+  }
+
+  BKE_id_free(NULL, result);
+  BKE_id_free(NULL, expected);
+}
+
+/* Merging the second copy one column over dumps all of its faces but the last column, which
+ * is kept to bridge the first copy and the unmerged vertices. */
+static void mesh_merge_verts_shifted_test(const int merge_mode)
+{
+  BKE_idtype_init();
+
+  const int verts_num = GRID_SIZE * GRID_SIZE;
+  const int polys_num = (GRID_SIZE - 1) * (GRID_SIZE - 1);
+  Mesh *result = mesh_merge_verts_offset(test_mesh_grid_new(GRID_SIZE, 2), 1, merge_mode);
+
+  EXPECT_EQ(result->totvert, verts_num + GRID_SIZE);
+  EXPECT_EQ(result->totpoly, polys_num + (GRID_SIZE - 1));
+  EXPECT_EQ(result->totloop, (polys_num + (GRID_SIZE - 1)) * 4);
+
+  /* The bridging faces must not have collapsed corners. */
+  for (int i = 0; i < result->totpoly; i++) {
+    const MPoly *mp = &result->mpoly[i];
+    ASSERT_EQ(mp->totloop, 4);
+    const MLoop *ml = &result->mloop[mp->loopstart];
+    for (int j = 0; j < 4; j++) {
+      EXPECT_LT(ml[j].v, (uint)result->totvert);
+      EXPECT_NE(ml[j].v, ml[(j + 1) % 4].v);
+    }
+  }
+
+  BKE_id_free(NULL, result);
+}
+
+TEST(mesh_merge, MergeVertsOverlapDumpIfMapped)
+{
+  mesh_merge_verts_overlap_test(MESH_MERGE_VERTS_DUMP_IF_MAPPED);
+}
+
+TEST(mesh_merge, MergeVertsOverlapDumpIfEqual)
+{
+  mesh_merge_verts_overlap_test(MESH_MERGE_VERTS_DUMP_IF_EQUAL);
+}
+
+TEST(mesh_merge, MergeVertsShiftedDumpIfMapped)
+{
+  mesh_merge_verts_shifted_test(MESH_MERGE_VERTS_DUMP_IF_MAPPED);
+}
+
+TEST(mesh_merge, MergeVertsShiftedDumpIfEqual)
+{
+  mesh_merge_verts_shifted_test(MESH_MERGE_VERTS_DUMP_IF_EQUAL);
+}
@@ -0,0 +1,82 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_timeit.hh"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_math.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh_runtime.h"
+}
+
+#include "mesh_test_util.h"
+
+#define GRID_SIZE 2000
+#define NORMALS_RUNS_NUM 5
+
+/* A grid of quads, bent along the X axis so the normals are not all the same. */
+static Mesh *mesh_bent_grid_new(const int size)
+{
+  Mesh *mesh = test_mesh_grid_new(size);
+  for (int i = 0; i < mesh->totvert; i++) {
+    MVert *mv = &mesh->mvert[i];
+    const float angle = mv->co[0] / (float)size * (float)M_PI;
+    mv->co[1] = mv->co[1] / (float)size;
+    mv->co[0] = cosf(angle);
+    mv->co[2] = sinf(angle);
+  }
+  return mesh;
+}
+
+/* Normals of a bent grid point away from the bend axis (the Y axis), or towards it. */
+static void mesh_grid_normals_check(const Mesh *mesh)
+{
+  for (int i = 0; i < mesh->totvert; i++) {
+    const MVert *mv = &mesh->mvert[i];
+    float no[3], radial[3] = {mv->co[0], 0.0f, mv->co[2]};
+    normal_short_to_float_v3(no, mv->no);
+    normalize_v3(radial);
+    EXPECT_NEAR(fabsf(dot_v3v3(no, radial)), 1.0f, 1e-3f);
+  }
+}
+
+TEST(mesh_normals, CalcNormals)
+{
+  BKE_idtype_init();
+  Mesh *mesh = mesh_bent_grid_new(GRID_SIZE);
+
+  for (int i = 0; i < NORMALS_RUNS_NUM; i++) {
+    SCOPED_TIMER("calc normals");
+    BKE_mesh_calc_normals(mesh);
+  }
+  mesh_grid_normals_check(mesh);
+
+  BKE_id_free(NULL, mesh);
+}
+
+TEST(mesh_normals, CalcNormalsLooptri)
+{
+  BKE_idtype_init();
+  Mesh *mesh = mesh_bent_grid_new(GRID_SIZE);
+  const MLoopTri *looptri = BKE_mesh_runtime_looptri_ensure(mesh);
+  const int looptri_num = BKE_mesh_runtime_looptri_len(mesh);
+
+  for (int i = 0; i < NORMALS_RUNS_NUM; i++) {
+    SCOPED_TIMER("calc normals looptri");
+    BKE_mesh_calc_normals_looptri(
+        mesh->mvert, mesh->totvert, mesh->mloop, looptri, looptri_num, NULL);
+  }
+  mesh_grid_normals_check(mesh);
+
+  BKE_id_free(NULL, mesh);
+}
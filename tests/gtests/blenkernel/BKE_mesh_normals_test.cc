@@ -0,0 +1,109 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_math.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+}
+
+#include "mesh_test_util.h"
+
+#define GRID_SIZE 500
+
+/* The result must not depend on the order threads accumulate vertex normals in. */
+TEST(mesh_normals, CalcNormalsDeterministic)
+{
+  BKE_idtype_init();
+  Mesh *mesh = test_mesh_grid_new(GRID_SIZE);
+  /* Displace the grid so the vertex normals are not all the same. */
+  for (int i = 0; i < mesh->totvert; i++) {
+    MVert *mv = &mesh->mvert[i];
+    mv->co[2] = sinf(mv->co[0] * 0.1f) * cosf(mv->co[1] * 0.1f) * 10.0f;
+  }
+
+  float(*vnors_a)[3] = (float(*)[3])MEM_malloc_arrayN(
+      (size_t)mesh->totvert, sizeof(*vnors_a), __func__);
+  float(*vnors_b)[3] = (float(*)[3])MEM_malloc_arrayN(
+      (size_t)mesh->totvert, sizeof(*vnors_b), __func__);
+
+  BKE_mesh_calc_normals_poly(mesh->mvert,
+                             vnors_a,
+                             mesh->totvert,
+                             mesh->mloop,
+                             mesh->mpoly,
+                             mesh->totloop,
+                             mesh->totpoly,
+                             NULL,
+                             false);
+  BKE_mesh_calc_normals_poly(mesh->mvert,
+                             vnors_b,
+                             mesh->totvert,
+                             mesh->mloop,
+                             mesh->mpoly,
+                             mesh->totloop,
+                             mesh->totpoly,
+                             NULL,
+                             false);
+  EXPECT_EQ(memcmp(vnors_a, vnors_b, sizeof(*vnors_a) * (size_t)mesh->totvert), 0);
+
+  MEM_freeN(vnors_a);
+  MEM_freeN(vnors_b);
+  BKE_id_free(NULL, mesh);
+}
+
+/* All vertices of a tilted plane share the analytic normal of the plane. */
+TEST(mesh_normals, CalcNormalsPlane)
+{
+  BKE_idtype_init();
+  Mesh *mesh = test_mesh_grid_new(GRID_SIZE);
+  const float slope_x = 0.5f, slope_y = -2.0f;
+  for (int i = 0; i < mesh->totvert; i++) {
+    MVert *mv = &mesh->mvert[i];
+    mv->co[2] = mv->co[0] * slope_x + mv->co[1] * slope_y;
+  }
+  float normal_expected[3] = {-slope_x, -slope_y, 1.0f};
+  normalize_v3(normal_expected);
+
+  float(*vnors)[3] = (float(*)[3])MEM_malloc_arrayN(
+      (size_t)mesh->totvert, sizeof(*vnors), __func__);
+  float(*pnors)[3] = (float(*)[3])MEM_malloc_arrayN(
+      (size_t)mesh->totpoly, sizeof(*pnors), __func__);
+
+  BKE_mesh_calc_normals_poly(mesh->mvert,
+                             vnors,
+                             mesh->totvert,
+                             mesh->mloop,
+                             mesh->mpoly,
+                             mesh->totloop,
+                             mesh->totpoly,
+                             pnors,
+                             false);
+
+  int pnors_wrong = 0, vnors_wrong = 0;
+  for (int i = 0; i < mesh->totpoly; i++) {
+    if (!compare_v3v3(pnors[i], normal_expected, 1e-5f)) {
+      pnors_wrong++;
+    }
+  }
+  for (int i = 0; i < mesh->totvert; i++) {
+    if (!compare_v3v3(vnors[i], normal_expected, 1e-5f)) {
+      vnors_wrong++;
+    }
+  }
+  EXPECT_EQ(pnors_wrong, 0);
+  EXPECT_EQ(vnors_wrong, 0);
+
+  MEM_freeN(vnors);
+  MEM_freeN(pnors);
+  BKE_id_free(NULL, mesh);
+}
@@ -0,0 +1,99 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_timeit.hh"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_utildefines.h"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh_runtime.h"
+#include "BKE_pbvh.h"
+}
+
+#include "mesh_test_util.h"
+
+#define GRID_SIZE 2000
+
+static Mesh *mesh_grid_new(const int size)
+{
+  Mesh *mesh = test_mesh_grid_new(size);
+  for (int i = 0; i < mesh->totvert; i++) {
+    MVert *mv = &mesh->mvert[i];
+    mv->co[2] = (float)(((i % size) * (i / size)) % 7);
+  }
+  return mesh;
+}
+
+static PBVH *pbvh_build_mesh(Mesh *mesh)
+{
+  /* The PBVH owns the looptris. */
+  const MLoopTri *looptri = (const MLoopTri *)MEM_dupallocN(
+      BKE_mesh_runtime_looptri_ensure(mesh));
+  const int looptri_num = BKE_mesh_runtime_looptri_len(mesh);
+
+  PBVH *pbvh = BKE_pbvh_new();
+  {
+    SCOPED_TIMER("build pbvh mesh");
+    BKE_pbvh_build_mesh(pbvh,
+                        mesh,
+                        mesh->mpoly,
+                        mesh->mloop,
+                        mesh->mvert,
+                        mesh->totvert,
+                        &mesh->vdata,
+                        &mesh->ldata,
+                        &mesh->pdata,
+                        looptri,
+                        looptri_num);
+  }
+  return pbvh;
+}
+
+TEST(pbvh, BuildMesh)
+{
+  BKE_idtype_init();
+  Mesh *mesh = mesh_grid_new(GRID_SIZE);
+
+  PBVH *pbvh_a = pbvh_build_mesh(mesh);
+  PBVH *pbvh_b = pbvh_build_mesh(mesh);
+
+  PBVHNode **nodes_a, **nodes_b;
+  int totnode_a, totnode_b;
+  BKE_pbvh_search_gather(pbvh_a, NULL, NULL, &nodes_a, &totnode_a);
+  BKE_pbvh_search_gather(pbvh_b, NULL, NULL, &nodes_b, &totnode_b);
+  EXPECT_GT(totnode_a, 1);
+  ASSERT_EQ(totnode_a, totnode_b);
+
+  /* Every vertex is unique in exactly one leaf, and building is deterministic. */
+  int uniq_verts_sum = 0;
+  for (int i = 0; i < totnode_a; i++) {
+    int uniq_verts_a, totvert_a, uniq_verts_b, totvert_b;
+    BKE_pbvh_node_num_verts(pbvh_a, nodes_a[i], &uniq_verts_a, &totvert_a);
+    BKE_pbvh_node_num_verts(pbvh_b, nodes_b[i], &uniq_verts_b, &totvert_b);
+    EXPECT_EQ(uniq_verts_a, uniq_verts_b);
+    EXPECT_EQ(totvert_a, totvert_b);
+
+    const int *vert_indices_a, *vert_indices_b;
+    BKE_pbvh_node_get_verts(pbvh_a, nodes_a[i], &vert_indices_a, NULL);
+    BKE_pbvh_node_get_verts(pbvh_b, nodes_b[i], &vert_indices_b, NULL);
+    EXPECT_EQ(memcmp(vert_indices_a, vert_indices_b, sizeof(int) * (size_t)totvert_a), 0);
+
+    uniq_verts_sum += uniq_verts_a;
+  }
+  EXPECT_EQ(uniq_verts_sum, mesh->totvert);
+
+  MEM_freeN(nodes_a);
+  MEM_freeN(nodes_b);
+  BKE_pbvh_free(pbvh_a);
+  BKE_pbvh_free(pbvh_b);
+  BKE_id_free(NULL, mesh);
+}
@@ -0,0 +1,46 @@
+/* Apache License, Version 2.0 */
+
+#include "mesh_test_util.h"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BKE_mesh.h"
+}
+
+Mesh *test_mesh_grid_new(const int size, const int copies)
+{
+  const int verts_num = size * size;
+  const int polys_num = (size - 1) * (size - 1);
+  Mesh *mesh = BKE_mesh_new_nomain(
+      verts_num * copies, 0, 0, polys_num * copies * 4, polys_num * copies);
+
+  for (int copy = 0; copy < copies; copy++) {
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        MVert *mv = &mesh->mvert[copy * verts_num + y * size + x];
+        mv->co[0] = (float)x;
+        mv->co[1] = (float)y;
+        mv->co[2] = 0.0f;
+      }
+    }
+
+    MPoly *mp = &mesh->mpoly[copy * polys_num];
+    MLoop *ml = &mesh->mloop[copy * polys_num * 4];
+    for (int y = 0; y < size - 1; y++) {
+      for (int x = 0; x < size - 1; x++, mp++, ml += 4) {
+        const int v = copy * verts_num + y * size + x;
+        mp->loopstart = (int)(ml - mesh->mloop);
+        mp->totloop = 4;
+        ml[0].v = v;
+        ml[1].v = v + 1;
+        ml[2].v = v + size + 1;
+        ml[3].v = v + size;
+      }
+    }
+  }
+
+  BKE_mesh_calc_edges(mesh, false, false);
+  return mesh;
+}
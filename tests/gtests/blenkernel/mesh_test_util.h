@@ -0,0 +1,18 @@
+/* Apache License, Version 2.0 */
+
+#ifndef __MESH_TEST_UTIL_H__
+#define __MESH_TEST_UTIL_H__
+
+struct Mesh;
+
+/**
+ * Create a mesh of quads in a grid of \a size by \a size vertices. Vertex (x, y) has index
+ * `y * size + x` and coordinates (x, y, 0), so tests can displace vertices based on their grid
+ * location. With \a copies larger than one, the grid is repeated in consecutive ranges of
+ * vertices, loops and polygons, with the copies on top of each other.
+ *
+ * Edges are calculated, normals are not.
+ */
+struct Mesh *test_mesh_grid_new(const int size, const int copies = 1);
+
+#endif /* __MESH_TEST_UTIL_H__ */
@@ -0,0 +1,78 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_concurrent_map.hh"
+#include "BLI_map.hh"
+#include "BLI_timeit.hh"
+#include "BLI_vector.hh"
+
+extern "C" {
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+}
+
+using BLI::ConcurrentMap;
+using BLI::Map;
+using BLI::Vector;
+
+/* Build an edge map from the edges of random triangles: every edge is given by each of the
+ * triangles using it, like when building the edges of a mesh from its faces. */
+
+#define EDGE_MAP_VERTS_NUM 1000000
+#define EDGE_MAP_TRIS_NUM 2000000
+
+static void edge_map_keys_init(Vector<uint64_t> &keys)
+{
+  RNG *rng = BLI_rng_new(0);
+  for (int i = 0; i < EDGE_MAP_TRIS_NUM; i++) {
+    /* Neighboring vertices, so edges are shared between triangles. */
+    const uint v = BLI_rng_get_uint(rng) % EDGE_MAP_VERTS_NUM;
+    const uint tri[3] = {v, (v + 1) % EDGE_MAP_VERTS_NUM, (v + 2) % EDGE_MAP_VERTS_NUM};
+    for (int j = 0; j < 3; j++) {
+      const uint v1 = tri[j], v2 = tri[(j + 1) % 3];
+      keys.append(((uint64_t)MIN2(v1, v2) << 32) | MAX2(v1, v2));
+    }
+  }
+  BLI_rng_free(rng);
+}
+
+TEST(concurrent_map, EdgeMapPerformance)
+{
+  Vector<uint64_t> keys;
+  edge_map_keys_init(keys);
+  Vector<int> values;
+  for (uint i = 0; i < keys.size(); i++) {
+    values.append((int)i);
+  }
+
+  BLI_threadapi_init();
+
+  uint map_size;
+  {
+    Map<uint64_t, int> map;
+    SCOPED_TIMER("Map, single thread");
+    for (uint i = 0; i < keys.size(); i++) {
+      map.add(keys[i], values[i]);
+    }
+    map_size = map.size();
+  }
+  {
+    ConcurrentMap<uint64_t, int> map(keys.size());
+    SCOPED_TIMER("ConcurrentMap, single thread");
+    for (uint i = 0; i < keys.size(); i++) {
+      map.add(keys[i], values[i]);
+    }
+    EXPECT_EQ(map.size(), map_size);
+  }
+  {
+    ConcurrentMap<uint64_t, int> map;
+    {
+      SCOPED_TIMER("ConcurrentMap, add_parallel");
+      map.add_parallel(keys, values);
+    }
+    EXPECT_EQ(map.size(), map_size);
+  }
+
+  BLI_threadapi_exit();
+}
@@ -0,0 +1,155 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_concurrent_map.hh"
+#include "BLI_vector.hh"
+
+extern "C" {
+#include "BLI_threads.h"
+}
+
+using BLI::ArrayRef;
+using BLI::ConcurrentMap;
+using BLI::Vector;
+using IntFloatMap = ConcurrentMap<int, float>;
+
+TEST(concurrent_map, DefaultConstructor)
+{
+  IntFloatMap map;
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_TRUE(map.is_empty());
+  EXPECT_FALSE(map.contains(0));
+}
+
+TEST(concurrent_map, AddLookup)
+{
+  IntFloatMap map(10);
+  EXPECT_GE(map.max_size(), 10);
+  EXPECT_TRUE(map.add(2, 5.0f));
+  EXPECT_TRUE(map.add(6, 2.0f));
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.lookup(2), 5.0f);
+  EXPECT_EQ(map.lookup(6), 2.0f);
+  EXPECT_EQ(map.lookup_ptr(3), nullptr);
+  EXPECT_EQ(map.lookup_default(3, 1.0f), 1.0f);
+}
+
+TEST(concurrent_map, AddExistingKeepsFirstValue)
+{
+  IntFloatMap map(10);
+  EXPECT_TRUE(map.add(3, 1.0f));
+  EXPECT_FALSE(map.add(3, 2.0f));
+  EXPECT_EQ(map.lookup(3), 1.0f);
+  EXPECT_EQ(map.lookup_or_add(3, 4.0f), 1.0f);
+  EXPECT_EQ(map.lookup_or_add(4, 4.0f), 4.0f);
+  EXPECT_EQ(map.size(), 2);
+}
+
+TEST(concurrent_map, ReserveKeepsKeys)
+{
+  IntFloatMap map(4);
+  for (int i = 0; i < 4; i++) {
+    map.add(i, (float)i);
+  }
+  map.reserve(1000);
+  EXPECT_GE(map.max_size(), 1000);
+  for (int i = 4; i < 1000; i++) {
+    map.add(i, (float)i);
+  }
+  EXPECT_EQ(map.size(), 1000);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(map.lookup(i), (float)i);
+  }
+}
+
+TEST(concurrent_map, NonTrivialTypes)
+{
+  ConcurrentMap<std::string, std::string> map(2);
+  map.add("Hello", "World");
+  map.add("Hi", "There");
+  map.add("Hello", "Again");
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.lookup("Hello"), "World");
+  EXPECT_EQ(map.lookup("Hi"), "There");
+}
+
+TEST(concurrent_map, ForeachItem)
+{
+  IntFloatMap map(100);
+  for (int i = 0; i < 100; i++) {
+    map.add(i, (float)(i * 2));
+  }
+  int num_items = 0;
+  map.foreach_item([&](int key, float value) {
+    EXPECT_EQ(value, (float)(key * 2));
+    num_items++;
+  });
+  EXPECT_EQ(num_items, 100);
+}
+
+/* Every key is added many times from different threads, all threads must agree on its value. */
+
+struct ParallelAddData {
+  ConcurrentMap<uint64_t, int> *map;
+  int num_keys;
+  int *values;
+};
+
+static void parallel_add_func(void *__restrict userdata,
+                              const int index,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ParallelAddData *data = (ParallelAddData *)userdata;
+  data->values[index] = data->map->lookup_or_add((uint64_t)(index % data->num_keys), index);
+}
+
+TEST(concurrent_map, ParallelLookupOrAdd)
+{
+  const int num_keys = 1000;
+  const int num_adds = 100000;
+  ConcurrentMap<uint64_t, int> map(num_keys);
+  Vector<int> values(num_adds);
+
+  BLI_threadapi_init();
+
+  ParallelAddData data = {&map, num_keys, values.begin()};
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, num_adds, &data, parallel_add_func, &settings);
+
+  EXPECT_EQ(map.size(), num_keys);
+  for (int i = 0; i < num_adds; i++) {
+    const int value = map.lookup((uint64_t)(i % num_keys));
+    EXPECT_EQ(values[i], value);
+    EXPECT_EQ(value % num_keys, i % num_keys);
+  }
+
+  BLI_threadapi_exit();
+}
+
+TEST(concurrent_map, AddParallel)
+{
+  const int num_keys = 50000;
+  Vector<uint64_t> keys;
+  Vector<int> values;
+  for (int i = 0; i < num_keys * 2; i++) {
+    /* Every key is given twice. */
+    keys.append((uint64_t)(i % num_keys) * 3);
+    values.append(i);
+  }
+
+  BLI_threadapi_init();
+
+  ConcurrentMap<uint64_t, int> map;
+  map.add_parallel(keys, values);
+
+  EXPECT_EQ(map.size(), num_keys);
+  for (int i = 0; i < num_keys; i++) {
+    const int value = map.lookup((uint64_t)i * 3);
+    EXPECT_TRUE(ELEM(value, i, i + num_keys));
+  }
+
+  BLI_threadapi_exit();
+}
@@ -209,3 +209,250 @@ TEST(ghash, Pop)
 
   BLI_ghash_free(ghash, NULL, NULL);
 }
+
+/* Flat storage, same checks as above. */
+
+TEST(ghash, FlatInsertLookup)
+{
+  GHash *ghash = BLI_ghash_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i;
+
+  init_keys(keys, 0);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    BLI_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  EXPECT_EQ(BLI_ghash_len(ghash), TESTCASE_SIZE);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    void *v = BLI_ghash_lookup(ghash, POINTER_FROM_UINT(*k));
+    EXPECT_EQ(POINTER_AS_UINT(v), *k);
+  }
+  EXPECT_FALSE(BLI_ghash_haskey(ghash, POINTER_FROM_UINT(keys[0] + 1)) &&
+               BLI_ghash_haskey(ghash, POINTER_FROM_UINT(keys[1] + 1)) &&
+               BLI_ghash_haskey(ghash, POINTER_FROM_UINT(keys[2] + 1)));
+
+  BLI_ghash_free(ghash, NULL, NULL);
+}
+
+/* Removing and inserting again re-uses deleted slots, without growing the table. */
+TEST(ghash, FlatInsertRemove)
+{
+  GHash *ghash = BLI_ghash_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i, bkt_size;
+
+  init_keys(keys, 10);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    BLI_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  EXPECT_EQ(BLI_ghash_len(ghash), TESTCASE_SIZE);
+  bkt_size = BLI_ghash_buckets_len(ghash);
+
+  for (int pass = 0; pass < 4; pass++) {
+    for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+      void *v = BLI_ghash_popkey(ghash, POINTER_FROM_UINT(*k), NULL);
+      EXPECT_EQ(POINTER_AS_UINT(v), *k);
+    }
+    EXPECT_EQ(BLI_ghash_len(ghash), 0);
+
+    for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+      EXPECT_TRUE(BLI_ghash_reinsert(
+          ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k), NULL, NULL));
+    }
+    EXPECT_EQ(BLI_ghash_len(ghash), TESTCASE_SIZE);
+  }
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    EXPECT_TRUE(BLI_ghash_remove(ghash, POINTER_FROM_UINT(*k), NULL, NULL));
+  }
+
+  EXPECT_EQ(BLI_ghash_len(ghash), 0);
+  EXPECT_EQ(BLI_ghash_buckets_len(ghash), bkt_size);
+
+  BLI_ghash_free(ghash, NULL, NULL);
+}
+
+TEST(ghash, FlatInsertRemoveShrink)
+{
+  GHash *ghash = BLI_ghash_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i, bkt_size;
+
+  BLI_ghash_flag_set(ghash, GHASH_FLAG_ALLOW_SHRINK);
+  init_keys(keys, 20);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    BLI_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  EXPECT_EQ(BLI_ghash_len(ghash), TESTCASE_SIZE);
+  bkt_size = BLI_ghash_buckets_len(ghash);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    void *v = BLI_ghash_popkey(ghash, POINTER_FROM_UINT(*k), NULL);
+    EXPECT_EQ(POINTER_AS_UINT(v), *k);
+  }
+
+  EXPECT_EQ(BLI_ghash_len(ghash), 0);
+  EXPECT_LT(BLI_ghash_buckets_len(ghash), bkt_size);
+
+  BLI_ghash_free(ghash, NULL, NULL);
+}
+
+TEST(ghash, FlatCopy)
+{
+  GHash *ghash = BLI_ghash_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  GHash *ghash_copy;
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i;
+
+  init_keys(keys, 30);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    BLI_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  ghash_copy = BLI_ghash_copy(ghash, NULL, NULL);
+  BLI_ghash_clear(ghash, NULL, NULL);
+
+  EXPECT_EQ(BLI_ghash_len(ghash), 0);
+  EXPECT_EQ(BLI_ghash_len(ghash_copy), TESTCASE_SIZE);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    void *v = BLI_ghash_lookup(ghash_copy, POINTER_FROM_UINT(*k));
+    EXPECT_EQ(POINTER_AS_UINT(v), *k);
+  }
+
+  BLI_ghash_free(ghash, NULL, NULL);
+  BLI_ghash_free(ghash_copy, NULL, NULL);
+}
+
+TEST(ghash, FlatPop)
+{
+  GHash *ghash = BLI_ghash_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i;
+
+  BLI_ghash_flag_set(ghash, GHASH_FLAG_ALLOW_SHRINK);
+  init_keys(keys, 30);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    BLI_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  GHashIterState pop_state = {0};
+  int num_popped = 0;
+  {
+    void *k, *v;
+    while (BLI_ghash_pop(ghash, &pop_state, &k, &v)) {
+      EXPECT_EQ(k, v);
+      num_popped++;
+    }
+  }
+  EXPECT_EQ(num_popped, TESTCASE_SIZE);
+  EXPECT_EQ(BLI_ghash_len(ghash), 0);
+
+  BLI_ghash_free(ghash, NULL, NULL);
+}
+
+/* Iterate over every entry exactly once, also after removing some. */
+TEST(ghash, FlatIterator)
+{
+  GHash *ghash = BLI_ghash_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE];
+  unsigned long long sum_expect = 0, sum = 0;
+  int num_iter = 0;
+
+  init_keys(keys, 40);
+
+  for (int i = 0; i < TESTCASE_SIZE; i++) {
+    BLI_ghash_insert(ghash, POINTER_FROM_UINT(keys[i]), POINTER_FROM_UINT(keys[i]));
+  }
+  for (int i = 0; i < TESTCASE_SIZE; i++) {
+    if (i % 3) {
+      sum_expect += keys[i];
+    }
+    else {
+      BLI_ghash_remove(ghash, POINTER_FROM_UINT(keys[i]), NULL, NULL);
+    }
+  }
+
+  GHASH_FOREACH_BEGIN (void *, v, ghash) {
+    sum += POINTER_AS_UINT(v);
+    num_iter++;
+  }
+  GHASH_FOREACH_END();
+
+  EXPECT_EQ(num_iter, BLI_ghash_len(ghash));
+  EXPECT_EQ(sum, sum_expect);
+
+  BLI_ghash_free(ghash, NULL, NULL);
+}
+
+TEST(ghash, FlatGSet)
+{
+  GSet *gset = BLI_gset_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE];
+
+  init_keys(keys, 50);
+
+  for (int i = 0; i < TESTCASE_SIZE; i++) {
+    EXPECT_TRUE(BLI_gset_add(gset, POINTER_FROM_UINT(keys[i])));
+  }
+  EXPECT_EQ(BLI_gset_len(gset), TESTCASE_SIZE);
+
+  for (int i = 0; i < TESTCASE_SIZE; i++) {
+    EXPECT_FALSE(BLI_gset_add(gset, POINTER_FROM_UINT(keys[i])));
+    EXPECT_EQ(BLI_gset_lookup(gset, POINTER_FROM_UINT(keys[i])), POINTER_FROM_UINT(keys[i]));
+  }
+  for (int i = 0; i < TESTCASE_SIZE; i += 2) {
+    EXPECT_EQ(BLI_gset_pop_key(gset, POINTER_FROM_UINT(keys[i])), POINTER_FROM_UINT(keys[i]));
+  }
+  for (int i = 0; i < TESTCASE_SIZE; i++) {
+    EXPECT_EQ(BLI_gset_haskey(gset, POINTER_FROM_UINT(keys[i])), (i % 2) != 0);
+  }
+  EXPECT_EQ(BLI_gset_len(gset), TESTCASE_SIZE / 2);
+
+  BLI_gset_free(gset, NULL);
+}
+
+TEST(ghash, FlatQuality)
+{
+  GHash *ghash = BLI_ghash_new_flat(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  double load, variance, prop_empty, prop_overloaded;
+  int biggest_bucket, i;
+
+  EXPECT_EQ(
+      BLI_ghash_calc_quality_ex(
+          ghash, &load, &variance, &prop_empty, &prop_overloaded, &biggest_bucket),
+      0.0);
+  EXPECT_EQ(load, 0.0);
+  EXPECT_EQ(prop_empty, 1.0);
+  EXPECT_EQ(biggest_bucket, 0);
+
+  init_keys(keys, 60);
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    BLI_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  /* Mean probe length, at least one group per lookup. */
+  EXPECT_GE(
+      BLI_ghash_calc_quality_ex(
+          ghash, &load, &variance, &prop_empty, &prop_overloaded, &biggest_bucket),
+      1.0);
+  EXPECT_GT(load, 0.0);
+  EXPECT_LE(load, 1.0);
+  EXPECT_GE(biggest_bucket, 1);
+
+  /* Empty again after removing everything. */
+  BLI_ghash_clear(ghash, NULL, NULL);
+  EXPECT_EQ(BLI_ghash_calc_quality(ghash), 0.0);
+
+  BLI_ghash_free(ghash, NULL, NULL);
+}
@@ -0,0 +1,105 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_timeit.hh"
+
+extern "C" {
+#include "BLI_kdopbvh.h"
+#include "BLI_math_vector.h"
+#include "BLI_utildefines.h"
+}
+
+#define GRID_SIZE 1000
+
+/* A grid of boxes (like the faces of a mesh), with coherent rays cast from a grid above it. */
+static BVHTree *grid_tree_new(const int size)
+{
+  BVHTree *tree = BLI_bvhtree_new(size * size, 0.0f, 2, 6);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const float co[2][3] = {{(float)x, (float)y, (float)((x * y) % 5) * 0.1f},
+                              {(float)x + 1.0f, (float)y + 1.0f, 0.5f}};
+      BLI_bvhtree_insert(tree, y * size + x, co[0], 2);
+    }
+  }
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+TEST(kdopbvh, RayCastPerformance)
+{
+  const int rays_len = GRID_SIZE * GRID_SIZE;
+  BVHTree *tree = grid_tree_new(GRID_SIZE);
+
+  float(*co)[3] = (float(*)[3])MEM_malloc_arrayN(rays_len, sizeof(*co), __func__);
+  float(*dir)[3] = (float(*)[3])MEM_malloc_arrayN(rays_len, sizeof(*dir), __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_malloc_arrayN(rays_len, sizeof(*hits), __func__);
+  for (int i = 0; i < rays_len; i++) {
+    co[i][0] = (float)(i % GRID_SIZE) + 0.25f;
+    co[i][1] = (float)(i / GRID_SIZE) + 0.75f;
+    co[i][2] = 10.0f;
+    copy_v3_fl3(dir[i], 0.1f, 0.0f, -1.0f);
+    normalize_v3(dir[i]);
+  }
+
+  {
+    SCOPED_TIMER("ray cast");
+    for (int i = 0; i < rays_len; i++) {
+      hits[i].index = -1;
+      hits[i].dist = BVH_RAYCAST_DIST_MAX;
+      BLI_bvhtree_ray_cast_ex(tree, co[i], dir[i], 0.0f, &hits[i], NULL, NULL, 0);
+    }
+  }
+
+  {
+    SCOPED_TIMER("ray cast batch");
+    for (int i = 0; i < rays_len; i++) {
+      hits[i].index = -1;
+      hits[i].dist = BVH_RAYCAST_DIST_MAX;
+    }
+    BLI_bvhtree_ray_cast_batch(tree, co, dir, rays_len, 0.0f, hits, NULL, NULL, 0);
+  }
+
+  MEM_freeN(co);
+  MEM_freeN(dir);
+  MEM_freeN(hits);
+  BLI_bvhtree_free(tree);
+}
+
+TEST(kdopbvh, FindNearestPerformance)
+{
+  const int points_len = GRID_SIZE * GRID_SIZE;
+  BVHTree *tree = grid_tree_new(GRID_SIZE);
+
+  float(*co)[3] = (float(*)[3])MEM_malloc_arrayN(points_len, sizeof(*co), __func__);
+  BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_malloc_arrayN(
+      points_len, sizeof(*nearest), __func__);
+  for (int i = 0; i < points_len; i++) {
+    copy_v3_fl3(co[i], (float)(i % GRID_SIZE) + 0.25f, (float)(i / GRID_SIZE) + 0.75f, 2.0f);
+  }
+
+  {
+    SCOPED_TIMER("find nearest");
+    for (int i = 0; i < points_len; i++) {
+      nearest[i].index = -1;
+      nearest[i].dist_sq = FLT_MAX;
+      BLI_bvhtree_find_nearest_ex(tree, co[i], &nearest[i], NULL, NULL, 0);
+    }
+  }
+
+  {
+    SCOPED_TIMER("find nearest batch");
+    for (int i = 0; i < points_len; i++) {
+      nearest[i].index = -1;
+      nearest[i].dist_sq = FLT_MAX;
+    }
+    BLI_bvhtree_find_nearest_batch(tree, co, points_len, nearest, NULL, NULL, 0);
+  }
+
+  MEM_freeN(co);
+  MEM_freeN(nearest);
+  BLI_bvhtree_free(tree);
+}
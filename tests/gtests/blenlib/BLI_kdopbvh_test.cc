@@ -136,3 +136,92 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+/* Random boxes, with rays cast from random points towards the center. */
+static BVHTree *random_boxes_tree_new(const int boxes_len, RNG *rng)
+{
+  const float size[3] = {0.01f, 0.02f, 0.03f};
+  BVHTree *tree = BLI_bvhtree_new(boxes_len, 0.0, 2, 6);
+  for (int i = 0; i < boxes_len; i++) {
+    float co[2][3];
+    rng_v3_round(co[0], 3, rng, 1000, 1.0f);
+    add_v3_v3v3(co[1], co[0], size);
+    BLI_bvhtree_insert(tree, i, co[0], 2);
+  }
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+TEST(kdopbvh, RayCastBatch)
+{
+  const int rays_len = 1003;
+  RNG *rng = BLI_rng_new(0);
+  BVHTree *tree = random_boxes_tree_new(1000, rng);
+
+  float(*co)[3] = (float(*)[3])MEM_malloc_arrayN(rays_len, sizeof(*co), __func__);
+  float(*dir)[3] = (float(*)[3])MEM_malloc_arrayN(rays_len, sizeof(*dir), __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_malloc_arrayN(rays_len, sizeof(*hits), __func__);
+  for (int i = 0; i < rays_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, co[i]);
+    mul_v3_fl(co[i], 2.0f);
+    negate_v3_v3(dir[i], co[i]);
+    normalize_v3(dir[i]);
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+  /* Also cast rays missing everything. */
+  negate_v3(dir[0]);
+
+  BLI_bvhtree_ray_cast_batch(tree, co, dir, rays_len, 0.0f, hits, NULL, NULL, 0);
+
+  int hits_num = 0;
+  for (int i = 0; i < rays_len; i++) {
+    BVHTreeRayHit hit;
+    hit.index = -1;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast_ex(tree, co[i], dir[i], 0.0f, &hit, NULL, NULL, 0);
+    EXPECT_EQ(hits[i].index, hit.index);
+    if (hit.index != -1) {
+      EXPECT_FLOAT_EQ(hits[i].dist, hit.dist);
+      hits_num++;
+    }
+  }
+  EXPECT_EQ(hits[0].index, -1);
+  EXPECT_GT(hits_num, rays_len / 2);
+
+  MEM_freeN(co);
+  MEM_freeN(dir);
+  MEM_freeN(hits);
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, FindNearestBatch)
+{
+  const int points_len = 500;
+  RNG *rng = BLI_rng_new(12);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+  float(*points)[3] = (float(*)[3])MEM_malloc_arrayN(points_len, sizeof(*points), __func__);
+  BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_malloc_arrayN(
+      points_len, sizeof(*nearest), __func__);
+
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+    nearest[i].index = -1;
+    nearest[i].dist_sq = FLT_MAX;
+  }
+  BLI_bvhtree_balance(tree);
+
+  BLI_bvhtree_find_nearest_batch(tree, points, points_len, nearest, NULL, NULL, 0);
+  for (int i = 0; i < points_len; i++) {
+    EXPECT_GE(nearest[i].index, 0);
+    EXPECT_EQ_ARRAY(points[i], points[nearest[i].index], 3);
+    EXPECT_EQ(nearest[i].dist_sq, 0.0f);
+  }
+
+  MEM_freeN(points);
+  MEM_freeN(nearest);
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+}
@@ -0,0 +1,72 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_timeit.hh"
+
+extern "C" {
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+#include "BLI_utildefines.h"
+}
+
+#define POINTS_NUM 4000000
+#define QUERIES_NUM 1000000
+
+static float (*random_coords_new(const int coords_len, const uint seed))[3]
+{
+  RNG *rng = BLI_rng_new(seed);
+  float(*coords)[3] = (float(*)[3])MEM_malloc_arrayN(coords_len, sizeof(*coords), __func__);
+  for (int i = 0; i < coords_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, coords[i]);
+    mul_v3_fl(coords[i], BLI_rng_get_float(rng));
+  }
+  BLI_rng_free(rng);
+  return coords;
+}
+
+TEST(kdtree, Performance)
+{
+  float(*coords)[3] = random_coords_new(POINTS_NUM, 0);
+  float(*queries)[3] = random_coords_new(QUERIES_NUM, 1);
+  KDTreeNearest_3d *nearest = (KDTreeNearest_3d *)MEM_malloc_arrayN(
+      QUERIES_NUM, sizeof(*nearest), __func__);
+
+  KDTree_3d *tree = BLI_kdtree_3d_new(POINTS_NUM);
+  for (int i = 0; i < POINTS_NUM; i++) {
+    BLI_kdtree_3d_insert(tree, i, coords[i]);
+  }
+
+  {
+    SCOPED_TIMER("balance");
+    BLI_kdtree_3d_balance(tree);
+  }
+
+  {
+    SCOPED_TIMER("find nearest");
+    for (int i = 0; i < QUERIES_NUM; i++) {
+      BLI_kdtree_3d_find_nearest(tree, queries[i], &nearest[i]);
+    }
+  }
+
+  {
+    SCOPED_TIMER("find nearest batch");
+    BLI_kdtree_3d_find_nearest_batch(tree, queries, QUERIES_NUM, nearest);
+  }
+
+  {
+    SCOPED_TIMER("calc duplicates fast");
+    int *duplicates = (int *)MEM_malloc_arrayN(POINTS_NUM, sizeof(int), __func__);
+    copy_vn_i(duplicates, POINTS_NUM, -1);
+    BLI_kdtree_3d_calc_duplicates_fast(tree, 0.001f, false, duplicates);
+    MEM_freeN(duplicates);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(coords);
+  MEM_freeN(queries);
+  MEM_freeN(nearest);
+}
@@ -0,0 +1,154 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+#include "BLI_utildefines.h"
+}
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static KDTree_3d *kdtree_random_new(float (*coords)[3], const int coords_len, RNG *rng)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new((uint)coords_len);
+  for (int i = 0; i < coords_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, coords[i]);
+    mul_v3_fl(coords[i], BLI_rng_get_float(rng));
+    BLI_kdtree_3d_insert(tree, i, coords[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+  return tree;
+}
+
+static int find_nearest_brute_force(const float (*coords)[3],
+                                    const int coords_len,
+                                    const float co[3])
+{
+  int index = -1;
+  float dist_sq_min = FLT_MAX;
+  for (int i = 0; i < coords_len; i++) {
+    const float dist_sq = len_squared_v3v3(coords[i], co);
+    if (dist_sq < dist_sq_min) {
+      dist_sq_min = dist_sq;
+      index = i;
+    }
+  }
+  return index;
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdtree, Empty)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(0);
+  BLI_kdtree_3d_balance(tree);
+  const float co[3] = {0.0f, 0.0f, 0.0f};
+  EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, co, NULL), -1);
+
+  KDTreeNearest_3d nearest;
+  BLI_kdtree_3d_find_nearest_batch(tree, &co, 1, &nearest);
+  EXPECT_EQ(nearest.index, -1);
+  BLI_kdtree_3d_free(tree);
+}
+
+static void find_nearest_test(const int coords_len, const int queries_len)
+{
+  RNG *rng = BLI_rng_new(coords_len);
+  float(*coords)[3] = (float(*)[3])MEM_malloc_arrayN(coords_len, sizeof(*coords), __func__);
+  float(*queries)[3] = (float(*)[3])MEM_malloc_arrayN(queries_len, sizeof(*queries), __func__);
+  KDTreeNearest_3d *nearest = (KDTreeNearest_3d *)MEM_malloc_arrayN(
+      queries_len, sizeof(*nearest), __func__);
+
+  KDTree_3d *tree = kdtree_random_new(coords, coords_len, rng);
+  for (int i = 0; i < queries_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, queries[i]);
+  }
+
+  BLI_kdtree_3d_find_nearest_batch(tree, queries, (uint)queries_len, nearest);
+  for (int i = 0; i < queries_len; i++) {
+    const int index = find_nearest_brute_force(coords, coords_len, queries[i]);
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, queries[i], NULL), index);
+    EXPECT_EQ(nearest[i].index, index);
+    EXPECT_FLOAT_EQ(nearest[i].dist, len_v3v3(coords[index], queries[i]));
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(coords);
+  MEM_freeN(queries);
+  MEM_freeN(nearest);
+  BLI_rng_free(rng);
+}
+
+TEST(kdtree, FindNearestSmall)
+{
+  find_nearest_test(100, 1000);
+}
+
+/* Large enough to be balanced in multiple tasks. */
+TEST(kdtree, FindNearestLarge)
+{
+  find_nearest_test(100000, 1000);
+}
+
+TEST(kdtree, RangeSearch)
+{
+  const int coords_len = 50000;
+  const float range = 0.1f;
+  RNG *rng = BLI_rng_new(0);
+  float(*coords)[3] = (float(*)[3])MEM_malloc_arrayN(coords_len, sizeof(*coords), __func__);
+  KDTree_3d *tree = kdtree_random_new(coords, coords_len, rng);
+
+  for (int i = 0; i < 100; i++) {
+    KDTreeNearest_3d *nearest;
+    const int found = BLI_kdtree_3d_range_search(tree, coords[i], &nearest, range);
+
+    int found_brute_force = 0;
+    for (int j = 0; j < coords_len; j++) {
+      found_brute_force += len_squared_v3v3(coords[i], coords[j]) <= square_f(range);
+    }
+    EXPECT_EQ(found, found_brute_force);
+    for (int j = 1; j < found; j++) {
+      EXPECT_LE(nearest[j - 1].dist, nearest[j].dist);
+    }
+    MEM_SAFE_FREE(nearest);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(coords);
+  BLI_rng_free(rng);
+}
+
+/* Every point is duplicated, each pair has to be merged. */
+TEST(kdtree, CalcDuplicatesFast)
+{
+  const int coords_len = 20000;
+  KDTree_3d *tree = BLI_kdtree_3d_new(coords_len * 2);
+  for (int i = 0; i < coords_len; i++) {
+    const float co[3] = {(float)i, (float)(i % 7), 0.0f};
+    BLI_kdtree_3d_insert(tree, i, co);
+    BLI_kdtree_3d_insert(tree, i + coords_len, co);
+  }
+  BLI_kdtree_3d_balance(tree);
+
+  for (int use_index_order = 0; use_index_order < 2; use_index_order++) {
+    int *duplicates = (int *)MEM_malloc_arrayN(coords_len * 2, sizeof(int), __func__);
+    copy_vn_i(duplicates, coords_len * 2, -1);
+    EXPECT_EQ(BLI_kdtree_3d_calc_duplicates_fast(tree, 0.1f, use_index_order, duplicates),
+              coords_len);
+    for (int i = 0; i < coords_len; i++) {
+      const int a = duplicates[i], b = duplicates[i + coords_len];
+      /* One of the pair is the target of the other one. */
+      EXPECT_TRUE((a == i && b == i) || (a == i + coords_len && b == i + coords_len));
+    }
+    MEM_freeN(duplicates);
+  }
+
+  BLI_kdtree_3d_free(tree);
+}
@@ -0,0 +1,245 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_task.h"
+
+#include "atomic_ops.h"
+
+struct TaskData {
+  int value;
+  int store;
+};
+
+static void TaskData_increase_value(void *taskdata)
+{
+  TaskData *data = (TaskData *)taskdata;
+  data->value += 1;
+}
+static void TaskData_decrease_value(void *taskdata)
+{
+  TaskData *data = (TaskData *)taskdata;
+  data->value -= 1;
+}
+static void TaskData_multiply_by_two_value(void *taskdata)
+{
+  TaskData *data = (TaskData *)taskdata;
+  data->value *= 2;
+}
+static void TaskData_store_value(void *taskdata)
+{
+  TaskData *data = (TaskData *)taskdata;
+  data->store = data->value;
+}
+static void TaskData_square_value(void *taskdata)
+{
+  TaskData *data = (TaskData *)taskdata;
+  data->value *= data->value;
+}
+
+/* Sequential Test for using `BLI_task_graph` */
+TEST(task, GraphSequential)
+{
+  TaskData data = {0};
+  TaskGraph *graph = BLI_task_graph_create();
+
+  /* 0 => 1 */
+  TaskNode *node_a = BLI_task_graph_node_create(graph, TaskData_increase_value, &data, NULL);
+  /* 1 => 2 */
+  TaskNode *node_b = BLI_task_graph_node_create(graph, TaskData_multiply_by_two_value, &data, NULL);
+  /* 2 => 1 */
+  TaskNode *node_c = BLI_task_graph_node_create(graph, TaskData_decrease_value, &data, NULL);
+  /* 2 => 1 */
+  TaskNode *node_d = BLI_task_graph_node_create(graph, TaskData_square_value, &data, NULL);
+  /* 1 => 1 */
+  TaskNode *node_e = BLI_task_graph_node_create(graph, TaskData_increase_value, &data, NULL);
+  /* 1 => 2 */
+  const int expected_value = 2;
+
+  BLI_task_graph_edge_create(node_a, node_b);
+  BLI_task_graph_edge_create(node_b, node_c);
+  BLI_task_graph_edge_create(node_c, node_d);
+  BLI_task_graph_edge_create(node_d, node_e);
+
+  EXPECT_FALSE(BLI_task_graph_node_push_work(node_b));
+  EXPECT_TRUE(BLI_task_graph_node_push_work(node_a));
+  BLI_task_graph_work_and_wait(graph);
+
+  EXPECT_EQ(expected_value, data.value);
+  BLI_task_graph_free(graph);
+}
+
+/* Run the same graph twice, dependency counters must be reset in between. */
+TEST(task, GraphRunTwice)
+{
+  TaskData data = {0};
+  TaskGraph *graph = BLI_task_graph_create();
+
+  TaskNode *node_a = BLI_task_graph_node_create(graph, TaskData_increase_value, &data, NULL);
+  TaskNode *node_b = BLI_task_graph_node_create(graph, TaskData_multiply_by_two_value, &data, NULL);
+  BLI_task_graph_edge_create(node_a, node_b);
+
+  /* (0 + 1) * 2 = 2 */
+  BLI_task_graph_node_push_work(node_a);
+  BLI_task_graph_work_and_wait(graph);
+  EXPECT_EQ(2, data.value);
+
+  /* (2 + 1) * 2 = 6 */
+  BLI_task_graph_node_push_work(node_a);
+  BLI_task_graph_work_and_wait(graph);
+  EXPECT_EQ(6, data.value);
+
+  BLI_task_graph_free(graph);
+}
+
+TEST(task, GraphStartAtAnyNode)
+{
+  TaskData data = {4};
+  TaskGraph *graph = BLI_task_graph_create();
+
+  TaskNode *node_a = BLI_task_graph_node_create(graph, TaskData_increase_value, &data, NULL);
+  TaskNode *node_b = BLI_task_graph_node_create(graph, TaskData_multiply_by_two_value, &data, NULL);
+  TaskNode *node_c = BLI_task_graph_node_create(graph, TaskData_decrease_value, &data, NULL);
+  TaskNode *node_d = BLI_task_graph_node_create(graph, TaskData_square_value, &data, NULL);
+  TaskNode *node_e = BLI_task_graph_node_create(graph, TaskData_increase_value, &data, NULL);
+
+  /* Two separate chains, only the second one is started: 4 => 3 => 9 => 10. */
+  BLI_task_graph_edge_create(node_a, node_b);
+  BLI_task_graph_edge_create(node_c, node_d);
+  BLI_task_graph_edge_create(node_d, node_e);
+
+  BLI_task_graph_node_push_work(node_c);
+  BLI_task_graph_work_and_wait(graph);
+
+  EXPECT_EQ(10, data.value);
+  BLI_task_graph_free(graph);
+}
+
+TEST(task, GraphSplit)
+{
+  TaskData data = {1};
+
+  TaskGraph *graph = BLI_task_graph_create();
+  TaskNode *node_a = BLI_task_graph_node_create(graph, TaskData_increase_value, &data, NULL);
+  TaskNode *node_b = BLI_task_graph_node_create(graph, TaskData_store_value, &data, NULL);
+  TaskNode *node_c = BLI_task_graph_node_create(graph, TaskData_increase_value, &data, NULL);
+  TaskNode *node_d = BLI_task_graph_node_create(graph, TaskData_multiply_by_two_value, &data, NULL);
+  BLI_task_graph_edge_create(node_a, node_b);
+  BLI_task_graph_edge_create(node_b, node_c);
+  BLI_task_graph_edge_create(node_b, node_d);
+  BLI_task_graph_node_push_work(node_a);
+  BLI_task_graph_work_and_wait(graph);
+
+  EXPECT_EQ(2, data.store);
+  BLI_task_graph_free(graph);
+}
+
+/* A node only runs when all its predecessors are done. */
+
+struct JoinData {
+  int num_done;
+  int num_done_at_join;
+};
+
+static void JoinData_branch(void *taskdata)
+{
+  JoinData *data = (JoinData *)taskdata;
+  atomic_add_and_fetch_int32(&data->num_done, 1);
+}
+
+static void JoinData_join(void *taskdata)
+{
+  JoinData *data = (JoinData *)taskdata;
+  data->num_done_at_join = data->num_done;
+}
+
+TEST(task, GraphJoin)
+{
+  const int num_branches = 100;
+  JoinData data = {0, 0};
+
+  TaskGraph *graph = BLI_task_graph_create();
+  TaskNode *node_root = BLI_task_graph_node_create(graph, JoinData_branch, &data, NULL);
+  TaskNode *node_join = BLI_task_graph_node_create(graph, JoinData_join, &data, NULL);
+  for (int i = 0; i < num_branches; i++) {
+    TaskNode *node_branch = BLI_task_graph_node_create(graph, JoinData_branch, &data, NULL);
+    BLI_task_graph_edge_create(node_root, node_branch);
+    BLI_task_graph_edge_create(node_branch, node_join);
+  }
+
+  BLI_task_graph_node_push_work(node_root);
+  BLI_task_graph_work_and_wait(graph);
+
+  EXPECT_EQ(num_branches + 1, data.num_done);
+  EXPECT_EQ(num_branches + 1, data.num_done_at_join);
+  BLI_task_graph_free(graph);
+}
+
+TEST(task, GraphForest)
+{
+  TaskData data1 = {1};
+  TaskData data2 = {3};
+
+  TaskGraph *graph = BLI_task_graph_create();
+
+  {
+    TaskNode *tree1_node_a = BLI_task_graph_node_create(
+        graph, TaskData_increase_value, &data1, NULL);
+    TaskNode *tree1_node_b = BLI_task_graph_node_create(graph, TaskData_store_value, &data1, NULL);
+    TaskNode *tree1_node_c = BLI_task_graph_node_create(
+        graph, TaskData_increase_value, &data1, NULL);
+    TaskNode *tree1_node_d = BLI_task_graph_node_create(
+        graph, TaskData_multiply_by_two_value, &data1, NULL);
+    BLI_task_graph_edge_create(tree1_node_a, tree1_node_b);
+    BLI_task_graph_edge_create(tree1_node_b, tree1_node_c);
+    BLI_task_graph_edge_create(tree1_node_b, tree1_node_d);
+    BLI_task_graph_node_push_work(tree1_node_a);
+  }
+
+  {
+    TaskNode *tree2_node_a = BLI_task_graph_node_create(
+        graph, TaskData_increase_value, &data2, NULL);
+    TaskNode *tree2_node_b = BLI_task_graph_node_create(graph, TaskData_store_value, &data2, NULL);
+    TaskNode *tree2_node_c = BLI_task_graph_node_create(
+        graph, TaskData_increase_value, &data2, NULL);
+    TaskNode *tree2_node_d = BLI_task_graph_node_create(
+        graph, TaskData_multiply_by_two_value, &data2, NULL);
+    BLI_task_graph_edge_create(tree2_node_a, tree2_node_b);
+    BLI_task_graph_edge_create(tree2_node_b, tree2_node_c);
+    BLI_task_graph_edge_create(tree2_node_b, tree2_node_d);
+    BLI_task_graph_node_push_work(tree2_node_a);
+  }
+
+  BLI_task_graph_work_and_wait(graph);
+
+  EXPECT_EQ(2, data1.store);
+  EXPECT_EQ(4, data2.store);
+  BLI_task_graph_free(graph);
+}
+
+static int task_data_num_freed = 0;
+
+static void TaskData_free(void *taskdata)
+{
+  TaskData *data = (TaskData *)taskdata;
+  MEM_freeN(data);
+  task_data_num_freed++;
+}
+
+TEST(task, GraphTaskData)
+{
+  TaskGraph *graph = BLI_task_graph_create();
+  TaskData *data = (TaskData *)MEM_callocN(sizeof(TaskData), __func__);
+  TaskNode *node_a = BLI_task_graph_node_create(graph, TaskData_store_value, data, TaskData_free);
+  TaskNode *node_b = BLI_task_graph_node_create(graph, TaskData_store_value, data, NULL);
+  BLI_task_graph_edge_create(node_a, node_b);
+  EXPECT_TRUE(BLI_task_graph_node_push_work(node_a));
+  BLI_task_graph_work_and_wait(graph);
+  EXPECT_EQ(0, data->store);
+  EXPECT_EQ(0, task_data_num_freed);
+  BLI_task_graph_free(graph);
+  /* data should be freed once, when the graph is freed. */
+  EXPECT_EQ(1, task_data_num_freed);
+}
@@ -210,3 +210,124 @@ TEST(task, ListBaseIter100k)
 {
   task_listbase_test("ListBase parallel iteration - Threaded - 100000 items", 100000, true);
 }
+
+/* *** Task graph, nodes depending on nodes of the previous layer. *** */
+
+#define NUM_RUN_GRAPH_AVERAGED 10
+
+typedef struct TaskGraphPerfData {
+  int *values;
+  int num_nodes_per_layer;
+} TaskGraphPerfData;
+
+typedef struct TaskGraphPerfNode {
+  TaskGraphPerfData *data;
+  int layer;
+  int index;
+} TaskGraphPerfNode;
+
+static void task_graph_perf_node_func(void *__restrict task_data)
+{
+  TaskGraphPerfNode *node = (TaskGraphPerfNode *)task_data;
+  TaskGraphPerfData *data = node->data;
+  int *values = &data->values[node->layer * data->num_nodes_per_layer];
+
+  /* 'Random' amount of work, using the values of the previous layer. */
+  int value = (node->layer == 0) ? node->index : values[node->index - data->num_nodes_per_layer];
+  const uint num = gen_pseudo_random_number((uint)(node->layer * data->num_nodes_per_layer +
+                                                   node->index));
+  for (uint i = 0; i < num; i++) {
+    value += (i % 2) ? -1 : 2;
+  }
+  values[node->index] = value;
+}
+
+static void task_graph_test(const char *id, const int num_layers, const int num_nodes_per_layer)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  const int num_nodes = num_layers * num_nodes_per_layer;
+  TaskGraphPerfData data;
+  data.values = (int *)MEM_calloc_arrayN(num_nodes, sizeof(int), __func__);
+  data.num_nodes_per_layer = num_nodes_per_layer;
+  TaskGraphPerfNode *nodes_data = (TaskGraphPerfNode *)MEM_calloc_arrayN(
+      num_nodes, sizeof(*nodes_data), __func__);
+
+  TaskGraph *graph = BLI_task_graph_create();
+  TaskNode **nodes = (TaskNode **)MEM_calloc_arrayN(num_nodes, sizeof(*nodes), __func__);
+  for (int layer = 0; layer < num_layers; layer++) {
+    for (int i = 0; i < num_nodes_per_layer; i++) {
+      const int node_index = layer * num_nodes_per_layer + i;
+      TaskGraphPerfNode *node_data = &nodes_data[node_index];
+      node_data->data = &data;
+      node_data->layer = layer;
+      node_data->index = i;
+      nodes[node_index] = BLI_task_graph_node_create(
+          graph, task_graph_perf_node_func, node_data, NULL);
+      if (layer > 0) {
+        /* Depend on the node above and its neighbor. */
+        const int prev_index = node_index - num_nodes_per_layer;
+        const int prev_index_next = (layer - 1) * num_nodes_per_layer +
+                                    (i + 1) % num_nodes_per_layer;
+        BLI_task_graph_edge_create(nodes[prev_index], nodes[node_index]);
+        if (prev_index_next != prev_index) {
+          BLI_task_graph_edge_create(nodes[prev_index_next], nodes[node_index]);
+        }
+      }
+    }
+  }
+
+  /* Reference result, evaluating nodes layer by layer on a single thread. */
+  double sequential_timing = 0.0;
+  for (int run = 0; run < NUM_RUN_GRAPH_AVERAGED; run++) {
+    const double init_time = PIL_check_seconds_timer();
+    for (int node_index = 0; node_index < num_nodes; node_index++) {
+      task_graph_perf_node_func(&nodes_data[node_index]);
+    }
+    sequential_timing += PIL_check_seconds_timer() - init_time;
+  }
+  int *values_expected = (int *)MEM_dupallocN(data.values);
+
+  double graph_timing = 0.0;
+  for (int run = 0; run < NUM_RUN_GRAPH_AVERAGED; run++) {
+    memset(data.values, 0, sizeof(int) * (size_t)num_nodes);
+    const double init_time = PIL_check_seconds_timer();
+    for (int i = 0; i < num_nodes_per_layer; i++) {
+      BLI_task_graph_node_push_work(nodes[i]);
+    }
+    BLI_task_graph_work_and_wait(graph);
+    graph_timing += PIL_check_seconds_timer() - init_time;
+
+    EXPECT_EQ(0, memcmp(values_expected, data.values, sizeof(int) * (size_t)num_nodes));
+  }
+
+  printf("\tSequential: done in %fs on average over %d runs\n",
+         sequential_timing / NUM_RUN_GRAPH_AVERAGED,
+         NUM_RUN_GRAPH_AVERAGED);
+  printf("\tTask graph: done in %fs on average over %d runs\n",
+         graph_timing / NUM_RUN_GRAPH_AVERAGED,
+         NUM_RUN_GRAPH_AVERAGED);
+
+  BLI_task_graph_free(graph);
+  MEM_freeN(nodes);
+  MEM_freeN(nodes_data);
+  MEM_freeN(values_expected);
+  MEM_freeN(data.values);
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(task, GraphChain10k)
+{
+  task_graph_test("Task graph - Chain - 10000 nodes", 10000, 1);
+}
+
+TEST(task, GraphLayers100x100)
+{
+  task_graph_test("Task graph - 100 layers of 100 nodes", 100, 100);
+}
+
+TEST(task, GraphLayers10x1k)
+{
+  task_graph_test("Task graph - 10 layers of 1000 nodes", 10, 1000);
+}
@@ -0,0 +1,163 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BKE_customdata.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+
+#include "BLI_listbase.h"
+
+#include "BLO_readfile.h"
+#include "BLO_undofile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_ID.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+}
+
+class BlendfileUndoTest : public BlendfileLoadingBaseTest {
+ protected:
+  static Mesh *mesh_add(Main *bmain, const char *name, const int verts_len, const float offset)
+  {
+    Mesh *mesh = BKE_mesh_add(bmain, name);
+    mesh->totvert = verts_len;
+    CustomData_add_layer(&mesh->vdata, CD_MVERT, CD_CALLOC, NULL, verts_len);
+    BKE_mesh_update_customdata_pointers(mesh, false);
+    mesh_offset(mesh, offset);
+    return mesh;
+  }
+
+  static void mesh_offset(Mesh *mesh, const float offset)
+  {
+    for (int i = 0; i < mesh->totvert; i++) {
+      mesh->mvert[i].co[0] = (float)i + offset;
+      mesh->mvert[i].co[1] = offset;
+      mesh->mvert[i].co[2] = -(float)i;
+    }
+  }
+
+  static bool mesh_has_offset(const Mesh *mesh, const float offset)
+  {
+    for (int i = 0; i < mesh->totvert; i++) {
+      if (mesh->mvert[i].co[0] != (float)i + offset || mesh->mvert[i].co[1] != offset ||
+          mesh->mvert[i].co[2] != -(float)i) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* Count the chunks of an ID, and how many of them are shared with the previous step. */
+  static void memfile_id_chunks_count(const MemFile *memfile,
+                                      const ID *id,
+                                      int *r_chunks_len,
+                                      int *r_identical_len)
+  {
+    *r_chunks_len = 0;
+    *r_identical_len = 0;
+    LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile->chunks) {
+      if (chunk->id_session_uuid == id->session_uuid) {
+        (*r_chunks_len)++;
+        if (chunk->is_identical) {
+          (*r_identical_len)++;
+        }
+      }
+    }
+  }
+};
+
+TEST_F(BlendfileUndoTest, ReuseUnchangedIDs)
+{
+  const int verts_len = 10000;
+
+  /* Not G.main, the test setup adds an incomplete window manager to it. */
+  Main *bmain = BKE_main_new();
+  Mesh *mesh_static = mesh_add(bmain, "UndoTestStatic", verts_len, 0.0f);
+  Mesh *mesh_edited = mesh_add(bmain, "UndoTestEdited", verts_len, 0.0f);
+
+  MemFile *memfile_first = (MemFile *)MEM_callocN(sizeof(MemFile), __func__);
+  EXPECT_TRUE(BLO_write_file_mem(bmain, NULL, memfile_first, 0));
+
+  /* Edit one mesh and tag it, like an operator would before the next undo push. */
+  mesh_offset(mesh_edited, 1.0f);
+  mesh_edited->id.recalc_after_undo_push = ID_RECALC_GEOMETRY;
+  mesh_static->id.recalc_after_undo_push = 0;
+
+  MemFile *memfile_second = (MemFile *)MEM_callocN(sizeof(MemFile), __func__);
+  EXPECT_TRUE(BLO_write_file_mem(bmain, memfile_first, memfile_second, 0));
+
+  /* All data of the unchanged mesh is shared with the first step. */
+  int chunks_len, identical_len;
+  memfile_id_chunks_count(memfile_second, &mesh_static->id, &chunks_len, &identical_len);
+  EXPECT_GT(chunks_len, 0);
+  EXPECT_EQ(identical_len, chunks_len);
+  memfile_id_chunks_count(memfile_second, &mesh_edited->id, &chunks_len, &identical_len);
+  EXPECT_GT(chunks_len, 0);
+  EXPECT_LT(identical_len, chunks_len);
+
+  /* Change the edited mesh again, then restore the second undo step. */
+  mesh_offset(mesh_edited, 2.0f);
+  const MVert *mvert_static = mesh_static->mvert;
+
+  BlendFileReadParams params = {0};
+  params.undo_direction = 1;
+  BlendFileData *bfd = BLO_read_from_memfile(bmain, "", memfile_second, &params, NULL);
+  EXPECT_NE(bfd, nullptr);
+
+  if (bfd != nullptr) {
+    const Mesh *mesh_static_read = (const Mesh *)BKE_libblock_find_name(
+        bfd->main, ID_ME, "UndoTestStatic");
+    const Mesh *mesh_edited_read = (const Mesh *)BKE_libblock_find_name(
+        bfd->main, ID_ME, "UndoTestEdited");
+
+    /* The unchanged mesh is moved to the new main as is, without reading it again. */
+    EXPECT_EQ(mesh_static_read, mesh_static);
+    if (mesh_static_read == mesh_static) {
+      EXPECT_TRUE(mesh_static_read->id.tag & LIB_TAG_UNDO_OLD_ID_REUSED);
+      EXPECT_EQ(mesh_static_read->mvert, mvert_static);
+      EXPECT_EQ(mesh_static_read->totvert, verts_len);
+      EXPECT_TRUE(mesh_has_offset(mesh_static_read, 0.0f));
+    }
+
+    /* The edited mesh is read again at its old address, with the data of the second step. */
+    EXPECT_EQ(mesh_edited_read, mesh_edited);
+    if (mesh_edited_read == mesh_edited) {
+      EXPECT_FALSE(mesh_edited_read->id.tag & LIB_TAG_UNDO_OLD_ID_REUSED);
+      EXPECT_EQ(mesh_edited_read->totvert, verts_len);
+      EXPECT_TRUE(mesh_has_offset(mesh_edited_read, 1.0f));
+    }
+  }
+
+  /* The old main only holds the replaced data now. */
+  BKE_main_free(bmain);
+  if (bfd != nullptr) {
+    BLO_blendfiledata_free(bfd);
+  }
+
+  /* Chunks shared with the first step are owned by it. */
+  BLO_memfile_free(memfile_second);
+  BLO_memfile_free(memfile_first);
+  MEM_freeN(memfile_second);
+  MEM_freeN(memfile_first);
+}
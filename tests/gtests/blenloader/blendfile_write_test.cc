@@ -0,0 +1,142 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BKE_appdir.h"
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+}
+
+class BlendfileWriteTest : public BlendfileLoadingBaseTest {
+ protected:
+  /* Save a main database with a mesh large enough to span several compression frames, then load the
+   * thumbnail and the file again and compare them. */
+  void write_read_mesh(const char *filename, const int write_flags)
+  {
+    BKE_tempdir_init(NULL);
+    char filepath[FILE_MAX];
+    BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_session(), filename);
+
+    /* Not G.main, the test setup adds an incomplete window manager to it. */
+    Main *bmain = BKE_main_new();
+    const int verts_len = 200000;
+    Mesh *mesh = BKE_mesh_add(bmain, "WriteTestMesh");
+    mesh->totvert = verts_len;
+    CustomData_add_layer(&mesh->vdata, CD_MVERT, CD_CALLOC, NULL, verts_len);
+    BKE_mesh_update_customdata_pointers(mesh, false);
+    for (int i = 0; i < verts_len; i++) {
+      mesh->mvert[i].co[0] = (float)i;
+      mesh->mvert[i].co[1] = (float)(i % 1000) * 0.5f;
+      mesh->mvert[i].co[2] = -(float)i;
+    }
+
+    /* The thumbnail is written right after the file header. */
+    const int thumb_size = 64;
+    BlendThumbnail *thumb = (BlendThumbnail *)MEM_mallocN(
+        BLEN_THUMB_MEMSIZE(thumb_size, thumb_size), __func__);
+    thumb->width = thumb_size;
+    thumb->height = thumb_size;
+    for (int i = 0; i < thumb_size * thumb_size; i++) {
+      ((int *)thumb->rect)[i] = i * 7919;
+    }
+
+    const bool write_ok = BLO_write_file(bmain, filepath, write_flags, NULL, thumb);
+    EXPECT_TRUE(write_ok);
+
+    if (write_ok) {
+      /* Compressed files are gzip members, others start with the blend-file header. */
+      unsigned char magic[2] = {0, 0};
+      FILE *file = BLI_fopen(filepath, "rb");
+      EXPECT_NE(file, nullptr);
+      if (file != nullptr) {
+        EXPECT_EQ(fread(magic, 1, sizeof(magic), file), sizeof(magic));
+        fclose(file);
+      }
+      if (write_flags & G_FILE_COMPRESS) {
+        EXPECT_EQ(magic[0], 0x1f);
+        EXPECT_EQ(magic[1], 0x8b);
+      }
+      else {
+        EXPECT_EQ(magic[0], 'B');
+        EXPECT_EQ(magic[1], 'L');
+      }
+
+      BlendThumbnail *thumb_read = BLO_thumbnail_from_file(filepath);
+      EXPECT_NE(thumb_read, nullptr);
+      if (thumb_read != nullptr) {
+        EXPECT_EQ(thumb_read->width, thumb_size);
+        EXPECT_EQ(thumb_read->height, thumb_size);
+        if (thumb_read->width == thumb_size && thumb_read->height == thumb_size) {
+          EXPECT_EQ(memcmp(thumb_read->rect, thumb->rect, sizeof(int) * thumb_size * thumb_size),
+                    0);
+        }
+        MEM_freeN(thumb_read);
+      }
+
+      bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, NULL);
+      EXPECT_NE(bfile, nullptr);
+    }
+
+    if (bfile != nullptr) {
+      const Mesh *mesh_read = (const Mesh *)BKE_libblock_find_name(
+          bfile->main, ID_ME, "WriteTestMesh");
+      EXPECT_NE(mesh_read, nullptr);
+      if (mesh_read != nullptr) {
+        EXPECT_EQ(mesh_read->totvert, verts_len);
+        if (mesh_read->totvert == verts_len) {
+          int verts_differ = 0;
+          for (int i = 0; i < verts_len; i++) {
+            if (memcmp(mesh_read->mvert[i].co, mesh->mvert[i].co, sizeof(float[3])) != 0) {
+              verts_differ++;
+            }
+          }
+          EXPECT_EQ(verts_differ, 0);
+        }
+      }
+    }
+
+    MEM_freeN(thumb);
+    BKE_main_free(bmain);
+    BLI_delete(filepath, false, false);
+  }
+};
+
+TEST_F(BlendfileWriteTest, UncompressedRoundTrip)
+{
+  write_read_mesh("write_test_uncompressed.blend", 0);
+}
+
+TEST_F(BlendfileWriteTest, CompressedRoundTrip)
+{
+  write_read_mesh("write_test_compressed.blend", G_FILE_COMPRESS);
+}
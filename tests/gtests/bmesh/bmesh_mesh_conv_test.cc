@@ -0,0 +1,100 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_timeit.hh"
+
+extern "C" {
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_math.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_customdata.h"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+
+#include "bmesh.h"
+}
+
+#include "blenkernel/mesh_test_util.h"
+
+#define GRID_SIZE 500
+
+/* A grid of quads with UV's, like a mesh entering edit-mode. */
+static Mesh *mesh_grid_new(const int size)
+{
+  Mesh *mesh = test_mesh_grid_new(size);
+  for (int i = 0; i < mesh->totvert; i++) {
+    MVert *mv = &mesh->mvert[i];
+    mv->co[0] /= (float)size;
+    mv->co[1] /= (float)size;
+    mv->co[2] = 0.1f * sinf(mv->co[0] * 10.0f);
+  }
+
+  CustomData_add_layer(&mesh->ldata, CD_MLOOPUV, CD_CALLOC, NULL, mesh->totloop);
+  BKE_mesh_update_customdata_pointers(mesh, false);
+  for (int i = 0; i < mesh->totloop; i++) {
+    copy_v2_v2(mesh->mloopuv[i].uv, mesh->mvert[mesh->mloop[i].v].co);
+  }
+
+  BKE_mesh_calc_normals(mesh);
+  return mesh;
+}
+
+/* Converting to a BMesh and back must give the same mesh. */
+TEST(bmesh_mesh_conv, RoundTrip)
+{
+  BKE_idtype_init();
+  Mesh *mesh = mesh_grid_new(GRID_SIZE);
+
+  const BMAllocTemplate allocsize = BMALLOC_TEMPLATE_FROM_ME(mesh);
+  BMeshCreateParams create_params = {0};
+  create_params.use_toolflags = true;
+  BMesh *bm = BM_mesh_create(&allocsize, &create_params);
+
+  {
+    SCOPED_TIMER("mesh to bmesh");
+    BMeshFromMeshParams params = {0};
+    params.calc_face_normal = true;
+    BM_mesh_bm_from_me(bm, mesh, &params);
+  }
+
+  Mesh *mesh_result = BKE_mesh_new_nomain(0, 0, 0, 0, 0);
+  {
+    SCOPED_TIMER("bmesh to mesh");
+    BMeshToMeshParams params = {0};
+    BM_mesh_bm_to_me(NULL, bm, mesh_result, &params);
+  }
+  BM_mesh_free(bm);
+
+  ASSERT_EQ(mesh_result->totvert, mesh->totvert);
+  ASSERT_EQ(mesh_result->totedge, mesh->totedge);
+  ASSERT_EQ(mesh_result->totloop, mesh->totloop);
+  ASSERT_EQ(mesh_result->totpoly, mesh->totpoly);
+  ASSERT_NE(mesh_result->mloopuv, nullptr);
+
+  for (int i = 0; i < mesh->totvert; i++) {
+    EXPECT_TRUE(equals_v3v3(mesh_result->mvert[i].co, mesh->mvert[i].co));
+  }
+  for (int i = 0; i < mesh->totedge; i++) {
+    EXPECT_EQ(mesh_result->medge[i].v1, mesh->medge[i].v1);
+    EXPECT_EQ(mesh_result->medge[i].v2, mesh->medge[i].v2);
+  }
+  for (int i = 0; i < mesh->totpoly; i++) {
+    EXPECT_EQ(mesh_result->mpoly[i].loopstart, mesh->mpoly[i].loopstart);
+    EXPECT_EQ(mesh_result->mpoly[i].totloop, mesh->mpoly[i].totloop);
+  }
+  for (int i = 0; i < mesh->totloop; i++) {
+    EXPECT_EQ(mesh_result->mloop[i].v, mesh->mloop[i].v);
+    EXPECT_EQ(mesh_result->mloop[i].e, mesh->mloop[i].e);
+    EXPECT_TRUE(equals_v2v2(mesh_result->mloopuv[i].uv, mesh->mloopuv[i].uv));
+  }
+
+  BKE_id_free(NULL, mesh_result);
+  BKE_id_free(NULL, mesh);
+}
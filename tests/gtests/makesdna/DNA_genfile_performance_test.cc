@@ -0,0 +1,60 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+
+#include "DNA_genfile.h"
+#include "DNA_sdna_types.h"
+#include "DNA_view2d_types.h"
+
+#include "PIL_time_utildefines.h"
+}
+
+/* Number of struct instances reconstructed per block (as read from a file). */
+#define BLOCK_LEN 1000
+/* Number of blocks reconstructed. */
+#define BLOCKS_NUM 1000
+
+/* Reconstruct blocks of structs as done when loading a file saved by an older version,
+ * the old SDNA is simulated by renaming a member of a commonly nested struct. */
+TEST(dna_genfile, StructReconstructPerformance)
+{
+  const SDNA *sdna_new = DNA_sdna_from_data(DNAstr, DNAlen, false, false, NULL);
+  SDNA *sdna_old = DNA_sdna_from_data(DNAstr, DNAlen, false, true, NULL);
+  DNA_sdna_patch_struct_member(sdna_old, "rctf", "xmin", "xmin_legacy");
+
+  const char *compflags = DNA_struct_get_compareflags(sdna_old, sdna_new);
+  const int struct_nr = DNA_struct_find_nr(sdna_old, "View2D");
+
+  View2D *data = (View2D *)MEM_calloc_arrayN(BLOCK_LEN, sizeof(*data), __func__);
+
+  printf("\n========== STARTING %s ==========\n", __func__);
+
+  {
+    DNA_ReconstructInfo *reconstruct_info;
+
+    TIMEIT_START(reconstruct_info_create);
+    reconstruct_info = DNA_reconstruct_info_create(sdna_old, sdna_new, compflags);
+    TIMEIT_END(reconstruct_info_create);
+
+    TIMEIT_START(struct_reconstruct);
+    for (int i = 0; i < BLOCKS_NUM; i++) {
+      void *data_new = DNA_struct_reconstruct(reconstruct_info, struct_nr, BLOCK_LEN, data);
+      MEM_freeN(data_new);
+    }
+    TIMEIT_END(struct_reconstruct);
+
+    DNA_reconstruct_info_free(reconstruct_info);
+  }
+
+  printf("========== ENDED %s ==========\n\n", __func__);
+
+  MEM_freeN(data);
+  MEM_freeN((void *)compflags);
+  DNA_sdna_free(sdna_old);
+  DNA_sdna_free((SDNA *)sdna_new);
+}
@@ -0,0 +1,86 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+
+#include "DNA_genfile.h"
+#include "DNA_sdna_types.h"
+#include "DNA_vec_types.h"
+#include "DNA_view2d_types.h"
+}
+
+/* Simulate a file saved by an older Blender version, by renaming struct members
+ * of the current SDNA (the memory layout of the data stays the same). */
+static SDNA *sdna_old_create(void)
+{
+  SDNA *sdna = DNA_sdna_from_data(DNAstr, DNAlen, false, true, NULL);
+  EXPECT_TRUE(DNA_sdna_patch_struct_member(sdna, "rctf", "xmin", "xmin_legacy"));
+  return sdna;
+}
+
+static void view2d_fill(View2D *v2d, int seed)
+{
+  unsigned char *data = (unsigned char *)v2d;
+  for (size_t i = 0; i < sizeof(*v2d); i++) {
+    data[i] = (unsigned char)(i + seed);
+  }
+}
+
+TEST(dna_genfile, CompareFlags)
+{
+  const SDNA *sdna_new = DNA_sdna_from_data(DNAstr, DNAlen, false, false, NULL);
+  SDNA *sdna_old = sdna_old_create();
+
+  const char *compflags = DNA_struct_get_compareflags(sdna_old, sdna_new);
+  EXPECT_EQ(compflags[DNA_struct_find_nr(sdna_old, "rctf")], SDNA_CMP_NOT_EQUAL);
+  /* Structs containing a changed struct change too. */
+  EXPECT_EQ(compflags[DNA_struct_find_nr(sdna_old, "View2D")], SDNA_CMP_NOT_EQUAL);
+  EXPECT_EQ(compflags[DNA_struct_find_nr(sdna_old, "rcti")], SDNA_CMP_EQUAL);
+
+  MEM_freeN((void *)compflags);
+  DNA_sdna_free(sdna_old);
+  DNA_sdna_free((SDNA *)sdna_new);
+}
+
+TEST(dna_genfile, StructReconstruct)
+{
+  const SDNA *sdna_new = DNA_sdna_from_data(DNAstr, DNAlen, false, false, NULL);
+  SDNA *sdna_old = sdna_old_create();
+
+  const char *compflags = DNA_struct_get_compareflags(sdna_old, sdna_new);
+  DNA_ReconstructInfo *reconstruct_info = DNA_reconstruct_info_create(
+      sdna_old, sdna_new, compflags);
+
+  const int blocks = 3;
+  View2D v2d_old[blocks];
+  for (int i = 0; i < blocks; i++) {
+    view2d_fill(&v2d_old[i], i);
+  }
+
+  View2D *v2d_new = (View2D *)DNA_struct_reconstruct(
+      reconstruct_info, DNA_struct_find_nr(sdna_old, "View2D"), blocks, v2d_old);
+  ASSERT_NE(v2d_new, nullptr);
+
+  for (int i = 0; i < blocks; i++) {
+    /* Renamed members are no longer found, they are zero initialized. */
+    EXPECT_EQ(v2d_new[i].tot.xmin, 0.0f);
+    EXPECT_EQ(v2d_new[i].cur.xmin, 0.0f);
+
+    /* Everything else is copied (except padding). */
+    View2D v2d_expect = v2d_old[i];
+    v2d_expect.tot.xmin = 0.0f;
+    v2d_expect.cur.xmin = 0.0f;
+    memset(v2d_expect._pad, 0, sizeof(v2d_expect._pad));
+    EXPECT_EQ(memcmp(&v2d_expect, &v2d_new[i], sizeof(View2D)), 0);
+  }
+
+  MEM_freeN(v2d_new);
+  DNA_reconstruct_info_free(reconstruct_info);
+  MEM_freeN((void *)compflags);
+  DNA_sdna_free(sdna_old);
+  DNA_sdna_free((SDNA *)sdna_new);
+}